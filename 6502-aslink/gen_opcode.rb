@@ -1,40 +1,99 @@
-require 'hpricot'
-
 #this reads opcode taken from here:
 #http://www.xmission.com/~trevin/atari/6502_opcodes.html
-#and creates an hash of all the opcodes available
+#and writes them out as opcodes.def, the descriptor table shared with the emulator
+#(mnemonic, addressing mode, length, base cycles, page-crossing penalty for all 256 opcodes)
+#
+#the assembler only ever reads opcodes.def, so the emulator, its disassembler
+#and the assembler can't disagree on an opcode
+#
+#to regenerate: ruby gen_opcode.rb
 class GenOpCode
-  
+
+  #columns of opcode_table, in the same order as the addressing modes in Assembler
+  MODES = [ "IMPLIED", "ACCUM", "IMMEDIATE", "Z_PAGE", "Z_PAGE_X", "Z_PAGE_Y", "IND_X",
+    "IND_Y", "ABS_X", "ABS_Y", "ABSOLUTE", "INDIRECT", "RELATIVE" ]
+
+  #undocumented opcodes are marked with a '*' in opcode_table, except for these
+  UNDOCUMENTED = [ "ASR" ]
+
+  #read instrs that take an extra cycle when their indexed addr crosses a page
+  #(opcode_table has no column for this)
+  PAGE_PENALTY_INSTR = [ "ADC", "AND", "CMP", "EOR", "LDA", "LDX", "LDY", "ORA", "SBC" ]
+  PAGE_PENALTY_MODES = [ "ABS_X", "ABS_Y", "IND_Y" ]
+
   def initialize
-    @GenOpCode_width = 40
-    @GenOpCode_start = 54
+    @GenOpCode_html = File.join(File.dirname(__FILE__), "opcode_table")
+    @GenOpCode_def = File.join(File.dirname(__FILE__), "..", "6502-cpu-emulator", "6502", "opcodes.def")
   end
-  
+
+  #returns a hash of all the opcodes available
+  #ex: instr_set["LDA"][IMMEDIATE] == "A9"
   def emit_table
     instr_set = Hash.new
-    h = Hpricot(open("opcode_table"))
-    arr = h.search("td")
-    
-    i = 0;
-    j = (arr.size - @GenOpCode_start) / @GenOpCode_width
-    
-    while i < j do
-      temp = arr[@GenOpCode_start +i * @GenOpCode_width,@GenOpCode_width]
-      
-      tarr = Array.new
-      instr_name = temp.shift.inner_html
-
-      temp.each_index{ |k|
-        tarr[k.div(3)] = temp[k].inner_html if k%3 == 0 and temp[k].inner_html != ""
+
+    File.open(@GenOpCode_def).each_line{ |line|
+      next if line !~ /^OPCODE_DESC\(\s*0x([0-9A-F]{2}),\s*(\w+),\s*(\w+),/
+      next if $2 == "INVALID"
+
+      instr_set[$2] = Array.new if ! instr_set.has_key?($2)
+      instr_set[$2][ MODES.index($3) ] = $1
+    }
+
+    instr_set
+  end
+
+  #scrapes opcode_table and writes opcodes.def
+  def emit_def
+    ops = Array.new(256)
+
+    html = File.open(@GenOpCode_html, "rb"){ |f| f.read }
+    html.scan(/<tr[^>]*>(.*?)<\/tr>/m){ |row|
+      cells = row[0].scan(/<td[^>]*>(.*?)<\/td>/m).map{ |c| c[0].split(/<br>/).map{ |s| s.strip } }
+      next if cells.size != 1 + MODES.size * 3
+
+      #a row can hold several instrs, ex: "SBC<br>SBC *"
+      names = cells.shift
+
+      MODES.each_index{ |m|
+        codes, lengths, cycles = cells[m * 3, 3]
+
+        codes.each_index{ |k|
+          name = names[ [k, names.size - 1].min ]
+          next if name.index("*") != nil or UNDOCUMENTED.include?(name)
+
+          base = cycles[k].to_i
+          penalty = 0
+          penalty = 1 if PAGE_PENALTY_MODES.include?(MODES[m]) and PAGE_PENALTY_INSTR.include?(name)
+
+          #branches are listed with a footnote instead of cycles:
+          #2, one more if taken and another one if that lands on a different page
+          if MODES[m] == "RELATIVE"
+            base = 2
+            penalty = 1
+          end
+
+          ops[ codes[k].hex ] = [name, MODES[m], lengths[k].to_i, base, penalty]
+        }
       }
-      instr_set[ instr_name ] = tarr
-    
-      #other stuff happens
-      i += 1
-    end
-    
-    instr_set.delete_if{ |k,v| k.index("*")  != nil }
+    }
+
+    File.open(@GenOpCode_def, "w"){ |f|
+      f.print "//generated by 6502-aslink/gen_opcode.rb from opcode_table, do not edit\n"
+      f.print "//\n"
+      f.print "//OPCODE_DESC( opcode, mnemonic, addressing mode, length, base cycles, page-crossing penalty )\n"
+      f.print "//for branches the penalty is for the branch being taken; crossing a page costs it once more\n"
+      f.print "//opcodes not in the table are INVALID\n"
+      f.print "\n"
+
+      ops.each_index{ |i|
+        op = ops[i] || ["INVALID", "NONE", 1, 0, 0]
+        f.printf "OPCODE_DESC( 0x%02X, %s, %s, %d, %d, %d )\n", i, op[0], op[1], op[2], op[3], op[4]
+      }
+    }
   end
-  
-  
-end
\ No newline at end of file
+
+end
+
+if __FILE__ == $0
+  GenOpCode.new.emit_def
+end
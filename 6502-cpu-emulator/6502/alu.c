@@ -0,0 +1,127 @@
+/* These are the precomputed ALU tables; each arithmetic instr is a single lookup into them  */
+
+#include <stdio.h>
+
+#include "alu.h"
+
+#ifdef ENABLE_ALU_TABLES
+
+unsigned short alu_adc[2][256][256];
+unsigned short alu_sbc[2][256][256];
+unsigned char alu_cmp[256][256];
+unsigned short alu_asl[256];
+unsigned short alu_lsr[256];
+unsigned short alu_rol[2][2][256];
+unsigned short alu_ror[2][256];
+unsigned char alu_nz[256];
+
+static int alu_tables_built = 0;
+
+//puts a result and the flags it set together into an entry
+static unsigned short alu_entry( unsigned char res, unsigned char P )
+{
+	return res | (P << 8);
+}
+
+/**************************************
+ * Name:  build_alu_tables
+ * Inputs:  None
+ * Outputs: None
+ * Function: works out every entry of the tables, the same way the instrs' macros
+ * 			 would; only does anything the first time it's called
+ *
+***************************************/
+void build_alu_tables( void )
+{
+	unsigned int c;
+	unsigned int n;
+	unsigned int a;
+	unsigned int m;
+	unsigned char ch1;
+	unsigned char ch2;
+	unsigned char res;
+	unsigned char P;
+
+	if ( alu_tables_built )
+	{
+		return;
+	}
+
+	for ( a = 0; a < 256; a++ )
+	{
+		ch1 = a;
+
+		P = 0;
+		TEST_AND_SET_ZERO(P, ch1) ;
+		TEST_AND_SET_NEG(P, ch1) ;
+		alu_nz[a] = P;
+
+		for ( m = 0; m < 256; m++ )
+		{
+			for ( c = 0; c < 2; c++ )
+			{
+				//ADC, carry in doesnt count towards C and V
+				ch2 = m;
+				res = (ch1 + ch2) + c;
+				P = 0;
+				TEST_AND_SET_ZERO(P, res) ;
+				TEST_AND_SET_NEG(P, res) ;
+				TEST_AND_SET_CARRY_ADDITION(P, ch1, ch2 ) ;
+				TEST_AND_SET_V_OVERFLOW_ADDITION(P, ch1, ch2);
+				alu_adc[c][a][m] = alu_entry(res, P);
+
+				//SBC, the borrow goes into M first
+				ch2 = m + (1 - c);
+				res = ch1 - ch2;
+				P = 0;
+				TEST_AND_SET_ZERO(P, res) ;
+				TEST_AND_SET_NEG(P, res) ;
+				TEST_AND_SET_CARRY_SUBTRACTION(P, ch1, ch2 ) ;
+				TEST_AND_SET_V_OVERFLOW_SUBTRACTION(P, ch1, ch2);
+				alu_sbc[c][a][m] = alu_entry(res, P);
+			}
+
+			//CMP/CPX/CPY
+			ch2 = m;
+			res = ch1 - ch2;
+			P = 0;
+			TEST_AND_SET_ZERO(P, res) ;
+			TEST_AND_SET_NEG(P, res) ;
+			TEST_AND_SET_CARRY_SUBTRACTION(P, ch1, ch2 ) ;
+			alu_cmp[a][m] = P;
+		}
+	}
+
+	for ( m = 0; m < 256; m++ )
+	{
+		//ASL, bit 7 goes into C
+		res = m << 1;
+		P = alu_nz[res] | (m >> 7);
+		alu_asl[m] = alu_entry(res, P);
+
+		//LSR, bit 0 goes into C
+		res = m >> 1;
+		P = alu_nz[res] | (m & 0x01);
+		alu_lsr[m] = alu_entry(res, P);
+
+		for ( c = 0; c < 2; c++ )
+		{
+			//ROL, C goes into bit 0 and N into C
+			for ( n = 0; n < 2; n++ )
+			{
+				res = (m << 1) | c;
+				P = alu_nz[res] | n;
+				alu_rol[n][c][m] = alu_entry(res, P);
+			}
+
+			//ROR, C goes into bit 7 and bit 0 into C
+			res = (m >> 1) | (c << 7);
+			P = alu_nz[res] | (m & 0x01);
+			alu_ror[c][m] = alu_entry(res, P);
+		}
+	}
+
+	alu_tables_built = 1;
+}
+
+#endif
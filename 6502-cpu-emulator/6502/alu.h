@@ -0,0 +1,38 @@
+#ifndef ALU_H
+#define ALU_H
+
+#include "em_6502.h"
+
+#ifdef ENABLE_ALU_TABLES
+
+//the P bits an entry can set
+#define ALU_NZCV 0xC3
+#define ALU_NZC 0x83
+#define ALU_NZ 0x82
+
+//entries that have a result keep it in their low byte, and the flags in their high byte
+#define ALU_RESULT(entry) ((unsigned char)(entry))
+#define ALU_FLAGS(entry) ((entry) >> 8)
+
+extern unsigned short alu_adc[2][256][256]; //[C][A][M]
+extern unsigned short alu_sbc[2][256][256]; //[C][A][M]
+extern unsigned char alu_cmp[256][256]; //[reg][M], flags only
+extern unsigned short alu_asl[256]; //[M]
+extern unsigned short alu_lsr[256]; //[M]
+extern unsigned short alu_rol[2][2][256]; //[N][C][M], ROL shifts N into C, see INSTR_ROL
+extern unsigned short alu_ror[2][256]; //[C][M]
+extern unsigned char alu_nz[256]; //[val], the N and Z flags everything else sets
+
+/**************************************
+ * Name:  build_alu_tables
+ * Inputs:  None
+ * Outputs: None
+ * Function: works out every entry of the tables, the same way the instrs' macros
+ * 			 would; only does anything the first time it's called
+ *
+***************************************/
+void build_alu_tables( void );
+
+#endif
+
+#endif /* ALU_H */
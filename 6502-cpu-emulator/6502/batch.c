@@ -0,0 +1,427 @@
+/* This is the batch runner; it runs lots of independent programs across a pool of threads  */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <pthread.h>
+#include <unistd.h>
+
+#include "batch.h"
+#include "alu.h"
+
+#ifdef ENABLE_BATCH
+
+/*
+ * The jobs get split evenly between the threads up front. Each thread works
+ * through its own share from the front, and once that runs out, takes jobs off
+ * the back of whichever other thread still has some. A thread keeps one
+ * emulator for all of its jobs and resets it in between, which is a lot
+ * cheaper than making a new one, and leaves nothing from one job to the next.
+ */
+
+//a thread in the pool, and the jobs it has left
+typedef struct {
+	pthread_mutex_t lock; //guards next and end; other threads steal from end
+	unsigned int next; //the next job it runs itself
+	unsigned int end; //one past its last job
+	pthread_t thread;
+	unsigned char started; //1 once thread is running; the others steal the jobs of one that couldnt start
+	unsigned int id;
+	struct batch_pool *pool;
+}batch_worker;
+
+struct batch_pool {
+	batch_job *jobs;
+	batch_result *results;
+	batch_worker *workers;
+	unsigned int num_workers;
+};
+
+
+//the job the worker should run next, -1 once there are none left anywhere
+static int take_job( batch_worker *worker )
+{
+	struct batch_pool *pool = worker->pool;
+	batch_worker *victim;
+	unsigned int i;
+	int job = -1;
+
+	pthread_mutex_lock(&worker->lock);
+	if ( worker->next < worker->end )
+	{
+		job = worker->next++;
+	}
+	pthread_mutex_unlock(&worker->lock);
+
+	//steal from the others, starting with the next one along so they dont all pick on the same one
+	for ( i = 1; job < 0 && i < pool->num_workers; i++ )
+	{
+		victim = &pool->workers[(worker->id + i) % pool->num_workers];
+
+		pthread_mutex_lock(&victim->lock);
+		if ( victim->next < victim->end )
+		{
+			job = --victim->end;
+		}
+		pthread_mutex_unlock(&victim->lock);
+	}
+
+	return job;
+}
+
+//64-bit FNV-1a
+static unsigned long long hash_memory( const unsigned char *mem, size_t size )
+{
+	unsigned long long hash = 0xCBF29CE484222325ULL;
+	size_t i;
+
+	for ( i = 0; i < size; i++ )
+	{
+		hash ^= mem[i];
+		hash *= 0x100000001B3ULL;
+	}
+
+	return hash;
+}
+
+//puts the job's binary in memory, 0 if it couldnt
+static int load_job( em6502 *emu, const batch_job *job )
+{
+	unsigned char *buffer = 0;
+	const unsigned char *image = job->image;
+	size_t size = job->image_size;
+	FILE *file;
+
+	if ( image == 0 )
+	{
+		file = fopen(job->path, "rb");
+		if ( file == 0 )
+		{
+			return 0;
+		}
+
+		buffer = (unsigned char *)malloc(MEMORY_SIZE + 1);
+		size = fread(buffer, 1, MEMORY_SIZE + 1, file);
+		fclose(file);
+		image = buffer;
+	}
+
+	if ( size > MEMORY_SIZE - job->load_addr )
+	{
+		free(buffer);
+		return 0;
+	}
+
+	load_memory(emu, image, size, job->load_addr);
+
+	free(buffer);
+	return 1;
+}
+
+//runs a single job on the worker's emulator
+static void run_job( em6502 *emu, const batch_job *job, batch_result *result )
+{
+	memset(result, 0, sizeof(batch_result));
+
+	reset_em6502(emu);
+	emu->stop_at_brk = 1;
+
+	if ( !load_job(emu, job) )
+	{
+		result->stop = STOP_LOAD_ERROR;
+		return;
+	}
+
+	emu->PC = job->start_pc;
+	result->stop = run_program_cycles(emu, job->max_instrs, job->max_cycles);
+
+	result->Acc = emu->Acc;
+	result->X = emu->X;
+	result->Y = emu->Y;
+	result->P = emu->P;
+	result->S = emu->S;
+	result->PC = emu->PC;
+	result->instr_count = emu->instr_count;
+	result->cycles = emu->cycles;
+	result->mem_hash = hash_memory(emu->_memory, MEMORY_SIZE);
+}
+
+//a thread of the pool; runs jobs until there are none left
+static void *batch_thread( void *arg )
+{
+	batch_worker *worker = (batch_worker *)arg;
+	struct batch_pool *pool = worker->pool;
+	em6502 emu;
+	int job;
+
+	initialize_em6502(&emu);
+	create_simple_memory_map(&emu);
+
+	while ( (job = take_job(worker)) >= 0 )
+	{
+		run_job(&emu, &pool->jobs[job], &pool->results[job]);
+	}
+
+	destroy_em6502(&emu);
+	return 0;
+}
+
+
+/**************************************
+ * Name:  run_batch
+ * Inputs:  batch_job * - the jobs
+ * 			batch_result * - a result for each of them
+ * 			unsigned int - number of jobs
+ * 			unsigned int - number of threads to run them on
+ * Outputs: None
+ * Function: runs every job on its own emulator, across a pool of threads that
+ * 			 steal each other's jobs once theirs run out. Each job starts from a
+ * 			 freshly reset emulator, with stop_at_brk set so a BRK ends it
+ *
+***************************************/
+void run_batch( batch_job *jobs, batch_result *results, unsigned int count, unsigned int threads )
+{
+	struct batch_pool pool;
+	batch_worker *worker;
+	unsigned int i;
+
+	if ( threads == 0 )
+	{
+		threads = 1;
+	}
+	if ( threads > count )
+	{
+		threads = count == 0 ? 1 : count;
+	}
+
+	#ifdef ENABLE_ALU_TABLES
+	//shared by every emulator; built here so the threads dont race to do it
+	build_alu_tables();
+	#endif
+
+	pool.jobs = jobs;
+	pool.results = results;
+	pool.num_workers = threads;
+	pool.workers = (batch_worker *)calloc(threads, sizeof(batch_worker));
+
+	for ( i = 0; i < threads; i++ )
+	{
+		worker = &pool.workers[i];
+		pthread_mutex_init(&worker->lock, 0);
+		worker->next = (unsigned long long)count * i / threads;
+		worker->end = (unsigned long long)count * (i + 1) / threads;
+		worker->id = i;
+		worker->pool = &pool;
+	}
+
+	//this thread is worker 0
+	for ( i = 1; i < threads; i++ )
+	{
+		pool.workers[i].started = pthread_create(&pool.workers[i].thread, 0, batch_thread, &pool.workers[i]) == 0;
+	}
+	batch_thread(&pool.workers[0]);
+	for ( i = 1; i < threads; i++ )
+	{
+		if ( pool.workers[i].started )
+		{
+			pthread_join(pool.workers[i].thread, 0);
+		}
+	}
+
+	for ( i = 0; i < threads; i++ )
+	{
+		pthread_mutex_destroy(&pool.workers[i].lock);
+	}
+	free(pool.workers);
+}
+
+
+/**************************************
+ * Name:  read_manifest
+ * Inputs:  const char * - path of the manifest
+ * 			batch_job ** - where to put the jobs; malloc'ed, for the caller to free
+ * Outputs: int - how many jobs there are, -1 if it couldnt be read
+ * Function: reads a job from each line that isnt empty or a # comment:
+ * 			 path load_addr [start_pc [max_instrs [max_cycles]]]
+ * 			 numbers are in C syntax (0x0600, 1536); start_pc defaults to load_addr,
+ * 			 the budgets to BATCH_DEFAULT_MAX_INSTRS and no cycle limit
+ *
+***************************************/
+int read_manifest( const char *path, batch_job **jobs )
+{
+	FILE *file;
+	char line[BATCH_MAX_PATH + 128];
+	char name[BATCH_MAX_PATH];
+	char format[64];
+	int name_end;
+	unsigned int load_addr;
+	unsigned int start_pc;
+	unsigned int max_instrs;
+	unsigned long long max_cycles;
+	unsigned int size = 0;
+	int count = 0;
+	int fields;
+	batch_job *job;
+
+	file = fopen(path, "r");
+	if ( file == 0 )
+	{
+		return -1;
+	}
+
+	//the path takes as much of name as there is, and no more
+	sprintf(format, "%%%ds%%n %%i %%i %%i %%lli", BATCH_MAX_PATH - 1);
+
+	*jobs = 0;
+	while ( fgets(line, sizeof(line), file) != 0 )
+	{
+		name_end = 0;
+		fields = sscanf(line, format, name, &name_end, (int *)&load_addr, (int *)&start_pc,
+						(int *)&max_instrs, (long long *)&max_cycles);
+
+		//a line too long for line doesnt get to its newline, and the rest of it would be read as the next one
+		if ( (fields < 1 || name[0] == '#') && (strchr(line, '\n') != 0 || feof(file)) )
+		{
+			continue;
+		}
+
+		//and a path too long for name stops short of the space after it, so the rest would be misread
+		if ( fields < 2 || load_addr >= MEMORY_SIZE || !isspace((unsigned char)line[name_end]) ||
+			 (strchr(line, '\n') == 0 && !feof(file)) )
+		{
+			printf("%s: bad line: %s", path, line);
+			fclose(file);
+			free(*jobs);
+			return -1;
+		}
+
+		if ( count == size )
+		{
+			size = size == 0 ? 64 : size * 2;
+			*jobs = (batch_job *)realloc(*jobs, size * sizeof(batch_job));
+		}
+
+		job = &(*jobs)[count++];
+		memset(job, 0, sizeof(batch_job));
+		strcpy(job->path, name);
+		job->load_addr = load_addr;
+		job->start_pc = fields > 2 ? start_pc : load_addr;
+		job->max_instrs = fields > 3 ? max_instrs : BATCH_DEFAULT_MAX_INSTRS;
+		job->max_cycles = fields > 4 ? max_cycles : NO_CYCLE_LIMIT;
+	}
+
+	fclose(file);
+	return count;
+}
+
+
+//what batch_result->stop comes out as
+static const char *stop_name( int stop )
+{
+	switch ( stop )
+	{
+		case STOP_BUDGET: return "budget";
+		case STOP_INVALID_OPCODE: return "invalid_opcode";
+		case STOP_BRK: return "brk";
+		case STOP_BREAKPOINT: return "breakpoint";
+		case STOP_LOAD_ERROR: return "load_error";
+	}
+
+	return "unknown";
+}
+
+/**************************************
+ * Name:  write_result_json
+ * Inputs:  FILE * - where to write
+ * 			unsigned int - the job's index in the manifest
+ * 			const batch_job * - the job
+ * 			const batch_result * - how it ended up
+ * Outputs: None
+ * Function: writes the result as a single line of JSON
+ *
+***************************************/
+void write_result_json( FILE *out, unsigned int index, const batch_job *job, const batch_result *result )
+{
+	const char *c;
+
+	fprintf(out, "{\"job\":%u,\"path\":\"", index);
+	for ( c = job->path; *c != 0; c++ )
+	{
+		if ( *c == '"' || *c == '\\' )
+		{
+			fputc('\\', out);
+			fputc(*c, out);
+		}
+		else if ( (unsigned char)*c < 0x20 )
+		{
+			fprintf(out, "\\u%04x", *c);
+		}
+		else
+		{
+			fputc(*c, out);
+		}
+	}
+
+	fprintf(out, "\",\"exit\":\"%s\"", stop_name(result->stop));
+	if ( result->stop != STOP_LOAD_ERROR )
+	{
+		fprintf(out, ",\"pc\":%u,\"a\":%u,\"x\":%u,\"y\":%u,\"p\":%u,\"s\":%u"
+					 ",\"instrs\":%u,\"cycles\":%llu,\"mem_hash\":\"%016llx\"",
+				result->PC, result->Acc, result->X, result->Y, result->P, result->S,
+				result->instr_count, result->cycles, result->mem_hash);
+	}
+	fprintf(out, "}\n");
+}
+
+
+/**************************************
+ * Name:  run_batch_cli
+ * Inputs:  int - number of args
+ * 			char ** - the args: manifest [threads]
+ * Outputs: int - exit code for main; 0 once every job has run, whatever they did
+ * Function: runs the jobs in a manifest and writes their results to stdout as
+ * 			 JSON lines, in manifest order; threads defaults to one per core
+ *
+***************************************/
+int run_batch_cli( int argc, char **argv )
+{
+	batch_job *jobs;
+	batch_result *results;
+	long threads;
+	int count;
+	int i;
+
+	if ( argc < 1 )
+	{
+		printf("usage: --batch manifest [threads]\n");
+		return 1;
+	}
+
+	count = read_manifest(argv[0], &jobs);
+	if ( count < 0 )
+	{
+		printf("could not read manifest %s\n", argv[0]);
+		return 1;
+	}
+
+	threads = argc > 1 ? atol(argv[1]) : sysconf(_SC_NPROCESSORS_ONLN);
+	if ( threads < 1 )
+	{
+		threads = 1;
+	}
+
+	results = (batch_result *)malloc((count + 1) * sizeof(batch_result));
+	run_batch(jobs, results, count, threads);
+
+	for ( i = 0; i < count; i++ )
+	{
+		write_result_json(stdout, i, &jobs[i], &results[i]);
+	}
+
+	free(results);
+	free(jobs);
+	return 0;
+}
+
+#endif
@@ -0,0 +1,96 @@
+#ifndef BATCH_H
+#define BATCH_H
+
+#include <stdio.h>
+
+#include "em_6502.h"
+
+#ifdef ENABLE_BATCH
+
+//longest path a manifest line can have
+#define BATCH_MAX_PATH 256
+
+//budget for a job whose manifest line doesnt give one
+#define BATCH_DEFAULT_MAX_INSTRS 10000000
+
+//batch_result->stop for a job whose binary couldnt be loaded
+#define STOP_LOAD_ERROR -1
+
+//a program to run, see read_manifest
+typedef struct {
+	char path[BATCH_MAX_PATH]; //raw binary to load
+	const unsigned char *image; //or, when not 0, the bytes themselves; path is then just a name for them
+	size_t image_size;
+	unsigned short load_addr; //where it goes in memory
+	unsigned short start_pc; //where it starts running
+	unsigned int max_instrs; //stops after this many instrs
+	unsigned long long max_cycles; //or this many cycles, whichever comes first
+}batch_job;
+
+//how a job ended up
+typedef struct {
+	int stop; //why it stopped, one of STOP_*, or STOP_LOAD_ERROR
+	unsigned char Acc, X, Y, P, S;
+	unsigned short PC;
+	unsigned int instr_count;
+	unsigned long long cycles;
+	unsigned long long mem_hash; //64-bit FNV-1a of all of memory
+}batch_result;
+
+
+/**************************************
+ * Name:  read_manifest
+ * Inputs:  const char * - path of the manifest
+ * 			batch_job ** - where to put the jobs; malloc'ed, for the caller to free
+ * Outputs: int - how many jobs there are, -1 if it couldnt be read
+ * Function: reads a job from each line that isnt empty or a # comment:
+ * 			 path load_addr [start_pc [max_instrs [max_cycles]]]
+ * 			 numbers are in C syntax (0x0600, 1536); start_pc defaults to load_addr,
+ * 			 the budgets to BATCH_DEFAULT_MAX_INSTRS and no cycle limit
+ *
+***************************************/
+int read_manifest( const char *, batch_job ** );
+
+
+/**************************************
+ * Name:  run_batch
+ * Inputs:  batch_job * - the jobs
+ * 			batch_result * - a result for each of them
+ * 			unsigned int - number of jobs
+ * 			unsigned int - number of threads to run them on
+ * Outputs: None
+ * Function: runs every job on its own emulator, across a pool of threads that
+ * 			 steal each other's jobs once theirs run out. Each job starts from a
+ * 			 freshly reset emulator, with stop_at_brk set so a BRK ends it
+ *
+***************************************/
+void run_batch( batch_job *, batch_result *, unsigned int, unsigned int );
+
+
+/**************************************
+ * Name:  write_result_json
+ * Inputs:  FILE * - where to write
+ * 			unsigned int - the job's index in the manifest
+ * 			const batch_job * - the job
+ * 			const batch_result * - how it ended up
+ * Outputs: None
+ * Function: writes the result as a single line of JSON
+ *
+***************************************/
+void write_result_json( FILE *, unsigned int, const batch_job *, const batch_result * );
+
+
+/**************************************
+ * Name:  run_batch_cli
+ * Inputs:  int - number of args
+ * 			char ** - the args: manifest [threads]
+ * Outputs: int - exit code for main; 0 once every job has run, whatever they did
+ * Function: runs the jobs in a manifest and writes their results to stdout as
+ * 			 JSON lines, in manifest order; threads defaults to one per core
+ *
+***************************************/
+int run_batch_cli( int, char ** );
+
+#endif
+
+#endif /* BATCH_H */
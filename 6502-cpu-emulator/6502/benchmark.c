@@ -0,0 +1,197 @@
+//this times the emulator on a handful of real programs
+//numbers are in millions of 6502 instrs per second of host cpu time
+
+#include <stdio.h>
+#include <time.h>
+
+#include "benchmark.h"
+#include "em_6502.h"
+#include "profile.h"
+#include "definitions.h"
+
+
+//how many instrs each program gets to run
+#define BENCHMARK_INSTR_COUNT 50000000
+
+//run_program gets called with this many instrs at a time
+#define BENCHMARK_SLICE 100000
+
+//how many fusion candidates to list for each program, when profiling
+#define BENCHMARK_PROFILE_LEN 10
+
+#ifdef ENABLE_DYNAREC
+//engine the programs get run on
+static unsigned char bench_engine = ENGINE_INTERPRETER;
+#endif
+
+#ifdef ENABLE_FUSION
+//whether the interpreter fuses instrs while they run
+static unsigned char bench_fusion = 1;
+#endif
+
+
+//progs/disco.as, as compiled by 6502-aslink
+//loads at $0600
+unsigned char bench_disco[] = {
+0xE8, 0x8A, 0x99, 0x00, 0x02, 0x99, 0x00, 0x03,
+0x99, 0x00, 0x04, 0x99, 0x00, 0x05, 0xC8, 0x98,
+0xC5, 0x10, 0xD0, 0x04, 0xC8, 0x4C, 0x00, 0x06,
+0xC8, 0xC8, 0xC8, 0xC8, 0x4C, 0x00, 0x06
+};
+
+//progs/alive.as
+//loads at $0600
+unsigned char bench_alive[] = {
+0xA9, 0x0F, 0x85, 0x00, 0x85, 0x01, 0xA5, 0xFE,
+0x29, 0x03, 0xC9, 0x00, 0xF0, 0x2F, 0xC9, 0x01,
+0xF0, 0x30, 0xC9, 0x02, 0xF0, 0x22, 0xC6, 0x01,
+0xA5, 0x01, 0x29, 0x1F, 0x0A, 0xAA, 0xBD, 0x47,
+0x06, 0x85, 0x02, 0xE8, 0xBD, 0x47, 0x06, 0x85,
+0x03, 0xA5, 0x00, 0x29, 0x1F, 0xA8, 0xB1, 0x02,
+0xAA, 0xE8, 0x8A, 0x91, 0x02, 0x4C, 0x06, 0x06,
+0xE6, 0x01, 0x4C, 0x18, 0x06, 0xC6, 0x00, 0x4C,
+0x18, 0x06, 0xE6, 0x00, 0x4C, 0x18, 0x06,
+0x00, 0x02, 0x20, 0x02, 0x40, 0x02, 0x60, 0x02,
+0x80, 0x02, 0xA0, 0x02, 0xC0, 0x02, 0xE0, 0x02,
+0x00, 0x03, 0x20, 0x03, 0x40, 0x03, 0x60, 0x03,
+0x80, 0x03, 0xA0, 0x03, 0xC0, 0x03, 0xE0, 0x03,
+0x00, 0x04, 0x20, 0x04, 0x40, 0x04, 0x60, 0x04,
+0x80, 0x04, 0xA0, 0x04, 0xC0, 0x04, 0xE0, 0x04,
+0x00, 0x05, 0x20, 0x05, 0x40, 0x05, 0x60, 0x05,
+0x80, 0x05, 0xA0, 0x05, 0xC0, 0x05, 0xE0, 0x05
+};
+
+//the bouncing pixel from program_1.h
+//loads at $0000
+unsigned char bench_bounce[] = {
+0xA9, 0x0F, 0x8D, 0x00, 0x00, 0xA9, 0x04, 0x8D,
+0x01, 0x00, 0xA9, 0x01, 0x8D, 0x02, 0x00, 0xAD,
+0x00, 0x00, 0x8D, 0x03, 0x00, 0xAD, 0x01, 0x00,
+0x8D, 0x04, 0x00, 0xAD, 0x02, 0x00, 0xC9, 0x00,
+0xD0, 0x06, 0xEE, 0x00, 0x00, 0x4C, 0x2B, 0x00,
+0xCE, 0x00, 0x00, 0xAE, 0x02, 0x00, 0xAD, 0x00,
+0x00, 0xC9, 0x1F, 0xD0, 0x05, 0xA2, 0x01, 0x4C,
+0x40, 0x00, 0xC9, 0x00, 0xD0, 0x02, 0xA2, 0x00,
+0x8E, 0x02, 0x00, 0xA9, 0x01, 0xA2, 0x00, 0x81,
+0x00, 0xA9, 0x00, 0xA2, 0x00, 0x81, 0x03, 0x4C,
+0x0F, 0x00
+};
+
+//waits for a key, polling $FF like the easy6502 programs do
+//loads at $0600; nothing ever presses one
+unsigned char bench_wait_key[] = {
+0xA5, 0xFF, 0xF0, 0xFC
+};
+
+//adds, subtracts, shifts and compares a few zero page counters, forever
+//loads at $0600
+unsigned char bench_arith[] = {
+0xA5, 0x00, 0x18, 0x65, 0x01, 0x85, 0x00, 0xA5,
+0x02, 0x69, 0x00, 0x85, 0x02, 0xA5, 0x01, 0x38,
+0xE9, 0x03, 0x85, 0x01, 0x0A, 0x26, 0x03, 0x46,
+0x04, 0x6A, 0x45, 0x00, 0xC9, 0x80, 0x90, 0xE0,
+0xE6, 0x05, 0x4C, 0x00, 0x06
+};
+
+
+/**************************************
+ * Name:  benchmark_program
+ * Inputs:  const char * - name to report
+ *			unsigned char * - the program
+ *			size_t - size of the program
+ *			unsigned int - where to load it
+ * Outputs: None
+ * Function: runs the program for BENCHMARK_INSTR_COUNT instrs and
+ *			 prints how fast that went
+ *
+***************************************/
+void benchmark_program(const char *name, unsigned char *prog, size_t size, unsigned int offset)
+{
+	em6502 emulator;
+	unsigned int left;
+	clock_t start;
+	double secs;
+
+	initialize_em6502( &emulator );
+	create_simple_memory_map( &emulator );
+	memset( emulator._memory, 0, MEMORY_SIZE );
+	load_program( &emulator, prog, size, offset );
+
+	#ifdef ENABLE_DYNAREC
+	emulator.engine = bench_engine;
+	#endif
+
+	#ifdef ENABLE_FUSION
+	emulator.fusion = bench_fusion;
+	#endif
+
+	start = clock();
+	for ( left = BENCHMARK_INSTR_COUNT; left > 0; left -= BENCHMARK_SLICE )
+	{
+		run_program( &emulator, BENCHMARK_SLICE );
+	}
+	secs = (double)(clock() - start) / CLOCKS_PER_SEC;
+
+	printf("%-10s %8.1f M instr/s\n", name, BENCHMARK_INSTR_COUNT / secs / 1000000.0 );
+
+	#ifdef ENABLE_PROFILER
+	print_profile( &emulator, stdout, BENCHMARK_PROFILE_LEN );
+	#endif
+
+	destroy_em6502( &emulator );
+}
+
+
+/**************************************
+ * Name:  benchmark_all
+ * Inputs:  const char * - what the programs are being run on, to report
+ * Outputs: None
+ * Function: runs every benchmark program
+ *
+***************************************/
+void benchmark_all(const char *what)
+{
+	printf("%s:\n", what);
+
+	benchmark_program("disco", bench_disco, sizeof(bench_disco), 0x0600);
+	benchmark_program("alive", bench_alive, sizeof(bench_alive), 0x0600);
+	benchmark_program("bounce", bench_bounce, sizeof(bench_bounce), 0x0000);
+	benchmark_program("wait key", bench_wait_key, sizeof(bench_wait_key), 0x0600);
+	benchmark_program("arith", bench_arith, sizeof(bench_arith), 0x0600);
+}
+
+
+/**************************************
+ * Name:  run_benchmark
+ * Inputs:  None
+ * Outputs: None
+ * Function: runs every benchmark program, on everything the emulator can run them on
+ *
+***************************************/
+void run_benchmark()
+{
+	printf("running benchmark...\n");
+
+	#ifdef ENABLE_THREADED_DISPATCH
+	printf("dispatch: threaded\n");
+	#else
+	printf("dispatch: switch\n");
+	#endif
+
+	#ifdef ENABLE_FUSION
+	//before and after fusing
+	bench_fusion = 0;
+	benchmark_all("interpreter");
+	bench_fusion = 1;
+	benchmark_all("interpreter, fused");
+	#else
+	benchmark_all("interpreter");
+	#endif
+
+	#ifdef ENABLE_DYNAREC
+	bench_engine = ENGINE_DYNAREC;
+	benchmark_all("dynarec");
+	#endif
+
+	printf("...finished benchmark!\n");
+}
@@ -0,0 +1,11 @@
+#ifndef BENCHMARK_H
+#define BENCHMARK_H
+
+//main benchmark entrance
+void run_benchmark();
+
+//where we define if we run the benchmark
+//#define RUN_BENCHMARK 1
+
+
+#endif /* BENCHMARK_H */
@@ -0,0 +1,242 @@
+/* This is the Atari 2600 cartridge mapper; it bank switches by repointing pages, rather than copying ROM  */
+
+#include <stdlib.h>
+#include "assert.h"
+
+#include "cartridge.h"
+
+#ifdef ENABLE_CARTRIDGE
+
+/*
+ * Every page of the cartridge's 4K, in every mirror, points straight into the ROM
+ * image. Touching a hotspot calls switch_bank, which repoints the pages of a window
+ * at another slice with switch_page_data; that also swaps out the code decoded and
+ * translated from the slice going out, so coming back to it doesnt decode it all
+ * again. The hotspots are byte-granular access listeners, one per mirror, so only
+ * reads of the hotspots themselves call anything.
+ */
+
+//where each scheme's hotspots are, from the start of the 4K; 3F's are in the zero page
+static const unsigned short hotspot_low[] = { 0xFF8, 0xFF6, 0xFF4, 0xFE0, 0x000 };
+static const unsigned short hotspot_high[] = { 0xFF9, 0xFF9, 0xFFB, 0xFF7, 0x03F };
+
+//first page of the cartridge's 4K in mirror m
+#define MIRROR_PAGE(m) ((0x1000 + (m) * 0x2000) / PAGE_SIZE)
+
+//where the code put aside for page k of a slice in a window and mirror goes
+#define CODE_INDEX(cart,window,slice,k,m) \
+	((((window) * (cart)->num_slices + (slice)) * ((cart)->slice_size / PAGE_SIZE) + (k)) * CART_MIRRORS + (m))
+
+//the listener on the hotspots
+static void touch_hotspot( em6502 *emu, void *context, unsigned short addr, unsigned char val, unsigned char mode )
+{
+	cartridge *cart = (cartridge *)context;
+	unsigned int offset = addr % 0x1000 - hotspot_low[cart->scheme];
+
+	//reads and writes switch the same way
+	(void)mode;
+
+	switch ( cart->scheme )
+	{
+		case CART_F8:
+		case CART_F6:
+		case CART_F4:
+			switch_bank(emu, cart, 0, offset);
+			break;
+
+		case CART_E0:
+			switch_bank(emu, cart, offset / 8, offset % 8);
+			break;
+
+		case CART_3F:
+			switch_bank(emu, cart, 0, val % cart->num_slices);
+			break;
+	}
+}
+
+
+/**************************************
+ * Name:  initialize_cartridge
+ * Inputs:  cartridge * - the cartridge to init
+ * 			const unsigned char * - its ROM image
+ * 			size_t - the image's size
+ * 			int - its scheme, one of CART_*
+ * Outputs: int - 1 if it worked, 0 if the image isnt a size the scheme takes
+ * Function: works out its slices, and which it starts with
+ *
+***************************************/
+int initialize_cartridge( cartridge *cart, const unsigned char *image, size_t size, int scheme )
+{
+	memset(cart, 0, sizeof(cartridge));
+	cart->scheme = scheme;
+	cart->image = image;
+	cart->size = size;
+
+	switch ( scheme )
+	{
+		case CART_F8:
+		case CART_F6:
+		case CART_F4:
+			if ( size != (size_t)0x2000 << (scheme - CART_F8) )
+			{
+				return 0;
+			}
+			cart->slice_size = 0x1000;
+			break;
+
+		case CART_E0:
+			if ( size != 0x2000 )
+			{
+				return 0;
+			}
+			cart->slice_size = 0x400;
+			break;
+
+		case CART_3F:
+			if ( size % 0x800 != 0 || size < 0x1000 || size > 256 * 0x800 )
+			{
+				return 0;
+			}
+			cart->slice_size = 0x800;
+			break;
+
+		default:
+			return 0;
+	}
+
+	cart->num_slices = size / cart->slice_size;
+	cart->num_windows = 0x1000 / cart->slice_size;
+
+	//the last window of E0 and 3F never switches, so the last slice goes there
+	cart->slice[cart->num_windows - 1] = cart->num_slices - 1;
+	if ( scheme == CART_E0 )
+	{
+		cart->slice[0] = 4;
+		cart->slice[1] = 5;
+		cart->slice[2] = 6;
+	}
+
+	cart->code = (page_code *)calloc(cart->num_windows * cart->num_slices * (cart->slice_size / PAGE_SIZE) * CART_MIRRORS,
+									 sizeof(page_code));
+	return 1;
+}
+
+
+/**************************************
+ * Name:  destroy_cartridge
+ * Inputs:  cartridge * - the cartridge
+ * Outputs: None
+ * Function: frees the code it put aside
+ *
+***************************************/
+void destroy_cartridge( cartridge *cart )
+{
+	unsigned int i;
+
+	for ( i = 0; i < cart->num_windows * cart->num_slices * (cart->slice_size / PAGE_SIZE) * CART_MIRRORS; i++ )
+	{
+		free_page_code(&cart->code[i]);
+	}
+
+	free(cart->code);
+	cart->code = 0;
+}
+
+
+/**************************************
+ * Name:  attach_cartridge
+ * Inputs:  em6502 * - the 6502 object
+ * 			cartridge * - the cartridge
+ * Outputs: int - 1 if it worked, 0 if there arent enough listeners left
+ * Function: maps its slices into every mirror, and listens for its hotspots
+ *
+***************************************/
+int attach_cartridge( em6502 *emu, cartridge *cart )
+{
+	unsigned int pages = cart->slice_size / PAGE_SIZE;
+	unsigned int page;
+	unsigned int w, k, m;
+	mem_region region;
+
+	//3F's hotspots are only written, and only in the zero page
+	if ( emu->num_write_listeners + (cart->scheme == CART_3F ? 1 : CART_MIRRORS) > MAX_MEMORY_WRITER_LISTENERS )
+	{
+		return 0;
+	}
+
+	for ( m = 0; m < CART_MIRRORS; m++ )
+	{
+		for ( w = 0; w < cart->num_windows; w++ )
+		{
+			for ( k = 0; k < pages; k++ )
+			{
+				page = MIRROR_PAGE(m) + w * pages + k;
+
+				unshare_page(emu, page);
+				emu->page_table[page]->data = (unsigned char *)&cart->image[cart->slice[w] * cart->slice_size + k * PAGE_SIZE];
+				emu->page_table[page]->flag = READ | EXECUTE;
+				update_page(emu, page);
+			}
+		}
+	}
+
+	if ( cart->scheme == CART_3F )
+	{
+		region.low = hotspot_low[CART_3F];
+		region.high = hotspot_high[CART_3F];
+		add_memory_access_listener(emu, region, WRITE, touch_hotspot, cart);
+	}
+	else
+	{
+		for ( m = 0; m < CART_MIRRORS; m++ )
+		{
+			region.low = MIRROR_PAGE(m) * PAGE_SIZE + hotspot_low[cart->scheme];
+			region.high = MIRROR_PAGE(m) * PAGE_SIZE + hotspot_high[cart->scheme];
+			add_memory_access_listener(emu, region, READ | WRITE, touch_hotspot, cart);
+		}
+	}
+
+	return 1;
+}
+
+
+/**************************************
+ * Name:  switch_bank
+ * Inputs:  em6502 * - the 6502 object it's attached to
+ * 			cartridge * - the cartridge
+ * 			unsigned int - the window
+ * 			unsigned int - the slice to put in it
+ * Outputs: None
+ * Function: repoints the window's pages in every mirror at the slice
+ *
+***************************************/
+void switch_bank( em6502 *emu, cartridge *cart, unsigned int window, unsigned int slice )
+{
+	unsigned int pages = cart->slice_size / PAGE_SIZE;
+	unsigned int old = cart->slice[window];
+	unsigned int k, m;
+
+	assert(window < cart->num_windows);
+	assert(slice < cart->num_slices);
+
+	if ( slice == old )
+	{
+		return;
+	}
+
+	for ( m = 0; m < CART_MIRRORS; m++ )
+	{
+		for ( k = 0; k < pages; k++ )
+		{
+			switch_page_data(emu, MIRROR_PAGE(m) + window * pages + k,
+							 (unsigned char *)&cart->image[slice * cart->slice_size + k * PAGE_SIZE],
+							 &cart->code[CODE_INDEX(cart, window, old, k, m)],
+							 &cart->code[CODE_INDEX(cart, window, slice, k, m)]);
+		}
+	}
+
+	cart->slice[window] = slice;
+	cart->switches++;
+}
+
+#endif
@@ -0,0 +1,96 @@
+#ifndef CARTRIDGE_H
+#define CARTRIDGE_H
+
+#include <stddef.h>
+
+#include "em_6502.h"
+
+#ifdef ENABLE_CARTRIDGE
+
+//Atari 2600 bank switching schemes
+#define CART_F8 0 //8K, 2 4K banks; touching $1FF8-$1FF9 picks one
+#define CART_F6 1 //16K, 4 4K banks; $1FF6-$1FF9
+#define CART_F4 2 //32K, 8 4K banks; $1FF4-$1FFB
+#define CART_E0 3 //8K, 8 1K slices; $1FE0-$1FE7, $1FE8-$1FEF and $1FF0-$1FF7 pick the slice in
+				  //each of the first 3 1K windows, the last one always has slice 7
+#define CART_3F 4 //2K banks, up to 256 of them; writing n to $0000-$003F puts bank n in the
+				  //first 2K window, the last one always has the last bank
+
+//the 2600 only has 13 addr lines, and the cartridge answers wherever A12 is set,
+//so its 4K shows up at $1000, $3000 and so on up to $F000
+#define CART_MIRRORS 8
+
+//most windows a scheme splits the 4K into
+#define CART_MAX_WINDOWS 4
+
+//a cartridge, and which of its slices are in the emulator it's attached to
+typedef struct {
+	int scheme; //one of CART_*
+	const unsigned char *image; //the whole ROM; the cartridge doesnt copy it, so it has to outlive it
+	size_t size;
+	unsigned int slice_size; //bytes a switch swaps; 4K, or 1K for E0 and 2K for 3F
+	unsigned int num_slices; //size / slice_size
+	unsigned int num_windows; //4K / slice_size
+	unsigned int slice[CART_MAX_WINDOWS]; //which slice each window has
+	page_code *code; //what's been decoded from each page of each slice, in each window and mirror, while it's switched out
+	unsigned long long switches; //times a window got a different slice
+}cartridge;
+
+
+/**************************************
+ * Name:  initialize_cartridge
+ * Inputs:  cartridge * - the cartridge to init
+ * 			const unsigned char * - its ROM image
+ * 			size_t - the image's size
+ * 			int - its scheme, one of CART_*
+ * Outputs: int - 1 if it worked, 0 if the image isnt a size the scheme takes
+ * Function: sets it up with the slices it starts with: the last bank for F8, F6 and F4,
+ * 			 slices 4, 5, 6 and 7 for E0, and banks 0 and the last one for 3F
+ *
+***************************************/
+int initialize_cartridge( cartridge *, const unsigned char *, size_t, int );
+
+
+/**************************************
+ * Name:  destroy_cartridge
+ * Inputs:  cartridge * - the cartridge
+ * Outputs: None
+ * Function: frees the code it put aside; the emulator it was attached to has to be reset,
+ * 			 destroyed or given a new memory map first, since its hotspot listeners point at it
+ *
+***************************************/
+void destroy_cartridge( cartridge * );
+
+
+/**************************************
+ * Name:  attach_cartridge
+ * Inputs:  em6502 * - the 6502 object, with a memory map
+ * 			cartridge * - the cartridge
+ * Outputs: int - 1 if it worked, 0 if there arent enough listeners left for its hotspots
+ * Function: points the pages at $1000-$1FFF and its mirrors at the cartridge's slices, as ROM,
+ * 			 and listens for its hotspots: a byte-granular listener on each mirror, so reads
+ * 			 of the rest of the ROM stay on the fast path, and its code still gets decoded and
+ * 			 translated. PC is left alone; a 2600 starts from the reset vector at $FFFC.
+ * 			 A cartridge goes in a single emulator; forks and rollback_em6502 dont know about it
+ *
+***************************************/
+int attach_cartridge( em6502 *, cartridge * );
+
+
+/**************************************
+ * Name:  switch_bank
+ * Inputs:  em6502 * - the 6502 object it's attached to
+ * 			cartridge * - the cartridge
+ * 			unsigned int - the window; 0 for F8, F6 and F4
+ * 			unsigned int - the slice to put in it
+ * Outputs: None
+ * Function: what touching a hotspot does; repoints the window's pages in every mirror with
+ * 			 switch_page_data, and never copies any of the ROM. The code decoded from the
+ * 			 slice going out is kept for when it comes back
+ *
+***************************************/
+void switch_bank( em6502 *, cartridge *, unsigned int, unsigned int );
+
+#endif
+
+#endif /* CARTRIDGE_H */
@@ -24,12 +24,142 @@
 //for debugging, we have a max instr counter
 #define ALLOW_MAX_INSTR_COUNT 1
 
+//count the cycles each instr takes, page crossings and taken branches included,
+//so run_program_cycles can run for a number of them
+#define ENABLE_CYCLE_COUNT 1
+
+//let devices schedule callbacks at a given cycle, see events.c; run_program runs the
+//cpu flat out up to the next one due, rather than checking for them every instr
+#ifdef ENABLE_CYCLE_COUNT
+	#define ENABLE_EVENTS 1
+#endif
+
+//most events an emulator can have scheduled at once
+#define MAX_EVENTS 32
+
+//IRQ, NMI and RESET inputs; they get taken at the same points run_program stops the cpu
+//for events, so the instrs never check for them
+#ifdef ENABLE_EVENTS
+	#define ENABLE_INTERRUPTS 1
+#endif
+
+//decode each executed instr only once and keep it around until its memory
+//is written to; comment out to fetch every opcode/operand through read_mem
+#define ENABLE_PREDECODE_CACHE 1
+
+//jump from each instr straight to the next one through a table of label addrs,
+//rather than going back through the big switch in run_program
+//this needs gcc's labels-as-values (clang has them too); others get the switch
+#ifdef __GNUC__
+	#define ENABLE_THREADED_DISPATCH 1
+#endif
+
+//keep the registers in locals while run_program interprets, instead of going through the
+//em6502 for every access, so the compiler can leave them in host registers
+//off by default: gcc 12 runs out of registers across the threaded dispatch and spills
+//them to the stack anyway, so it comes out 10-30% slower than going through emu
+//#define ENABLE_REGISTER_LOCALS 1
+
+//look the results and flags of ADC/SBC/CMP/the shifts, and the N/Z of everything else, up
+//in precomputed tables instead of working the flags out bit by bit; see alu.c
+//the tables take ~650K, and get built the first time an emulator is initialized
+//#define ENABLE_ALU_TABLES 1
+
+//keep N/Z/C/V out of P while run_program runs; the instrs that set them just store the
+//result they come from, and P only gets put back together when something needs all of it:
+//PHP, BRK, the idle loop check, and run_program returning
+//the ALU tables hold P's bits, so it's one or the other
+#ifndef ENABLE_ALU_TABLES
+	#define ENABLE_LAZY_FLAGS 1
+#endif
+
+//translate basic blocks into x86-64 code and run that instead of interpreting,
+//for emulators whose engine is set to ENGINE_DYNAREC
+//the generated code follows the System V calling convention and lives in mmap'ed memory,
+//so this is only available on 64-bit unix-likes
+//the common instrs are only translated to x86 with ENABLE_LAZY_FLAGS; without it, blocks call the interpreter's instrs
+#if defined(__GNUC__) && defined(__x86_64__) && defined(__unix__) && !defined(__CYGWIN__) && defined(ALLOW_MAX_INSTR_COUNT)
+	#define ENABLE_DYNAREC 1
+#endif
+
+//bytes of executable memory each emulator gets for translated blocks
+//when it fills up, all blocks are thrown away and translated again as they run
+#define DYNAREC_CODE_SIZE (1024*1024)
+
+//most 6502 instrs a single translated block can hold
+#define DYNAREC_MAX_BLOCK_INSTRS 32
+
+//count which instrs run back to back, so profile.c can list the sequences worth
+//adding to fusions.def; everything runs a lot slower, and unfused, while this is on
+//#define ENABLE_PROFILER 1
+
+#if defined(ENABLE_PROFILER) && !defined(ENABLE_PREDECODE_CACHE)
+	#error "ENABLE_PROFILER needs ENABLE_PREDECODE_CACHE"
+#endif
+
+//run each instr sequence listed in fusions.def as a single case of the interpreter,
+//dispatching once for the whole sequence instead of once per instr
+//sequences get fused as they're decoded, so this needs the decode cache
+#if defined(ENABLE_PREDECODE_CACHE) && !defined(ENABLE_PROFILER)
+	#define ENABLE_FUSION 1
+#endif
+
+//longest sequence fusions.def can have
+#define MAX_FUSED_INSTRS 3
+
+//fast-forward through loops that provably do nothing, like a JMP to itself or polling
+//memory nothing can change while run_program runs, instead of running every iteration
+//the instr count is what gets fast-forwarded, so this needs it
+#ifdef ALLOW_MAX_INSTR_COUNT
+	#define ENABLE_IDLE_SKIP 1
+#endif
+
+//read_mem goes straight to a page's bytes, wherever they are, unless something listens to it;
+//write_mem goes straight to _memory for plain RAM pages, and the rest take the long way
+#define ENABLE_FAST_MEMORY 1
+
+//run_frame paces the emulator to a real clock, a frame's worth of cycles at a time, see throttle.c
+//it sleeps on the POSIX monotonic clock, so this needs the cycle count and a unix-like
+#if defined(ENABLE_CYCLE_COUNT) && defined(__unix__)
+	#define ENABLE_THROTTLE 1
+#endif
+
+//run_batch runs lots of programs at once on a pool of pthreads, see batch.c;
+//harness takes --batch for it. needs the counters, for the results it writes
+#if defined(__unix__) && defined(ALLOW_MAX_INSTR_COUNT) && defined(ENABLE_CYCLE_COUNT)
+	#define ENABLE_BATCH 1
+#endif
+
+//run_lockstep runs the same program on LOCKSTEP_LANES emulators at once, a SIMD lane each, see lockstep.c
+//it's written with gcc's vector extensions (clang has them too), and counts like run_program does
+#if defined(__GNUC__) && defined(ALLOW_MAX_INSTR_COUNT) && defined(ENABLE_CYCLE_COUNT)
+	#define ENABLE_LOCKSTEP 1
+#endif
+
+//lanes run_lockstep has; 8, 16 or 32. 32 fills an AVX2 register with a byte of each
+#define LOCKSTEP_LANES 32
+
+//dedup_pages points the pages of any number of emulators that hold the same bytes at a
+//single copy of them, kept in a page_store, see page_store.c
+#define ENABLE_PAGE_STORE 1
+
+//attach_rom points pages straight at a ROM image mmap'd out of its file, see rom.c
+#if defined(__unix__) || defined(__APPLE__)
+	#define ENABLE_ROM_MAPPING 1
+#endif
+
+//load_image takes RAW, PRG, Intel HEX and Atari XEX images, and loads them where they say, see loader.c
+#define ENABLE_LOADER 1
+
+//attach_cartridge maps an Atari 2600 cartridge in, and bank switches it the way its scheme does, see cartridge.c
+#define ENABLE_CARTRIDGE 1
+
 //we want to have devices mapped into memory
 //#define ENABLE_MEM_MAP_DEVICES 1
 
-//max of 5 memory mapped regions we're watching
-//arbitrary
-#define MAX_MEMORY_WRITER_LISTENERS 5
+//max of 16 memory mapped regions we're watching
+//arbitrary; a cartridge's hotspots take one for each of its 8 mirrors
+#define MAX_MEMORY_WRITER_LISTENERS 16
 
 
 //page size on 6502, in bytes
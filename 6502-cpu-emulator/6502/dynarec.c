@@ -0,0 +1,1668 @@
+/* This is the dynamic recompiler; it translates 6502 basic blocks into x86-64 code  */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stddef.h>
+#include <sys/mman.h>
+#include "assert.h"
+
+#include "dynarec.h"
+#include "idle.h"
+
+#ifdef ENABLE_DYNAREC
+
+/*
+ * A block is the run of instrs starting at some addr, up to and including the first one
+ * that jumps/branches/returns (or DYNAREC_MAX_BLOCK_INSTRS of them, or the end of the page).
+ * Running its translation skips all of the fetching, decoding and dispatching.
+ *
+ * The common instrs (loads, stores, the ALU, shifts, inc/dec, transfers, stack, branches,
+ * JMP/JSR/RTS) get translated into x86 that does the same thing; the rest are a call to
+ * their dynarec_handler, the interpreter's own instr, with the operand baked in.
+ * While a block runs, the 6502 lives in callee-saved registers, so calls out leave it be:
+ *		rbx		emu
+ *		rbp		emu->cycles
+ *		r12		A
+ *		r13		X, both zero-extended; only their low byte ever changes
+ *		r14		Y
+ *		r15		emu->_memory
+ * N/Z/C/V stay in emu->flag_*, and S and PC in the em6502. The rest are scratch;
+ * ecx holds the addr an instr works on, eax what it read and edx what it writes.
+ *
+ * Translated code looks like:
+ *		push rbx, rbp, r12-r15, and load them up
+ *		add rbp, cycles				; for every instr:
+ *		mov rax, [rbx+read_pages+page*8]	; its reads and writes go straight to memory when
+ *		test rax, rax				; nothing can hear about them
+ *		jz slow
+ *		movzx eax, byte [rax+offset]
+ *	back:
+ *		...
+ *		cmp byte [rbx+dynarec_stale], 0	; after an instr that called out: stop if it overwrote code
+ *		jne stale
+ *		...
+ *		mov word [rbx+PC], next		; at the end, and after a branch either way
+ *		mov eax, instrs in block
+ *	exit:
+ *		store them back, pop, ret
+ *	slow:
+ *		mov word [rbx+PC], pc		; out of the way, after the exit
+ *		call read_mem's trampoline
+ *		jmp back
+ *	stale:
+ *		mov word [rbx+PC], next
+ *		mov eax, instrs run so far
+ *		jmp exit
+ *
+ * The trampolines at the start of the code memory store the registers back, call read_mem,
+ * write_mem or a handler, and load them up again, so everything called out to sees the same
+ * em6502 it would under the interpreter. Both engines give the same results.
+ *
+ * The code memory is never writable and executable at once; it's only made writable while
+ * a block is being emitted into it, then goes back to read+exec before anything runs.
+ */
+
+//a translated block
+typedef struct {
+	unsigned char *code; //where its translated code starts, 0 if the instr at its addr cant be translated
+	unsigned char count; //number of instrs in it
+	unsigned short last; //addr of the last one
+	unsigned short max_cycles; //most cycles it can take, with every page crossed and branch taken
+}dynarec_block;
+
+//the blocks translated from a single page
+struct dynarec_page {
+	dynarec_block *block[PAGE_SIZE]; //block starting at each addr in the page
+	unsigned char code_bytes[PAGE_SIZE / 8]; //a bit per byte that some block was translated from
+};
+
+#ifdef ENABLE_CYCLE_COUNT
+//1 if an instr in the block might start past the cycle budget
+#define BLOCK_OVER_CYCLE_LIMIT(emu,block) ((emu)->cycle_limit - (emu)->cycles < (block)->max_cycles)
+#else
+#define BLOCK_OVER_CYCLE_LIMIT(emu,block) 0
+#endif
+
+//translated code takes the emulator and returns how many instrs it ran
+typedef unsigned int (*dynarec_entry_t)( em6502 * );
+
+//most bytes of x86 a single instr (its slow paths included)/whole block translates to
+#define MAX_INSTR_CODE 400
+#define MAX_BLOCK_CODE (200 + DYNAREC_MAX_BLOCK_INSTRS * MAX_INSTR_CODE)
+
+//the trampolines, at the start of the code memory; blocks go after them
+#define TRAMPOLINE_SIZE 128
+#define TRAMPOLINE_READ 0
+#define TRAMPOLINE_WRITE 1
+#define TRAMPOLINE_HANDLER 2
+#define NUM_TRAMPOLINES 3
+
+//most slow paths and exits a block can have out of the way, a few per instr
+#define MAX_OUT_OF_LINE (5 * DYNAREC_MAX_BLOCK_INSTRS)
+
+
+//x86-64 registers, numbered the way ModRM and REX take them
+#define RAX 0
+#define RCX 1
+#define RDX 2
+#define RBX 3
+#define RSP 4
+#define RBP 5
+#define RSI 6
+#define RDI 7
+#define R12 12
+#define R13 13
+#define R14 14
+#define R15 15
+#define NO_INDEX -1
+
+//where translated code keeps the 6502, see above
+#define HOST_EMU RBX
+#define HOST_CYCLES RBP
+#define HOST_A R12
+#define HOST_X R13
+#define HOST_Y R14
+#define HOST_MEMORY R15
+
+//emit_mem/emit_reg flags
+#define OP_W 1 //64-bit operands
+#define OP_BYTE 2 //byte registers; sil/dil only mean that with a REX, without one they're dh/bh
+#define OP_16 4 //16-bit operands
+
+//condition codes, for jcc/setcc
+#define CC_AE 0x3
+#define CC_E 0x4
+#define CC_NE 0x5
+#define CC_A 0x7
+
+//where a field of the em6502 is, from rbx
+#define EMU(field) ((int)offsetof(em6502, field))
+
+#ifdef ENABLE_LAZY_FLAGS
+//what each opcode is, from opcodes.def, so the translator can switch on it
+enum {
+	NATIVE_ADC, NATIVE_AND, NATIVE_ASL, NATIVE_BCC, NATIVE_BCS, NATIVE_BEQ, NATIVE_BIT,
+	NATIVE_BMI, NATIVE_BNE, NATIVE_BPL, NATIVE_BRK, NATIVE_BVC, NATIVE_BVS, NATIVE_CLC,
+	NATIVE_CLD, NATIVE_CLI, NATIVE_CLV, NATIVE_CMP, NATIVE_CPX, NATIVE_CPY, NATIVE_DEC,
+	NATIVE_DEX, NATIVE_DEY, NATIVE_EOR, NATIVE_INC, NATIVE_INVALID, NATIVE_INX, NATIVE_INY,
+	NATIVE_JMP, NATIVE_JSR, NATIVE_LDA, NATIVE_LDX, NATIVE_LDY, NATIVE_LSR, NATIVE_NOP,
+	NATIVE_ORA, NATIVE_PHA, NATIVE_PHP, NATIVE_PLA, NATIVE_PLP, NATIVE_ROL, NATIVE_ROR,
+	NATIVE_RTI, NATIVE_RTS, NATIVE_SBC, NATIVE_SEC, NATIVE_SED, NATIVE_SEI, NATIVE_STA,
+	NATIVE_STX, NATIVE_STY, NATIVE_TAX, NATIVE_TAY, NATIVE_TSX, NATIVE_TXA, NATIVE_TXS,
+	NATIVE_TYA
+};
+
+static const unsigned char native_instr[256] =
+{
+	#define OPCODE_DESC(code,mnemonic,mode,length,cycles,penalty) [code] = NATIVE_##mnemonic,
+	#include "opcodes.def"
+	#undef OPCODE_DESC
+};
+#endif
+
+//out of the way code kinds
+#define OUT_READ 0 //read_mem, for a read that has to go the long way
+#define OUT_WRITE 1 //write_mem, the same for a write
+#define OUT_EXIT 2 //stops the block after an instr overwrote code
+
+//code that goes after the block's exit, out of the way of the fast path
+typedef struct {
+	unsigned char *jump[6]; //the rel32s in the block that jump to it
+	unsigned int num_jumps;
+	unsigned char *back; //where it jumps back to, for reads/writes
+	unsigned char kind; //one of OUT_*
+	int ea; //for reads/writes: the addr, or -1 when it's in ecx
+	unsigned short pc; //addr of the instr it's for; for exits, where the 6502 goes next
+	unsigned int count; //for exits: instrs run so far
+}out_of_line;
+
+//what translate_block keeps track of while it emits a block
+typedef struct {
+	em6502 *emu;
+	unsigned char *p; //where the next byte goes
+	unsigned short pc; //addr of the instr being translated
+	unsigned int count; //instrs translated before it
+	unsigned char called_out; //1 once the instr has code that can call out
+	unsigned char handled; //1 if the instr calls its handler, which sets PC itself
+	out_of_line out[MAX_OUT_OF_LINE];
+	unsigned int num_out;
+	unsigned char *exit_jump[2]; //jumps to the exit, from the end of the block
+	unsigned int num_exit_jumps;
+}block_emitter;
+
+
+//writes bytes of x86 code
+static unsigned char *emit_bytes( unsigned char *p, const void *bytes, size_t size )
+{
+	memcpy(p, bytes, size);
+	return p + size;
+}
+
+static unsigned char *emit_byte( unsigned char *p, unsigned char b )
+{
+	return emit_bytes(p, &b, 1);
+}
+
+static unsigned char *emit_u16( unsigned char *p, unsigned short val )
+{
+	return emit_bytes(p, &val, sizeof(val));
+}
+
+static unsigned char *emit_u32( unsigned char *p, unsigned int val )
+{
+	return emit_bytes(p, &val, sizeof(val));
+}
+
+//points the rel32 at 'at' at target
+static void patch_rel32( unsigned char *at, unsigned char *target )
+{
+	int rel = (int)(target - (at + 4));
+
+	memcpy(at, &rel, sizeof(rel));
+}
+
+//prefixes and opcode (0F xx for a 2 byte one) of an instr with a ModRM byte
+//rm_reg is rm when it's a register, for the REX byte registers need
+static unsigned char *emit_opcode( unsigned char *p, int flags, unsigned int opcode, int reg, int index, int rm, int rm_reg )
+{
+	unsigned char rex = 0x40 | ((flags & OP_W) ? 8 : 0) | (reg >= 8 ? 4 : 0) | (index >= 8 ? 2 : 0) | (rm >= 8 ? 1 : 0);
+
+	if ( flags & OP_16 )
+	{
+		p = emit_byte(p, 0x66);
+	}
+
+	if ( rex != 0x40 || ((flags & OP_BYTE) && ((reg >= 4 && reg < 8) || (rm_reg >= 4 && rm_reg < 8))) )
+	{
+		p = emit_byte(p, rex);
+	}
+
+	if ( opcode > 0xFF )
+	{
+		p = emit_byte(p, opcode >> 8);
+	}
+
+	return emit_byte(p, opcode & 0xFF);
+}
+
+//op reg, [base + index*scale + disp]; reg is the opcode extension for the ones that have one
+static unsigned char *emit_mem( unsigned char *p, int flags, unsigned int opcode, int reg, int base, int index, int scale, int disp )
+{
+	unsigned char mod = disp == 0 && (base & 7) != RBP ? 0x00 : (disp >= -128 && disp <= 127 ? 0x40 : 0x80);
+
+	p = emit_opcode(p, flags, opcode, reg, index, base, -1);
+
+	if ( index == NO_INDEX && (base & 7) != RSP )
+	{
+		p = emit_byte(p, mod | (reg & 7) << 3 | (base & 7));
+	}
+	else
+	{
+		//rsp/r12 as base, or any index, takes a SIB byte
+		p = emit_byte(p, mod | (reg & 7) << 3 | RSP);
+		p = emit_byte(p, (scale == 8 ? 0xC0 : scale == 4 ? 0x80 : scale == 2 ? 0x40 : 0x00) |
+						 ((index == NO_INDEX ? RSP : index) & 7) << 3 | (base & 7));
+	}
+
+	if ( mod == 0x40 )
+	{
+		return emit_byte(p, (unsigned char)disp);
+	}
+	if ( mod == 0x80 )
+	{
+		return emit_u32(p, (unsigned int)disp);
+	}
+	return p;
+}
+
+//op rm, reg with both registers; again reg can be an opcode extension
+static unsigned char *emit_reg( unsigned char *p, int flags, unsigned int opcode, int reg, int rm )
+{
+	p = emit_opcode(p, flags, opcode, reg, NO_INDEX, rm, rm);
+	return emit_byte(p, 0xC0 | (reg & 7) << 3 | (rm & 7));
+}
+
+//op [rbx + field], for the em6502's fields
+static unsigned char *emit_emu( unsigned char *p, int flags, unsigned int opcode, int reg, int field )
+{
+	return emit_mem(p, flags, opcode, reg, HOST_EMU, NO_INDEX, 0, field);
+}
+
+//mov reg32, imm32
+static unsigned char *emit_mov_imm( unsigned char *p, int reg, unsigned int val )
+{
+	if ( reg >= 8 )
+	{
+		p = emit_byte(p, 0x41);
+	}
+	p = emit_byte(p, 0xB8 + (reg & 7));
+	return emit_u32(p, val);
+}
+
+//mov rax, imm64; call rax
+static unsigned char *emit_call_abs( unsigned char *p, void *target )
+{
+	static const unsigned char mov_rax[] = { 0x48, 0xB8 };
+	static const unsigned char call_rax[] = { 0xFF, 0xD0 };
+
+	p = emit_bytes(p, mov_rax, sizeof(mov_rax));
+	p = emit_bytes(p, &target, sizeof(target));
+	return emit_bytes(p, call_rax, sizeof(call_rax));
+}
+
+//jcc/jmp/call rel32 to target, 0 to patch later; returns the end, the rel32 is the 4 bytes before it
+static unsigned char *emit_jcc( unsigned char *p, int cc, unsigned char *target )
+{
+	p = emit_byte(p, 0x0F);
+	p = emit_byte(p, 0x80 + cc);
+	p = emit_u32(p, 0);
+	if ( target != 0 )
+	{
+		patch_rel32(p - 4, target);
+	}
+	return p;
+}
+
+static unsigned char *emit_jmp( unsigned char *p, unsigned char opcode, unsigned char *target )
+{
+	p = emit_byte(p, opcode);
+	p = emit_u32(p, 0);
+	if ( target != 0 )
+	{
+		patch_rel32(p - 4, target);
+	}
+	return p;
+}
+#define JMP 0xE9
+#define CALL 0xE8
+
+//mov word [rbx+PC], pc
+static unsigned char *emit_set_pc( unsigned char *p, unsigned short pc )
+{
+	p = emit_emu(p, OP_16, 0xC7, 0, EMU(PC));
+	return emit_u16(p, pc);
+}
+
+//the registers back in the em6502, for calling out and at the end
+static unsigned char *emit_store_regs( unsigned char *p )
+{
+	p = emit_emu(p, OP_BYTE, 0x88, HOST_A, EMU(Acc));
+	p = emit_emu(p, OP_BYTE, 0x88, HOST_X, EMU(X));
+	p = emit_emu(p, OP_BYTE, 0x88, HOST_Y, EMU(Y));
+	#ifdef ENABLE_CYCLE_COUNT
+	p = emit_emu(p, OP_W, 0x89, HOST_CYCLES, EMU(cycles));
+	#endif
+	return p;
+}
+
+//and out again, once whatever was called might have changed them
+static unsigned char *emit_load_regs( unsigned char *p )
+{
+	p = emit_emu(p, 0, 0x0FB6, HOST_A, EMU(Acc));
+	p = emit_emu(p, 0, 0x0FB6, HOST_X, EMU(X));
+	p = emit_emu(p, 0, 0x0FB6, HOST_Y, EMU(Y));
+	#ifdef ENABLE_CYCLE_COUNT
+	p = emit_emu(p, OP_W, 0x8B, HOST_CYCLES, EMU(cycles));
+	#endif
+	return emit_emu(p, OP_W, 0x8B, HOST_MEMORY, EMU(_memory));
+}
+
+
+/**************************************
+ * Name:  emit_trampolines
+ * Inputs:  unsigned char * - the start of the code memory
+ * Outputs: None
+ * Function: writes the trampolines the blocks call out through; each stores the registers back,
+ * 			 calls, then loads them up again
+ * 			 read: ecx is the addr, the byte comes back in eax
+ * 			 write: ecx is the addr, dl the byte
+ * 			 both leave ecx and edx be
+ * 			 handler: rax is the handler, esi the operand
+ *
+***************************************/
+static void emit_trampolines( unsigned char *code )
+{
+	static const unsigned char save[] = { 0x51, 0x52, 0x48, 0x83, 0xEC, 0x08 }; //push rcx; push rdx; sub rsp, 8
+	static const unsigned char restore[] = { 0x48, 0x83, 0xC4, 0x08, 0x5A, 0x59, 0xC3 }; //add rsp, 8; pop rdx; pop rcx; ret
+	static const unsigned char args[] = { 0x48, 0x89, 0xDF, 0x89, 0xCE }; //mov rdi, rbx; mov esi, ecx
+	unsigned char *p;
+
+	//the call into a block left rsp 16 byte aligned; each of these leaves it that way again
+	p = code + TRAMPOLINE_READ * TRAMPOLINE_SIZE;
+	p = emit_bytes(p, save, sizeof(save));
+	p = emit_store_regs(p);
+	p = emit_bytes(p, args, sizeof(args));
+	p = emit_call_abs(p, (void *)read_mem);
+	p = emit_reg(p, 0, 0x0FB6, RAX, RAX); //movzx eax, al
+	p = emit_load_regs(p);
+	p = emit_bytes(p, restore, sizeof(restore));
+	assert(p <= code + (TRAMPOLINE_READ + 1) * TRAMPOLINE_SIZE);
+
+	p = code + TRAMPOLINE_WRITE * TRAMPOLINE_SIZE;
+	p = emit_bytes(p, save, sizeof(save));
+	p = emit_store_regs(p);
+	p = emit_bytes(p, args, sizeof(args));
+	p = emit_call_abs(p, (void *)write_mem);
+	p = emit_load_regs(p);
+	p = emit_bytes(p, restore, sizeof(restore));
+	assert(p <= code + (TRAMPOLINE_WRITE + 1) * TRAMPOLINE_SIZE);
+
+	p = code + TRAMPOLINE_HANDLER * TRAMPOLINE_SIZE;
+	p = emit_bytes(p, "\x48\x83\xEC\x08", 4); //sub rsp, 8
+	p = emit_store_regs(p);
+	p = emit_bytes(p, "\x48\x89\xDF\xFF\xD0", 5); //mov rdi, rbx; call rax
+	p = emit_load_regs(p);
+	p = emit_bytes(p, "\x48\x83\xC4\x08\xC3", 5); //add rsp, 8; ret
+	assert(p <= code + (TRAMPOLINE_HANDLER + 1) * TRAMPOLINE_SIZE);
+}
+
+
+//a new bit of out of the way code for the instr being translated
+static out_of_line *add_out_of_line( block_emitter *e, unsigned char kind, int ea )
+{
+	out_of_line *out = &e->out[e->num_out++];
+
+	assert(e->num_out <= MAX_OUT_OF_LINE);
+	out->num_jumps = 0;
+	out->back = 0;
+	out->kind = kind;
+	out->ea = ea;
+	out->pc = e->pc;
+	out->count = 0;
+	return out;
+}
+
+//jcc to out, patched once it's been emitted
+static void jump_out( block_emitter *e, out_of_line *out, int cc )
+{
+	e->p = emit_jcc(e->p, cc, 0);
+	out->jump[out->num_jumps++] = e->p - 4;
+}
+
+#ifdef ENABLE_LAZY_FLAGS
+//the native instrs work on the lazy flags; with the ALU tables, every instr calls its handler
+
+#ifdef ENABLE_FAST_MEMORY
+//cmp qword [rbx + table + page*8], 0 and off to out if it isnt; page is a constant, or in reg
+static void jump_out_if_set( block_emitter *e, out_of_line *out, int table, int page, int reg )
+{
+	if ( reg == NO_INDEX )
+	{
+		e->p = emit_emu(e->p, OP_W, 0x83, 7, table + page * 8);
+	}
+	else
+	{
+		e->p = emit_mem(e->p, OP_W, 0x83, 7, HOST_EMU, reg, 8, table);
+	}
+	e->p = emit_byte(e->p, 0);
+	jump_out(e, out, CC_NE);
+}
+#endif
+
+//counts cycles the instr takes, like INSTR_CYCLES does
+static void emit_cycles( block_emitter *e, unsigned int cycles )
+{
+	#ifdef ENABLE_CYCLE_COUNT
+	//add rbp, cycles
+	e->p = emit_reg(e->p, OP_W, 0x83, 0, HOST_CYCLES);
+	e->p = emit_byte(e->p, cycles);
+	#endif
+}
+
+//and 1 more if the indexed addr went into the next page, when base + index + low is past 0xFF
+static void emit_page_penalty( block_emitter *e, int index, int base, int low )
+{
+	#ifdef ENABLE_CYCLE_COUNT
+	//lea esi, [base + index + low]; shr esi, 8; add rbp, rsi
+	e->p = emit_mem(e->p, 0, 0x8D, RSI, base, index, 1, low);
+	e->p = emit_reg(e->p, 0, 0xC1, 5, RSI);
+	e->p = emit_byte(e->p, 8);
+	e->p = emit_reg(e->p, OP_W, 0x01, RSI, HOST_CYCLES);
+	#endif
+}
+
+
+/**************************************
+ * Name:  emit_read
+ * Inputs:  block_emitter * - the block being emitted
+ * 			int - the addr, or -1 when it's in ecx
+ * Outputs: None
+ * Function: the byte there into eax, straight from the page's data when it's in read_pages,
+ * 			 out of the way through read_mem when it isnt; like MEM_READ does
+ * 			 ecx and edx are left be, and so is everything else in the fast path but eax and esi
+ *
+***************************************/
+static void emit_read( block_emitter *e, int ea )
+{
+	out_of_line *out = add_out_of_line(e, OUT_READ, ea);
+
+	e->called_out = 1;
+
+	#ifdef ENABLE_FAST_MEMORY
+	if ( ea >= 0 )
+	{
+		//mov rax, [rbx + read_pages + page*8]
+		e->p = emit_emu(e->p, OP_W, 0x8B, RAX, EMU(read_pages) + ea / PAGE_SIZE * 8);
+	}
+	else
+	{
+		//mov eax, ecx; shr eax, 8; mov rax, [rbx + read_pages + rax*8]
+		e->p = emit_reg(e->p, 0, 0x89, RCX, RAX);
+		e->p = emit_reg(e->p, 0, 0xC1, 5, RAX);
+		e->p = emit_byte(e->p, 8);
+		e->p = emit_mem(e->p, OP_W, 0x8B, RAX, HOST_EMU, RAX, 8, EMU(read_pages));
+	}
+
+	//test rax, rax; jz out
+	e->p = emit_reg(e->p, OP_W, 0x85, RAX, RAX);
+	jump_out(e, out, CC_E);
+
+	if ( ea >= 0 )
+	{
+		//movzx eax, byte [rax + offset]
+		e->p = emit_mem(e->p, 0, 0x0FB6, RAX, RAX, NO_INDEX, 0, ea % PAGE_SIZE);
+	}
+	else
+	{
+		//movzx esi, cl; movzx eax, byte [rax + rsi]
+		e->p = emit_reg(e->p, 0, 0x0FB6, RSI, RCX);
+		e->p = emit_mem(e->p, 0, 0x0FB6, RAX, RAX, RSI, 1, 0);
+	}
+	#else
+	e->p = emit_jmp(e->p, JMP, 0);
+	out->jump[out->num_jumps++] = e->p - 4;
+	#endif
+
+	out->back = e->p;
+}
+
+
+/**************************************
+ * Name:  emit_write
+ * Inputs:  block_emitter * - the block being emitted
+ * 			int - the addr, or -1 when it's in ecx
+ * Outputs: None
+ * Function: dl there; straight into _memory when it's plain RAM, and nothing was
+ * 			 decoded or translated from its page, and nothing watches it. It still gets
+ * 			 marked dirty. Anything else goes out of the way through write_mem
+ * 			 ecx and edx are left be
+ *
+***************************************/
+static void emit_write( block_emitter *e, int ea )
+{
+	out_of_line *out = add_out_of_line(e, OUT_WRITE, ea);
+	#ifdef ENABLE_FAST_MEMORY
+	int page = ea / PAGE_SIZE;
+	int reg = NO_INDEX;
+	#endif
+
+	e->called_out = 1;
+
+	#ifdef ENABLE_FAST_MEMORY
+	if ( ea < 0 )
+	{
+		//movzx eax, ch; the page
+		e->p = emit_bytes(e->p, "\x0F\xB6\xC5", 3);
+		reg = RAX;
+		page = 0;
+	}
+
+	//cmp byte [rbx + slow_pages + page], 0; jne out
+	e->p = emit_mem(e->p, 0, 0x80, 7, HOST_EMU, reg, 1, EMU(slow_pages) + page);
+	e->p = emit_byte(e->p, 0);
+	jump_out(e, out, CC_NE);
+
+	#ifdef ENABLE_PREDECODE_CACHE
+	//the decoded instrs it might be part of start as far back as the page before
+	jump_out_if_set(e, out, EMU(decode_cache), page, reg);
+	if ( ea < 0 )
+	{
+		//lea esi, [rax - 1]; movzx esi, sil
+		e->p = emit_mem(e->p, 0, 0x8D, RSI, RAX, NO_INDEX, 0, -1);
+		e->p = emit_reg(e->p, OP_BYTE, 0x0FB6, RSI, RSI);
+		jump_out_if_set(e, out, EMU(decode_cache), 0, RSI);
+	}
+	else if ( ea % PAGE_SIZE < 2 )
+	{
+		jump_out_if_set(e, out, EMU(decode_cache), (page - 1) & (NUM_PAGES - 1), NO_INDEX);
+	}
+	#endif
+
+	jump_out_if_set(e, out, EMU(dynarec_pages), page, reg);
+	jump_out_if_set(e, out, EMU(watch_masks), page, reg);
+
+	if ( ea >= 0 )
+	{
+		//mov [r15 + ea], dl; or byte [rbx + dirty_pages + page/8], bit
+		e->p = emit_mem(e->p, 0, 0x88, RDX, HOST_MEMORY, NO_INDEX, 0, ea);
+		e->p = emit_emu(e->p, 0, 0x80, 1, EMU(dirty_pages) + page / 8);
+		e->p = emit_byte(e->p, 1 << (page % 8));
+	}
+	else
+	{
+		//mov [r15 + rcx], dl
+		e->p = emit_mem(e->p, 0, 0x88, RDX, HOST_MEMORY, RCX, 1, 0);
+
+		//mov esi, eax; shr esi, 3; movzx edi, byte [rbx + dirty_pages + rsi]
+		//bts edi, eax (it only takes eax's low 5 bits, so and it to 7 first); mov [rbx + dirty_pages + rsi], dil
+		e->p = emit_reg(e->p, 0, 0x89, RAX, RSI);
+		e->p = emit_reg(e->p, 0, 0xC1, 5, RSI);
+		e->p = emit_byte(e->p, 3);
+		e->p = emit_reg(e->p, 0, 0x83, 4, RAX);
+		e->p = emit_byte(e->p, 7);
+		e->p = emit_mem(e->p, 0, 0x0FB6, RDI, HOST_EMU, RSI, 1, EMU(dirty_pages));
+		e->p = emit_reg(e->p, 0, 0x0FAB, RAX, RDI);
+		e->p = emit_mem(e->p, OP_BYTE, 0x88, RDI, HOST_EMU, RSI, 1, EMU(dirty_pages));
+	}
+	#else
+	e->p = emit_jmp(e->p, JMP, 0);
+	out->jump[out->num_jumps++] = e->p - 4;
+	#endif
+
+	out->back = e->p;
+}
+
+
+//flag_n = flag_z = reg8, like SET_NZ
+static void emit_set_nz( block_emitter *e, int reg )
+{
+	e->p = emit_emu(e->p, OP_BYTE, 0x88, reg, EMU(flag_n));
+	e->p = emit_emu(e->p, OP_BYTE, 0x88, reg, EMU(flag_z));
+}
+
+//mov dest32, src32
+static void emit_mov( block_emitter *e, int dest, int src )
+{
+	e->p = emit_reg(e->p, 0, 0x89, src, dest);
+}
+
+//ecx = 0x100 | S, the stack slot S points at; adjusted by delta first, which doesnt change S
+static void emit_stack_addr( block_emitter *e, int delta )
+{
+	//movzx ecx, byte [rbx+S]
+	e->p = emit_emu(e->p, 0, 0x0FB6, RCX, EMU(S));
+	if ( delta != 0 )
+	{
+		//add ecx, delta; movzx ecx, cl
+		e->p = emit_reg(e->p, 0, 0x83, 0, RCX);
+		e->p = emit_byte(e->p, delta);
+		e->p = emit_reg(e->p, 0, 0x0FB6, RCX, RCX);
+	}
+	//or ecx, 0x100; the stack is page 1
+	e->p = emit_reg(e->p, 0, 0x81, 1, RCX);
+	e->p = emit_u32(e->p, 0x100);
+}
+
+//inc/dec byte [rbx+S]
+static void emit_step_s( block_emitter *e, int dec )
+{
+	e->p = emit_emu(e->p, 0, 0xFE, dec, EMU(S));
+}
+
+//pushes dl, like PUSH does
+static void emit_push( block_emitter *e )
+{
+	emit_stack_addr(e, 0);
+	emit_write(e, -1);
+	emit_step_s(e, 1);
+}
+
+
+/**************************************
+ * Name:  emit_ea
+ * Inputs:  block_emitter * - the block being emitted
+ * 			const opcode_desc * - the instr
+ * 			unsigned short - its operand
+ * Outputs: int - the addr it works on, or -1 if it's only known once it runs; then it's in ecx
+ * Function: works out the addr like EA_<mode> does, and counts the instr's cycles, page
+ * 			 crossings included, after it, like INSTR_CYCLES does. Not for immediates
+ *
+***************************************/
+static int emit_ea( block_emitter *e, const opcode_desc *desc, unsigned short operand )
+{
+	int index = desc->mode == MODE_Z_PAGE_X || desc->mode == MODE_ABS_X ? HOST_X : HOST_Y;
+	int ea = -1;
+
+	switch ( desc->mode )
+	{
+		case MODE_Z_PAGE:
+			ea = operand & 0xFF;
+			emit_cycles(e, desc->cycles);
+			break;
+
+		case MODE_ABSOLUTE:
+			ea = operand;
+			emit_cycles(e, desc->cycles);
+			break;
+
+		case MODE_Z_PAGE_X:
+		case MODE_Z_PAGE_Y:
+			//lea ecx, [index + operand]; movzx ecx, cl
+			e->p = emit_mem(e->p, 0, 0x8D, RCX, index, NO_INDEX, 0, operand & 0xFF);
+			e->p = emit_reg(e->p, 0, 0x0FB6, RCX, RCX);
+			emit_cycles(e, desc->cycles);
+			break;
+
+		case MODE_ABS_X:
+		case MODE_ABS_Y:
+			//lea ecx, [index + operand]; movzx ecx, cx
+			e->p = emit_mem(e->p, 0, 0x8D, RCX, index, NO_INDEX, 0, operand);
+			e->p = emit_reg(e->p, 0, 0x0FB7, RCX, RCX);
+			emit_cycles(e, desc->cycles);
+			if ( desc->page_penalty )
+			{
+				emit_page_penalty(e, NO_INDEX, index, operand & 0xFF);
+			}
+			break;
+
+		case MODE_IND_X:
+			//the pointer is at operand + X, which doesnt wrap round the zero page
+			//lea ecx, [r13 + operand]; read; mov edx, eax; inc ecx; read
+			e->p = emit_mem(e->p, 0, 0x8D, RCX, HOST_X, NO_INDEX, 0, operand & 0xFF);
+			emit_read(e, -1);
+			emit_mov(e, RDX, RAX);
+			e->p = emit_reg(e->p, 0, 0xFF, 0, RCX);
+			emit_read(e, -1);
+
+			//shl eax, 8; or eax, edx; mov ecx, eax
+			e->p = emit_reg(e->p, 0, 0xC1, 4, RAX);
+			e->p = emit_byte(e->p, 8);
+			e->p = emit_reg(e->p, 0, 0x09, RDX, RAX);
+			emit_mov(e, RCX, RAX);
+			emit_cycles(e, desc->cycles);
+			break;
+
+		case MODE_IND_Y:
+			//read; mov edx, eax; read
+			emit_read(e, operand & 0xFF);
+			emit_mov(e, RDX, RAX);
+			emit_read(e, (operand & 0xFF) + 1);
+
+			//shl eax, 8; or eax, edx; add eax, r14d; movzx ecx, ax
+			e->p = emit_reg(e->p, 0, 0xC1, 4, RAX);
+			e->p = emit_byte(e->p, 8);
+			e->p = emit_reg(e->p, 0, 0x09, RDX, RAX);
+			e->p = emit_reg(e->p, 0, 0x01, HOST_Y, RAX);
+			e->p = emit_reg(e->p, 0, 0x0FB7, RCX, RAX);
+			emit_cycles(e, desc->cycles);
+			if ( desc->page_penalty )
+			{
+				emit_page_penalty(e, HOST_Y, RDX, 0);
+			}
+			break;
+	}
+
+	return ea;
+}
+
+//the instr's operand into eax, like READ_<mode> does
+static void emit_operand( block_emitter *e, const opcode_desc *desc, unsigned short operand )
+{
+	if ( desc->mode == MODE_IMMEDIATE )
+	{
+		emit_cycles(e, desc->cycles);
+		e->p = emit_mov_imm(e->p, RAX, operand & 0xFF);
+		return;
+	}
+
+	emit_read(e, emit_ea(e, desc, operand));
+}
+
+//reads the operand of a read-modify-write instr, ea is where it gets written back
+static int emit_rmw_operand( block_emitter *e, const opcode_desc *desc, unsigned short operand )
+{
+	int ea;
+
+	if ( desc->mode == MODE_ACCUM )
+	{
+		emit_cycles(e, desc->cycles);
+		emit_mov(e, RAX, HOST_A);
+		return -1;
+	}
+
+	ea = emit_ea(e, desc, operand);
+	emit_read(e, ea);
+	return ea;
+}
+
+//and writes back dl
+static void emit_rmw_result( block_emitter *e, const opcode_desc *desc, int ea )
+{
+	if ( desc->mode == MODE_ACCUM )
+	{
+		//movzx r12d, dl
+		e->p = emit_reg(e->p, 0, 0x0FB6, HOST_A, RDX);
+	}
+	else
+	{
+		emit_write(e, ea);
+	}
+	emit_set_nz(e, RDX);
+}
+
+//the host register a 6502 one is in
+static int host_reg( int instr )
+{
+	switch ( instr )
+	{
+		case NATIVE_LDX: case NATIVE_STX: case NATIVE_CPX: case NATIVE_INX: case NATIVE_DEX:
+			return HOST_X;
+
+		case NATIVE_LDY: case NATIVE_STY: case NATIVE_CPY: case NATIVE_INY: case NATIVE_DEY:
+			return HOST_Y;
+	}
+
+	return HOST_A;
+}
+
+
+/**************************************
+ * Name:  emit_native
+ * Inputs:  block_emitter * - the block being emitted
+ * 			unsigned char - the opcode
+ * 			unsigned short - its operand
+ * Outputs: int - 1 if it got translated, 0 if it has to call its handler
+ * Function: translates an instr that doesnt go anywhere else into x86 doing what
+ * 			 INSTR_<mnemonic> does; flow changing ones are emit_flow's
+ *
+***************************************/
+static int emit_native( block_emitter *e, unsigned char opcode, unsigned short operand )
+{
+	const opcode_desc *desc = &opcode_table[opcode];
+	int instr = native_instr[opcode];
+	int reg = host_reg(instr);
+	int ea;
+
+	switch ( instr )
+	{
+		case NATIVE_LDA: case NATIVE_LDX: case NATIVE_LDY:
+			emit_operand(e, desc, operand);
+			emit_mov(e, reg, RAX);
+			emit_set_nz(e, reg);
+			break;
+
+		case NATIVE_STA: case NATIVE_STX: case NATIVE_STY:
+			ea = emit_ea(e, desc, operand);
+			emit_mov(e, RDX, reg);
+			emit_write(e, ea);
+			break;
+
+		case NATIVE_ADC:
+			//edi = C; edx = A; ecx = A + M
+			emit_operand(e, desc, operand);
+			e->p = emit_emu(e->p, 0, 0x0FB6, RDI, EMU(flag_c));
+			emit_mov(e, RDX, HOST_A);
+			e->p = emit_mem(e->p, 0, 0x8D, RCX, RDX, RAX, 1, 0);
+
+			//C = A + M > 0xFF; V = ~(A ^ M) & (A ^ (A + M)), without the carry, see SET_V_ADDITION
+			e->p = emit_reg(e->p, 0, 0x81, 7, RCX);
+			e->p = emit_u32(e->p, 0xFF);
+			e->p = emit_emu(e->p, 0, 0x0F90 + CC_A, 0, EMU(flag_c));
+			emit_mov(e, RSI, RDX);
+			e->p = emit_reg(e->p, 0, 0x31, RAX, RSI);
+			e->p = emit_reg(e->p, 0, 0xF7, 2, RSI);
+			e->p = emit_reg(e->p, 0, 0x31, RCX, RDX);
+			e->p = emit_reg(e->p, 0, 0x21, RDX, RSI);
+			e->p = emit_emu(e->p, OP_BYTE, 0x88, RSI, EMU(flag_v));
+
+			//A = A + M + C
+			e->p = emit_reg(e->p, 0, 0x01, RDI, RCX);
+			e->p = emit_reg(e->p, 0, 0x0FB6, HOST_A, RCX);
+			emit_set_nz(e, HOST_A);
+			break;
+
+		case NATIVE_SBC:
+			//eax = M + 1 - C, as a byte
+			emit_operand(e, desc, operand);
+			e->p = emit_emu(e->p, 0, 0x0FB6, RDI, EMU(flag_c));
+			e->p = emit_mov_imm(e->p, RSI, 1);
+			e->p = emit_reg(e->p, 0, 0x29, RDI, RSI);
+			e->p = emit_reg(e->p, 0, 0x01, RSI, RAX);
+			e->p = emit_reg(e->p, 0, 0x0FB6, RAX, RAX);
+
+			//C = A >= that; ecx = A - that
+			emit_mov(e, RDX, HOST_A);
+			e->p = emit_reg(e->p, 0, 0x39, RAX, RDX);
+			e->p = emit_emu(e->p, 0, 0x0F90 + CC_AE, 0, EMU(flag_c));
+			emit_mov(e, RCX, RDX);
+			e->p = emit_reg(e->p, 0, 0x29, RAX, RCX);
+			e->p = emit_reg(e->p, 0, 0x0FB6, RCX, RCX);
+
+			//V = (A ^ that) & (A ^ result), see SET_V_SUBTRACTION
+			emit_mov(e, RSI, RDX);
+			e->p = emit_reg(e->p, 0, 0x31, RAX, RSI);
+			e->p = emit_reg(e->p, 0, 0x31, RCX, RDX);
+			e->p = emit_reg(e->p, 0, 0x21, RDX, RSI);
+			e->p = emit_emu(e->p, OP_BYTE, 0x88, RSI, EMU(flag_v));
+
+			emit_mov(e, HOST_A, RCX);
+			emit_set_nz(e, HOST_A);
+			break;
+
+		case NATIVE_AND: case NATIVE_ORA: case NATIVE_EOR:
+			emit_operand(e, desc, operand);
+			e->p = emit_reg(e->p, 0, instr == NATIVE_AND ? 0x21 : instr == NATIVE_ORA ? 0x09 : 0x31, RAX, HOST_A);
+			emit_set_nz(e, HOST_A);
+			break;
+
+		case NATIVE_CMP: case NATIVE_CPX: case NATIVE_CPY:
+			//C = reg >= M; N/Z from reg - M
+			emit_operand(e, desc, operand);
+			emit_mov(e, RCX, reg);
+			e->p = emit_reg(e->p, 0, 0x39, RAX, RCX);
+			e->p = emit_emu(e->p, 0, 0x0F90 + CC_AE, 0, EMU(flag_c));
+			e->p = emit_reg(e->p, 0, 0x29, RAX, RCX);
+			emit_set_nz(e, RCX);
+			break;
+
+		case NATIVE_BIT:
+			//N = M; V = M << 1; Z = A & M
+			emit_operand(e, desc, operand);
+			e->p = emit_emu(e->p, 0, 0x88, RAX, EMU(flag_n));
+			e->p = emit_mem(e->p, 0, 0x8D, RCX, RAX, RAX, 1, 0);
+			e->p = emit_emu(e->p, 0, 0x88, RCX, EMU(flag_v));
+			e->p = emit_reg(e->p, 0, 0x21, HOST_A, RAX);
+			e->p = emit_emu(e->p, 0, 0x88, RAX, EMU(flag_z));
+			break;
+
+		case NATIVE_INC: case NATIVE_DEC:
+			//lea edx, [rax +/- 1]
+			ea = emit_rmw_operand(e, desc, operand);
+			e->p = emit_mem(e->p, 0, 0x8D, RDX, RAX, NO_INDEX, 0, instr == NATIVE_INC ? 1 : -1);
+			emit_rmw_result(e, desc, ea);
+			break;
+
+		case NATIVE_ASL:
+			//C = bit 7; lea edx, [rax + rax]
+			ea = emit_rmw_operand(e, desc, operand);
+			emit_mov(e, RSI, RAX);
+			e->p = emit_reg(e->p, 0, 0xC1, 5, RSI);
+			e->p = emit_byte(e->p, 7);
+			e->p = emit_emu(e->p, OP_BYTE, 0x88, RSI, EMU(flag_c));
+			e->p = emit_mem(e->p, 0, 0x8D, RDX, RAX, RAX, 1, 0);
+			emit_rmw_result(e, desc, ea);
+			break;
+
+		case NATIVE_LSR:
+			//C = bit 0; edx = eax >> 1
+			ea = emit_rmw_operand(e, desc, operand);
+			emit_mov(e, RSI, RAX);
+			e->p = emit_reg(e->p, 0, 0x83, 4, RSI);
+			e->p = emit_byte(e->p, 1);
+			e->p = emit_emu(e->p, OP_BYTE, 0x88, RSI, EMU(flag_c));
+			emit_mov(e, RDX, RAX);
+			e->p = emit_reg(e->p, 0, 0xD1, 5, RDX);
+			emit_rmw_result(e, desc, ea);
+			break;
+
+		case NATIVE_ROL:
+			//edi = C; edx = eax << 1 | C; C = N, the way INSTR_ROL has it
+			ea = emit_rmw_operand(e, desc, operand);
+			e->p = emit_reg(e->p, 0, 0x31, RDI, RDI);
+			e->p = emit_emu(e->p, 0, 0x80, 7, EMU(flag_c));
+			e->p = emit_byte(e->p, 0);
+			e->p = emit_reg(e->p, OP_BYTE, 0x0F90 + CC_NE, 0, RDI);
+			e->p = emit_mem(e->p, 0, 0x8D, RDX, RDI, RAX, 2, 0);
+			e->p = emit_emu(e->p, 0, 0x0FB6, RSI, EMU(flag_n));
+			e->p = emit_reg(e->p, 0, 0xC1, 5, RSI);
+			e->p = emit_byte(e->p, 7);
+			e->p = emit_emu(e->p, OP_BYTE, 0x88, RSI, EMU(flag_c));
+			emit_rmw_result(e, desc, ea);
+			break;
+
+		case NATIVE_ROR:
+			//edi = C << 7; C = bit 0; edx = eax >> 1 | edi
+			ea = emit_rmw_operand(e, desc, operand);
+			e->p = emit_reg(e->p, 0, 0x31, RDI, RDI);
+			e->p = emit_emu(e->p, 0, 0x80, 7, EMU(flag_c));
+			e->p = emit_byte(e->p, 0);
+			e->p = emit_reg(e->p, OP_BYTE, 0x0F90 + CC_NE, 0, RDI);
+			e->p = emit_reg(e->p, 0, 0xC1, 4, RDI);
+			e->p = emit_byte(e->p, 7);
+			emit_mov(e, RSI, RAX);
+			e->p = emit_reg(e->p, 0, 0x83, 4, RSI);
+			e->p = emit_byte(e->p, 1);
+			e->p = emit_emu(e->p, OP_BYTE, 0x88, RSI, EMU(flag_c));
+			emit_mov(e, RDX, RAX);
+			e->p = emit_reg(e->p, 0, 0xD1, 5, RDX);
+			e->p = emit_reg(e->p, 0, 0x09, RDI, RDX);
+			emit_rmw_result(e, desc, ea);
+			break;
+
+		case NATIVE_INX: case NATIVE_INY: case NATIVE_DEX: case NATIVE_DEY:
+			//inc/dec reg8
+			emit_cycles(e, desc->cycles);
+			e->p = emit_reg(e->p, OP_BYTE, 0xFE, instr == NATIVE_INX || instr == NATIVE_INY ? 0 : 1, reg);
+			emit_set_nz(e, reg);
+			break;
+
+		case NATIVE_TAX: case NATIVE_TAY:
+			emit_cycles(e, desc->cycles);
+			reg = instr == NATIVE_TAX ? HOST_X : HOST_Y;
+			emit_mov(e, reg, HOST_A);
+			emit_set_nz(e, reg);
+			break;
+
+		case NATIVE_TXA: case NATIVE_TYA:
+			emit_cycles(e, desc->cycles);
+			emit_mov(e, HOST_A, instr == NATIVE_TXA ? HOST_X : HOST_Y);
+			emit_set_nz(e, HOST_A);
+			break;
+
+		case NATIVE_TSX:
+			emit_cycles(e, desc->cycles);
+			e->p = emit_emu(e->p, 0, 0x0FB6, HOST_X, EMU(S));
+			emit_set_nz(e, HOST_X);
+			break;
+
+		case NATIVE_TXS:
+			emit_cycles(e, desc->cycles);
+			e->p = emit_emu(e->p, OP_BYTE, 0x88, HOST_X, EMU(S));
+			break;
+
+		case NATIVE_CLC: case NATIVE_SEC: case NATIVE_CLV:
+			//mov byte [rbx + flag], 0/1
+			emit_cycles(e, desc->cycles);
+			e->p = emit_emu(e->p, 0, 0xC6, 0, instr == NATIVE_CLV ? EMU(flag_v) : EMU(flag_c));
+			e->p = emit_byte(e->p, instr == NATIVE_SEC);
+			break;
+
+		case NATIVE_NOP:
+			emit_cycles(e, desc->cycles);
+			break;
+
+		case NATIVE_PHA:
+			emit_cycles(e, desc->cycles);
+			emit_mov(e, RDX, HOST_A);
+			emit_push(e);
+			break;
+
+		case NATIVE_PLA:
+			emit_cycles(e, desc->cycles);
+			emit_step_s(e, 0);
+			emit_stack_addr(e, 0);
+			emit_read(e, -1);
+			emit_mov(e, HOST_A, RAX);
+			emit_set_nz(e, HOST_A);
+			break;
+
+		default:
+			return 0;
+	}
+
+	return 1;
+}
+
+//mov eax, count, then off to the exit; from the end of the block, where the exit isnt emitted yet
+static void emit_exit( block_emitter *e, unsigned int count )
+{
+	e->p = emit_mov_imm(e->p, RAX, count);
+	e->p = emit_jmp(e->p, JMP, 0);
+	e->exit_jump[e->num_exit_jumps++] = e->p - 4;
+}
+
+
+/**************************************
+ * Name:  emit_flow
+ * Inputs:  block_emitter * - the block being emitted
+ * 			unsigned char - the opcode
+ * 			unsigned short - its operand
+ * Outputs: int - 1 if it got translated, 0 if it has to call its handler
+ * Function: translates the instr that ends the block by going somewhere else,
+ * 			 and the exits after it; PC is set to wherever it went
+ *
+***************************************/
+static int emit_flow( block_emitter *e, unsigned char opcode, unsigned short operand )
+{
+	const opcode_desc *desc = &opcode_table[opcode];
+	int instr = native_instr[opcode];
+	unsigned short next = e->pc + desc->length;
+	unsigned short target = e->pc + 2 + (signed char)operand;
+	unsigned char *taken;
+	int field;
+
+	switch ( instr )
+	{
+		case NATIVE_JMP:
+			if ( desc->mode != MODE_ABSOLUTE )
+			{
+				return 0;
+			}
+			emit_cycles(e, desc->cycles);
+			e->p = emit_set_pc(e->p, operand);
+			emit_exit(e, e->count + 1);
+			break;
+
+		case NATIVE_JSR:
+			//pushes the addr of its last byte, high byte first
+			emit_cycles(e, desc->cycles);
+			e->p = emit_mov_imm(e->p, RDX, (unsigned short)(e->pc + 2) >> 8);
+			emit_push(e);
+			e->p = emit_mov_imm(e->p, RDX, (e->pc + 2) & 0xFF);
+			emit_push(e);
+			e->p = emit_set_pc(e->p, operand);
+			emit_exit(e, e->count + 1);
+			break;
+
+		case NATIVE_RTS:
+			//S+1; edx = low byte; eax = high byte, from S+1 again; S+1; PC = that + 1
+			emit_cycles(e, desc->cycles);
+			emit_step_s(e, 0);
+			emit_stack_addr(e, 0);
+			emit_read(e, -1);
+			emit_mov(e, RDX, RAX);
+			emit_stack_addr(e, 1);
+			emit_read(e, -1);
+			emit_step_s(e, 0);
+			e->p = emit_reg(e->p, 0, 0xC1, 4, RAX);
+			e->p = emit_byte(e->p, 8);
+			e->p = emit_reg(e->p, 0, 0x09, RDX, RAX);
+			e->p = emit_reg(e->p, 0, 0xFF, 0, RAX);
+			e->p = emit_emu(e->p, OP_16, 0x89, RAX, EMU(PC));
+			emit_exit(e, e->count + 1);
+			break;
+
+		case NATIVE_BCC: case NATIVE_BCS: case NATIVE_BEQ: case NATIVE_BNE:
+			//cmp byte [rbx + flag], 0; C is 0/1, Z is set when flag_z is 0
+			emit_cycles(e, desc->cycles);
+			field = instr == NATIVE_BCC || instr == NATIVE_BCS ? EMU(flag_c) : EMU(flag_z);
+			e->p = emit_emu(e->p, 0, 0x80, 7, field);
+			e->p = emit_byte(e->p, 0);
+			e->p = emit_jcc(e->p, instr == NATIVE_BCS || instr == NATIVE_BNE ? CC_NE : CC_E, 0);
+			taken = e->p - 4;
+
+			e->p = emit_set_pc(e->p, next);
+			emit_exit(e, e->count + 1);
+
+			//a taken branch takes 1 more, and another if it lands in a different page, see BRANCH_CYCLES
+			patch_rel32(taken, e->p);
+			emit_cycles(e, 1 + ((target ^ next) > 0xFF));
+			e->p = emit_set_pc(e->p, target);
+			emit_exit(e, e->count + 1);
+			break;
+
+		case NATIVE_BMI: case NATIVE_BPL: case NATIVE_BVS: case NATIVE_BVC:
+			//test byte [rbx + flag], 0x80
+			emit_cycles(e, desc->cycles);
+			field = instr == NATIVE_BMI || instr == NATIVE_BPL ? EMU(flag_n) : EMU(flag_v);
+			e->p = emit_emu(e->p, 0, 0xF6, 0, field);
+			e->p = emit_byte(e->p, 0x80);
+			e->p = emit_jcc(e->p, instr == NATIVE_BMI || instr == NATIVE_BVS ? CC_NE : CC_E, 0);
+			taken = e->p - 4;
+
+			e->p = emit_set_pc(e->p, next);
+			emit_exit(e, e->count + 1);
+
+			patch_rel32(taken, e->p);
+			emit_cycles(e, 1 + ((target ^ next) > 0xFF));
+			e->p = emit_set_pc(e->p, target);
+			emit_exit(e, e->count + 1);
+			break;
+
+		default:
+			return 0;
+	}
+
+	return 1;
+}
+
+#endif
+
+//mov word [rbx+PC], pc; mov esi, operand; mov rax, handler; call the handler trampoline
+static void emit_handler( block_emitter *e, unsigned char opcode, unsigned short operand )
+{
+	e->p = emit_set_pc(e->p, e->pc);
+	e->p = emit_mov_imm(e->p, RSI, operand);
+	e->p = emit_bytes(e->p, "\x48\xB8", 2);
+	e->p = emit_bytes(e->p, &dynarec_handler[opcode], sizeof(dynarec_handler_t));
+	e->p = emit_jmp(e->p, CALL, e->emu->dynarec_code + TRAMPOLINE_HANDLER * TRAMPOLINE_SIZE);
+	e->called_out = 1;
+	e->handled = 1;
+}
+
+
+/**************************************
+ * Name:  emit_out_of_line
+ * Inputs:  block_emitter * - the block, with its exit emitted
+ * 			unsigned char * - the exit
+ * Outputs: None
+ * Function: emits the slow paths and stale exits after the block,
+ * 			 and points the jumps to them at them
+ *
+***************************************/
+static void emit_out_of_line( block_emitter *e, unsigned char *exit )
+{
+	unsigned char *tramps = e->emu->dynarec_code;
+	out_of_line *out;
+	unsigned int i;
+	unsigned int j;
+
+	for ( i = 0; i < e->num_out; i++ )
+	{
+		out = &e->out[i];
+		for ( j = 0; j < out->num_jumps; j++ )
+		{
+			patch_rel32(out->jump[j], e->p);
+		}
+
+		e->p = emit_set_pc(e->p, out->pc);
+		if ( out->kind == OUT_EXIT )
+		{
+			e->p = emit_mov_imm(e->p, RAX, out->count);
+			e->p = emit_jmp(e->p, JMP, exit);
+			continue;
+		}
+
+		if ( out->ea >= 0 )
+		{
+			e->p = emit_mov_imm(e->p, RCX, out->ea);
+		}
+		e->p = emit_jmp(e->p, CALL, tramps + (out->kind == OUT_READ ? TRAMPOLINE_READ : TRAMPOLINE_WRITE) * TRAMPOLINE_SIZE);
+		e->p = emit_jmp(e->p, JMP, out->back);
+	}
+}
+
+
+//marks bytes of a page as translated, so writing them throws the page's blocks away
+static void mark_code_bytes( struct dynarec_page *dpage, unsigned int offset, unsigned int size )
+{
+	for ( ; size > 0 && offset < PAGE_SIZE; size--, offset++ )
+	{
+		dpage->code_bytes[offset / 8] |= 1 << (offset % 8);
+	}
+}
+
+//1 if a listener watches reads of any byte of the instr at addr; it gets called as the
+//interpreter decodes it
+static int fetch_watched( em6502 *emu, unsigned short addr, unsigned int length )
+{
+	unsigned int i;
+
+	for ( i = 0; i < length; i++ )
+	{
+		if ( READ_WATCHED(emu, addr + i) )
+		{
+			return 1;
+		}
+	}
+
+	return 0;
+}
+
+/**************************************
+ * Name:  protect_code
+ * Inputs:  em6502 * - the 6502 object
+ * 			int - PROT_READ | PROT_WRITE to emit code, PROT_READ | PROT_EXEC to run it
+ * Outputs: int - 1 if it worked
+ * Function: flips the whole code memory between writable and executable
+ * 			 if it cant be flipped, we give up on translating and interpret instead
+ *
+***************************************/
+static int protect_code( em6502 *emu, int prot )
+{
+	if ( mprotect(emu->dynarec_code, DYNAREC_CODE_SIZE, prot) != 0 )
+	{
+		printf("dynarec: could not change code memory protection, interpreting instead\n");
+		emu->engine = ENGINE_INTERPRETER;
+		return 0;
+	}
+
+	return 1;
+}
+
+/**************************************
+ * Name:  flush_all
+ * Inputs:  em6502 * - the 6502 object
+ * Outputs: None
+ * Function: throws away every translated block and reuses their code memory
+ *
+***************************************/
+static void flush_all( em6502 *emu )
+{
+	unsigned int page;
+
+	for ( page = 0; page < NUM_PAGES; page++ )
+	{
+		if ( emu->dynarec_pages[page] != 0 )
+		{
+			dynarec_invalidate_page(emu, page);
+		}
+	}
+
+	//the trampolines get written again along with the next block
+	emu->dynarec_code_used = 0;
+
+	//blocks put aside by switch_page_data are gone too
+	emu->dynarec_flushes++;
+}
+
+/**************************************
+ * Name:  translate_block
+ * Inputs:  em6502 * - the 6502 object
+ * 			unsigned short - addr the block starts at
+ * Outputs: dynarec_block * - the new block, 0 if we have no executable memory (or cant write it)
+ * Function: translates the block at addr and puts it in the block cache
+ * 			 if not even its first instr can be translated, the block
+ * 			 is still cached, with no code, so we dont try again every time
+ *
+***************************************/
+static dynarec_block *translate_block( em6502 *emu, unsigned short addr )
+{
+	static const unsigned char prologue[] =
+	{
+		0x53, 0x55, 0x41, 0x54, 0x41, 0x55, 0x41, 0x56, 0x41, 0x57, //push rbx, rbp, r12-r15
+		0x48, 0x83, 0xEC, 0x08, //sub rsp, 8; 16 byte aligned again
+		0x48, 0x89, 0xFB //mov rbx, rdi
+	};
+	static const unsigned char epilogue[] =
+	{
+		0x48, 0x83, 0xC4, 0x08, //add rsp, 8
+		0x41, 0x5F, 0x41, 0x5E, 0x41, 0x5D, 0x41, 0x5C, 0x5D, 0x5B, //pop r15-r12, rbp, rbx
+		0xC3 //ret
+	};
+	block_emitter *e;
+	struct dynarec_page *dpage;
+	dynarec_block *block;
+	const opcode_desc *desc;
+	unsigned char *start;
+	unsigned char *exit;
+	unsigned char opcode;
+	unsigned short operand;
+	unsigned int i;
+
+	if ( emu->dynarec_code == 0 )
+	{
+		//first block this emulator translates
+		start = mmap(0, DYNAREC_CODE_SIZE, PROT_READ | PROT_EXEC, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+		if ( start == MAP_FAILED )
+		{
+			printf("dynarec: could not get executable memory, interpreting instead\n");
+			emu->engine = ENGINE_INTERPRETER;
+			return 0;
+		}
+
+		emu->dynarec_code = start;
+		emu->dynarec_code_used = 0;
+	}
+
+	if ( emu->dynarec_code_used + MAX_BLOCK_CODE > DYNAREC_CODE_SIZE )
+	{
+		flush_all(emu);
+	}
+
+	if ( !protect_code(emu, PROT_READ | PROT_WRITE) )
+	{
+		return 0;
+	}
+
+	if ( emu->dynarec_code_used == 0 )
+	{
+		emit_trampolines(emu->dynarec_code);
+		emu->dynarec_code_used = NUM_TRAMPOLINES * TRAMPOLINE_SIZE;
+	}
+
+	dpage = emu->dynarec_pages[addr / PAGE_SIZE];
+	if ( dpage == 0 )
+	{
+		//first block in this page
+		dpage = (struct dynarec_page *)calloc(1, sizeof(struct dynarec_page));
+		emu->dynarec_pages[addr / PAGE_SIZE] = dpage;
+	}
+
+	block = (dynarec_block *)calloc(1, sizeof(dynarec_block));
+	dpage->block[addr % PAGE_SIZE] = block;
+
+	//the slow paths make it too big for the stack of a batch thread
+	e = (block_emitter *)malloc(sizeof(block_emitter));
+	e->emu = emu;
+	e->pc = addr;
+	e->count = 0;
+	e->num_out = 0;
+	e->num_exit_jumps = 0;
+
+	start = e->p = emu->dynarec_code + emu->dynarec_code_used;
+	e->p = emit_bytes(e->p, prologue, sizeof(prologue));
+	e->p = emit_load_regs(e->p);
+
+	//the code gets peeked at, not read; the cpu hasnt got to most of it yet, and a listener
+	//(a cart's hotspot, say) mustnt hear about reads that havent happened
+	while ( e->count < DYNAREC_MAX_BLOCK_INSTRS )
+	{
+		opcode = PEEK_MEM(emu, e->pc);
+		desc = &opcode_table[opcode];
+
+		//invalid opcodes, instrs running into the next page, anything that can stop
+		//the run (BRK, breakpoints), and instrs a listener watches being fetched
+		//are left to the interpreter
+		if ( desc->mode == MODE_NONE || e->pc % PAGE_SIZE + desc->length > PAGE_SIZE ||
+			 opcode == 0x00 || BREAKPOINT_AT(emu, e->pc) || fetch_watched(emu, e->pc, desc->length) )
+		{
+			break;
+		}
+
+		operand = 0;
+		if ( desc->length > 1 )
+		{
+			operand = PEEK_MEM(emu, e->pc + 1);
+		}
+		if ( desc->length > 2 )
+		{
+			operand |= PEEK_MEM(emu, e->pc + 2) << 8;
+		}
+
+		e->called_out = 0;
+		e->handled = 0;
+		#ifdef ENABLE_LAZY_FLAGS
+		if ( changes_flow(opcode) ? !emit_flow(e, opcode, operand) : !emit_native(e, opcode, operand) )
+		#endif
+		{
+			emit_handler(e, opcode, operand);
+		}
+
+		mark_code_bytes(dpage, e->pc % PAGE_SIZE, desc->length);
+		block->last = e->pc;
+		block->count++;
+		e->count++;
+
+		//a taken branch can cross a page on top of its penalty
+		block->max_cycles += desc->cycles + desc->page_penalty + (desc->mode == MODE_RELATIVE);
+		e->pc += desc->length;
+
+		//a block's code_bytes are all in its own page, so it can't run into the next one (or wrap around to page 0)
+		if ( changes_flow(opcode) || e->pc / PAGE_SIZE != addr / PAGE_SIZE )
+		{
+			break;
+		}
+
+		//stop if the instr overwrote code, before the next one runs
+		if ( e->called_out && e->count < DYNAREC_MAX_BLOCK_INSTRS )
+		{
+			e->p = emit_emu(e->p, 0, 0x80, 7, EMU(dynarec_stale));
+			e->p = emit_byte(e->p, 0);
+			jump_out(e, add_out_of_line(e, OUT_EXIT, 0), CC_NE);
+			e->out[e->num_out - 1].pc = e->pc;
+			e->out[e->num_out - 1].count = e->count;
+		}
+
+		assert(e->p - start <= 100 + e->count * MAX_INSTR_CODE);
+	}
+
+	if ( block->count == 0 )
+	{
+		free(e);
+		protect_code(emu, PROT_READ | PROT_EXEC);
+
+		//still have to notice if this gets overwritten with something we can translate
+		mark_code_bytes(dpage, addr % PAGE_SIZE, 3);
+		return block;
+	}
+
+	//a block that didnt end going somewhere goes on to the next instr; a handler set PC itself
+	if ( e->num_exit_jumps == 0 )
+	{
+		if ( !e->handled )
+		{
+			e->p = emit_set_pc(e->p, e->pc);
+		}
+		e->p = emit_mov_imm(e->p, RAX, e->count);
+	}
+	else if ( e->exit_jump[e->num_exit_jumps - 1] == e->p - 4 )
+	{
+		//the last exit can fall into it instead
+		e->p -= 5;
+		e->num_exit_jumps--;
+	}
+
+	exit = e->p;
+	e->p = emit_store_regs(e->p);
+	e->p = emit_bytes(e->p, epilogue, sizeof(epilogue));
+	for ( i = 0; i < e->num_exit_jumps; i++ )
+	{
+		patch_rel32(e->exit_jump[i], exit);
+	}
+
+	emit_out_of_line(e, exit);
+	assert(e->p - start <= MAX_BLOCK_CODE);
+
+	block->code = start;
+	emu->dynarec_code_used += e->p - start;
+	free(e);
+
+	if ( !protect_code(emu, PROT_READ | PROT_EXEC) )
+	{
+		block->code = 0;
+		return 0;
+	}
+
+	return block;
+}
+
+
+/**************************************
+ * Name:  dynarec_invalidate_page
+ * Inputs:  em6502 * - the 6502 object
+ * 			unsigned int - the page
+ * Outputs: None
+ * Function: throws away every block translated from the page
+ * 			 their code memory only gets reused once it all fills up
+ *
+***************************************/
+void dynarec_invalidate_page( em6502 *emu, unsigned int page )
+{
+	if ( emu->dynarec_pages[page] == 0 )
+	{
+		return;
+	}
+
+	dynarec_free_page(emu->dynarec_pages[page]);
+	emu->dynarec_pages[page] = 0;
+
+	//the block that's running might be one of them
+	emu->dynarec_stale = 1;
+}
+
+
+/**************************************
+ * Name:  dynarec_free_page
+ * Inputs:  struct dynarec_page * - blocks translated from a page, can be 0
+ * Outputs: None
+ * Function: frees them
+ *
+***************************************/
+void dynarec_free_page( struct dynarec_page *dpage )
+{
+	int i;
+
+	if ( dpage == 0 )
+	{
+		return;
+	}
+
+	for ( i = 0; i < PAGE_SIZE; i++ )
+	{
+		free(dpage->block[i]);
+	}
+
+	free(dpage);
+}
+
+
+/**************************************
+ * Name:  dynarec_invalidate
+ * Inputs:  em6502 * - the 6502 object
+ * 			unsigned short - addr that was written
+ * Outputs: None
+ * Function: if a block was translated from the byte at addr, throws away
+ * 			 every block in its page
+ *
+***************************************/
+void dynarec_invalidate( em6502 *emu, unsigned short addr )
+{
+	struct dynarec_page *dpage = emu->dynarec_pages[addr / PAGE_SIZE];
+	unsigned int offset = addr % PAGE_SIZE;
+
+	if ( dpage != 0 && (dpage->code_bytes[offset / 8] & (1 << (offset % 8))) )
+	{
+		dynarec_invalidate_page(emu, addr / PAGE_SIZE);
+	}
+}
+
+
+/**************************************
+ * Name:  dynarec_free
+ * Inputs:  em6502 * - the 6502 object
+ * Outputs: None
+ * Function: throws away every translated block, and gives back their code memory
+ *
+***************************************/
+void dynarec_free( em6502 *emu )
+{
+	flush_all(emu);
+
+	if ( emu->dynarec_code != 0 )
+	{
+		munmap(emu->dynarec_code, DYNAREC_CODE_SIZE);
+		emu->dynarec_code = 0;
+	}
+}
+
+
+/**************************************
+ * Name:  run_dynarec
+ * Inputs:  em6502 * - the 6502 object to execute
+ *				unsigned int - max number of instructions to execute, -1 for all
+ * Outputs: int - why it stopped, one of STOP_*
+ * Function: same as run_program, but runs translated blocks wherever it can
+ *
+***************************************/
+int run_dynarec( em6502 *emu, unsigned int max_instr_count )
+{
+	struct dynarec_page *dpage;
+	dynarec_block *block;
+	unsigned int ran;
+	int stop;
+
+	while ( max_instr_count != 0 )
+	{
+		#ifdef ENABLE_CYCLE_COUNT
+		if ( emu->cycles >= emu->cycle_limit )
+		{
+			break;
+		}
+		#endif
+
+		block = 0;
+
+		//code in pages with a listener is always interpreted, so the listener sees it fetched
+		if ( !HAS_LISTENER(emu->page_table[emu->PC / PAGE_SIZE]) )
+		{
+			dpage = emu->dynarec_pages[emu->PC / PAGE_SIZE];
+			if ( dpage != 0 )
+			{
+				block = dpage->block[emu->PC % PAGE_SIZE];
+			}
+			if ( block == 0 )
+			{
+				block = translate_block(emu, emu->PC);
+			}
+		}
+
+		//the interpreter also takes whatever we couldnt translate, and the end of the budget
+		if ( block == 0 || block->code == 0 || block->count > max_instr_count || BLOCK_OVER_CYCLE_LIMIT(emu, block) )
+		{
+			stop = run_interpreter(emu, 1);
+			if ( stop != STOP_BUDGET )
+			{
+				return stop;
+			}
+			max_instr_count--;
+			continue;
+		}
+
+		emu->dynarec_stale = 0;
+		ran = ((dynarec_entry_t)block->code)(emu);
+
+		emu->instr_count += ran;
+		max_instr_count -= ran;
+
+		#ifdef ENABLE_IDLE_SKIP
+		//the block ended jumping back; same as the interpreter does there, before the jump is counted
+		//if it overwrote code, the block itself may be gone
+		if ( !emu->dynarec_stale && ran == block->count && emu->PC <= block->last )
+		{
+			#ifdef ENABLE_LAZY_FLAGS
+			PACK_FLAGS(emu, emu->P);
+			#endif
+			emu->instr_count--;
+			ran = idle_loop_skip(emu, emu->PC, block->last, max_instr_count);
+			emu->instr_count++;
+			max_instr_count -= ran;
+		}
+		#endif
+	}
+
+	return STOP_BUDGET;
+}
+
+#endif
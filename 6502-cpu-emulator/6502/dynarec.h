@@ -0,0 +1,72 @@
+#ifndef DYNAREC_H
+#define DYNAREC_H
+
+#include "em_6502.h"
+
+#ifdef ENABLE_DYNAREC
+
+//runs a single instr at emu->PC; translated blocks call these for the instrs they dont turn into x86
+//the operand was decoded when the block was translated, so it gets passed in
+typedef void (*dynarec_handler_t)( em6502 *, unsigned short );
+
+//one handler per opcode, built from opcodes.def in em_6502.c
+//invalid opcodes have none; they're never translated
+extern const dynarec_handler_t dynarec_handler[256];
+
+
+/**************************************
+ * Name:  run_dynarec
+ * Inputs:  em6502 * - the 6502 object to execute
+ *				unsigned int - max number of instructions to execute, -1 for all
+ * Outputs: int - why it stopped, one of STOP_*
+ * Function: same as run_program, but runs translated blocks wherever it can
+ *
+***************************************/
+int run_dynarec( em6502 *, unsigned int );
+
+
+/**************************************
+ * Name:  dynarec_invalidate
+ * Inputs:  em6502 * - the 6502 object
+ * 			unsigned short - addr that was written
+ * Outputs: None
+ * Function: if a block was translated from the byte at addr, throws away
+ * 			 every block in its page
+ *
+***************************************/
+void dynarec_invalidate( em6502 *, unsigned short );
+
+
+/**************************************
+ * Name:  dynarec_invalidate_page
+ * Inputs:  em6502 * - the 6502 object
+ * 			unsigned int - the page
+ * Outputs: None
+ * Function: throws away every block translated from the page
+ *
+***************************************/
+void dynarec_invalidate_page( em6502 *, unsigned int );
+
+
+/**************************************
+ * Name:  dynarec_free_page
+ * Inputs:  struct dynarec_page * - blocks translated from a page, can be 0
+ * Outputs: None
+ * Function: frees them; for pages put aside by switch_page_data
+ *
+***************************************/
+void dynarec_free_page( struct dynarec_page * );
+
+
+/**************************************
+ * Name:  dynarec_free
+ * Inputs:  em6502 * - the 6502 object
+ * Outputs: None
+ * Function: throws away every translated block, and gives back their code memory
+ *
+***************************************/
+void dynarec_free( em6502 * );
+
+#endif
+
+#endif /* DYNAREC_H */
@@ -6,6 +6,11 @@
 
 
 #include "em_6502.h"
+#include "dynarec.h"
+#include "profile.h"
+#include "idle.h"
+#include "events.h"
+#include "alu.h"
 
 
 
@@ -24,6 +29,112 @@
  *
  *
  */
+
+//the interpreter has a case for each of the 256 opcodes, one for instrs with a breakpoint,
+//then one for each sequence in fusions.def, numbered in the order they're listed there
+enum {
+	LAST_OPCODE_HANDLER = 255,
+	BREAKPOINT_HANDLER,
+	#ifdef ENABLE_FUSION
+	#define FUSE2(op1,m1,mode1,len1,op2,m2,mode2,len2) FUSION_##op1##_##op2,
+	#define FUSE3(op1,m1,mode1,len1,op2,m2,mode2,len2,op3,m3,mode3,len3) FUSION_##op1##_##op2##_##op3,
+	#include "fusions.def"
+	#undef FUSE2
+	#undef FUSE3
+	#endif
+	NUM_HANDLERS
+};
+
+#ifdef ENABLE_FUSION
+
+//the opcodes each fused sequence starts with, for spotting them as they're decoded
+static const struct {
+	unsigned char length; //instrs in it
+	unsigned char opcode[MAX_FUSED_INSTRS];
+} fusion_table[] =
+{
+	#define FUSE2(op1,m1,mode1,len1,op2,m2,mode2,len2) { 2, { op1, op2 } },
+	#define FUSE3(op1,m1,mode1,len1,op2,m2,mode2,len2,op3,m3,mode3,len3) { 3, { op1, op2, op3 } },
+	#include "fusions.def"
+	#undef FUSE2
+	#undef FUSE3
+};
+
+//a fused slot covers every byte of its sequence, up to 3 bytes an instr
+#define DECODED_SPAN (MAX_FUSED_INSTRS * 3)
+#else
+#define DECODED_SPAN 3
+#endif
+
+#ifdef ENABLE_PREDECODE_CACHE
+/**************************************
+ * Name:  invalidate_decoded_byte
+ * Inputs:  em6502 * - the 6502 chip whose memory changed
+ *				unsigned short  - the addr that changed
+ * Outputs: None
+ * Function: drops every cached instr the byte at addr could be part of;
+ *			 that's the instr starting there plus the 2 before it,
+ *			 since an instr is at most 3 bytes long,
+ *			 plus any fused sequence starting further back that runs over it
+ *
+***************************************/
+static void invalidate_decoded_byte( em6502 *emu, unsigned short addr )
+{
+	int i;
+	decoded_instr *cache;
+	unsigned short slot = addr;
+
+	for ( i = 0; i < 3; i++, slot--)
+	{
+		cache = emu->decode_cache[slot / PAGE_SIZE];
+		if ( cache != 0 )
+		{
+			cache[slot % PAGE_SIZE].length = 0;
+		}
+	}
+
+	#ifdef ENABLE_FUSION
+	//fused sequences never leave their page, so only a page with some in it needs a longer look
+	cache = emu->decode_cache[addr / PAGE_SIZE];
+	if ( cache == 0 || !emu->fused_pages[addr / PAGE_SIZE] )
+	{
+		return;
+	}
+
+	for ( ; i < DECODED_SPAN && i <= addr % PAGE_SIZE; i++ )
+	{
+		if ( cache[addr % PAGE_SIZE - i].handler > BREAKPOINT_HANDLER )
+		{
+			cache[addr % PAGE_SIZE - i].length = 0;
+		}
+	}
+	#endif
+}
+#endif
+
+//calls every listener watching this kind of access to addr, in the order they were added
+static void notify_listeners( em6502 *emu, unsigned short addr, unsigned char val, unsigned char mode )
+{
+	write_listener *listener;
+	unsigned int i;
+
+	for ( i = 0; i < emu->num_write_listeners; i++ )
+	{
+		listener = &emu->write_listeners[i];
+		if ( addr >= listener->region.low && addr <= listener->region.high && (listener->mode & mode) )
+		{
+			if ( listener->cb_access != 0 )
+			{
+				(* listener->cb_access)(emu, listener->context, addr, val, mode);
+			}
+			else
+			{
+				(* listener->cb_mem_write)(addr);
+			}
+		}
+	}
+}
+
 /**************************************
  * Name:  read_mem
  * Inputs:  em6502 * - the 6502 chip whose memory we want to read
@@ -34,9 +145,25 @@
 ***************************************/
 inline unsigned char read_mem( em6502 *em, unsigned short addr )
 {
+	page_t *page;
+
+	#ifdef ENABLE_FAST_MEMORY
+	//nothing to check; RAM, ROM, or a page shared with a fork
+	if ( em->read_pages[addr / PAGE_SIZE] != 0 )
+	{
+		return em->read_pages[addr / PAGE_SIZE][addr % PAGE_SIZE];
+	}
+	#endif
+
+	//a listener can switch what's there, so it goes first
+	if ( READ_WATCHED(em, addr) )
+	{
+		notify_listeners(em, addr, 0, READ);
+	}
+
 	//need to translate our addr to page in pagetable
 	//addr(0-255) goto page 0, addr (256-256+255) goto page 1, etc
-	page_t *page = em->page_table[addr / PAGE_SIZE];
+	page = em->page_table[addr / PAGE_SIZE];
 
 	//check that we have permissions to read it
 	assert(GET_READ(page->flag));
@@ -47,9 +174,103 @@ inline unsigned char read_mem( em6502 *em, unsigned short addr )
 		(* page->cb_mem_listener)(addr,page->data[addr % PAGE_SIZE],READ);
 	}
 
+	//a device decides what gets read
+	if ( page->cb_device != 0 )
+	{
+		return (* page->cb_device)(em, page->device_context, addr, page->data[addr % PAGE_SIZE], READ);
+	}
+
 	return page->data[addr % PAGE_SIZE];
 }
 
+//works out whether the page's accesses can skip its page_t
+//reads can skip it wherever its bytes are, as long as nothing hears about them; writes only to plain RAM,
+//since ROM ignores them and a shared page gets copied first
+static void update_slow_page( em6502 *emu, unsigned int page )
+{
+	#ifdef ENABLE_FAST_MEMORY
+	page_t *p = emu->page_table[page];
+
+	emu->read_pages[page] = 0;
+	if ( emu->_memory != 0 && !HAS_LISTENER(p) && emu->read_watch_masks[page] == 0 && (GET_READ(p->flag)) )
+	{
+		emu->read_pages[page] = p->data;
+	}
+
+	if ( emu->_memory != 0 && p->data == &emu->_memory[page * PAGE_SIZE] && !HAS_LISTENER(p) &&
+		 emu->read_watch_masks[page] == 0 && (GET_READ(p->flag)) && (GET_WRITE(p->flag)) )
+	{
+		emu->slow_pages[page] = 0;
+	}
+	else
+	{
+		emu->slow_pages[page] = 1;
+	}
+	#endif
+}
+
+//lets go of a page shared with forks, freeing it once none of them have it
+static void release_shared_page( em6502 *emu, unsigned int page )
+{
+	shared_page *shared = emu->shared_pages[page];
+
+	emu->shared_pages[page] = 0;
+	if ( --shared->refs == 0 )
+	{
+		free(shared);
+	}
+}
+
+/**************************************
+ * Name:  unshare_page
+ * Inputs:  em6502 * - the 6502 object
+ * 			unsigned int - the page
+ * Outputs: None
+ * Function: gives the emulator its own copy of a page it shares with a fork, if it does;
+ * 			 the copy goes back in its place in _memory, making it plain RAM again
+ *
+***************************************/
+void unshare_page( em6502 *emu, unsigned int page )
+{
+	if ( emu->shared_pages[page] == 0 )
+	{
+		return;
+	}
+
+	memcpy(&emu->_memory[page * PAGE_SIZE], emu->shared_pages[page]->data, PAGE_SIZE);
+	emu->page_table[page]->data = &emu->_memory[page * PAGE_SIZE];
+	release_shared_page(emu, page);
+
+	//the bytes are the same, so whatever was decoded from them still holds
+	update_slow_page(emu, page);
+}
+
+/**************************************
+ * Name:  share_page
+ * Inputs:  em6502 * - the 6502 object
+ * 			unsigned int - the page
+ * 			shared_page * - what to point it at
+ * Outputs: None
+ * Function: points the page at a shared_page holding the same bytes it does, letting go
+ * 			 of whichever it shared before; the page has to be in its place in _memory
+ * 			 or shared already. Writes to it get it copied back, like a fork's
+ *
+***************************************/
+void share_page( em6502 *emu, unsigned int page, shared_page *shared )
+{
+	shared->refs++;
+	if ( emu->shared_pages[page] != 0 )
+	{
+		release_shared_page(emu, page);
+	}
+
+	emu->shared_pages[page] = shared;
+	emu->page_table[page]->data = shared->data;
+
+	//same bytes, so whatever was decoded from them still holds
+	update_slow_page(emu, page);
+}
+
 /**************************************
  * Name:  write_mem
  * Inputs:  em6502 * - the 6502 chip whose memory we want to write
@@ -61,55 +282,270 @@ inline unsigned char read_mem( em6502 *em, unsigned short addr )
 ***************************************/
 inline void write_mem( em6502 *emu, unsigned short addr, unsigned char val )
 {
-	//need to translate our addr to page in pagetable
-	//addr(0-255) goto page 0, etc
-	page_t *page = emu->page_table[addr / PAGE_SIZE];
+	page_t *page;
+	unsigned char stored = val;
 
-	//check that we have permissions to read it
-	assert(GET_WRITE(page->flag));
+	#ifdef ENABLE_FAST_MEMORY
+	if ( !SLOW_PAGE(emu, addr) )
+	{
+		//plain RAM, nothing to check
+		emu->_memory[addr] = val;
+	}
+	else
+	#endif
+	{
+		//need to translate our addr to page in pagetable
+		//addr(0-255) goto page 0, etc
+		page = emu->page_table[addr / PAGE_SIZE];
 
-	//if handler exists, invoke it for mode=READ
-	if ( page->cb_mem_listener != 0)
+		//if handler exists, invoke it for mode=READ
+		if ( page->cb_mem_listener != 0)
+		{
+			(* page->cb_mem_listener)(addr,val,WRITE);
+		}
+
+		//and a device what gets stored
+		if ( page->cb_device != 0 )
+		{
+			stored = (* page->cb_device)(emu, page->device_context, addr, val, WRITE);
+		}
+
+		//writes to ROM go nowhere, the same as on the real bus (its data may well be mapped
+		//read-only, see rom.c). nothing changed, so there's no code to drop or page to roll back;
+		//listeners still see them, that's how carts bank switch
+		if ( (GET_WRITE(page->flag)) == 0 )
+		{
+			if ( WATCHED(emu, addr) )
+			{
+				notify_listeners(emu, addr, val, WRITE);
+			}
+			return;
+		}
+
+		//a page shared with forks gets copied before it's written
+		if ( emu->shared_pages[addr / PAGE_SIZE] != 0 )
+		{
+			unshare_page(emu, addr / PAGE_SIZE);
+		}
+
+		//modify actual memory location
+		page->data[addr % PAGE_SIZE] = stored;
+	}
+
+	#ifdef ENABLE_PREDECODE_CACHE
+	//if we just overwrote code, it must be decoded again
+	invalidate_decoded_byte(emu, addr);
+	#endif
+
+	#ifdef ENABLE_DYNAREC
+	//and translated again
+	if ( emu->dynarec_pages[addr / PAGE_SIZE] != 0 )
+	{
+		dynarec_invalidate(emu, addr);
+	}
+	#endif
+
+	MARK_DIRTY(emu, addr);
+
+	//listeners get what the cpu wrote
+	if ( WATCHED(emu, addr) )
+	{
+		notify_listeners(emu, addr, val, WRITE);
+	}
+}
+
+#ifdef ENABLE_FAST_MEMORY
+//read_mem's fast path on its own, small enough to go inline everywhere the instrs read;
+//RAM, ROM and shared pages get read right there, and only pages something listens to call out
+static inline unsigned char read_ram( em6502 *emu, unsigned short addr )
+{
+	if ( emu->read_pages[addr / PAGE_SIZE] == 0 )
 	{
-		(* page->cb_mem_listener)(addr,val,WRITE);
+		return read_mem(emu, addr);
 	}
 
-	//modify actual memory location
-	page->data[addr % PAGE_SIZE] = val;
+	return emu->read_pages[addr / PAGE_SIZE][addr % PAGE_SIZE];
 }
 
+#define MEM_READ(addr) read_ram(emu,(addr))
+#else
+#define MEM_READ(addr) read_mem(emu,(addr))
+#endif
+
+//the registers, as the instrs below get at them
+//run_interpreter swaps in its own versions of these, see there
+#define REG_A emu->Acc
+#define REG_X emu->X
+#define REG_Y emu->Y
+#define REG_P emu->P
+#define REG_S emu->S
+#define REG_PC emu->PC
+
+//write the registers/just PC back to the em6502, for when they're kept somewhere else
+#define SPILL_REGS
+#define SPILL_PC
+
+#ifdef ENABLE_PREDECODE_CACHE
+//the case of the interpreter that runs the instr at PC
+#define CURRENT_HANDLER instr->handler
+
+//This is a convenience macro for getting the next argument for the PC
+//it comes straight out of the decoded instr
+#define GET_FIRST_ARG ((unsigned char)instr->operand)
+
+//This is a convenience macro for getting the 2nd next argument for the PC
+#define GET_SECOND_ARG ((unsigned char)(instr->operand >> 8))
+
+//both arguments, already put together into an addr
+#define GET_ADDR_ARG instr->operand
+#else
+//the case of the interpreter that runs the instr at PC
+#define CURRENT_HANDLER MEM_READ(REG_PC)
+
 //This is a convenience macro for getting the next argument for the PC
-#define GET_FIRST_ARG read_mem(emu,emu->PC+1)
+#define GET_FIRST_ARG MEM_READ(REG_PC+1)
 						//emu->Memory[emu->PC+1]
 
 //This is a convenience macro for getting the 2nd next argument for the PC
-#define GET_SECOND_ARG read_mem(emu,emu->PC+2)
+#define GET_SECOND_ARG MEM_READ(REG_PC+2)
 						//emu->Memory[emu->PC+2]
 
+//both arguments, put together into an addr
+#define GET_ADDR_ARG generate_addr(GET_FIRST_ARG, GET_SECOND_ARG)
+#endif
+
 
 //These are convinience macros for commonly used addressing modes
 //they each return the addr for the memory access
 #define IMMIDIATE_ACCESS GET_FIRST_ARG
 #define ZP_DIRECT_ACCESS (unsigned char)GET_FIRST_ARG //we must not allow overflow to short type on zero-page addrs
-#define ZP_INDEXED_X_ACCESS (unsigned char) (GET_FIRST_ARG + emu->X) //we must not allow overflow to short type on zero-page addrs
-#define ZP_INDEXED_Y_ACCESS (unsigned char)(GET_FIRST_ARG + emu->Y) //we must not allow overflow to short type on zero-page addrs
+#define ZP_INDEXED_X_ACCESS (unsigned char) (GET_FIRST_ARG + REG_X) //we must not allow overflow to short type on zero-page addrs
+#define ZP_INDEXED_Y_ACCESS (unsigned char)(GET_FIRST_ARG + REG_Y) //we must not allow overflow to short type on zero-page addrs
 //#define PRE_INDEXED_X_INDIRECT_ACCESS generate_addr( emu->Memory[GET_FIRST_ARG + emu->X], emu->Memory[GET_FIRST_ARG + emu->X + 1] )
-#define PRE_INDEXED_X_INDIRECT_ACCESS generate_addr( read_mem(emu,GET_FIRST_ARG + emu->X), read_mem(emu,GET_FIRST_ARG + emu->X + 1) )
+#define PRE_INDEXED_X_INDIRECT_ACCESS generate_addr( MEM_READ(GET_FIRST_ARG + REG_X), MEM_READ(GET_FIRST_ARG + REG_X + 1) )
 
 //#define POST_INDEXED_Y_INDIRECT_ACCESS generate_addr( emu->Memory[GET_FIRST_ARG], emu->Memory[GET_FIRST_ARG + 1] ) + emu->Y
-#define POST_INDEXED_Y_INDIRECT_ACCESS generate_addr( read_mem(emu,GET_FIRST_ARG), read_mem(emu,GET_FIRST_ARG + 1) ) + emu->Y
+#define POST_INDEXED_Y_INDIRECT_ACCESS generate_addr( MEM_READ(GET_FIRST_ARG), MEM_READ(GET_FIRST_ARG + 1) ) + REG_Y
+
+#define EXTENDED_DIRECT_ACCESS GET_ADDR_ARG
+#define ABSOLUTE_INDEXED_Y_ACCESS GET_ADDR_ARG+REG_Y
+#define ABSOLUTE_INDEXED_X_ACCESS GET_ADDR_ARG+REG_X
+
+#ifdef ENABLE_PROFILER
+#define PROFILE_INSTR SPILL_PC; profile_instr(emu, instr->opcode)
+#else
+#define PROFILE_INSTR
+#endif
+
+#ifdef ENABLE_PREDECODE_CACHE
+//looks up the decoded instr at PC, only calling out to decode it on a miss
+#define FETCH_INSTR \
+	do { \
+		instr = emu->decode_cache[REG_PC / PAGE_SIZE]; \
+		if ( instr == 0 || (instr += REG_PC % PAGE_SIZE)->length == 0 ) \
+		{ \
+			SPILL_PC; \
+			instr = fetch_decoded(emu, &scratch); \
+		} \
+		PROFILE_INSTR; \
+	} while (0)
+#else
+//opcode and operands get read straight from memory
+//with nowhere to mark instrs with breakpoints, every one gets checked
+#define FETCH_INSTR \
+	if ( BREAKPOINT_AT(emu, REG_PC) && BREAKPOINT_STOPS ) STOP_RUN(STOP_BREAKPOINT)
+#endif
+
+//leaves run_interpreter, with PC at the instr it stopped at
+#define STOP_RUN(reason) \
+	do { \
+		stop = (reason); \
+		goto stop_run; \
+	} while (0)
+
+//whether the breakpoint at PC stops the run; it doesnt if run_program started there,
+//the first time it gets there
+#define BREAKPOINT_STOPS ( !emu->resume || REG_PC != emu->resume_pc || (emu->resume = 0) )
+
+
+#ifdef ENABLE_THREADED_DISPATCH
+//each opcode is a label; run_program's dispatch_table holds their addrs
+#define OPCODE(code) op_##code
+
+#ifdef ALLOW_MAX_INSTR_COUNT
+	#define COUNT_INSTR emu->instr_count++
+	#define INSTR_BUDGET_LEFT (max_instr_count-- != 0 && CYCLE_BUDGET_LEFT)
+#else
+	#define COUNT_INSTR
+	#define INSTR_BUDGET_LEFT CYCLE_BUDGET_LEFT
+#endif
+
+//every instr ends with its own copy of the fetch-and-jump to the next one,
+//rather than all of them going back through one shared switch. that gives
+//the host cpu a separate indirect jump to predict after each opcode
+#define NEXT_INSTR_NO_COUNT \
+	do { \
+		if ( !INSTR_BUDGET_LEFT ) STOP_RUN(STOP_BUDGET); \
+		FETCH_INSTR; \
+		DISPATCH(CURRENT_HANDLER); \
+	} while (0)
+
+#define NEXT_INSTR \
+	do { \
+		COUNT_INSTR; \
+		NEXT_INSTR_NO_COUNT; \
+	} while (0)
+
+//between the instrs of a fused sequence: counts the one that just ran and moves on
+//to the next one's decoded slot. if the budget ran out, or the one that just ran
+//overwrote the rest of the sequence, we're back to dispatching one instr at a time
+#define FUSED_NEXT(len) \
+	COUNT_INSTR; \
+	if ( !INSTR_BUDGET_LEFT ) STOP_RUN(STOP_BUDGET); \
+	if ( (instr + (len))->length == 0 ) \
+	{ \
+		FETCH_INSTR; \
+		DISPATCH(CURRENT_HANDLER); \
+	} \
+	instr += (len)
+
+//runs the case for handler
+#define DISPATCH(handler) goto *dispatch_table[handler]
+#else
+//each opcode is a case in run_program's switch
+#define OPCODE(code) case code
+#define NEXT_INSTR break
+
+//runs the case for handler; it goes back to the top of the switch
+#define DISPATCH(handler) \
+	do { \
+		cur_handler = (handler); \
+		goto dispatch; \
+	} while (0)
+
+//between the instrs of a fused sequence, see above
+//breaking out leaves the rest of it to the loop, one instr at a time
+#ifdef ALLOW_MAX_INSTR_COUNT
+	#define FUSED_NEXT(len) \
+		if ( max_instr_count == 0 || !CYCLE_BUDGET_LEFT || (instr + (len))->length == 0 ) break; \
+		max_instr_count--; \
+		emu->instr_count++; \
+		instr += (len)
+#else
+	#define FUSED_NEXT(len) \
+		if ( !CYCLE_BUDGET_LEFT || (instr + (len))->length == 0 ) break; \
+		instr += (len)
+#endif
+#endif
 
-#define EXTENDED_DIRECT_ACCESS generate_addr(GET_FIRST_ARG, GET_SECOND_ARG)
-#define ABSOLUTE_INDEXED_Y_ACCESS generate_addr(GET_FIRST_ARG, GET_SECOND_ARG)+emu->Y
-#define ABSOLUTE_INDEXED_X_ACCESS generate_addr(GET_FIRST_ARG, GET_SECOND_ARG)+emu->X
 
 //this is a special case of pre/post indexed indirect addressing with index=0
 //only ever used by the JMP instr
 //#define ABSOLUTE_INDIRECT_JMP_ACCESS generate_addr( emu->Memory[generate_addr( GET_FIRST_ARG, GET_SECOND_ARG )], \
 //													emu->Memory[generate_addr( GET_FIRST_ARG + 1, GET_SECOND_ARG )] )
 
-#define ABSOLUTE_INDIRECT_JMP_ACCESS generate_addr( read_mem(emu,generate_addr( GET_FIRST_ARG, GET_SECOND_ARG )), \
-													read_mem(emu,generate_addr( GET_FIRST_ARG + 1, GET_SECOND_ARG )) )
+#define ABSOLUTE_INDIRECT_JMP_ACCESS generate_addr( MEM_READ(generate_addr( GET_FIRST_ARG, GET_SECOND_ARG )), \
+													MEM_READ(generate_addr( GET_FIRST_ARG + 1, GET_SECOND_ARG )) )
 
 
 //this is the default addr that the stack starts a
@@ -120,6 +556,10 @@ inline void write_mem( em6502 *emu, unsigned short addr, unsigned char val )
 #define ISR_HIGH_ADDR 0xFF
 #define ISR_LOW_ADDR  ISR_HIGH_ADDR - 1
 
+//and the other vectors, in the same page
+#define NMI_VECTOR_LOW_ADDR 0xFA
+#define RESET_VECTOR_LOW_ADDR 0xFC
+
 /**************************************
  * Name:  generate_addr
  * Inputs:  unsigned char  - the low char memory addr
@@ -139,2143 +579,2092 @@ inline unsigned short generate_addr(unsigned char low, unsigned char high )
 }
 
 
-
-
+#ifdef ENABLE_PREDECODE_CACHE
 /**************************************
- * Name:  initialize_em6502
- * Inputs:  em6502 * - the 6502 chip to init
+ * Name:  decode_instr
+ * Inputs:  em6502 * - the 6502 chip to decode from
+ *				unsigned short - addr of the opcode
+ *				decoded_instr * - where to put the result
  * Outputs: None
- * Function: initializes the values to a known state
+ * Function: decodes the instr at addr; the opcode and its operand bytes are
+ *			 fetched through read_mem, so a listener sees each of them
  *
 ***************************************/
-void initialize_em6502(em6502 * emu)
+static void decode_instr( em6502 *emu, unsigned short addr, decoded_instr *instr )
 {
-	int i;
+	unsigned char low = 0;
+	unsigned char high = 0;
+	const opcode_desc *desc;
 
-	emu->Acc = 0;
-	emu->X = 0;
-	emu->Y = 0;
-	emu->P = 0;
-	emu->S = 0xFF;  //stack confined to: $0100-$01FF, starts at $01FF
-	emu->PC = 0;
-
-	//OVERFLOW_SET(emu->P) ; //we start out with this flag set, who knows why?
+	instr->opcode = read_mem(emu, addr);
+	desc = &opcode_table[instr->opcode];
+	instr->mode = desc->mode;
 
-	//memset(emu->Memory, -1, MEMORY_SIZE );
-
-	#ifdef ALLOW_MAX_INSTR_COUNT
-	emu->instr_count = 0;
-	#endif
-}
+	if ( desc->length > 1 )
+	{
+		low = read_mem(emu, addr + 1);
+	}
+	if ( desc->length > 2 )
+	{
+		high = read_mem(emu, addr + 2);
+	}
 
-//loads a single page into memory
-void load_page(em6502 *emu, unsigned char *chunk, size_t size, unsigned int addr_start)
-{
-	//check that we're not crossing any page boundaries
-	assert((addr_start+size-1) / PAGE_SIZE == addr_start / PAGE_SIZE);
+	instr->operand = generate_addr(low, high);
+	instr->handler = BREAKPOINT_AT(emu, addr) ? BREAKPOINT_HANDLER : instr->opcode;
 
-	page_t *page = emu->page_table[addr_start / PAGE_SIZE];
-	memcpy( &page->data[addr_start % PAGE_SIZE], chunk, size);
+	//set last; this is what marks the slot as valid
+	instr->length = desc->length;
 }
 
+#ifdef ENABLE_FUSION
 /**************************************
- * Name:  load_program
- * Inputs:  em6502 * - the 6502 object to load program
- *	 			void * - the memory containing the program; gets copied into em6502->Memory
- *				size_t - size of program to copy
- *				unsigned int -  offset from start
+ * Name:  fuse_decoded
+ * Inputs:  em6502 * - the 6502 chip to decode from
+ *				unsigned short - addr of the instr that was just decoded into its cache slot
  * Outputs: None
- * Function: copies the memory into the memory space of the em6502 object. This allows us
- * to use relocatable code and copy it anywhere in the memory space
- * This assumes that the paging memory model has already been built
- * This also assumes that you can only load the memory on a page-multiple
+ * Function: if the instr at addr starts one of the sequences in fusions.def, hands its
+ *			 slot to that sequence's case of the interpreter, picking the longest one.
+ *			 Only instrs that fall through to the next one can be followed by more,
+ *			 all of them have to start in this page, and none can have a breakpoint.
+ *			 The rest of the sequence is read from its own slots when it runs; until
+ *			 those get decoded, the fused case stops after the first instr
  *
 ***************************************/
-void load_program( em6502 *emu, void *prog, size_t size, unsigned int offset)
+static void fuse_decoded( em6502 *emu, unsigned short addr )
 {
-	//memcpy( emu->Memory+offset, prog, size );
-	assert( offset % PAGE_SIZE == 0);
+	decoded_instr *instr = &emu->decode_cache[addr / PAGE_SIZE][addr % PAGE_SIZE];
+	unsigned char opcode[MAX_FUSED_INSTRS];
+	unsigned int offset = addr % PAGE_SIZE + instr->length;
+	unsigned int count = 1;
+	unsigned int best = 0;
+	unsigned int i, k;
 
-	unsigned int start = offset;
+	opcode[0] = instr->opcode;
 
-	//must now copy program into the paging model memory, 1 page at a time
-	unsigned char *file = (char *)(prog);
-	size_t to_copy;
+	if ( instr->handler == BREAKPOINT_HANDLER )
+	{
+		return;
+	}
+
+	//the instrs after it get peeked at; the cpu hasnt fetched them yet, so no listener
+	//should hear about it (a cart's hotspot would switch banks under it). They call theirs
+	//when they're decoded into their own slots
+	while ( count < MAX_FUSED_INSTRS && offset + 3 <= PAGE_SIZE &&
+			opcode_table[opcode[count - 1]].mode != MODE_NONE && !changes_flow(opcode[count - 1]) &&
+			!BREAKPOINT_AT(emu, addr - addr % PAGE_SIZE + offset) )
+	{
+		opcode[count] = PEEK_MEM(emu, addr - addr % PAGE_SIZE + offset);
+		offset += opcode_table[opcode[count]].length;
+		count++;
+	}
 
-	while( size > 0)
+	for ( k = 0; k < sizeof(fusion_table) / sizeof(fusion_table[0]); k++ )
 	{
-		if ( size > PAGE_SIZE )
+		if ( fusion_table[k].length > count || fusion_table[k].length <= best )
 		{
-			to_copy = PAGE_SIZE;
+			continue;
 		}
-		else
+
+		for ( i = 0; i < fusion_table[k].length && opcode[i] == fusion_table[k].opcode[i]; i++ )
 		{
-			to_copy = size;
 		}
 
-		load_page(emu,file,to_copy,offset);
+		if ( i == fusion_table[k].length )
+		{
+			best = fusion_table[k].length;
+			instr->handler = BREAKPOINT_HANDLER + 1 + k;
+			emu->fused_pages[addr / PAGE_SIZE] = 1;
+		}
+	}
+}
+#endif
 
-		//update offset to next page
-		offset+= PAGE_SIZE;
+/**************************************
+ * Name:  fetch_decoded
+ * Inputs:  em6502 * - the 6502 chip to fetch from
+ *				decoded_instr * - scratch slot for instrs that cant be cached
+ * Outputs: decoded_instr * - the decoded instr at PC
+ * Function: slow path of FETCH_INSTR, for when the instr at PC isnt cached yet.
+ *			 decodes it into its cache slot, creating the page's cache if needed.
+ *			 Pages with a listener are never cached, they get decoded into
+ *			 scratch on every fetch instead
+ *
+***************************************/
+static decoded_instr *fetch_decoded( em6502 *emu, decoded_instr *scratch )
+{
+	decoded_instr *cache = emu->decode_cache[emu->PC / PAGE_SIZE];
+	decoded_instr *instr;
 
-		//update file to point to next chunk of data
-		file+= PAGE_SIZE;
+	if ( cache == 0 )
+	{
+		if ( HAS_LISTENER(emu->page_table[emu->PC / PAGE_SIZE]) )
+		{
+			decode_instr(emu, emu->PC, scratch);
+			return scratch;
+		}
 
-		//update count of data remaining to copy
-		size-= to_copy;
+		//first time we run code in this page
+		cache = (decoded_instr *)calloc(PAGE_SIZE, sizeof(decoded_instr));
+		emu->decode_cache[emu->PC / PAGE_SIZE] = cache;
 	}
 
-	//also, we must fix the PC to point to start of memory region, for supporting relocatable code
-	emu->PC = start;
+	instr = &cache[emu->PC % PAGE_SIZE];
+	decode_instr(emu, emu->PC, instr);
+
+	#ifdef ENABLE_FUSION
+	if ( emu->fusion )
+	{
+		fuse_decoded(emu, emu->PC);
+	}
+	#endif
+
+	return instr;
 }
+#endif
 
 
 /**************************************
- * Name:  create_simple_memory_map
- * Inputs:  em6502 * - the 6502 object to execute
+ * Name:  invalidate_code
+ * Inputs:  em6502 * - the 6502 object
+ * 			unsigned short - first addr that was modified
+ * 			unsigned short - last addr that was modified
  * Outputs: None
- * Function: creates the simplest memory map possible;
- * 			 straight mapping with all pages marked as read-able
+ * Function: drops any decoded instrs overlapping the given range
+ *			 pages that got a listener since they were cached are dropped entirely,
+ *			 as are translated blocks in any page the range touches
+ *			 the pages also get marked as written, for rollback_em6502
  *
 ***************************************/
-void create_simple_memory_map( em6502 *emu )
+void invalidate_code( em6502 *emu, unsigned short low, unsigned short high )
 {
-	int i;
+	unsigned int addr;
+	unsigned int page;
 
-	//for the simple-memory model, we map into the entire memory space
-	//so we create the underlying memory
-	emu->_memory = (unsigned char*)malloc(sizeof(unsigned char)*MEMORY_SIZE);
+	for ( page = low / PAGE_SIZE; page <= high / PAGE_SIZE; page++ )
+	{
+		MARK_DIRTY(emu, page * PAGE_SIZE);
+	}
 
-	//now we simply create all the pages and point them to the corresponding memory
-	//mark them all as read/write/execute, no listeners
-	for ( i = 0; i < NUM_PAGES; i++)
+	#ifdef ENABLE_PREDECODE_CACHE
+	for ( addr = low; addr <= high; addr++ )
 	{
-		emu->page_table[i] = (page_t *)malloc(sizeof(page_t));
+		invalidate_decoded_byte(emu, addr);
+	}
 
-		emu->page_table[i]->data = &emu->_memory[i*PAGE_SIZE];
-		emu->page_table[i]->page_addr = i*PAGE_SIZE;
-		emu->page_table[i]->flag = READ | WRITE | EXECUTE;
-		emu->page_table[i]->cb_mem_listener = 0;
+	for ( page = low / PAGE_SIZE; page <= high / PAGE_SIZE; page++ )
+	{
+		if ( emu->decode_cache[page] != 0 && HAS_LISTENER(emu->page_table[page]) )
+		{
+			free(emu->decode_cache[page]);
+			emu->decode_cache[page] = 0;
+			#ifdef ENABLE_FUSION
+			emu->fused_pages[page] = 0;
+			#endif
+		}
+	}
+	#endif
+
+	#ifdef ENABLE_DYNAREC
+	//translated blocks go a whole page at a time
+	for ( page = low / PAGE_SIZE; page <= high / PAGE_SIZE; page++ )
+	{
+		dynarec_invalidate_page(emu, page);
 	}
+	#endif
 }
 
 
 /**************************************
- * Name:  run_program
- * Inputs:  em6502 * - the 6502 object to execute
- *				unsigned int - max number of instructions to execute, -1 for all
+ * Name:  drop_code
+ * Inputs:  em6502 * - the 6502 object
  * Outputs: None
- * Function: executes the previosuly loaded program
+ * Function: frees every decoded instr and translated block, whatever page they're in
  *
 ***************************************/
-void run_program( em6502 *emu, unsigned int max_instr_count )
+static void drop_code( em6502 *emu )
 {
-	unsigned char ch1;
-	unsigned char ch2;
-	unsigned char res;
+	unsigned int page;
 
-
-	#ifdef ALLOW_MAX_INSTR_COUNT
-		while (max_instr_count--)
-	#elif
-		while(1)
-	#endif
+	for ( page = 0; page < NUM_PAGES; page++ )
 	{
-		//process a single instruction here
-		//this defines the main logic loop that implements the instruction set for the 6502 chip
-		switch( read_mem(emu,emu->PC) )
-		{
+		#ifdef ENABLE_PREDECODE_CACHE
+		free(emu->decode_cache[page]);
+		emu->decode_cache[page] = 0;
+		#endif
 
-			//***********************>>>LDA INSTRUCTIONS<<<*************************
-			case 0xA9: // LDA data : A<- data, immidiate addressing mode
-				emu->Acc = read_mem(emu, emu->PC+1 ); //emu->Memory[emu->PC+1];
-				emu->PC+=2;
-				//affects s,z flags
-				TEST_AND_SET_ZERO(emu->P, emu->Acc) ;
-				TEST_AND_SET_NEG(emu->P, emu->Acc) ;
-				break;
-
-			case 0xA5: // LDA data : A<- [addr], zero-page direct addressing mode
-				emu->Acc = read_mem(emu, ZP_DIRECT_ACCESS );
-				emu->PC+=2;
-				//affects s,z flags
-				TEST_AND_SET_ZERO(emu->P, emu->Acc) ;
-				TEST_AND_SET_NEG(emu->P, emu->Acc) ;
-				break;
-
-			case 0xB5: //LDA data : A<- [addr+X] , zero-page indexed addressing mode
-				emu->Acc = read_mem(emu, ZP_INDEXED_X_ACCESS );
-			    emu->PC+=2;
-				//affects s,z flags
-				TEST_AND_SET_ZERO(emu->P, emu->Acc) ;
-				TEST_AND_SET_NEG(emu->P, emu->Acc) ;
-				break;
-
-		   case 0xA1: // LDA data : A<- [[addr+X]], pre-indexed, indirect addressing mode
-				emu->Acc = read_mem(emu, PRE_INDEXED_X_INDIRECT_ACCESS );
-				emu->PC+=2;
-				//affects s,z flags
-				TEST_AND_SET_ZERO(emu->P, emu->Acc) ;
-				TEST_AND_SET_NEG(emu->P, emu->Acc) ;
-				break;
-
-			case 0xB1: // LDA data : A<- [[addr+1,addr]+Y], post-indexed, indirect addressing mode
-				emu->Acc = read_mem(emu, POST_INDEXED_Y_INDIRECT_ACCESS );
-				emu->PC+=2;
-				//affects s,z flags
-				TEST_AND_SET_ZERO(emu->P, emu->Acc) ;
-				TEST_AND_SET_NEG(emu->P, emu->Acc) ;
-				break;
-
-			case 0xAD: //LDA data : A<- [addr16] , extended direct addressing mode
-				emu->Acc = read_mem(emu, EXTENDED_DIRECT_ACCESS );
-				emu->PC+=3;
-				//affects s,z flags
-				TEST_AND_SET_ZERO(emu->P, emu->Acc) ;
-				TEST_AND_SET_NEG(emu->P, emu->Acc) ;
-				break;
-
-			case 0xB9: //LDA data : A<- [addr16+Y], absolute indexed addressing mode
-				emu->Acc = read_mem(emu, ABSOLUTE_INDEXED_Y_ACCESS );
-				emu->PC+=3;
-				//affects s,z flags
-				TEST_AND_SET_ZERO(emu->P, emu->Acc) ;
-				TEST_AND_SET_NEG(emu->P, emu->Acc) ;
-				break;
-
-			case 0xBD: //LDA data : A<- [addr16+X], absolute indexed addressing mode
-				emu->Acc = read_mem(emu, ABSOLUTE_INDEXED_X_ACCESS );
-				emu->PC+=3;
-				//affects s,z flags
-				TEST_AND_SET_ZERO(emu->P, emu->Acc) ;
-				TEST_AND_SET_NEG(emu->P, emu->Acc) ;
-				break;
-
-
-			//***********************>>>LDY INSTRUCTIONS<<<*************************
-			case 0xA0: // LDY data : Y<- data, immidiate addressing mode
-				emu->Y = read_mem(emu, emu->PC+1); //emu->Memory[emu->PC+1];
-				emu->PC+=2;
-				//affects s,z flags
-				TEST_AND_SET_ZERO(emu->P, emu->Y) ;
-				TEST_AND_SET_NEG(emu->P, emu->Y) ;
-				break;
-
-		  case 0xA4: // LDY data : Y<- [data], zero-page direct addressing mode
-				emu->Y = read_mem(emu, ZP_DIRECT_ACCESS );
-				emu->PC+=2;
-				//affects s,z flags
-				TEST_AND_SET_ZERO(emu->P, emu->Y) ;
-				TEST_AND_SET_NEG(emu->P, emu->Y) ;
-				break;
-
-		  case 0xB4: // LDY data : Y<- [data+X], zero-page indexed addressing mode
-				emu->Y = read_mem(emu, ZP_INDEXED_X_ACCESS );
-				emu->PC+=2;
-				//affects s,z flags
-				TEST_AND_SET_ZERO(emu->P, emu->Y) ;
-				TEST_AND_SET_NEG(emu->P, emu->Y) ;
-				break;
-
-		 case 0xAC: // LDY data : Y<- [data16], extended direct addressing mode
-				emu->Y = read_mem(emu, EXTENDED_DIRECT_ACCESS );
-				emu->PC+=3;
-				//affects s,z flags
-				TEST_AND_SET_ZERO(emu->P, emu->Y) ;
-				TEST_AND_SET_NEG(emu->P, emu->Y) ;
-				break;
-
-		case 0xBC: // LDY data : Y<- [data16+X], absolute in addressing mode
-				emu->Y = read_mem(emu, ABSOLUTE_INDEXED_X_ACCESS );
-				emu->PC+=3;
-				//affects s,z flags
-				TEST_AND_SET_ZERO(emu->P, emu->Y) ;
-				TEST_AND_SET_NEG(emu->P, emu->Y) ;
-				break;
-
-
-			//***********************>>>LDX INSTRUCTIONS<<<*************************
-		   case 0xA2: // LDX data : X<- data, immidiate addressing mode
-				emu->X = read_mem(emu, emu->PC+1); //emu->Memory[emu->PC+1];
-				emu->PC+=2;
-				//affects s,z flags
-				TEST_AND_SET_ZERO(emu->P, emu->X) ;
-				TEST_AND_SET_NEG(emu->P, emu->X) ;
-				break;
-
-		  case 0xA6: // LDX data : X<- [data], zero-page direct addressing mode
-				emu->X = read_mem(emu, ZP_DIRECT_ACCESS );
-				emu->PC+=2;
-				//affects s,z flags
-				TEST_AND_SET_ZERO(emu->P, emu->X) ;
-				TEST_AND_SET_NEG(emu->P, emu->X) ;
-				break;
-
-		  case 0xB6: // LDX data : X<- [data+Y], zero-page indexed addressing mode
-				emu->X = read_mem(emu, ZP_INDEXED_Y_ACCESS );
-				emu->PC+=2;
-				//affects s,z flags
-				TEST_AND_SET_ZERO(emu->P, emu->X) ;
-				TEST_AND_SET_NEG(emu->P, emu->X) ;
-				break;
-
-		 case 0xAE: // LDX data : X<- [data16], extended direct addressing mode
-				emu->X = read_mem(emu, EXTENDED_DIRECT_ACCESS );
-				emu->PC+=3;
-				//affects s,z flags
-				TEST_AND_SET_ZERO(emu->P, emu->X) ;
-				TEST_AND_SET_NEG(emu->P, emu->X) ;
-				break;
-
-		case 0xBE: // LDX data : X<- [data16+Y], absolute in addressing mode
-				emu->X = read_mem(emu, ABSOLUTE_INDEXED_Y_ACCESS );
-				emu->PC+=3;
-				//affects s,z flags
-				TEST_AND_SET_ZERO(emu->P, emu->X) ;
-				TEST_AND_SET_NEG(emu->P, emu->X) ;
-				break;
-
-
-			//***********************>>>STA INSTRUCTIONS<<<*************************
-			case 0x85: //STA addr : [addr]<- A, zero-page direct addressing mode
-				write_mem(emu, ZP_DIRECT_ACCESS, emu->Acc  );
-			   emu->PC+=2;
-				//affects no flags
-				break;
-
-			case 0x95: //STA addr : [addr+X]<- A, zero-page indexed addressing mode
-				write_mem(emu, ZP_INDEXED_X_ACCESS, emu->Acc  );
-			   emu->PC+=2;
-				//affects no flags
-				break;
-
-			case 0x81: //STA addr : [[addr+X]]<- A, pre-indexed indirect addressing mode
-				write_mem(emu, PRE_INDEXED_X_INDIRECT_ACCESS, emu->Acc  );
-			   emu->PC+=2;
-				//affects no flags
-				break;
-
-			case 0x91: //STA addr : [[addr+1, addr]+ Y]<- A, post-indexed indirect addressing mode
-				write_mem( emu, POST_INDEXED_Y_INDIRECT_ACCESS, emu->Acc );
-				emu->PC+=2;
-				//affects no flags
-				break;
-
-		  case 0x8D: //STA addr : [addr16]<- A, extended direct addressing mode
-				write_mem( emu, EXTENDED_DIRECT_ACCESS, emu->Acc );
-				emu->PC+=3;
-				//affects no flags
-				break;
-
-			case 0x99: //STA addr : [addr16+Y]<- A, absolute indexed addressing mode
-				write_mem( emu, ABSOLUTE_INDEXED_Y_ACCESS, emu->Acc );
-				emu->PC+=3;
-				//affects no flags
-				break;
-
-			case 0x9D: //STA addr : [addr16+X]<- A, absolute indexed addressing mode
-				write_mem( emu, ABSOLUTE_INDEXED_X_ACCESS, emu->Acc );
-				emu->PC+=3;
-				//affects no flags
-				break;
-
-
-			//***********************>>>STX INSTRUCTIONS<<<*************************
-			case 0x86: //STX addr : [addr]<- X, zero page, direct addressing mode
-				write_mem(emu, ZP_DIRECT_ACCESS, emu->X  );
-				emu->PC+=2;
-				//affects no flags
-				break;
-
-			case 0x96: //STX addr : [addr+Y]<- X, zero-page indexed addressing mode
-				write_mem(emu, ZP_INDEXED_Y_ACCESS, emu->X  );
-				emu->PC+=2;
-				//affects no flags
-				break;
-
-			case 0x8E: //STX addr : [addr16]<- X, extended direct addressing mode
-				write_mem( emu, EXTENDED_DIRECT_ACCESS, emu->X );
-				emu->PC+=3;
-				//affects no flags
-				break;
-
-
-			//***********************>>>STY INSTRUCTIONS<<<*************************
-			case 0x84: //STY addr : [addr]<- Y, zero page, direct addressing mode
-				write_mem(emu, ZP_DIRECT_ACCESS, emu->Y  );
-				emu->PC+=2;
-				//affects no flags
-				break;
-
-			case 0x94: //STY addr : [addr+X]<- Y, zero-page indexed addressing mode
-				write_mem(emu, ZP_INDEXED_X_ACCESS, emu->Y  );
-				emu->PC+=2;
-				//affects no flags
-				break;
-
-			case 0x8C: //STY addr : [addr16]<- Y, extended direct addressing mode
-				write_mem( emu, EXTENDED_DIRECT_ACCESS, emu->Y );
-				emu->PC+=3;
-				//affects no flags
-				break;
-
-
-			//***********************>>>FLAG INSTRUCTIONS<<<*************************
-			case 0x18:  //CLC : C<- 0, clear carry flag
-				CARRY_CLEAR(emu->P);
-				emu->PC+=1;
-				//affects no flags
-				break;
-
-			case 0x38:  //SEC : C<- 1, set carry flag
-				CARRY_SET(emu->P);
-				emu->PC+=1;
-				//affects no flags
-				break;
-
-			case 0xD8:  //CLD : D<- 0, clear decimal flag
-				DECIMAL_MODE_CLEAR(emu->P);
-				emu->PC+=1;
-				//affects no flags
-				break;
-
-			case 0xF8:  //SED : D<- 1, set decimal flag
-				DECIMAL_MODE_SET(emu->P);
-				emu->PC+=1;
-				//affects no flags
-				break;
-
-			case 0xB8:  //CLV : V<- 1, clear overflow flag
-				OVERFLOW_CLEAR(emu->P);
-				emu->PC+=1;
-				//affects no flags
-				break;
-
-
-			//***********************>>>ADC INSTRUCTIONS<<<*************************
-			case 0x69: //ADC addr : A<- A + IMM + C
-			{
-				ch1 = emu->Acc;
-				ch2 = IMMIDIATE_ACCESS;
-
-				emu->Acc = (ch1 + ch2) + (unsigned char)(CARRY_GET(emu->P));
-				emu->PC+=2;
-				//affects s,z,v,c flags
-				TEST_AND_SET_ZERO(emu->P, emu->Acc) ;
-				TEST_AND_SET_NEG(emu->P, emu->Acc) ;
-				TEST_AND_SET_CARRY_ADDITION(emu->P, ch1, ch2 ) ;
-				TEST_AND_SET_V_OVERFLOW_ADDITION(emu->P, ch1, ch2) ;
-				break;
-			}
+		#ifdef ENABLE_FUSION
+		emu->fused_pages[page] = 0;
+		#endif
 
-			case 0x65: //ADC addr : A<- A + [addr] + C
-			{
-				ch1 = emu->Acc;
-				//ch2 = emu->Memory[ZP_DIRECT_ACCESS];
-				ch2 = read_mem(emu,ZP_DIRECT_ACCESS);
-
-				emu->Acc = (ch1 + ch2) + (unsigned char)(CARRY_GET(emu->P));
-				emu->PC+=2;
-				//affects s,z,v,c flags
-				TEST_AND_SET_ZERO(emu->P, emu->Acc) ;
-				TEST_AND_SET_NEG(emu->P, emu->Acc) ;
-				TEST_AND_SET_CARRY_ADDITION(emu->P, ch1, ch2 ) ;
-				TEST_AND_SET_V_OVERFLOW_ADDITION(emu->P, ch1, ch2) ;
-				break;
-			}
+		#ifdef ENABLE_DYNAREC
+		dynarec_invalidate_page(emu, page);
+		#endif
+	}
+}
 
-			case 0x75: //ADC addr : A<- A + [addr+X] + C
-			{
-				ch1 = emu->Acc;
-				ch2 =read_mem(emu,ZP_INDEXED_X_ACCESS);
-
-				emu->Acc = (ch1 + ch2) + (unsigned char)(CARRY_GET(emu->P));
-				emu->PC+=2;
-				//affects s,z,v,c flags
-				TEST_AND_SET_ZERO(emu->P, emu->Acc) ;
-				TEST_AND_SET_NEG(emu->P, emu->Acc) ;
-				TEST_AND_SET_CARRY_ADDITION(emu->P, ch1, ch2 ) ;
-				TEST_AND_SET_V_OVERFLOW_ADDITION(emu->P, ch1, ch2) ;
-				break;
-			}
 
-		    case 0x61: //ADC addr : A<- A + [[addr+X]] + C
-			{
-				ch1 = emu->Acc;
-				ch2 = read_mem(emu,PRE_INDEXED_X_INDIRECT_ACCESS);
-
-				emu->Acc = (ch1 + ch2) + (unsigned char)(CARRY_GET(emu->P));
-				emu->PC+=2;
-				//affects s,z,v,c flags
-				TEST_AND_SET_ZERO(emu->P, emu->Acc) ;
-				TEST_AND_SET_NEG(emu->P, emu->Acc) ;
-				TEST_AND_SET_CARRY_ADDITION(emu->P, ch1, ch2 ) ;
-				TEST_AND_SET_V_OVERFLOW_ADDITION(emu->P, ch1, ch2) ;
-				break;
-			}
+/**************************************
+ * Name:  update_page
+ * Inputs:  em6502 * - the 6502 object
+ * 			unsigned int - the page
+ * Outputs: None
+ * Function: call after changing a page's page_t (its data, flag or listener);
+ * 			 works out again whether its accesses can skip it, and drops any
+ * 			 code decoded from it
+ *
+***************************************/
+void update_page( em6502 *emu, unsigned int page )
+{
+	update_slow_page(emu, page);
 
-			case 0x71: //ADC addr : A<- A+ [[addr+1, addr]+ Y] + C, post-indexed indirect addressing mode
-			{
-				ch1 = emu->Acc;
-				ch2 = read_mem(emu,POST_INDEXED_Y_INDIRECT_ACCESS);
-
-				emu->Acc = (ch1 + ch2) + (unsigned char)(CARRY_GET(emu->P));
-				emu->PC+=2;
-				//affects s,z,v,c flags
-				TEST_AND_SET_ZERO(emu->P, emu->Acc) ;
-				TEST_AND_SET_NEG(emu->P, emu->Acc) ;
-				TEST_AND_SET_CARRY_ADDITION(emu->P, ch1, ch2 ) ;
-				TEST_AND_SET_V_OVERFLOW_ADDITION(emu->P, ch1, ch2) ;
-				break;
-			}
+	invalidate_code(emu, page * PAGE_SIZE, page * PAGE_SIZE + PAGE_SIZE - 1);
+}
 
-			case 0x6D: //ADC addr : A<- A+ [addr16] + C, extended direct addressing mode
-			{
-				ch1 = emu->Acc;
-				ch2 = read_mem(emu,EXTENDED_DIRECT_ACCESS);
-
-				emu->Acc = (ch1 + ch2) + (unsigned char)(CARRY_GET(emu->P));
-				emu->PC+=3;
-				//affects s,z,v,c flags
-				TEST_AND_SET_ZERO(emu->P, emu->Acc) ;
-				TEST_AND_SET_NEG(emu->P, emu->Acc) ;
-				TEST_AND_SET_CARRY_ADDITION(emu->P, ch1, ch2 ) ;
-				TEST_AND_SET_V_OVERFLOW_ADDITION(emu->P, ch1, ch2) ;
-				break;
-			}
 
-			case 0x79: //ADC addr: A<- A+ [addr16+Y] + C, absolute indexed addressing mode
-			{
-				ch1 = emu->Acc;
-				ch2 = read_mem(emu,ABSOLUTE_INDEXED_Y_ACCESS);
-
-				emu->Acc = (ch1 + ch2) + (unsigned char)(CARRY_GET(emu->P));
-				emu->PC+=3;
-				//affects s,z,v,c flags
-				TEST_AND_SET_ZERO(emu->P, emu->Acc) ;
-				TEST_AND_SET_NEG(emu->P, emu->Acc) ;
-				TEST_AND_SET_CARRY_ADDITION(emu->P, ch1, ch2 ) ;
-				TEST_AND_SET_V_OVERFLOW_ADDITION(emu->P, ch1, ch2) ;
-				break;
-			}
-
-			case 0x7D: //ADC addr: A<- A+ [addr16+X] + C, absolute indexed addressing mode
-			{
-				ch1 = emu->Acc;
-				ch2 = read_mem(emu,ABSOLUTE_INDEXED_X_ACCESS);
-
-				emu->Acc = (ch1 + ch2) + (unsigned char)(CARRY_GET(emu->P));
-				emu->PC+=3;
-				//affects s,z,v,c flags
-				TEST_AND_SET_ZERO(emu->P, emu->Acc) ;
-				TEST_AND_SET_NEG(emu->P, emu->Acc) ;
-				TEST_AND_SET_CARRY_ADDITION(emu->P, ch1, ch2 ) ;
-				TEST_AND_SET_V_OVERFLOW_ADDITION(emu->P, ch1, ch2) ;
-				break;
-			}
-
-
-			//***********************>>>AND INSTRUCTIONS<<<*************************
-			case 0x29: //AND addr : A<- A AND IMM
-				emu->Acc = emu->Acc & IMMIDIATE_ACCESS ;
-				emu->PC+=2;
-				//affects s,z flags
-				TEST_AND_SET_ZERO(emu->P, emu->Acc) ;
-				TEST_AND_SET_NEG(emu->P, emu->Acc) ;
-				break;
-
-			case 0x25: //AND addr : A<- A AND [addr]
-				emu->Acc = emu->Acc & read_mem(emu,ZP_DIRECT_ACCESS);
-				emu->PC+=2;
-				//affects s,z flags
-				TEST_AND_SET_ZERO(emu->P, emu->Acc) ;
-				TEST_AND_SET_NEG(emu->P, emu->Acc) ;
-				break;
-
-			case 0x35: //AND addr : A<- A AND [addr+X]
-				emu->Acc = emu->Acc & read_mem(emu,ZP_INDEXED_X_ACCESS);
-				emu->PC+=2;
-				//affects s,z flags
-				TEST_AND_SET_ZERO(emu->P, emu->Acc) ;
-				TEST_AND_SET_NEG(emu->P, emu->Acc) ;
-				break;
-
-			case 0x21: //AND addr : A<- A AND [[addr+X]]
-				emu->Acc = emu->Acc & read_mem(emu,PRE_INDEXED_X_INDIRECT_ACCESS);
-				emu->PC+=2;
-				//affects s,z flags
-				TEST_AND_SET_ZERO(emu->P, emu->Acc) ;
-				TEST_AND_SET_NEG(emu->P, emu->Acc) ;
-				break;
-
-			case 0x31: //AND addr : A<- A AND [[addr+1,addr] +Y]
-				emu->Acc = emu->Acc & read_mem(emu,POST_INDEXED_Y_INDIRECT_ACCESS);
-				emu->PC+=2;
-				//affects s,z flags
-				TEST_AND_SET_ZERO(emu->P, emu->Acc) ;
-				TEST_AND_SET_NEG(emu->P, emu->Acc) ;
-				break;
-
-			case 0x2D: //AND addr : A<- A AND [addr16]
-				emu->Acc = emu->Acc & read_mem(emu,EXTENDED_DIRECT_ACCESS);
-				emu->PC+=3;
-				//affects s,z flags
-				TEST_AND_SET_ZERO(emu->P, emu->Acc) ;
-				TEST_AND_SET_NEG(emu->P, emu->Acc) ;
-				break;
-
-			case 0x39: //AND addr : A<- A AND [addr16+Y]
-				emu->Acc = emu->Acc & read_mem(emu,ABSOLUTE_INDEXED_Y_ACCESS);
-				emu->PC+=3;
-				//affects s,z flags
-				TEST_AND_SET_ZERO(emu->P, emu->Acc) ;
-				TEST_AND_SET_NEG(emu->P, emu->Acc) ;
-				break;
-
-			case 0x3D: //AND addr : A<- A AND [addr16+X]
-				emu->Acc = emu->Acc & read_mem(emu,ABSOLUTE_INDEXED_X_ACCESS);
-				emu->PC+=3;
-				//affects s,z flags
-				TEST_AND_SET_ZERO(emu->P, emu->Acc) ;
-				TEST_AND_SET_NEG(emu->P, emu->Acc) ;
-				break;
-
-
-			//***********************>>>BIT INSTRUCTIONS<<<*************************
-			case 0x24: //BIT addr : A AND [addr], sets s,z,v flags only
-			{
-				//affects s,z,v flags
-				ch1 = read_mem(emu,ZP_DIRECT_ACCESS);
-				TEST_AND_SET_ZERO(emu->P, (unsigned char)(emu->Acc & ch1) );
-				TEST_AND_SET_NEG(emu->P, ch1 );
-				TEST_SIXTH_MEMORY_BIT(emu->P, ch1 );
-
-				emu->PC+=2;
-				break;
-			}
-			case 0x2C: //BIT addr : A AND [addr16], sets s,z,v flags only
-			{
-				//affects s,z,v flags
-				ch1 = read_mem(emu,EXTENDED_DIRECT_ACCESS);
-				TEST_AND_SET_ZERO(emu->P, (unsigned char)(emu->Acc & ch1) );
-				TEST_AND_SET_NEG(emu->P, ch1 );
-				TEST_SIXTH_MEMORY_BIT(emu->P, ch1 );
-
-				emu->PC+=3;
-				break;
-			}
+/**************************************
+ * Name:  switch_page_data
+ * Inputs:  em6502 * - the 6502 object
+ * 			unsigned int - the page
+ * 			unsigned char * - the bytes to point it at
+ * 			page_code * - gets the code decoded from the bytes going out
+ * 			page_code * - the code decoded from the ones coming in; emptied
+ * Outputs: None
+ * Function: points the page at other bytes, swapping code caches along with them
+ *
+***************************************/
+void switch_page_data( em6502 *emu, unsigned int page, unsigned char *data, page_code *out, page_code *in )
+{
+	//breakpoints set since the code went aside arent marked in it
+	if ( emu->breakpoints != 0 )
+	{
+		free_page_code(in);
+	}
 
-			//***********************>>>CMP INSTRUCTIONS<<<*************************
-			case 0xC9: //CMP addr : A - IMM, sets s,z,c flags only
-			{
-				ch1 = emu->Acc;
-				ch2 = IMMIDIATE_ACCESS ;
-				res = ch1 - ch2;
+	#ifdef ENABLE_PREDECODE_CACHE
+	out->decoded = emu->decode_cache[page];
+	emu->decode_cache[page] = in->decoded;
+	in->decoded = 0;
+	#endif
 
-				emu->PC+=2;
+	#ifdef ENABLE_FUSION
+	//a fused sequence whose first instr does the switching finishes out of the old slots;
+	//carts have the same code at the switch point in every bank, so that's the same instrs
+	out->fused = emu->fused_pages[page];
+	emu->fused_pages[page] = in->fused;
+	in->fused = 0;
+	#endif
 
-				//affects s,z,c flags
-				TEST_AND_SET_ZERO(emu->P, res) ;
-				TEST_AND_SET_NEG(emu->P, res) ;
-				TEST_AND_SET_CARRY_SUBTRACTION(emu->P, ch1, ch2 ) ;
-				break;
-			}
+	#ifdef ENABLE_DYNAREC
+	//blocks from before a flush point at code memory that's been reused
+	if ( in->flushes != emu->dynarec_flushes )
+	{
+		dynarec_free_page(in->translated);
+		in->translated = 0;
+	}
 
-			case 0xC5: //CMP addr : A - [addr], sets s,z,c flags only
-			{
-				ch1 = emu->Acc;
-				ch2 = read_mem(emu,ZP_DIRECT_ACCESS);
-				res = ch1 - ch2;
+	out->translated = emu->dynarec_pages[page];
+	out->flushes = emu->dynarec_flushes;
+	emu->dynarec_pages[page] = in->translated;
+	in->translated = 0;
 
-				emu->PC+=2;
+	//the block that's running might be in the page
+	emu->dynarec_stale = 1;
+	#endif
 
-				//affects s,z,c flags
-				TEST_AND_SET_ZERO(emu->P, res) ;
-				TEST_AND_SET_NEG(emu->P, res) ;
-				TEST_AND_SET_CARRY_SUBTRACTION(emu->P, ch1, ch2 ) ;
-				break;
-			}
+	emu->page_table[page]->data = data;
+	update_slow_page(emu, page);
 
-			case 0xD5: //CMP addr : A - [addr+X], sets s,z,c flags only
-			{
-				ch1 = emu->Acc;
-				ch2 = read_mem(emu,ZP_INDEXED_X_ACCESS);
-				res = ch1 - ch2;
+	//instrs running in from the page before, or out into the next one, were decoded with bytes that arent there now
+	#ifdef ENABLE_PREDECODE_CACHE
+	invalidate_decoded_byte(emu, page * PAGE_SIZE);
+	invalidate_decoded_byte(emu, page * PAGE_SIZE + 1);
+	invalidate_decoded_byte(emu, (page + 1) * PAGE_SIZE);
+	invalidate_decoded_byte(emu, (page + 1) * PAGE_SIZE + 1);
+	#endif
+}
 
-				emu->PC+=2;
 
-				//affects s,z,c flags
-				TEST_AND_SET_ZERO(emu->P, res) ;
-				TEST_AND_SET_NEG(emu->P, res) ;
-				TEST_AND_SET_CARRY_SUBTRACTION(emu->P, ch1, ch2 ) ;
-				break;
-			}
+/**************************************
+ * Name:  free_page_code
+ * Inputs:  page_code * - code put aside by switch_page_data
+ * Outputs: None
+ * Function: frees it
+ *
+***************************************/
+void free_page_code( page_code *code )
+{
+	#ifdef ENABLE_PREDECODE_CACHE
+	free(code->decoded);
+	code->decoded = 0;
+	#endif
 
-			case 0xC1: //CMP addr : A - [[addr+X]], sets s,z,c flags only
-			{
-				ch1 = emu->Acc;
-				ch2 = read_mem(emu,PRE_INDEXED_X_INDIRECT_ACCESS);
-				res = ch1 - ch2;
+	#ifdef ENABLE_FUSION
+	code->fused = 0;
+	#endif
 
-				emu->PC+=2;
+	#ifdef ENABLE_DYNAREC
+	dynarec_free_page(code->translated);
+	code->translated = 0;
+	#endif
+}
 
-				//affects s,z,c flags
-				TEST_AND_SET_ZERO(emu->P, res) ;
-				TEST_AND_SET_NEG(emu->P, res) ;
-				TEST_AND_SET_CARRY_SUBTRACTION(emu->P, ch1, ch2 ) ;
-				break;
-			}
 
-			case 0xD1: //CMP addr : A - [[addr+1,addr]+Y], sets s,z,c flags only
-			{
-				ch1 = emu->Acc;
-				ch2 = read_mem(emu,POST_INDEXED_Y_INDIRECT_ACCESS);
-				res = ch1 - ch2;
+/**************************************
+ * Name:  set_memory_device
+ * Inputs:  em6502 * - the 6502 object
+ * 			mem_region - addrs the device answers to
+ * 			cb_device - called on every read and write there, 0 to take the device away
+ * 			void * - passed back to it
+ * Outputs: None
+ * Function: puts a device behind every page the region touches; see page_t
+ * 			 for what it gets called with. It sees every access to those
+ * 			 pages, so one that only answers to part of a page should hand
+ * 			 the rest back as it came
+ *
+***************************************/
+void set_memory_device( em6502 *emu, mem_region region,
+						unsigned char (*cb_device)(em6502 *, void *, unsigned short, unsigned char, unsigned char),
+						void *context )
+{
+	unsigned int page;
 
-				emu->PC+=2;
+	for ( page = region.low / PAGE_SIZE; page <= region.high / PAGE_SIZE; page++ )
+	{
+		emu->page_table[page]->cb_device = cb_device;
+		emu->page_table[page]->device_context = cb_device != 0 ? context : 0;
+		update_page(emu, page);
+	}
+}
 
-				//affects s,z,c flags
-				TEST_AND_SET_ZERO(emu->P, res) ;
-				TEST_AND_SET_NEG(emu->P, res) ;
-				TEST_AND_SET_CARRY_SUBTRACTION(emu->P, ch1, ch2 ) ;
-				break;
-			}
+//adds a listener, and marks the bytes it watches in the watch masks for its mode
+static int add_listener( em6502 *emu, mem_region region, unsigned char mode, void (*cb_mem_write)(unsigned short),
+						 void (*cb_access)(em6502 *, void *, unsigned short, unsigned char, unsigned char), void *context )
+{
+	unsigned char **masks;
+	unsigned int addr;
+	unsigned int page;
+	int m;
 
-			case 0xCD: //CMP addr : A - [addr16], sets s,z,c flags only
-			{
-				ch1 = emu->Acc;
-				ch2 = read_mem(emu,EXTENDED_DIRECT_ACCESS);
-				res = ch1 - ch2;
+	if ( emu->num_write_listeners == MAX_MEMORY_WRITER_LISTENERS )
+	{
+		return 0;
+	}
 
-				emu->PC+=3;
+	emu->write_listeners[emu->num_write_listeners].region = region;
+	emu->write_listeners[emu->num_write_listeners].mode = mode;
+	emu->write_listeners[emu->num_write_listeners].cb_mem_write = cb_mem_write;
+	emu->write_listeners[emu->num_write_listeners].cb_access = cb_access;
+	emu->write_listeners[emu->num_write_listeners].context = context;
+	emu->num_write_listeners++;
 
-				//affects s,z,c flags
-				TEST_AND_SET_ZERO(emu->P, res) ;
-				TEST_AND_SET_NEG(emu->P, res) ;
-				TEST_AND_SET_CARRY_SUBTRACTION(emu->P, ch1, ch2 ) ;
-				break;
-			}
+	for ( m = READ; m <= WRITE; m++ )
+	{
+		if ( (mode & m) == 0 )
+		{
+			continue;
+		}
 
-			case 0xD9: //CMP addr : A - [addr16+Y], sets s,z,c flags only
+		masks = m == READ ? emu->read_watch_masks : emu->watch_masks;
+		for ( addr = region.low; addr <= region.high; addr++ )
+		{
+			page = addr / PAGE_SIZE;
+			if ( masks[page] == 0 )
 			{
-				ch1 = emu->Acc;
-				ch2 = read_mem(emu,ABSOLUTE_INDEXED_Y_ACCESS);
-				res = ch1 - ch2;
-
-				emu->PC+=3;
+				masks[page] = (unsigned char *)calloc(PAGE_SIZE / 8, 1);
 
-				//affects s,z,c flags
-				TEST_AND_SET_ZERO(emu->P, res) ;
-				TEST_AND_SET_NEG(emu->P, res) ;
-				TEST_AND_SET_CARRY_SUBTRACTION(emu->P, ch1, ch2 ) ;
-				break;
+				//reads of it have to come through read_mem now
+				if ( m == READ )
+				{
+					update_slow_page(emu, page);
+				}
 			}
 
-			case 0xDD: //CMP addr : A - [addr16+X], sets s,z,c flags only
-			{
-				ch1 = emu->Acc;
-				ch2 = read_mem(emu,ABSOLUTE_INDEXED_X_ACCESS);
-				res = ch1 - ch2;
-
-				emu->PC+=3;
+			masks[page][addr % PAGE_SIZE / 8] |= 1 << (addr % 8);
+		}
+	}
 
-				//affects s,z,c flags
-				TEST_AND_SET_ZERO(emu->P, res) ;
-				TEST_AND_SET_NEG(emu->P, res) ;
-				TEST_AND_SET_CARRY_SUBTRACTION(emu->P, ch1, ch2 ) ;
-				break;
-			}
+	return 1;
+}
 
+/**************************************
+ * Name:  add_memory_write_listener
+ * Inputs:  em6502 * - the 6502 object to execute
+ * 			mem_region - memory region to watch
+ *			void (*cb_mem_write)(unsigned short) - callback function ptr to invoke
+ * Outputs: int - 1 if it was added, 0 if there are MAX_MEMORY_WRITER_LISTENERS already
+ * Function: registers a memory write listener at given memory region
+ * 			 the region's bytes get marked in their pages' watch masks, so write_mem
+ * 			 only looks for listeners on writes to a byte one of them watches
+ *
+***************************************/
+int add_memory_write_listener( em6502 *emu, mem_region region, void (*cb_mem_write)(unsigned short) )
+{
+	return add_listener(emu, region, WRITE, cb_mem_write, 0, 0);
+}
 
-			//***********************>>>EOR INSTRUCTIONS<<<*************************
-			case 0x49: //EOR addr : A<- A ^ IMM
-				emu->Acc = emu->Acc ^ IMMIDIATE_ACCESS ;
-				emu->PC+=2;
-				//affects s,z flags
-				TEST_AND_SET_ZERO(emu->P, emu->Acc) ;
-				TEST_AND_SET_NEG(emu->P, emu->Acc) ;
-				break;
-
-			case 0x45: //EOR addr : A<- A ^ [addr]
-				emu->Acc = emu->Acc ^ read_mem(emu,ZP_DIRECT_ACCESS);
-				emu->PC+=2;
-				//affects s,z flags
-				TEST_AND_SET_ZERO(emu->P, emu->Acc) ;
-				TEST_AND_SET_NEG(emu->P, emu->Acc) ;
-				break;
-
-			case 0x55: //EOR addr : A<- A ^ [addr+X]
-				emu->Acc = emu->Acc ^ read_mem(emu,ZP_INDEXED_X_ACCESS);
-				emu->PC+=2;
-				//affects s,z flags
-				TEST_AND_SET_ZERO(emu->P, emu->Acc) ;
-				TEST_AND_SET_NEG(emu->P, emu->Acc) ;
-				break;
-
-			case 0x41: //EOR addr : A<- A ^ [[addr+X]]
-				emu->Acc = emu->Acc ^ read_mem(emu,PRE_INDEXED_X_INDIRECT_ACCESS);
-				emu->PC+=2;
-				//affects s,z flags
-				TEST_AND_SET_ZERO(emu->P, emu->Acc) ;
-				TEST_AND_SET_NEG(emu->P, emu->Acc) ;
-				break;
-
-			case 0x51: //EOR addr : A<- A ^ [[addr+1,addr] +Y]
-				emu->Acc = emu->Acc ^ read_mem(emu,POST_INDEXED_Y_INDIRECT_ACCESS);
-				emu->PC+=2;
-				//affects s,z flags
-				TEST_AND_SET_ZERO(emu->P, emu->Acc) ;
-				TEST_AND_SET_NEG(emu->P, emu->Acc) ;
-				break;
-
-			case 0x4D: //EOR addr : A<- A ^ [addr16]
-				emu->Acc = emu->Acc ^ read_mem(emu,EXTENDED_DIRECT_ACCESS);
-				emu->PC+=3;
-				//affects s,z flags
-				TEST_AND_SET_ZERO(emu->P, emu->Acc) ;
-				TEST_AND_SET_NEG(emu->P, emu->Acc) ;
-				break;
-
-			case 0x59: //EOR addr : A<- A ^ [addr16+Y]
-				emu->Acc = emu->Acc ^ read_mem(emu,ABSOLUTE_INDEXED_Y_ACCESS);
-				emu->PC+=3;
-				//affects s,z flags
-				TEST_AND_SET_ZERO(emu->P, emu->Acc) ;
-				TEST_AND_SET_NEG(emu->P, emu->Acc) ;
-				break;
-
-			case 0x5D: //EOR addr : A<- A ^ [addr16+X]
-				emu->Acc = emu->Acc ^ read_mem(emu,ABSOLUTE_INDEXED_X_ACCESS);
-				emu->PC+=3;
-				//affects s,z flags
-				TEST_AND_SET_ZERO(emu->P, emu->Acc) ;
-				TEST_AND_SET_NEG(emu->P, emu->Acc) ;
-				break;
-
-
-			//***********************>>>ORA INSTRUCTIONS<<<*************************
-			case 0x09: //ORA addr : A<- A | IMM
-				emu->Acc = emu->Acc | IMMIDIATE_ACCESS ;
-				emu->PC+=2;
-				//affects s,z flags
-				TEST_AND_SET_ZERO(emu->P, emu->Acc) ;
-				TEST_AND_SET_NEG(emu->P, emu->Acc) ;
-				break;
-
-			case 0x05: //ORA addr : A<- A | [addr]
-				emu->Acc = emu->Acc | read_mem(emu,ZP_DIRECT_ACCESS);
-				emu->PC+=2;
-				//affects s,z flags
-				TEST_AND_SET_ZERO(emu->P, emu->Acc) ;
-				TEST_AND_SET_NEG(emu->P, emu->Acc) ;
-				break;
-
-			case 0x15: //ORA addr : A<- A | [addr+X]
-				emu->Acc = emu->Acc | read_mem(emu,ZP_INDEXED_X_ACCESS);
-				emu->PC+=2;
-				//affects s,z flags
-				TEST_AND_SET_ZERO(emu->P, emu->Acc) ;
-				TEST_AND_SET_NEG(emu->P, emu->Acc) ;
-				break;
-
-			case 0x01: //ORA addr : A<- A | [[addr+X]]
-				emu->Acc = emu->Acc | read_mem(emu,PRE_INDEXED_X_INDIRECT_ACCESS);
-				emu->PC+=2;
-				//affects s,z flags
-				TEST_AND_SET_ZERO(emu->P, emu->Acc) ;
-				TEST_AND_SET_NEG(emu->P, emu->Acc) ;
-				break;
-
-			case 0x11: //ORA addr : A<- A | [[addr+1,addr] +Y]
-				emu->Acc = emu->Acc | read_mem(emu,POST_INDEXED_Y_INDIRECT_ACCESS);
-				emu->PC+=2;
-				//affects s,z flags
-				TEST_AND_SET_ZERO(emu->P, emu->Acc) ;
-				TEST_AND_SET_NEG(emu->P, emu->Acc) ;
-				break;
-
-			case 0x0D: //ORA addr : A<- A | [addr16]
-				emu->Acc = emu->Acc | read_mem(emu,EXTENDED_DIRECT_ACCESS);
-				emu->PC+=3;
-				//affects s,z flags
-				TEST_AND_SET_ZERO(emu->P, emu->Acc) ;
-				TEST_AND_SET_NEG(emu->P, emu->Acc) ;
-				break;
-
-			case 0x19: //ORA addr : A<- A | [addr16+Y]
-				emu->Acc = emu->Acc | read_mem(emu,ABSOLUTE_INDEXED_Y_ACCESS);
-				emu->PC+=3;
-				//affects s,z flags
-				TEST_AND_SET_ZERO(emu->P, emu->Acc) ;
-				TEST_AND_SET_NEG(emu->P, emu->Acc) ;
-				break;
-
-			case 0x1D: //ORA addr : A<- A | [addr16+X]
-				emu->Acc = emu->Acc | read_mem(emu,ABSOLUTE_INDEXED_X_ACCESS);
-				emu->PC+=3;
-				//affects s,z flags
-				TEST_AND_SET_ZERO(emu->P, emu->Acc) ;
-				TEST_AND_SET_NEG(emu->P, emu->Acc) ;
-				break;
-
-
-			//***********************>>>SBC INSTRUCTIONS<<<*************************
-			case 0xE9: //SBC addr : A<- A - IMM - C'
-			{
-				ch1 = emu->Acc;
-				ch2 = IMMIDIATE_ACCESS + ((unsigned char)1 - (unsigned char)(CARRY_GET(emu->P)));
-
-				emu->Acc = (ch1 - ch2);
-				emu->PC+=2;
-				//affects s,z,v,c flags
-				TEST_AND_SET_ZERO(emu->P, emu->Acc) ;
-				TEST_AND_SET_NEG(emu->P, emu->Acc) ;
-				TEST_AND_SET_CARRY_SUBTRACTION(emu->P, ch1, ch2 ) ;
-				TEST_AND_SET_V_OVERFLOW_SUBTRACTION(emu->P, ch1, ch2) ;
-				break;
-			}
+/**************************************
+ * Name:  add_memory_access_listener
+ * Inputs:  em6502 * - the 6502 object
+ * 			mem_region - memory region to watch
+ * 			unsigned char - READ, WRITE or READ | WRITE
+ *			cb_access - callback function ptr to invoke
+ * 			void * - passed back to it
+ * Outputs: int - 1 if it was added, 0 if there are MAX_MEMORY_WRITER_LISTENERS already
+ * Function: registers a listener for reads and/or writes; reads of its bytes go through
+ * 			 read_mem's slow path, and only those look for listeners
+ *
+***************************************/
+int add_memory_access_listener( em6502 *emu, mem_region region, unsigned char mode,
+								void (*cb_access)(em6502 *, void *, unsigned short, unsigned char, unsigned char),
+								void *context )
+{
+	assert(emu->arena != 0);
 
-			case 0xE5: //SBC addr : A<- A - [addr] - C'
-			{
-				ch1 = emu->Acc;
-				ch2 = read_mem(emu,ZP_DIRECT_ACCESS) + ((unsigned char)1 - (unsigned char)(CARRY_GET(emu->P)));
-
-				emu->Acc = (ch1 - ch2);
-				emu->PC+=2;
-				//affects s,z,v,c flags
-				TEST_AND_SET_ZERO(emu->P, emu->Acc) ;
-				TEST_AND_SET_NEG(emu->P, emu->Acc) ;
-				TEST_AND_SET_CARRY_SUBTRACTION(emu->P, ch1, ch2 ) ;
-				TEST_AND_SET_V_OVERFLOW_SUBTRACTION(emu->P, ch1, ch2) ;
-				break;
-			}
+	return add_listener(emu, region, mode, 0, cb_access, context);
+}
 
-			case 0xF5: //SBC addr : A<- A - [addr+X] - C'
-			{
-				ch1 = emu->Acc;
-				ch2 = read_mem(emu,ZP_INDEXED_X_ACCESS) + ((unsigned char)1 - (unsigned char)(CARRY_GET(emu->P)));
-
-				emu->Acc = (ch1 - ch2);
-				emu->PC+=2;
-				//affects s,z,v,c flags
-				TEST_AND_SET_ZERO(emu->P, emu->Acc) ;
-				TEST_AND_SET_NEG(emu->P, emu->Acc) ;
-				TEST_AND_SET_CARRY_SUBTRACTION(emu->P, ch1, ch2 ) ;
-				TEST_AND_SET_V_OVERFLOW_SUBTRACTION(emu->P, ch1, ch2) ;
-				break;
-			}
+//removes every listener, along with their watch masks
+static void clear_write_listeners( em6502 *emu )
+{
+	int i;
 
-		    case 0xE1: //SBC addr : A<- A - [[addr+X]] - C'
-			{
-				ch1 = emu->Acc;
-				ch2 = read_mem(emu,PRE_INDEXED_X_INDIRECT_ACCESS) + ((unsigned char)1 - (unsigned char)(CARRY_GET(emu->P)));
-
-				emu->Acc = (ch1 - ch2);
-				emu->PC+=2;
-				//affects s,z,v,c flags
-				TEST_AND_SET_ZERO(emu->P, emu->Acc) ;
-				TEST_AND_SET_NEG(emu->P, emu->Acc) ;
-				TEST_AND_SET_CARRY_SUBTRACTION(emu->P, ch1, ch2 ) ;
-				TEST_AND_SET_V_OVERFLOW_SUBTRACTION(emu->P, ch1, ch2) ;
-				break;
-			}
+	for ( i = 0; i < NUM_PAGES; i++ )
+	{
+		free(emu->watch_masks[i]);
+		emu->watch_masks[i] = 0;
 
-			case 0xF1: //SBC addr : A<- A - [[addr+1, addr]+ Y] - C', post-indexed indirect addressing mode
-			{
-				ch1 = emu->Acc;
-				ch2 =read_mem(emu,POST_INDEXED_Y_INDIRECT_ACCESS) + ((unsigned char)1 - (unsigned char)(CARRY_GET(emu->P)));
-
-				emu->Acc = (ch1 - ch2);
-				emu->PC+=2;
-				//affects s,z,v,c flags
-				TEST_AND_SET_ZERO(emu->P, emu->Acc) ;
-				TEST_AND_SET_NEG(emu->P, emu->Acc) ;
-				TEST_AND_SET_CARRY_SUBTRACTION(emu->P, ch1, ch2 ) ;
-				TEST_AND_SET_V_OVERFLOW_SUBTRACTION(emu->P, ch1, ch2) ;
-				break;
-			}
+		if ( emu->read_watch_masks[i] != 0 )
+		{
+			free(emu->read_watch_masks[i]);
+			emu->read_watch_masks[i] = 0;
+			update_slow_page(emu, i);
+		}
+	}
 
-			case 0xED: //SBC addr : A<- A - [addr16] - C', extended direct addressing mode
-			{
-				ch1 = emu->Acc;
-				ch2 = read_mem(emu,EXTENDED_DIRECT_ACCESS) + ((unsigned char)1 - (unsigned char)(CARRY_GET(emu->P)));
-
-				emu->Acc = (ch1 - ch2);
-				emu->PC+=3;
-				//affects s,z,v,c flags
-				TEST_AND_SET_ZERO(emu->P, emu->Acc) ;
-				TEST_AND_SET_NEG(emu->P, emu->Acc) ;
-				TEST_AND_SET_CARRY_SUBTRACTION(emu->P, ch1, ch2 ) ;
-				TEST_AND_SET_V_OVERFLOW_SUBTRACTION(emu->P, ch1, ch2) ;
-				break;
-			}
+	emu->num_write_listeners = 0;
+}
 
-			case 0xF9: //SBC addr: A<- A - [addr16+Y] - C', absolute indexed addressing mode
-			{
-				ch1 = emu->Acc;
-				ch2 = read_mem(emu,ABSOLUTE_INDEXED_Y_ACCESS) + ((unsigned char)1 - (unsigned char)(CARRY_GET(emu->P)));
-
-				emu->Acc = (ch1 - ch2);
-				emu->PC+=3;
-				//affects s,z,v,c flags
-				TEST_AND_SET_ZERO(emu->P, emu->Acc) ;
-				TEST_AND_SET_NEG(emu->P, emu->Acc) ;
-				TEST_AND_SET_CARRY_SUBTRACTION(emu->P, ch1, ch2 ) ;
-				TEST_AND_SET_V_OVERFLOW_SUBTRACTION(emu->P, ch1, ch2) ;
-				break;
-			}
+/**************************************
+ * Name:  fork_em6502
+ * Inputs:  em6502 * - the 6502 object to fork
+ * 			em6502 * - where to put the fork; it mustnt be initialized, or it leaks
+ * Outputs: None
+ * Function: makes a copy of the emulator that runs on from where it is, sharing its
+ * 			 memory a page at a time until one of them writes to the page
+ * 			 the parent's pages that are in their place in _memory get moved out into
+ * 			 shared_pages, which the parent reads from too from then on; pages it has
+ * 			 pointed somewhere else keep pointing there, in the fork as well
+ *
+***************************************/
+void fork_em6502( em6502 *parent, em6502 *child )
+{
+	unsigned char aliased[NUM_PAGES];
+	unsigned char *data;
+	shared_page *shared;
+	unsigned int i;
 
-			case 0xFD: //SBC addr: A<- A - [addr16+X] - C', absolute indexed addressing mode
-			{
-				ch1 = emu->Acc;
-				ch2 = read_mem(emu,ABSOLUTE_INDEXED_X_ACCESS) + ((unsigned char)1 - (unsigned char)(CARRY_GET(emu->P)));
-
-				emu->Acc = (ch1 - ch2);
-				emu->PC+=3;
-				//affects s,z,v,c flags
-				TEST_AND_SET_ZERO(emu->P, emu->Acc) ;
-				TEST_AND_SET_NEG(emu->P, emu->Acc) ;
-				TEST_AND_SET_CARRY_SUBTRACTION(emu->P, ch1, ch2 ) ;
-				TEST_AND_SET_V_OVERFLOW_SUBTRACTION(emu->P, ch1, ch2) ;
-				break;
-			}
+	assert(parent->arena != 0);
 
+	//pages other pages are pointed into have to stay where they are
+	memset(aliased, 0, sizeof(aliased));
+	for ( i = 0; i < NUM_PAGES; i++ )
+	{
+		data = parent->page_table[i]->data;
+		if ( data != &parent->_memory[i * PAGE_SIZE] && data >= parent->_memory && data < parent->_memory + MEMORY_SIZE )
+		{
+			aliased[(data - parent->_memory) / PAGE_SIZE] = 1;
+		}
+	}
 
-			//***********************>>>INC INSTRUCTIONS<<<*************************
-			case 0xE6: //INC addr : [addr]<- [addr]+1
-				STUB_OUT_MEM_ACCESS_IFACES ;
+	for ( i = 0; i < NUM_PAGES; i++ )
+	{
+		if ( parent->shared_pages[i] == 0 && !aliased[i] && parent->page_table[i]->data == &parent->_memory[i * PAGE_SIZE] )
+		{
+			shared = (shared_page *)malloc(sizeof(shared_page));
+			shared->refs = 1;
+			memcpy(shared->data, &parent->_memory[i * PAGE_SIZE], PAGE_SIZE);
+			parent->shared_pages[i] = shared;
+			parent->page_table[i]->data = shared->data;
+			update_slow_page(parent, i);
+		}
+	}
 
-				ch1 = read_mem(emu,ZP_DIRECT_ACCESS) + 1;
+	//registers, counters, events and settings as they are
+	memcpy(child, parent, sizeof(em6502));
 
-				write_mem(emu,ZP_DIRECT_ACCESS,ch1);
-				//emu->Memory[ZP_DIRECT_ACCESS] = ch1;
+	//not zeroed, which would cost as much as copying it; a page's place in it only
+	//gets used once something has been put there
+	child->arena = (memory_arena *)malloc(sizeof(memory_arena));
+	child->_memory = child->arena->memory;
 
-				emu->PC+=2;
-				//affects s,z flags
-				TEST_AND_SET_ZERO(emu->P, ch1) ;
-				TEST_AND_SET_NEG(emu->P, ch1) ;
-				break;
+	for ( i = 0; i < NUM_PAGES; i++ )
+	{
+		child->page_table[i] = &child->arena->pages[i];
+		*child->page_table[i] = *parent->page_table[i];
 
-			case 0xF6: //INC addr : [addr+X]<- [addr+X]+1
-				STUB_OUT_MEM_ACCESS_IFACES ;
+		data = parent->page_table[i]->data;
+		if ( child->shared_pages[i] != 0 )
+		{
+			child->shared_pages[i]->refs++;
+		}
+		else if ( data >= parent->_memory && data < parent->_memory + MEMORY_SIZE )
+		{
+			child->page_table[i]->data = child->_memory + (data - parent->_memory);
+		}
 
-				ch1 = read_mem(emu,ZP_INDEXED_X_ACCESS) + 1;
+		if ( aliased[i] || (child->shared_pages[i] == 0 && data == &parent->_memory[i * PAGE_SIZE]) )
+		{
+			memcpy(&child->_memory[i * PAGE_SIZE], &parent->_memory[i * PAGE_SIZE], PAGE_SIZE);
+		}
+		else if ( child->shared_pages[i] == 0 )
+		{
+			//pointed somewhere else; it's back here after create_simple_memory_map
+			memset(&child->_memory[i * PAGE_SIZE], 0, PAGE_SIZE);
+		}
 
-				//emu->Memory[ZP_INDEXED_X_ACCESS] = ch1;
-				write_mem(emu,ZP_INDEXED_X_ACCESS,ch1);
+		if ( parent->watch_masks[i] != 0 )
+		{
+			child->watch_masks[i] = (unsigned char *)malloc(PAGE_SIZE / 8);
+			memcpy(child->watch_masks[i], parent->watch_masks[i], PAGE_SIZE / 8);
+		}
+		if ( parent->read_watch_masks[i] != 0 )
+		{
+			child->read_watch_masks[i] = (unsigned char *)malloc(PAGE_SIZE / 8);
+			memcpy(child->read_watch_masks[i], parent->read_watch_masks[i], PAGE_SIZE / 8);
+		}
 
-				emu->PC+=2;
-				//affects s,z flags
-				TEST_AND_SET_ZERO(emu->P, ch1) ;
-				TEST_AND_SET_NEG(emu->P, ch1) ;
-				break;
+		update_slow_page(child, i);
+	}
 
-			case 0xEE: //INC addr : [addr16]<- [addr16]+1
-				STUB_OUT_MEM_ACCESS_IFACES ;
+	if ( parent->breakpoints != 0 )
+	{
+		child->breakpoints = (unsigned char *)malloc(MEMORY_SIZE / 8);
+		memcpy(child->breakpoints, parent->breakpoints, MEMORY_SIZE / 8);
+	}
 
-				ch1 = read_mem(emu,EXTENDED_DIRECT_ACCESS) + 1;
+	//it decodes and translates its code again as it runs
+	for ( i = 0; i < NUM_PAGES; i++ )
+	{
+		#ifdef ENABLE_PREDECODE_CACHE
+		child->decode_cache[i] = 0;
+		#endif
 
-				//emu->Memory[EXTENDED_DIRECT_ACCESS] = ch1;
-				write_mem(emu,EXTENDED_DIRECT_ACCESS,ch1);
+		#ifdef ENABLE_FUSION
+		child->fused_pages[i] = 0;
+		#endif
 
-				emu->PC+=3;
-				//affects s,z flags
-				TEST_AND_SET_ZERO(emu->P, ch1) ;
-				TEST_AND_SET_NEG(emu->P, ch1) ;
-				break;
+		#ifdef ENABLE_DYNAREC
+		child->dynarec_pages[i] = 0;
+		#endif
+	}
 
-			case 0xFE: //INC addr : [addr16+X]<- [addr16+X]+1
-				STUB_OUT_MEM_ACCESS_IFACES ;
+	#ifdef ENABLE_DYNAREC
+	child->dynarec_code = 0;
+	child->dynarec_code_used = 0;
+	child->dynarec_stale = 0;
+	#endif
 
-				ch1 = read_mem(emu,ABSOLUTE_INDEXED_X_ACCESS) + 1;
+	#ifdef ENABLE_PROFILER
+	child->profile = 0;
+	#endif
 
-				//emu->Memory[ABSOLUTE_INDEXED_X_ACCESS] = ch1;
-				write_mem(emu,ABSOLUTE_INDEXED_X_ACCESS,ch1);
+	//checkpoints arent shared
+	child->checkpoint = 0;
+}
 
-				emu->PC+=3;
-				//affects s,z flags
-				TEST_AND_SET_ZERO(emu->P, ch1) ;
-				TEST_AND_SET_NEG(emu->P, ch1) ;
-				break;
+//lets go of every page shared with forks, without copying them
+static void release_shared_pages( em6502 *emu )
+{
+	int i;
 
+	for ( i = 0; i < NUM_PAGES; i++ )
+	{
+		if ( emu->shared_pages[i] != 0 )
+		{
+			release_shared_page(emu, i);
+		}
+	}
+}
 
-			//***********************>>>DEC INSTRUCTIONS<<<*************************
-			case 0xC6: //DEC addr : [addr]<- [addr]-1
-				STUB_OUT_MEM_ACCESS_IFACES ;
+//what checkpoint_em6502 saves
+struct em6502_checkpoint {
+	em6502 state; //the registers, counters and events get put back from here
+	unsigned char memory[MEMORY_SIZE]; //every page's bytes, by addr
+};
 
-				ch1 = read_mem(emu,ZP_DIRECT_ACCESS) - 1;
+/**************************************
+ * Name:  checkpoint_em6502
+ * Inputs:  em6502 * - the 6502 object
+ * Outputs: None
+ * Function: saves the registers, counters, events and memory, for rollback_em6502;
+ * 			 memory is saved through the page_table, so pages pointed somewhere else
+ * 			 get what's there saved, and it clears the dirty pages
+ *
+***************************************/
+void checkpoint_em6502( em6502 *emu )
+{
+	unsigned int page;
 
-				//emu->Memory[ZP_DIRECT_ACCESS] = ch1;
-				write_mem(emu,ZP_DIRECT_ACCESS,ch1);
+	if ( emu->checkpoint == 0 )
+	{
+		emu->checkpoint = (struct em6502_checkpoint *)malloc(sizeof(struct em6502_checkpoint));
+	}
 
-				emu->PC+=2;
-				//affects s,z flags
-				TEST_AND_SET_ZERO(emu->P, ch1) ;
-				TEST_AND_SET_NEG(emu->P, ch1) ;
-				break;
+	memcpy(&emu->checkpoint->state, emu, sizeof(em6502));
+	for ( page = 0; page < NUM_PAGES; page++ )
+	{
+		memcpy(&emu->checkpoint->memory[page * PAGE_SIZE], emu->page_table[page]->data, PAGE_SIZE);
+	}
 
-			case 0xD6: //DEC addr : [addr+X]<- [addr+X]-1
-				STUB_OUT_MEM_ACCESS_IFACES ;
+	memset(emu->dirty_pages, 0, sizeof(emu->dirty_pages));
+}
 
-				ch1 = read_mem(emu,ZP_INDEXED_X_ACCESS) - 1;
 
-				//emu->Memory[ZP_INDEXED_X_ACCESS] = ch1;
-				write_mem(emu,ZP_INDEXED_X_ACCESS,ch1);
+/**************************************
+ * Name:  rollback_em6502
+ * Inputs:  em6502 * - the 6502 object
+ * Outputs: None
+ * Function: puts the emulator back the way it was at its checkpoint, copying back only
+ * 			 the pages marked dirty since; code decoded or translated from them is dropped
+ *
+***************************************/
+void rollback_em6502( em6502 *emu )
+{
+	em6502 *state;
+	unsigned int page;
 
-				emu->PC+=2;
-				//affects s,z flags
-				TEST_AND_SET_ZERO(emu->P, ch1) ;
-				TEST_AND_SET_NEG(emu->P, ch1) ;
-				break;
+	assert(emu->checkpoint != 0);
+	state = &emu->checkpoint->state;
 
-			case 0xCE: //DEC addr : [addr16]<- [addr16]+1
-				STUB_OUT_MEM_ACCESS_IFACES ;
+	for ( page = 0; page < NUM_PAGES; page++ )
+	{
+		if ( emu->dirty_pages[page / 8] == 0 )
+		{
+			//none of the 8 pages
+			page |= 7;
+			continue;
+		}
 
-				ch1 = read_mem(emu,EXTENDED_DIRECT_ACCESS) - 1;
+		//ROM cant have changed
+		if ( (emu->dirty_pages[page / 8] & (1 << (page % 8))) && (GET_WRITE(emu->page_table[page]->flag)) )
+		{
+			unshare_page(emu, page);
+			memcpy(emu->page_table[page]->data, &emu->checkpoint->memory[page * PAGE_SIZE], PAGE_SIZE);
+			invalidate_code(emu, page * PAGE_SIZE, page * PAGE_SIZE + PAGE_SIZE - 1);
+		}
+	}
+	memset(emu->dirty_pages, 0, sizeof(emu->dirty_pages));
 
-				//emu->Memory[EXTENDED_DIRECT_ACCESS] = ch1;
-				write_mem(emu,EXTENDED_DIRECT_ACCESS,ch1);
+	emu->Acc = state->Acc;
+	emu->X = state->X;
+	emu->Y = state->Y;
+	emu->P = state->P;
+	emu->S = state->S;
+	emu->PC = state->PC;
 
-				emu->PC+=3;
-				//affects s,z flags
-				TEST_AND_SET_ZERO(emu->P, ch1) ;
-				TEST_AND_SET_NEG(emu->P, ch1) ;
-				break;
+	#ifdef ALLOW_MAX_INSTR_COUNT
+	emu->instr_count = state->instr_count;
+	#endif
 
-			case 0xDE: //DEC addr : [addr16+X]<- [addr16+X]-1
-				STUB_OUT_MEM_ACCESS_IFACES ;
+	#ifdef ENABLE_CYCLE_COUNT
+	emu->cycles = state->cycles;
+	emu->cycle_limit = state->cycle_limit;
+	#endif
 
-				ch1 = read_mem(emu,ABSOLUTE_INDEXED_X_ACCESS) - 1;
+	#ifdef ENABLE_EVENTS
+	memcpy(emu->events, state->events, sizeof(emu->events));
+	emu->num_events = state->num_events;
+	emu->next_event_id = state->next_event_id;
+	#endif
 
-				//emu->Memory[ABSOLUTE_INDEXED_X_ACCESS] = ch1;
-				write_mem(emu,ABSOLUTE_INDEXED_X_ACCESS,ch1);
+	#ifdef ENABLE_INTERRUPTS
+	emu->irq_lines = state->irq_lines;
+	emu->nmi_line = state->nmi_line;
+	emu->pending_interrupts = state->pending_interrupts;
+	#endif
 
-				emu->PC+=3;
-				//affects s,z flags
-				TEST_AND_SET_ZERO(emu->P, ch1) ;
-				TEST_AND_SET_NEG(emu->P, ch1) ;
-				break;
+	emu->resume_pc = state->resume_pc;
+	emu->resume = state->resume;
 
+	#ifdef ENABLE_IDLE_SKIP
+	emu->idle = state->idle;
+	#endif
+}
 
-			//***********************>>>CPX INSTRUCTIONS<<<*************************
-			case 0xE0: //CPX addr : X-IMM, sets s,z,c flags
-				ch1 = emu->X;
-				ch2 = IMMIDIATE_ACCESS ;
-				res = ch1 - ch2;
+/**************************************
+ * Name:  set_breakpoint
+ * Inputs:  em6502 * - the 6502 object
+ *				unsigned short - addr to stop at
+ * Outputs: None
+ * Function: run_program stops with STOP_BREAKPOINT before running the instr at addr,
+ *			 unless that's the instr it was started on
+ *
+***************************************/
+void set_breakpoint( em6502 *emu, unsigned short addr )
+{
+	if ( emu->breakpoints == 0 )
+	{
+		emu->breakpoints = (unsigned char *)calloc(MEMORY_SIZE / 8, 1);
+	}
 
-				emu->PC+=2;
+	emu->breakpoints[addr / 8] |= 1 << (addr % 8);
 
-				//affects s,z,c flags
-				TEST_AND_SET_ZERO(emu->P, res) ;
-				TEST_AND_SET_NEG(emu->P, res) ;
-				TEST_AND_SET_CARRY_SUBTRACTION(emu->P, ch1, ch2 ) ;
-				break;
+	//so the instr at addr gets decoded/translated again, with the breakpoint
+	invalidate_code(emu, addr, addr);
+}
 
-			case 0xE4: //CPX addr : X-[addr], sets s,z,c flags
-				ch1 = emu->X;
-				ch2 = read_mem(emu,ZP_DIRECT_ACCESS);
-				res = ch1 - ch2;
 
-				emu->PC+=2;
+/**************************************
+ * Name:  clear_breakpoint
+ * Inputs:  em6502 * - the 6502 object
+ *				unsigned short - addr of the breakpoint
+ * Outputs: None
+ * Function: removes a breakpoint set with set_breakpoint
+ *
+***************************************/
+void clear_breakpoint( em6502 *emu, unsigned short addr )
+{
+	if ( BREAKPOINT_AT(emu, addr) )
+	{
+		emu->breakpoints[addr / 8] &= ~(1 << (addr % 8));
+		invalidate_code(emu, addr, addr);
+	}
+}
 
-				//affects s,z,c flags
-				TEST_AND_SET_ZERO(emu->P, res) ;
-				TEST_AND_SET_NEG(emu->P, res) ;
-				TEST_AND_SET_CARRY_SUBTRACTION(emu->P, ch1, ch2 ) ;
-				break;
 
-			case 0xEC: //CPX addr : X-[addr16], sets s,z,c flags
-				ch1 = emu->X;
-				ch2 = read_mem(emu,EXTENDED_DIRECT_ACCESS);
-				res = ch1 - ch2;
 
-				emu->PC+=3;
 
-				//affects s,z,c flags
-				TEST_AND_SET_ZERO(emu->P, res) ;
-				TEST_AND_SET_NEG(emu->P, res) ;
-				TEST_AND_SET_CARRY_SUBTRACTION(emu->P, ch1, ch2 ) ;
-				break;
+/**************************************
+ * Name:  initialize_em6502
+ * Inputs:  em6502 * - the 6502 chip to init
+ * Outputs: None
+ * Function: initializes the values to a known state
+ *
+***************************************/
+void initialize_em6502(em6502 * emu)
+{
+	int i;
 
+	emu->Acc = 0;
+	emu->X = 0;
+	emu->Y = 0;
+	emu->P = 0;
+	emu->S = 0xFF;  //stack confined to: $0100-$01FF, starts at $01FF
+	emu->PC = 0;
 
-			//***********************>>>CPY INSTRUCTIONS<<<*************************
-			case 0xC0: //CPY addr : Y-IMM, sets s,z,c flags
-				ch1 = emu->Y;
-				ch2 = IMMIDIATE_ACCESS ;
-				res = ch1 - ch2;
+	//OVERFLOW_SET(emu->P) ; //we start out with this flag set, who knows why?
 
-				emu->PC+=2;
+	//memset(emu->Memory, -1, MEMORY_SIZE );
 
-				//affects s,z,c flags
-				TEST_AND_SET_ZERO(emu->P, res) ;
-				TEST_AND_SET_NEG(emu->P, res) ;
-				TEST_AND_SET_CARRY_SUBTRACTION(emu->P, ch1, ch2 ) ;
-				break;
+	#ifdef ALLOW_MAX_INSTR_COUNT
+	emu->instr_count = 0;
+	#endif
 
-			case 0xC4: //CPY addr : Y-[addr], sets s,z,c flags
-				ch1 = emu->Y;
-				ch2 = read_mem(emu,ZP_DIRECT_ACCESS);
-				res = ch1 - ch2;
+	#ifdef ENABLE_CYCLE_COUNT
+	emu->cycles = 0;
+	emu->cycle_limit = NO_CYCLE_LIMIT;
+	#endif
 
-				emu->PC+=2;
+	#ifdef ENABLE_EVENTS
+	emu->num_events = 0;
+	emu->next_event_id = 1;
+	#endif
 
-				//affects s,z,c flags
-				TEST_AND_SET_ZERO(emu->P, res) ;
-				TEST_AND_SET_NEG(emu->P, res) ;
-				TEST_AND_SET_CARRY_SUBTRACTION(emu->P, ch1, ch2 ) ;
-				break;
+	#ifdef ENABLE_INTERRUPTS
+	emu->irq_lines = 0;
+	emu->nmi_line = 0;
+	emu->pending_interrupts = 0;
+	#endif
 
-			case 0xCC: //CPY addr : Y-[addr16], sets s,z,c flags
-				ch1 = emu->Y;
-				ch2 = read_mem(emu,EXTENDED_DIRECT_ACCESS);
-				res = ch1 - ch2;
+	emu->_memory = 0;
+	emu->arena = 0;
+	for ( i = 0; i < NUM_PAGES; i++)
+	{
+		emu->shared_pages[i] = 0;
+	}
+	memset(emu->dirty_pages, 0, sizeof(emu->dirty_pages));
+	emu->checkpoint = 0;
 
-				emu->PC+=3;
+	emu->stop_at_brk = 0;
+	emu->breakpoints = 0;
+	emu->resume = 0;
 
-				//affects s,z,c flags
-				TEST_AND_SET_ZERO(emu->P, res) ;
-				TEST_AND_SET_NEG(emu->P, res) ;
-				TEST_AND_SET_CARRY_SUBTRACTION(emu->P, ch1, ch2 ) ;
-				break;
+	emu->num_write_listeners = 0;
+	for ( i = 0; i < NUM_PAGES; i++)
+	{
+		emu->watch_masks[i] = 0;
+		emu->read_watch_masks[i] = 0;
+	}
 
+	#ifdef ENABLE_FAST_MEMORY
+	//until there's a memory map
+	memset(emu->slow_pages, 1, sizeof(emu->slow_pages));
+	memset(emu->read_pages, 0, sizeof(emu->read_pages));
+	#endif
 
-			//***********************>>>ROL INSTRUCTIONS<<<*************************
-			case 0x2A: //ROL addr : addr, sets s,z flags, rotated through c flag
-				//STUB_OUT_MEM_ACCESS_IFACES ;
+	#ifdef ENABLE_PREDECODE_CACHE
+	for ( i = 0; i < NUM_PAGES; i++)
+	{
+		emu->decode_cache[i] = 0;
+	}
+	#endif
 
-				ch1 = emu->Acc;
-				ch2 = (((int)(NEG_GET(emu->P))) == 0x00)?0:1;
-				res = (((int)(CARRY_GET(emu->P))) == 0x00)?0:1;
+	#ifdef ENABLE_ALU_TABLES
+	build_alu_tables();
+	#endif
 
-				ch1 = ch1 << 1;
+	#ifdef ENABLE_IDLE_SKIP
+	emu->idle_skip = 1;
+	emu->idle.seen = 0;
+	emu->idle.skipped = 0;
+	#endif
 
-				//rotate previous value of high-bit into carry flag
-				if (((int)(ch2)) == 0x00)CARRY_CLEAR(emu->P);
-				else CARRY_SET(emu->P);
+	#ifdef ENABLE_FUSION
+	emu->fusion = 1;
+	for ( i = 0; i < NUM_PAGES; i++)
+	{
+		emu->fused_pages[i] = 0;
+	}
+	#endif
 
-				//rotate previous value of carry flag into low-bit
-				if (((int)(res)) == 0x00)CARRY_CLEAR(ch1);
-				else CARRY_SET(ch1);
+	#ifdef ENABLE_PROFILER
+	emu->profile = 0;
+	#endif
 
-				//now move back to accumulator
-				emu->Acc = ch1;
+	#ifdef ENABLE_DYNAREC
+	emu->engine = ENGINE_INTERPRETER;
+	for ( i = 0; i < NUM_PAGES; i++)
+	{
+		emu->dynarec_pages[i] = 0;
+	}
+	emu->dynarec_code = 0;
+	emu->dynarec_code_used = 0;
+	emu->dynarec_stale = 0;
+	emu->dynarec_flushes = 0;
+	#endif
+}
 
-				emu->PC+=1;
+/**************************************
+ * Name:  reset_em6502
+ * Inputs:  em6502 * - the 6502 object to reset
+ * Outputs: None
+ * Function: puts the 6502 back the way initialize_em6502 and create_simple_memory_map
+ *			 left it, with its memory cleared; keeps what it has allocated, so
+ *			 reusing an emulator is cheaper than destroying it and making another
+ *
+***************************************/
+void reset_em6502( em6502 *emu )
+{
+	memory_arena *arena = emu->arena;
+	#ifdef ENABLE_DYNAREC
+	unsigned char *dynarec_code = emu->dynarec_code;
+	#endif
 
-				//affects s,z flags, c flag already set
-				TEST_AND_SET_ZERO(emu->P, ch1) ;
-				TEST_AND_SET_NEG(emu->P, ch1) ;
-				break;
+	drop_code(emu);
+	free(emu->breakpoints);
+	clear_write_listeners(emu);
+	release_shared_pages(emu);
+	free(emu->checkpoint);
 
+	#ifdef ENABLE_PROFILER
+	clear_profile(emu);
+	#endif
 
-			case 0x26: //ROL addr : [addr], sets s,z flags, rotated through c flag
-				STUB_OUT_MEM_ACCESS_IFACES ;
+	initialize_em6502(emu);
 
-				ch1 = read_mem(emu,ZP_DIRECT_ACCESS);
-				ch2 = (((int)(NEG_GET(emu->P))) == 0x00)?0:1;
-				res = (((int)(CARRY_GET(emu->P))) == 0x00)?0:1;
+	#ifdef ENABLE_DYNAREC
+	//the blocks in it are all gone, so it can be reused from the start
+	emu->dynarec_code = dynarec_code;
+	#endif
 
-				ch1 = ch1 << 1;
+	if ( arena != 0 )
+	{
+		emu->arena = arena;
+		create_simple_memory_map(emu);
+		memset(emu->_memory, 0, MEMORY_SIZE);
+	}
+}
 
-				//rotate previous value of high-bit into carry flag
-				if (((int)(ch2)) == 0x00)CARRY_CLEAR(emu->P);
-				else CARRY_SET(emu->P);
 
-				//rotate previous value of carry flag into low-bit
-				if (((int)(res)) == 0x00)CARRY_CLEAR(ch1);
-				else CARRY_SET(ch1);
+/**************************************
+ * Name:  destroy_em6502
+ * Inputs:  em6502 * - the 6502 object to destroy
+ * Outputs: None
+ * Function: frees everything the 6502 has allocated, memory map included;
+ *			 it has to be initialized again before it can be used
+ *
+***************************************/
+void destroy_em6502( em6502 *emu )
+{
+	drop_code(emu);
 
-				//now move back to memory
-				//emu->Memory[ZP_DIRECT_ACCESS] = ch1;
-				write_mem(emu,ZP_DIRECT_ACCESS,ch1);
+	#ifdef ENABLE_DYNAREC
+	dynarec_free(emu);
+	#endif
 
-				emu->PC+=2;
+	#ifdef ENABLE_PROFILER
+	clear_profile(emu);
+	#endif
 
-				//affects s,z flags, c flag already set
-				TEST_AND_SET_ZERO(emu->P, ch1) ;
-				TEST_AND_SET_NEG(emu->P, ch1) ;
-				break;
+	free(emu->breakpoints);
+	emu->breakpoints = 0;
 
-			case 0x36: //ROL addr : [addr+X], sets s,z flags, rotated through c flag
-				STUB_OUT_MEM_ACCESS_IFACES ;
+	clear_write_listeners(emu);
+	release_shared_pages(emu);
 
-				ch1 = read_mem(emu,ZP_INDEXED_X_ACCESS);
-				ch2 = (((int)(NEG_GET(emu->P))) == 0x00)?0:1;
-				res = (((int)(CARRY_GET(emu->P))) == 0x00)?0:1;
+	free(emu->checkpoint);
+	emu->checkpoint = 0;
 
-				ch1 = ch1 << 1;
+	free(emu->arena);
+	emu->arena = 0;
+	emu->_memory = 0;
+}
 
-				//rotate previous value of high-bit into carry flag
-				if (((int)(ch2)) == 0x00)CARRY_CLEAR(emu->P);
-				else CARRY_SET(emu->P);
-
-				//rotate previous value of carry flag into low-bit
-				if (((int)(res)) == 0x00)CARRY_CLEAR(ch1);
-				else CARRY_SET(ch1);
-
-				//now move back to memory
-				//emu->Memory[ZP_INDEXED_X_ACCESS] = ch1;
-				write_mem(emu,ZP_INDEXED_X_ACCESS,ch1);
-
-				emu->PC+=2;
-
-				//affects s,z flags, c flag already set
-				TEST_AND_SET_ZERO(emu->P, ch1) ;
-				TEST_AND_SET_NEG(emu->P, ch1) ;
-				break;
-
-			case 0x2E: //ROL addr : [addr16], sets s,z flags, rotated through c flag
-				STUB_OUT_MEM_ACCESS_IFACES ;
-
-				ch1 = read_mem(emu,EXTENDED_DIRECT_ACCESS);
-				ch2 = (((int)(NEG_GET(emu->P))) == 0x00)?0:1;
-				res = (((int)(CARRY_GET(emu->P))) == 0x00)?0:1;
-
-				ch1 = ch1 << 1;
-
-				//rotate previous value of high-bit into carry flag
-				if (((int)(ch2)) == 0x00)CARRY_CLEAR(emu->P);
-				else CARRY_SET(emu->P);
-
-				//rotate previous value of carry flag into low-bit
-				if (((int)(res)) == 0x00)CARRY_CLEAR(ch1);
-				else CARRY_SET(ch1);
-
-				//now move back to memory
-				//emu->Memory[EXTENDED_DIRECT_ACCESS] = ch1;
-				write_mem(emu,EXTENDED_DIRECT_ACCESS,ch1);
-
-
-				emu->PC+=3;
-
-				//affects s,z flags, c flag already set
-				TEST_AND_SET_ZERO(emu->P, ch1) ;
-				TEST_AND_SET_NEG(emu->P, ch1) ;
-				break;
-
-			case 0x3E: //ROL addr : [addr16+X], sets s,z flags, rotated through c flag
-				STUB_OUT_MEM_ACCESS_IFACES ;
-
-				ch1 = read_mem(emu,ABSOLUTE_INDEXED_X_ACCESS);
-				ch2 = (((int)(NEG_GET(emu->P))) == 0x00)?0:1;
-				res = (((int)(CARRY_GET(emu->P))) == 0x00)?0:1;
-
-				ch1 = ch1 << 1;
-
-				//rotate previous value of high-bit into carry flag
-				if (((int)(ch2)) == 0x00)CARRY_CLEAR(emu->P);
-				else CARRY_SET(emu->P);
-
-				//rotate previous value of carry flag into low-bit
-				if (((int)(res)) == 0x00)CARRY_CLEAR(ch1);
-				else CARRY_SET(ch1);
-
-				//now move back to memory
-				//emu->Memory[ABSOLUTE_INDEXED_X_ACCESS] = ch1;
-				write_mem(emu,ABSOLUTE_INDEXED_X_ACCESS,ch1);
-
-				emu->PC+=3;
-
-				//affects s,z flags, c flag already set
-				TEST_AND_SET_ZERO(emu->P, ch1) ;
-				TEST_AND_SET_NEG(emu->P, ch1) ;
-				break;
-
-
-
-			//***********************>>>ROR INSTRUCTIONS<<<*************************
-			case 0x6A: //ROR addr : addr, sets s,z flags, rotated through c flag
-				//STUB_OUT_MEM_ACCESS_IFACES ;
-
-				ch1 = emu->Acc;
-				ch2 = (((int)(CARRY_GET(ch1))) == 0x00)?0:1;
-				res = (((int)(CARRY_GET(emu->P))) == 0x00)?0:1;
-
-				ch1 = ch1 >> 1;
-
-				//rotate previous value of low-bit into carry flag
-				if (((int)(ch2)) == 0x00)CARRY_CLEAR(emu->P);
-				else CARRY_SET(emu->P);
-
-				//rotate previous value of carry flag into high-bit
-				if (((int)(res)) == 0x00)NEG_CLEAR(ch1);
-				else NEG_SET(ch1);
-
-				//now move back to memory
-				emu->Acc = ch1;
-
-				emu->PC+=1;
-
-				//affects s,z flags, c flag already set
-				TEST_AND_SET_ZERO(emu->P, ch1) ;
-				TEST_AND_SET_NEG(emu->P, ch1) ;
-				break;
-
-			case 0x66: //ROR addr : [addr], sets s,z flags, rotated through c flag
-				STUB_OUT_MEM_ACCESS_IFACES ;
-
-				ch1 = read_mem(emu,ZP_DIRECT_ACCESS);
-				ch2 = (((int)(CARRY_GET(ch1))) == 0x00)?0:1;
-				res = (((int)(CARRY_GET(emu->P))) == 0x00)?0:1;
-
-				ch1 = ch1 >> 1;
-
-				//rotate previous value of low-bit into carry flag
-				if (((int)(ch2)) == 0x00)CARRY_CLEAR(emu->P);
-				else CARRY_SET(emu->P);
-
-				//rotate previous value of carry flag into high-bit
-				if (((int)(res)) == 0x00)NEG_CLEAR(ch1);
-				else NEG_SET(ch1);
-
-				//now move back to memory
-				//emu->Memory[ZP_DIRECT_ACCESS] = ch1;
-				write_mem(emu,ZP_DIRECT_ACCESS,ch1);
-
-				emu->PC+=2;
-
-				//affects s,z flags, c flag already set
-				TEST_AND_SET_ZERO(emu->P, ch1) ;
-				TEST_AND_SET_NEG(emu->P, ch1) ;
-				break;
-
-			case 0x76: //ROR addr : [addr+X], sets s,z flags, rotated through c flag
-				STUB_OUT_MEM_ACCESS_IFACES ;
-
-				ch1 = read_mem(emu,ZP_INDEXED_X_ACCESS);
-				ch2 = (((int)(CARRY_GET(ch1))) == 0x00)?0:1;
-				res = (((int)(CARRY_GET(emu->P))) == 0x00)?0:1;
-
-				ch1 = ch1 >> 1;
-
-				//rotate previous value of low-bit into carry flag
-				if (((int)(ch2)) == 0x00)CARRY_CLEAR(emu->P);
-				else CARRY_SET(emu->P);
-
-				//rotate previous value of carry flag into high-bit
-				if (((int)(res)) == 0x00)NEG_CLEAR(ch1);
-				else NEG_SET(ch1);
-
-				//now move back to memory
-				//emu->Memory[ZP_INDEXED_X_ACCESS] = ch1;
-				write_mem(emu,ZP_INDEXED_X_ACCESS,ch1);
-
-				emu->PC+=2;
-
-				//affects s,z flags, c flag already set
-				TEST_AND_SET_ZERO(emu->P, ch1) ;
-				TEST_AND_SET_NEG(emu->P, ch1) ;
-				break;
-
-
-			case 0x6E: //ROR addr : [addr16], sets s,z flags, rotated through c flag
-				STUB_OUT_MEM_ACCESS_IFACES ;
-
-				ch1 = read_mem(emu,EXTENDED_DIRECT_ACCESS);
-				ch2 = (((int)(CARRY_GET(ch1))) == 0x00)?0:1;
-				res = (((int)(CARRY_GET(emu->P))) == 0x00)?0:1;
-
-				ch1 = ch1 >> 1;
-
-				//rotate previous value of low-bit into carry flag
-				if (((int)(ch2)) == 0x00)CARRY_CLEAR(emu->P);
-				else CARRY_SET(emu->P);
-
-				//rotate previous value of carry flag into high-bit
-				if (((int)(res)) == 0x00)NEG_CLEAR(ch1);
-				else NEG_SET(ch1);
-
-				//now move back to memory
-				//emu->Memory[EXTENDED_DIRECT_ACCESS] = ch1;
-				write_mem(emu,EXTENDED_DIRECT_ACCESS,ch1);
-
-				emu->PC+=3;
-
-				//affects s,z flags, c flag already set
-				TEST_AND_SET_ZERO(emu->P, ch1) ;
-				TEST_AND_SET_NEG(emu->P, ch1) ;
-				break;
-
-
-			case 0x7E: //ROR addr : [addr16+X], sets s,z flags, rotated through c flag
-				STUB_OUT_MEM_ACCESS_IFACES ;
-
-				ch1 = read_mem(emu,ABSOLUTE_INDEXED_X_ACCESS);
-				ch2 = (((int)(CARRY_GET(ch1))) == 0x00)?0:1;
-				res = (((int)(CARRY_GET(emu->P))) == 0x00)?0:1;
-
-				ch1 = ch1 >> 1;
-
-				//rotate previous value of low-bit into carry flag
-				if (((int)(ch2)) == 0x00)CARRY_CLEAR(emu->P);
-				else CARRY_SET(emu->P);
-
-				//rotate previous value of carry flag into high-bit
-				if (((int)(res)) == 0x00)NEG_CLEAR(ch1);
-				else NEG_SET(ch1);
-
-				//now move back to memory
-				//emu->Memory[ABSOLUTE_INDEXED_X_ACCESS] = ch1;
-				write_mem(emu,ABSOLUTE_INDEXED_X_ACCESS,ch1);
-
-				emu->PC+=3;
-
-				//affects s,z flags, c flag already set
-				TEST_AND_SET_ZERO(emu->P, ch1) ;
-				TEST_AND_SET_NEG(emu->P, ch1) ;
-				break;
-
-
-			//***********************>>>ASL INSTRUCTIONS<<<*************************
-			case 0x0A: //ASL addr : addr, sets n,z flags, shifts to c flag
-				//STUB_OUT_MEM_ACCESS_IFACES ;
-
-				ch1 = emu->Acc;
-				ch2 = (((int)(NEG_GET(ch1))) == 0x00)?0:1;
-				//res = (((int)(CARRY_GET(emu->P))) == 0x00)?0:1;
-
-				ch1 = ch1 << 1; //shift bits and clear 0th bit
-				CARRY_CLEAR(ch1);
-
-				//rotate previous value of high-bit into carry flag
-				if (((int)(ch2)) == 0x00)CARRY_CLEAR(emu->P);
-				else CARRY_SET(emu->P);
-
-				//now move back to memory
-				emu->Acc = ch1;
-
-				emu->PC+=1;
-
-				//affects n,z flags, c flag already set
-				TEST_AND_SET_ZERO(emu->P, ch1) ;
-				TEST_AND_SET_NEG(emu->P, ch1) ;
-				break;
-
-			case 0x06: //ASL addr : [addr], sets n,z flags, shifts to c flag
-				STUB_OUT_MEM_ACCESS_IFACES ;
-
-				ch1 = read_mem(emu,ZP_DIRECT_ACCESS);
-				ch2 = (((int)(NEG_GET(ch1))) == 0x00)?0:1;
-				//res = (((int)(CARRY_GET(emu->P))) == 0x00)?0:1;
-
-				ch1 = ch1 << 1; //shift bits and clear 0th bit
-				CARRY_CLEAR(ch1);
-
-				//rotate previous value of high-bit into carry flag
-				if (((int)(ch2)) == 0x00)CARRY_CLEAR(emu->P);
-				else CARRY_SET(emu->P);
-
-				//now move back to memory
-				//emu->Memory[ZP_DIRECT_ACCESS] = ch1;
-				write_mem(emu,ZP_DIRECT_ACCESS,ch1);
-
-				emu->PC+=2;
-
-				//affects n,z flags, c flag already set
-				TEST_AND_SET_ZERO(emu->P, ch1) ;
-				TEST_AND_SET_NEG(emu->P, ch1) ;
-				break;
-
-			case 0x16: //ASL addr : [addr+x], sets n,z flags, shifts to c flag
-				STUB_OUT_MEM_ACCESS_IFACES ;
-
-				ch1 = read_mem(emu,ZP_INDEXED_X_ACCESS);
-				ch2 = (((int)(NEG_GET(ch1))) == 0x00)?0:1;
-				//res = (((int)(CARRY_GET(emu->P))) == 0x00)?0:1;
-
-				ch1 = ch1 << 1; //shift bits and clear 0th bit
-				CARRY_CLEAR(ch1);
-
-				//rotate previous value of high-bit into carry flag
-				if (((int)(ch2)) == 0x00)CARRY_CLEAR(emu->P);
-				else CARRY_SET(emu->P);
-
-				//now move back to memory
-				//emu->Memory[ZP_INDEXED_X_ACCESS] = ch1;
-				write_mem(emu,ZP_INDEXED_X_ACCESS,ch1);
-
-				emu->PC+=2;
-
-				//affects n,z flags, c flag already set
-				TEST_AND_SET_ZERO(emu->P, ch1) ;
-				TEST_AND_SET_NEG(emu->P, ch1) ;
-				break;
-
-			case 0x0E: //ASL addr : [addr16], sets n,z flags, shifts to c flag
-				STUB_OUT_MEM_ACCESS_IFACES ;
-
-				ch1 = read_mem(emu,EXTENDED_DIRECT_ACCESS);
-				ch2 = (((int)(NEG_GET(ch1))) == 0x00)?0:1;
-				//res = (((int)(CARRY_GET(emu->P))) == 0x00)?0:1;
-
-				ch1 = ch1 << 1; //shift bits and clear 0th bit
-				CARRY_CLEAR(ch1);
-
-				//rotate previous value of high-bit into carry flag
-				if (((int)(ch2)) == 0x00)CARRY_CLEAR(emu->P);
-				else CARRY_SET(emu->P);
-
-				//now move back to memory
-				//emu->Memory[EXTENDED_DIRECT_ACCESS] = ch1;
-				write_mem(emu,EXTENDED_DIRECT_ACCESS,ch1);
-
-				emu->PC+=3;
-
-				//affects n,z flags, c flag already set
-				TEST_AND_SET_ZERO(emu->P, ch1) ;
-				TEST_AND_SET_NEG(emu->P, ch1) ;
-				break;
-
-			case 0x1E: //ASL addr : [addr16+X], sets n,z flags, shifts to c flag
-				STUB_OUT_MEM_ACCESS_IFACES ;
-
-				ch1 = read_mem(emu,ABSOLUTE_INDEXED_X_ACCESS);
-				ch2 = (((int)(NEG_GET(ch1))) == 0x00)?0:1;
-				//res = (((int)(CARRY_GET(emu->P))) == 0x00)?0:1;
-
-				ch1 = ch1 << 1; //shift bits and clear 0th bit
-				CARRY_CLEAR(ch1);
-
-				//rotate previous value of high-bit into carry flag
-				if (((int)(ch2)) == 0x00)CARRY_CLEAR(emu->P);
-				else CARRY_SET(emu->P);
-
-				//now move back to memory
-				//emu->Memory[ABSOLUTE_INDEXED_X_ACCESS] = ch1;
-				write_mem(emu,ABSOLUTE_INDEXED_X_ACCESS,ch1);
-
-				emu->PC+=3;
-
-				//affects n,z flags, c flag already set
-				TEST_AND_SET_ZERO(emu->P, ch1) ;
-				TEST_AND_SET_NEG(emu->P, ch1) ;
-				break;
-
-
-			//***********************>>>LSR INSTRUCTIONS<<<*************************
-			case 0x4A: //LSR addr : addr, sets z flag, clears n flag, shifts to c flag
-				//STUB_OUT_MEM_ACCESS_IFACES ;
-
-				ch1 = emu->Acc;
-				ch2 = (((int)(CARRY_GET(ch1))) == 0x00)?0:1;
-				//res = (((int)(CARRY_GET(emu->P))) == 0x00)?0:1;
-
-				ch1 = ch1 >> 1; //shift bits and clear high bit
-				NEG_CLEAR(ch1);
-
-				//rotate previous value of low-bit into carry flag
-				if (((int)(ch2)) == 0x00)CARRY_CLEAR(emu->P);
-				else CARRY_SET(emu->P);
-
-				//now move back to memory
-				emu->Acc = ch1;
-
-				emu->PC+=1;
-
-				//affects z,n flags, c flag already set
-				TEST_AND_SET_ZERO(emu->P, ch1) ;
-				NEG_CLEAR(emu->P);
-				break;
-
-			case 0x46: //LSR addr : [addr], sets z flag, clears n flag, shifts to c flag
-				STUB_OUT_MEM_ACCESS_IFACES ;
-
-				ch1 = read_mem(emu,ZP_DIRECT_ACCESS);
-				ch2 = (((int)(CARRY_GET(ch1))) == 0x00)?0:1;
-				//res = (((int)(CARRY_GET(emu->P))) == 0x00)?0:1;
-
-				ch1 = ch1 >> 1; //shift bits and clear high bit
-				NEG_CLEAR(ch1);
-
-				//rotate previous value of low-bit into carry flag
-				if (((int)(ch2)) == 0x00)CARRY_CLEAR(emu->P);
-				else CARRY_SET(emu->P);
-
-				//now move back to memory
-				//emu->Memory[ZP_DIRECT_ACCESS] = ch1;
-				write_mem(emu,ZP_DIRECT_ACCESS,ch1);
-
-				emu->PC+=2;
-
-				//affects z,n flags, c flag already set
-				TEST_AND_SET_ZERO(emu->P, ch1) ;
-				NEG_CLEAR(emu->P);
-				break;
-
-			case 0x56: //LSR addr : [addr], sets z flag, clears n flag, shifts to c flag
-				STUB_OUT_MEM_ACCESS_IFACES ;
-
-				ch1 = read_mem(emu,ZP_INDEXED_X_ACCESS);
-				ch2 = (((int)(CARRY_GET(ch1))) == 0x00)?0:1;
-				//res = (((int)(CARRY_GET(emu->P))) == 0x00)?0:1;
-
-				ch1 = ch1 >> 1; //shift bits and clear high bit
-				NEG_CLEAR(ch1);
-
-				//rotate previous value of low-bit into carry flag
-				if (((int)(ch2)) == 0x00)CARRY_CLEAR(emu->P);
-				else CARRY_SET(emu->P);
-
-				//now move back to memory
-				//emu->Memory[ZP_INDEXED_X_ACCESS] = ch1;
-				write_mem(emu,ZP_INDEXED_X_ACCESS,ch1);
-
-				emu->PC+=2;
-
-				//affects z,n flags, c flag already set
-				TEST_AND_SET_ZERO(emu->P, ch1) ;
-				NEG_CLEAR(emu->P);
-				break;
-
-			case 0x4E: //LSR addr : [addr16], sets z flag, clears n flag, shifts to c flag
-				STUB_OUT_MEM_ACCESS_IFACES ;
-
-				ch1 = read_mem(emu,EXTENDED_DIRECT_ACCESS);
-				ch2 = (((int)(CARRY_GET(ch1))) == 0x00)?0:1;
-				//res = (((int)(CARRY_GET(emu->P))) == 0x00)?0:1;
-
-				ch1 = ch1 >> 1; //shift bits and clear high bit
-				NEG_CLEAR(ch1);
-
-				//rotate previous value of low-bit into carry flag
-				if (((int)(ch2)) == 0x00)CARRY_CLEAR(emu->P);
-				else CARRY_SET(emu->P);
-
-				//now move back to memory
-				//emu->Memory[EXTENDED_DIRECT_ACCESS] = ch1;
-				write_mem(emu,EXTENDED_DIRECT_ACCESS,ch1);
-
-				emu->PC+=3;
-
-				//affects z,n flags, c flag already set
-				TEST_AND_SET_ZERO(emu->P, ch1) ;
-				NEG_CLEAR(emu->P);
-				break;
-
-			case 0x5E: //LSR addr : [addr16+X], sets z flag, clears n flag, shifts to c flag
-				STUB_OUT_MEM_ACCESS_IFACES ;
-
-				ch1 = read_mem(emu,ABSOLUTE_INDEXED_X_ACCESS);
-				ch2 = (((int)(CARRY_GET(ch1))) == 0x00)?0:1;
-				//res = (((int)(CARRY_GET(emu->P))) == 0x00)?0:1;
-
-				ch1 = ch1 >> 1; //shift bits and clear high bit
-				NEG_CLEAR(ch1);
-
-				//rotate previous value of low-bit into carry flag
-				if (((int)(ch2)) == 0x00)CARRY_CLEAR(emu->P);
-				else CARRY_SET(emu->P);
-
-				//now move back to memory
-				//emu->Memory[ABSOLUTE_INDEXED_X_ACCESS] = ch1;
-				write_mem(emu,ABSOLUTE_INDEXED_X_ACCESS,ch1);
-
-				emu->PC+=3;
-
-				//affects z,n flags, c flag already set
-				TEST_AND_SET_ZERO(emu->P, ch1) ;
-				NEG_CLEAR(emu->P);
-				break;
-
-
-			//***********************>>>JMP INSTRUCTIONS<<<*************************
-			case 0x4C: //JMP addr : PC<- addr16, no flags affected
-				emu->PC = EXTENDED_DIRECT_ACCESS;
-
-				//no flags affected
-				break;
-
-			case 0x6C: //JMP addr : PC<- [addr16], no flags affected
-				emu->PC = ABSOLUTE_INDIRECT_JMP_ACCESS;
-
-				//no flags affected
-				break;
-
-
-			//***********************>>>B** INSTRUCTIONS<<<*************************
-			case 0x90: //BCC addr : C=0-> PC+= addr+2, else PC+=2, no flags affectd
-				if ( (int)(CARRY_GET(emu->P)) == 0x00 )
-				{
-					emu->PC+= (signed char)(IMMIDIATE_ACCESS) ;
-				}
-				emu->PC +=2; //still have to add 2 to account for length of opcode executed
-
-				//no flags affected
-				break;
-
-			case 0xB0: //BCS addr : C=1-> PC+= addr+2, else PC+=2, no flags affectd
-				if ( (int)(CARRY_GET(emu->P)) != 0x00 )
-				{
-					emu->PC+= (signed char)(IMMIDIATE_ACCESS) ;
-				}
-				emu->PC +=2; //still have to add 2 to account for length of opcode executed
-
-				//no flags affected
-				break;
-
-			case 0xF0: //BEQ addr : Z=1-> PC+= addr+2, else PC+=2, no flags affectd
-				if ( (int)(ZERO_GET(emu->P)) != 0x00 )
-				{
-					emu->PC+= (signed char)(IMMIDIATE_ACCESS) ;
-				}
-				emu->PC +=2; //still have to add 2 to account for length of opcode executed
+/**************************************
+ * Name:  load_memory
+ * Inputs:  em6502 * - the 6502 object
+ *				const void * - the bytes to copy in
+ *				size_t - how many; they have to fit below $10000
+ *				unsigned int - addr to copy them to, any addr
+ * Outputs: None
+ * Function: copies the bytes in through the page table, without calling listeners;
+ * 			 one memcpy for each run of pages that follow on from each other in memory,
+ * 			 which is all of them for the simple memory map. ROM pages keep what they had
+ *
+***************************************/
+void load_memory( em6502 *emu, const void *bytes, size_t size, unsigned int addr )
+{
+	const unsigned char *src = (const unsigned char *)bytes;
+	unsigned int page;
+	unsigned int last;
+	unsigned int low;
+	unsigned int high;
 
-				//no flags affected
-				break;
+	if ( size == 0 )
+	{
+		return;
+	}
 
-			case 0x30: //BMI addr : N=1-> PC+= addr+2, else PC+=2, no flags affectd
-				if ( (int)(NEG_GET(emu->P)) != 0x00 )
-				{
-					emu->PC+= (signed char)(IMMIDIATE_ACCESS) ;
-				}
-				emu->PC +=2; //still have to add 2 to account for length of opcode executed
+	assert(addr + size <= MEMORY_SIZE);
+	last = (addr + size - 1) / PAGE_SIZE;
 
-				//no flags affected
-				break;
+	//pages shared with forks get their own copy to be written
+	for ( page = addr / PAGE_SIZE; page <= last; page++ )
+	{
+		unshare_page(emu, page);
+	}
 
-			case 0xD0: //BNE addr : Z=0-> PC+= addr+2, else PC+=2, no flags affectd
-				if ( (int)(ZERO_GET(emu->P)) == 0x00 )
-				{
-					emu->PC+= (signed char)(IMMIDIATE_ACCESS) ;
-				}
-				emu->PC +=2; //still have to add 2 to account for length of opcode executed
+	page = addr / PAGE_SIZE;
+	while ( page <= last )
+	{
+		if ( (GET_WRITE(emu->page_table[page]->flag)) == 0 )
+		{
+			page++;
+			continue;
+		}
 
-				//no flags affected
-				break;
+		//the run starts here, and takes in every page whose data comes right after the last one's
+		low = page * PAGE_SIZE > addr ? page * PAGE_SIZE : addr;
+		while ( page < last && (GET_WRITE(emu->page_table[page + 1]->flag)) &&
+				emu->page_table[page + 1]->data == emu->page_table[page]->data + PAGE_SIZE )
+		{
+			page++;
+		}
+		high = (page + 1) * PAGE_SIZE < addr + size ? (page + 1) * PAGE_SIZE : addr + size;
 
-			case 0x10: //BPL addr : N=0-> PC+= addr+2, else PC+=2, no flags affectd
-				if ( (int)(NEG_GET(emu->P)) == 0x00 )
-				{
-					emu->PC+= (signed char)(IMMIDIATE_ACCESS) ;
-				}
-				emu->PC +=2; //still have to add 2 to account for length of opcode executed
+		memcpy(&emu->page_table[low / PAGE_SIZE]->data[low % PAGE_SIZE], src + (low - addr), high - low);
+		page++;
+	}
 
-				//no flags affected
-				break;
+	invalidate_code(emu, addr, addr + size - 1);
+}
 
-			case 0x50: //BVC addr : V=0-> PC+= addr+2, else PC+=2, no flags affectd
-				if ( (int)(OVERFLOW_GET(emu->P)) == 0x00 )
-				{
-					emu->PC+= (signed char)(IMMIDIATE_ACCESS) ;
-				}
-				emu->PC +=2; //still have to add 2 to account for length of opcode executed
+/**************************************
+ * Name:  load_program
+ * Inputs:  em6502 * - the 6502 object to load program
+ *	 			void * - the memory containing the program; gets copied into em6502->Memory
+ *				size_t - size of program to copy
+ *				unsigned int -  offset from start
+ * Outputs: None
+ * Function: copies the memory into the memory space of the em6502 object. This allows us
+ * to use relocatable code and copy it anywhere in the memory space
+ * This assumes that the paging memory model has already been built
+ * The offset can be any addr; loader.c has the formats with load addrs of their own
+ *
+***************************************/
+void load_program( em6502 *emu, void *prog, size_t size, unsigned int offset)
+{
+	load_memory(emu, prog, size, offset);
 
-				//no flags affected
-				break;
+	//also, we must fix the PC to point to start of memory region, for supporting relocatable code
+	emu->PC = offset;
+}
 
-			case 0x70: //BVS addr : V=1-> PC+= addr+2, else PC+=2, no flags affectd
-				if ( (int)(OVERFLOW_GET(emu->P)) != 0x00 )
-				{
-					emu->PC+= (signed char)(IMMIDIATE_ACCESS) ;
-				}
-				emu->PC +=2; //still have to add 2 to account for length of opcode executed
+/**************************************
+ * Name:  create_simple_memory_map
+ * Inputs:  em6502 * - the 6502 object to execute
+ * Outputs: None
+ * Function: creates the simplest memory map possible;
+ * 			 straight mapping with all pages marked as read-able
+ * 			 an emulator that already has a map gets its pages put back that way;
+ * 			 whatever is in its memory stays there
+ *
+***************************************/
+void create_simple_memory_map( em6502 *emu )
+{
+	int i;
 
-				//no flags affected
-				break;
+	//for the simple-memory model, we map into the entire memory space
+	//so we create the underlying memory, and the pages along with it
+	//an emulator that already has them gets them put back the way they started
+	if ( emu->arena == 0 )
+	{
+		//zeroed, so nothing depends on what the last emulator to free its arena left behind
+		emu->arena = (memory_arena *)calloc(1, sizeof(memory_arena));
+	}
+	else
+	{
+		//whatever ran was decoded under the old map
+		drop_code(emu);
 
+		//and the pages shared with forks go back in their places
+		for ( i = 0; i < NUM_PAGES; i++ )
+		{
+			unshare_page(emu, i);
+		}
+	}
+	emu->_memory = emu->arena->memory;
 
-			//***********************>>>T** INSTRUCTIONS<<<*************************
-			case 0xAA: //TAX : X<- A, s,z flags affected
-				emu->X = emu->Acc;
+	//now we simply point all the pages to the corresponding memory
+	//mark them all as read/write/execute, no listeners
+	for ( i = 0; i < NUM_PAGES; i++)
+	{
+		emu->page_table[i] = &emu->arena->pages[i];
 
-				emu->PC+=1;
+		emu->page_table[i]->data = &emu->_memory[i*PAGE_SIZE];
+		emu->page_table[i]->page_addr = i*PAGE_SIZE;
+		emu->page_table[i]->flag = READ | WRITE | EXECUTE;
+		emu->page_table[i]->cb_mem_listener = 0;
+		emu->page_table[i]->cb_device = 0;
+		emu->page_table[i]->device_context = 0;
+	}
 
-				//affects s,z flags
-				TEST_AND_SET_ZERO(emu->P, emu->X);
-				TEST_AND_SET_NEG(emu->P, emu->X);
-				break;
+	#ifdef ENABLE_FAST_MEMORY
+	//which makes every page plain RAM
+	memset(emu->slow_pages, 0, sizeof(emu->slow_pages));
+	for ( i = 0; i < NUM_PAGES; i++ )
+	{
+		emu->read_pages[i] = emu->page_table[i]->data;
+	}
+	#endif
+}
 
-			case 0x8A: //TXA : A<- X, s,z flags affected
-				emu->Acc = emu->X;
 
-				emu->PC+=1;
+//***********************>>>ADDRESSING MODES<<<*************************
+//every instr is run as EA_<mode> followed by INSTR_<mnemonic>(mode,length),
+//both pasted together from its line in opcodes.def
+//
+//EA_<mode> works out the addr the instr operates on into ea, if it has one
+//READ_<mode> gets the operand, WRITE_<mode>(val) puts a result back where it came from
+#define EA_NONE
+#define EA_IMPLIED
+#define EA_ACCUM
+#define EA_IMMEDIATE
+#define EA_Z_PAGE ea = ZP_DIRECT_ACCESS
+#define EA_Z_PAGE_X ea = ZP_INDEXED_X_ACCESS
+#define EA_Z_PAGE_Y ea = ZP_INDEXED_Y_ACCESS
+#define EA_IND_X ea = PRE_INDEXED_X_INDIRECT_ACCESS
+#define EA_IND_Y ea = POST_INDEXED_Y_INDIRECT_ACCESS
+#define EA_ABS_X ea = ABSOLUTE_INDEXED_X_ACCESS
+#define EA_ABS_Y ea = ABSOLUTE_INDEXED_Y_ACCESS
+#define EA_ABSOLUTE ea = EXTENDED_DIRECT_ACCESS
+#define EA_INDIRECT ea = ABSOLUTE_INDIRECT_JMP_ACCESS
+#define EA_RELATIVE ea = REG_PC + 2 + (signed char)(IMMIDIATE_ACCESS) //where the branch goes if taken
+
+#define READ_ACCUM REG_A
+#define READ_IMMEDIATE IMMIDIATE_ACCESS
+#define READ_Z_PAGE MEM_READ(ea)
+#define READ_Z_PAGE_X MEM_READ(ea)
+#define READ_Z_PAGE_Y MEM_READ(ea)
+#define READ_IND_X MEM_READ(ea)
+#define READ_IND_Y MEM_READ(ea)
+#define READ_ABS_X MEM_READ(ea)
+#define READ_ABS_Y MEM_READ(ea)
+#define READ_ABSOLUTE MEM_READ(ea)
+
+#define WRITE_ACCUM(val) REG_A = (val)
+#define WRITE_Z_PAGE(val) write_mem(emu,ea,(val))
+#define WRITE_Z_PAGE_X(val) write_mem(emu,ea,(val))
+#define WRITE_Z_PAGE_Y(val) write_mem(emu,ea,(val))
+#define WRITE_IND_X(val) write_mem(emu,ea,(val))
+#define WRITE_IND_Y(val) write_mem(emu,ea,(val))
+#define WRITE_ABS_X(val) write_mem(emu,ea,(val))
+#define WRITE_ABS_Y(val) write_mem(emu,ea,(val))
+#define WRITE_ABSOLUTE(val) write_mem(emu,ea,(val))
+
+//push/pull a byte on the stack; remember that stack grows down
+#define PUSH(val) \
+	write_mem(emu,generate_addr(REG_S, STACK_HIGH_ADDR),(val)); \
+	REG_S-=1
+
+#define PULL(dest) \
+	REG_S+=1; \
+	dest = MEM_READ(generate_addr(REG_S, STACK_HIGH_ADDR) )
+
+
+//***********************>>>CYCLES<<<*************************
+#ifdef ENABLE_CYCLE_COUNT
+//each opcode's columns of opcodes.def, for the fused sequences, which only have its opcode
+enum {
+	#define OPCODE_DESC(code,mnemonic,mode,length,cycles,penalty) \
+		BASE_CYCLES_##code = cycles, PAGE_PENALTY_##code = penalty,
+	#include "opcodes.def"
+	#undef OPCODE_DESC
+};
+
+//1 if indexing took ea into the next page; the 6502 takes a cycle to fix up the high byte
+#define PAGE_CROSSED(index) ((ea ^ (unsigned short)(ea - (index))) > 0xFF)
+#define PAGE_CROSSED_NONE 0
+#define PAGE_CROSSED_IMPLIED 0
+#define PAGE_CROSSED_ACCUM 0
+#define PAGE_CROSSED_IMMEDIATE 0
+#define PAGE_CROSSED_Z_PAGE 0
+#define PAGE_CROSSED_Z_PAGE_X 0
+#define PAGE_CROSSED_Z_PAGE_Y 0
+#define PAGE_CROSSED_IND_X 0
+#define PAGE_CROSSED_IND_Y PAGE_CROSSED(REG_Y)
+#define PAGE_CROSSED_ABS_X PAGE_CROSSED(REG_X)
+#define PAGE_CROSSED_ABS_Y PAGE_CROSSED(REG_Y)
+#define PAGE_CROSSED_ABSOLUTE 0
+#define PAGE_CROSSED_INDIRECT 0
+#define PAGE_CROSSED_RELATIVE 0 //branches count their own, see BRANCH_IF
+
+//counts an instr's cycles, once ea is worked out and before it runs
+#define INSTR_CYCLES(code,mode) \
+	emu->cycles += BASE_CYCLES_##code + (PAGE_PENALTY_##code && PAGE_CROSSED_##mode)
+
+//a taken branch takes 1 more, and another if it lands in a different page than the next instr
+#define BRANCH_CYCLES(len) \
+	emu->cycles += 1 + ((ea ^ (unsigned short)(REG_PC + (len))) > 0xFF)
+
+//for an instr that stops the run instead of running
+#define UNCOUNT_CYCLES(code) emu->cycles -= BASE_CYCLES_##code
+
+//whether run_program has any cycles left to start another instr with
+#define CYCLE_BUDGET_LEFT (emu->cycles < emu->cycle_limit)
+#else
+#define INSTR_CYCLES(code,mode)
+#define BRANCH_CYCLES(len)
+#define UNCOUNT_CYCLES(code)
+#define CYCLE_BUDGET_LEFT 1
+#endif
+
+
+//***********************>>>INTERRUPTS<<<*************************
+#ifdef ENABLE_INTERRUPTS
+//stops the cpu once the instr it's on is done, so start_run can take an interrupt
+static void end_slice( em6502 *emu )
+{
+	emu->cycle_limit = emu->cycles;
 
-				//affects s,z flags
-				TEST_AND_SET_ZERO(emu->P, emu->Acc);
-				TEST_AND_SET_NEG(emu->P, emu->Acc);
-				break;
+	#ifdef ENABLE_DYNAREC
+	//and stops the block it's in
+	emu->dynarec_stale = 1;
+	#endif
+}
 
-			case 0xA8: //TAY : Y<- A, s,z flags affected
-				emu->Y = emu->Acc;
+//after an instr that can clear I; if a device is holding IRQ, it gets taken right after
+#define IRQ_UNMASKED \
+	if ( emu->irq_lines != 0 && !(IRQ_DISABLE_GET(REG_P)) ) end_slice(emu)
+#else
+#define IRQ_UNMASKED
+#endif
+
+
+//how the instrs below set and test N/Z/C/V
+#ifdef ENABLE_LAZY_FLAGS
+//they just store what the flags come from, see ENABLE_LAZY_FLAGS
+#define SET_NZ(val) emu->flag_n = emu->flag_z = (val)
+#define SET_Z_N(zval,nval) emu->flag_z = (zval); emu->flag_n = (nval)
+#define SET_C(bit) emu->flag_c = (bit)
+#define SET_C_ADDITION(ch1,ch2) emu->flag_c = (int)(ch1) + (int)(ch2) > 0xFF
+#define SET_C_SUBTRACTION(ch1,ch2) emu->flag_c = (ch1) >= (ch2)
+//same results as TEST_AND_SET_V_OVERFLOW_*, without the branches: like-signed operands
+//(unlike for subtraction) whose result has the other sign
+#define SET_V_ADDITION(ch1,ch2) emu->flag_v = ~((ch1) ^ (ch2)) & ((ch1) ^ (unsigned char)((ch1) + (ch2)))
+#define SET_V_SUBTRACTION(ch1,ch2) emu->flag_v = ((ch1) ^ (ch2)) & ((ch1) ^ (unsigned char)((ch1) - (ch2)))
+#define SET_V_BIT6(val) emu->flag_v = (val) << 1
+#define SET_V(bit) emu->flag_v = (bit) << 7
+
+#define FLAG_N (emu->flag_n & 0x80)
+#define FLAG_Z (emu->flag_z == 0)
+#define FLAG_C (emu->flag_c)
+#define FLAG_V (emu->flag_v & 0x80)
+
+//before/after anything that uses P as a whole
+#define FLAGS_TO_P PACK_FLAGS(emu, REG_P)
+#define FLAGS_FROM_P UNPACK_FLAGS(emu, REG_P)
+#else
+#define SET_NZ(val) TEST_AND_SET_ZERO(REG_P, val); TEST_AND_SET_NEG(REG_P, val)
+#define SET_Z_N(zval,nval) TEST_AND_SET_ZERO(REG_P, zval); TEST_AND_SET_NEG(REG_P, nval)
+#define SET_C(bit) if (((int)(bit)) == 0x00) CARRY_CLEAR(REG_P); else CARRY_SET(REG_P)
+#define SET_C_ADDITION(ch1,ch2) TEST_AND_SET_CARRY_ADDITION(REG_P, ch1, ch2)
+#define SET_C_SUBTRACTION(ch1,ch2) TEST_AND_SET_CARRY_SUBTRACTION(REG_P, ch1, ch2)
+#define SET_V_ADDITION(ch1,ch2) TEST_AND_SET_V_OVERFLOW_ADDITION(REG_P, ch1, ch2)
+#define SET_V_SUBTRACTION(ch1,ch2) TEST_AND_SET_V_OVERFLOW_SUBTRACTION(REG_P, ch1, ch2)
+#define SET_V_BIT6(val) TEST_SIXTH_MEMORY_BIT(REG_P, val)
+#define SET_V(bit) if (((int)(bit)) == 0x00) OVERFLOW_CLEAR(REG_P); else OVERFLOW_SET(REG_P)
+
+#define FLAG_N (NEG_GET(REG_P))
+#define FLAG_Z (ZERO_GET(REG_P))
+#define FLAG_C (CARRY_GET(REG_P))
+#define FLAG_V (OVERFLOW_GET(REG_P))
+
+#define FLAGS_TO_P
+#define FLAGS_FROM_P
+#endif
+
+#ifdef ENABLE_ALU_TABLES
+//everything that just sets N and Z looks them up; ADC, SBC, CMP and the shifts
+//look up the whole thing, see below
+#undef SET_NZ
+#define SET_NZ(val) REG_P = (REG_P & ~ALU_NZ) | alu_nz[(unsigned char)(val)]
+
+//puts the flags of an entry in P
+#define SET_ALU_FLAGS(mask,flags) REG_P = (REG_P & ~(mask)) | (flags)
+#endif
+
+//***********************>>>LD* INSTRUCTIONS<<<*************************
+//LD* data : reg<- data, affects s,z flags
+#define LOAD_REG(reg,mode,len) \
+	reg = READ_##mode; \
+	REG_PC+=len; \
+	SET_NZ(reg)
+
+#define INSTR_LDA(mode,len) LOAD_REG(REG_A,mode,len)
+#define INSTR_LDX(mode,len) LOAD_REG(REG_X,mode,len)
+#define INSTR_LDY(mode,len) LOAD_REG(REG_Y,mode,len)
+
+//***********************>>>ST* INSTRUCTIONS<<<*************************
+//ST* addr : [addr]<- reg, no flags affected
+#define STORE_REG(reg,mode,len) \
+	WRITE_##mode(reg); \
+	REG_PC+=len
+
+#define INSTR_STA(mode,len) STORE_REG(REG_A,mode,len)
+#define INSTR_STX(mode,len) STORE_REG(REG_X,mode,len)
+#define INSTR_STY(mode,len) STORE_REG(REG_Y,mode,len)
+
+//***********************>>>FLAG INSTRUCTIONS<<<*************************
+#define INSTR_CLC(mode,len) SET_C(0); REG_PC+=len
+#define INSTR_CLD(mode,len) DECIMAL_MODE_CLEAR(REG_P); REG_PC+=len
+#define INSTR_CLV(mode,len) SET_V(0); REG_PC+=len
+#define INSTR_SEC(mode,len) SET_C(1); REG_PC+=len
+#define INSTR_SED(mode,len) DECIMAL_MODE_SET(REG_P); REG_PC+=len
+
+//clear/set interrupts; clearing them lets in an IRQ that's being held, see IRQ_UNMASKED
+#define INSTR_CLI(mode,len) IRQ_DISABLE_CLEAR(REG_P); IRQ_UNMASKED; REG_PC+=len
+#define INSTR_SEI(mode,len) IRQ_DISABLE_SET(REG_P); REG_PC+=len
+
+//***********************>>>ADC INSTRUCTIONS<<<*************************
+//ADC addr : A<- A + M + C, affects s,z,c,v flags
+#ifdef ENABLE_ALU_TABLES
+#define INSTR_ADC(mode,len) \
+	alu = alu_adc[FLAG_C][REG_A][READ_##mode]; \
+	REG_A = ALU_RESULT(alu); \
+	REG_PC+=len; \
+	SET_ALU_FLAGS(ALU_NZCV, ALU_FLAGS(alu))
+#else
+#define INSTR_ADC(mode,len) \
+	ch1 = REG_A; \
+	ch2 = READ_##mode; \
+	REG_A = (ch1 + ch2) + (unsigned char)(FLAG_C); \
+	REG_PC+=len; \
+	SET_NZ(REG_A) ; \
+	SET_C_ADDITION(ch1, ch2) ; \
+	SET_V_ADDITION(ch1, ch2)
+#endif
+
+//***********************>>>SBC INSTRUCTIONS<<<*************************
+//SBC addr : A<- A - M - C', affects s,z,c,v flags
+#ifdef ENABLE_ALU_TABLES
+#define INSTR_SBC(mode,len) \
+	alu = alu_sbc[FLAG_C][REG_A][READ_##mode]; \
+	REG_A = ALU_RESULT(alu); \
+	REG_PC+=len; \
+	SET_ALU_FLAGS(ALU_NZCV, ALU_FLAGS(alu))
+#else
+#define INSTR_SBC(mode,len) \
+	ch1 = REG_A; \
+	ch2 = READ_##mode + ((unsigned char)1 - (unsigned char)(FLAG_C)); \
+	REG_A = (ch1 - ch2); \
+	REG_PC+=len; \
+	SET_NZ(REG_A) ; \
+	SET_C_SUBTRACTION(ch1, ch2) ; \
+	SET_V_SUBTRACTION(ch1, ch2)
+#endif
+
+//***********************>>>AND/EOR/ORA INSTRUCTIONS<<<*************************
+//A<- A op M, affects s,z flags
+#define LOGIC_OP(op,mode,len) \
+	REG_A = REG_A op READ_##mode; \
+	REG_PC+=len; \
+	SET_NZ(REG_A)
+
+#define INSTR_AND(mode,len) LOGIC_OP(&,mode,len)
+#define INSTR_EOR(mode,len) LOGIC_OP(^,mode,len)
+#define INSTR_ORA(mode,len) LOGIC_OP(|,mode,len)
+
+//***********************>>>BIT INSTRUCTIONS<<<*************************
+//BIT addr : A AND [addr], sets s,z,v flags only
+#define INSTR_BIT(mode,len) \
+	ch1 = READ_##mode; \
+	SET_Z_N((unsigned char)(REG_A & ch1), ch1); \
+	SET_V_BIT6(ch1); \
+	REG_PC+=len
+
+//***********************>>>CMP/CPX/CPY INSTRUCTIONS<<<*************************
+//reg - M, sets s,z,c flags only
+#ifdef ENABLE_ALU_TABLES
+#define COMPARE_REG(reg,mode,len) \
+	ch1 = alu_cmp[reg][READ_##mode]; \
+	REG_PC+=len; \
+	SET_ALU_FLAGS(ALU_NZC, ch1)
+#else
+#define COMPARE_REG(reg,mode,len) \
+	ch1 = reg; \
+	ch2 = READ_##mode; \
+	res = ch1 - ch2; \
+	REG_PC+=len; \
+	SET_NZ(res) ; \
+	SET_C_SUBTRACTION(ch1, ch2)
+#endif
+
+#define INSTR_CMP(mode,len) COMPARE_REG(REG_A,mode,len)
+#define INSTR_CPX(mode,len) COMPARE_REG(REG_X,mode,len)
+#define INSTR_CPY(mode,len) COMPARE_REG(REG_Y,mode,len)
+
+//***********************>>>INC/DEC INSTRUCTIONS<<<*************************
+//[addr]<- [addr] +/- 1, affects s,z flags
+#define STEP_MEM(op,mode,len) \
+	ch1 = READ_##mode op 1; \
+	WRITE_##mode(ch1); \
+	REG_PC+=len; \
+	SET_NZ(ch1)
+
+#define INSTR_INC(mode,len) STEP_MEM(+,mode,len)
+#define INSTR_DEC(mode,len) STEP_MEM(-,mode,len)
+
+//***********************>>>DEX/DEY/INX/INY INSTRUCTIONS<<<*************************
+//reg<- reg +/- 1, affects s,z flags
+#define STEP_REG(reg,op,len) \
+	reg = reg op (unsigned char)1; \
+	REG_PC+=len; \
+	SET_NZ(reg)
+
+#define INSTR_DEX(mode,len) STEP_REG(REG_X,-,len)
+#define INSTR_DEY(mode,len) STEP_REG(REG_Y,-,len)
+#define INSTR_INX(mode,len) STEP_REG(REG_X,+,len)
+#define INSTR_INY(mode,len) STEP_REG(REG_Y,+,len)
+
+//***********************>>>T** INSTRUCTIONS<<<*************************
+//dest<- src, s,z flags affected
+#define TRANSFER_REG(dest,src,len) \
+	dest = src; \
+	REG_PC+=len; \
+	SET_NZ(dest)
+
+#define INSTR_TAX(mode,len) TRANSFER_REG(REG_X,REG_A,len)
+#define INSTR_TAY(mode,len) TRANSFER_REG(REG_Y,REG_A,len)
+#define INSTR_TSX(mode,len) TRANSFER_REG(REG_X,REG_S,len)
+#define INSTR_TXA(mode,len) TRANSFER_REG(REG_A,REG_X,len)
+#define INSTR_TYA(mode,len) TRANSFER_REG(REG_A,REG_Y,len)
+
+//TXS : S<- X, no flags affected
+#define INSTR_TXS(mode,len) REG_S = REG_X; REG_PC+=len
+
+//***********************>>>ASL/LSR/ROL/ROR INSTRUCTIONS<<<*************************
+#ifdef ENABLE_ALU_TABLES
+//the result and flags come out of the table, given what gets shifted in
+#define SHIFT_OP(table,mode,len) \
+	alu = table[READ_##mode]; \
+	WRITE_##mode(ALU_RESULT(alu)); \
+	REG_PC+=len; \
+	SET_ALU_FLAGS(ALU_NZC, ALU_FLAGS(alu))
+
+#define INSTR_ASL(mode,len) SHIFT_OP(alu_asl,mode,len)
+#define INSTR_LSR(mode,len) SHIFT_OP(alu_lsr,mode,len)
+#define INSTR_ROL(mode,len) SHIFT_OP(alu_rol[FLAG_N ? 1 : 0][FLAG_C],mode,len)
+#define INSTR_ROR(mode,len) SHIFT_OP(alu_ror[FLAG_C],mode,len)
+#else
+//ASL addr : shifts left, sets s,z flags, shifts to c flag
+#define INSTR_ASL(mode,len) \
+	ch1 = READ_##mode; \
+	ch2 = (((int)(NEG_GET(ch1))) == 0x00)?0:1; \
+	ch1 = ch1 << 1; \
+	CARRY_CLEAR(ch1); \
+	SET_C(ch2); \
+	WRITE_##mode(ch1); \
+	REG_PC+=len; \
+	SET_NZ(ch1)
+
+//LSR addr : shifts right, sets z flag, clears n flag, shifts to c flag
+#define INSTR_LSR(mode,len) \
+	ch1 = READ_##mode; \
+	ch2 = (((int)(CARRY_GET(ch1))) == 0x00)?0:1; \
+	ch1 = ch1 >> 1; \
+	NEG_CLEAR(ch1); \
+	SET_C(ch2); \
+	WRITE_##mode(ch1); \
+	REG_PC+=len; \
+	SET_NZ(ch1)
+
+//ROL addr : rotated left through c flag, sets s,z flags
+#define INSTR_ROL(mode,len) \
+	ch1 = READ_##mode; \
+	ch2 = (((int)(FLAG_N)) == 0x00)?0:1; \
+	res = (((int)(FLAG_C)) == 0x00)?0:1; \
+	ch1 = ch1 << 1; \
+	SET_C(ch2); \
+	if (((int)(res)) == 0x00)CARRY_CLEAR(ch1); \
+	else CARRY_SET(ch1); \
+	WRITE_##mode(ch1); \
+	REG_PC+=len; \
+	SET_NZ(ch1)
+
+//ROR addr : rotated right through c flag, sets s,z flags
+#define INSTR_ROR(mode,len) \
+	ch1 = READ_##mode; \
+	ch2 = (((int)(CARRY_GET(ch1))) == 0x00)?0:1; \
+	res = (((int)(FLAG_C)) == 0x00)?0:1; \
+	ch1 = ch1 >> 1; \
+	SET_C(ch2); \
+	if (((int)(res)) == 0x00)NEG_CLEAR(ch1); \
+	else NEG_SET(ch1); \
+	WRITE_##mode(ch1); \
+	REG_PC+=len; \
+	SET_NZ(ch1)
+#endif
+
+//a jump back to target might close a loop that does nothing; if so, idle_loop_skip
+//counts as many of its iterations as the budget has room for, and they're done
+#ifdef ENABLE_IDLE_SKIP
+#define IDLE_CHECK(target) \
+	if ( (target) <= REG_PC ) \
+	{ \
+		FLAGS_TO_P; \
+		SPILL_REGS; \
+		max_instr_count -= idle_loop_skip(emu, target, REG_PC, max_instr_count); \
+	}
+#else
+#define IDLE_CHECK(target)
+#endif
+
+//***********************>>>JMP INSTRUCTIONS<<<*************************
+//JMP addr : PC<- addr16 or [addr16], no flags affected
+#define INSTR_JMP(mode,len) \
+	IDLE_CHECK(ea); \
+	REG_PC = ea
+
+//***********************>>>B** INSTRUCTIONS<<<*************************
+//B** addr : cond-> PC+= addr+2, else PC+=2, no flags affected
+#define BRANCH_IF(cond,len) \
+	if ( cond ) { BRANCH_CYCLES(len); IDLE_CHECK(ea); REG_PC = ea; } \
+	else REG_PC+=len
+
+#define INSTR_BCC(mode,len) BRANCH_IF( (int)(FLAG_C) == 0x00, len )
+#define INSTR_BCS(mode,len) BRANCH_IF( (int)(FLAG_C) != 0x00, len )
+#define INSTR_BEQ(mode,len) BRANCH_IF( (int)(FLAG_Z) != 0x00, len )
+#define INSTR_BMI(mode,len) BRANCH_IF( (int)(FLAG_N) != 0x00, len )
+#define INSTR_BNE(mode,len) BRANCH_IF( (int)(FLAG_Z) == 0x00, len )
+#define INSTR_BPL(mode,len) BRANCH_IF( (int)(FLAG_N) == 0x00, len )
+#define INSTR_BVC(mode,len) BRANCH_IF( (int)(FLAG_V) == 0x00, len )
+#define INSTR_BVS(mode,len) BRANCH_IF( (int)(FLAG_V) != 0x00, len )
+
+//***********************>>>STACK INSTRUCTIONS<<<*************************
+//PHA/PHP : [stack]<- reg, stack<- stack - 1, affects no flags
+#define INSTR_PHA(mode,len) PUSH(REG_A); REG_PC+=len
+#define INSTR_PHP(mode,len) FLAGS_TO_P; PUSH(REG_P); REG_PC+=len
+
+//PLA : stack<- stack + 1, Acc<- [stack], affects s,z flags
+#define INSTR_PLA(mode,len) \
+	PULL(REG_A); \
+	REG_PC+=len; \
+	SET_NZ(REG_A)
+
+//PLP : stack<- stack + 1, P<- [stack]
+#define INSTR_PLP(mode,len) PULL(REG_P); FLAGS_FROM_P; IRQ_UNMASKED; REG_PC+=len
+
+//***********************>>>NOP INSTRUCTIONS<<<*************************
+#define INSTR_NOP(mode,len) REG_PC+=len
+
+//***********************>>>BRK INSTRUCTIONS<<<*************************
+//BRK : programmed interrupt
+//pushes PC+2 (the 2nd byte of the instr is the interrupt signature) and P with the break flag set,
+//disables interrupts then jumps to the isr, which for historic reasons is at [0xFFFF,0xFFFE]
+//with stop_at_brk set, the run stops at it instead, like the end of the program
+#define INSTR_BRK(mode,len) \
+	if ( emu->stop_at_brk ) { UNCOUNT_CYCLES(0x00); STOP_RUN(STOP_BRK); } \
+	PUSH(((REG_PC)+2) >> 8); \
+	PUSH((REG_PC)+2); \
+	FLAGS_TO_P; \
+	BRK_SET(REG_P); \
+	PUSH(REG_P); \
+	IRQ_DISABLE_SET(REG_P); \
+	REG_PC = generate_addr( \
+			MEM_READ(generate_addr( ISR_LOW_ADDR, ISR_HIGH_ADDR ) ), \
+			MEM_READ(generate_addr( ISR_HIGH_ADDR, ISR_HIGH_ADDR ) ) \
+	)
+
+//***********************>>>RTI INSTRUCTIONS<<<*************************
+//RTI : return from interrupt
+//pulls P then PC; this does not mess with IRQ status, whatever it was when it
+//was pushed is what comes out. if you want to change it, the isr must modify it on the stack
+#define INSTR_RTI(mode,len) \
+	PULL(REG_P); \
+	FLAGS_FROM_P; \
+	IRQ_UNMASKED; \
+	REG_S+=1; \
+	REG_PC = generate_addr( \
+			MEM_READ(generate_addr(REG_S, STACK_HIGH_ADDR) ), \
+			MEM_READ(generate_addr((REG_S)+1, STACK_HIGH_ADDR) ) \
+	); \
+	REG_S+=1
+
+//***********************>>>JSR INSTRUCTIONS<<<*************************
+//JSR addr16 : jump to subroutine
+//pushes the addr of the 3rd byte of the JSR instr, no flags affected
+#define INSTR_JSR(mode,len) \
+	PUSH(((REG_PC)+2) >> 8); \
+	PUSH((REG_PC)+2); \
+	REG_PC = ea
+
+//***********************>>>RTS INSTRUCTIONS<<<*************************
+//RTS : return from subroutine
+//pulls the addr JSR pushed, then moves past it
+#define INSTR_RTS(mode,len) \
+	REG_S+=1; \
+	REG_PC = generate_addr( \
+			MEM_READ(generate_addr(REG_S, STACK_HIGH_ADDR) ), \
+			MEM_READ(generate_addr((REG_S)+1, STACK_HIGH_ADDR) ) \
+	); \
+	REG_S+=1; \
+	REG_PC+=1
+
+//opcodes the 6502 doesnt have
+#define INSTR_INVALID(mode,len) STOP_RUN(STOP_INVALID_OPCODE)
 
-				emu->PC+=1;
 
-				//affects s,z flags
-				TEST_AND_SET_ZERO(emu->P, emu->Y);
-				TEST_AND_SET_NEG(emu->P, emu->Y);
-				break;
+/**************************************
+ * Name:  run_slice
+ * Inputs:  em6502 * - the 6502 object to execute
+ *				unsigned int - max number of instructions to execute, -1 for all
+ * Outputs: int - why it stopped, one of STOP_*
+ * Function: runs the cpu on the engine the emulator is set to, until it runs out
+ *			 of instrs or gets to cycle_limit
+ *
+***************************************/
+static int run_slice( em6502 *emu, unsigned int max_instr_count )
+{
+	int stop;
 
-			case 0x98: //TYA : A<- Y, s,z flags affected
-				emu->Acc = emu->Y;
+	#ifdef ENABLE_IDLE_SKIP
+	//memory might have been changed since the last call, so no loop is known to be idle
+	emu->idle.seen = 0;
+	#endif
 
-				emu->PC+=1;
+	#ifdef ENABLE_LAZY_FLAGS
+	UNPACK_FLAGS(emu, emu->P);
+	#endif
 
-				//affects s,z flags
-				TEST_AND_SET_ZERO(emu->P, emu->Acc);
-				TEST_AND_SET_NEG(emu->P, emu->Acc);
-				break;
+	#ifdef ENABLE_DYNAREC
+	if ( emu->engine == ENGINE_DYNAREC )
+	{
+		stop = run_dynarec(emu, max_instr_count);
+	}
+	else
+	#endif
+	{
+		stop = run_interpreter(emu, max_instr_count);
+	}
 
-			case 0xBA: //TSX : X<- S, s,z flags affected
-				emu->X = emu->S;
+	#ifdef ENABLE_LAZY_FLAGS
+	PACK_FLAGS(emu, emu->P);
+	#endif
 
-				emu->PC+=1;
+	return stop;
+}
 
-				//affects s,z flags
-				TEST_AND_SET_ZERO(emu->P, emu->X);
-				TEST_AND_SET_NEG(emu->P, emu->X);
-				break;
 
-			case 0x9A: //TXS : S<- X, no flags affected
-				emu->S = emu->X;
+#ifdef ENABLE_INTERRUPTS
+/**************************************
+ * Name:  interrupt
+ * Inputs:  em6502 * - the 6502 object
+ *				unsigned char - low byte of the addr of the vector, in the ISR's page
+ * Outputs: None
+ * Function: pushes PC and P, the way BRK does but with the break flag clear so
+ *			 the isr can tell them apart, disables interrupts and jumps through the vector
+ *
+***************************************/
+static void interrupt( em6502 *emu, unsigned char vector )
+{
+	PUSH(REG_PC >> 8);
+	PUSH(REG_PC);
+	PUSH(REG_P & 0xEF);
+	IRQ_DISABLE_SET(REG_P);
+	REG_PC = generate_addr(
+			read_mem(emu, generate_addr( vector, ISR_HIGH_ADDR ) ),
+			read_mem(emu, generate_addr( vector + 1, ISR_HIGH_ADDR ) )
+	);
+
+	emu->cycles += 7;
+}
 
-				emu->PC+=1;
 
-				//no flags affected
-				break;
+/**************************************
+ * Name:  take_interrupts
+ * Inputs:  em6502 * - the 6502 object
+ * Outputs: None
+ * Function: takes whichever interrupt is up, if any; RESET first, then NMI, then IRQ
+ *
+***************************************/
+static void take_interrupts( em6502 *emu )
+{
+	if ( emu->pending_interrupts & INTERRUPT_RESET )
+	{
+		//it goes through the motions of an interrupt, but the stack writes dont happen
+		emu->pending_interrupts = 0;
+		REG_S -= 3;
+		IRQ_DISABLE_SET(REG_P);
+		REG_PC = generate_addr(
+				read_mem(emu, generate_addr( RESET_VECTOR_LOW_ADDR, ISR_HIGH_ADDR ) ),
+				read_mem(emu, generate_addr( RESET_VECTOR_LOW_ADDR + 1, ISR_HIGH_ADDR ) )
+		);
+		emu->cycles += 7;
+	}
+	else if ( emu->pending_interrupts & INTERRUPT_NMI )
+	{
+		emu->pending_interrupts &= ~INTERRUPT_NMI;
+		interrupt(emu, NMI_VECTOR_LOW_ADDR);
+	}
+	else if ( emu->irq_lines != 0 && !(IRQ_DISABLE_GET(REG_P)) )
+	{
+		interrupt(emu, ISR_LOW_ADDR);
+	}
+}
 
 
-			//***********************>>>DEX INSTRUCTIONS<<<*************************
-			case 0xCA: //DEX : X<- X - 1
-				emu->X = emu->X - (unsigned char)1;
+/**************************************
+ * Name:  set_irq
+ * Inputs:  em6502 * - the 6502 object
+ *				unsigned int - which device's IRQ output, 0-31
+ *				int - 1 to hold IRQ, 0 to let go of it
+ * Outputs: None
+ * Function: IRQ is level triggered; while any device holds it and I is clear, the cpu
+ *			 takes it through the vector at $FFFE, once the instr it's on is done
+ *
+***************************************/
+void set_irq( em6502 *emu, unsigned int line, int level )
+{
+	if ( level )
+	{
+		emu->irq_lines |= 1u << line;
+		if ( !(IRQ_DISABLE_GET(emu->P)) )
+		{
+			end_slice(emu);
+		}
+	}
+	else
+	{
+		emu->irq_lines &= ~(1u << line);
+	}
+}
 
-				emu->PC+=1;
-				//affects s,z flags
-				TEST_AND_SET_ZERO(emu->P, emu->X) ;
-				TEST_AND_SET_NEG(emu->P, emu->X) ;
-				break;
 
+/**************************************
+ * Name:  set_nmi
+ * Inputs:  em6502 * - the 6502 object
+ *				int - 1 to hold NMI, 0 to let go of it
+ * Outputs: None
+ * Function: NMI is edge triggered; it gets taken through the vector at $FFFA once
+ *			 each time it goes from 0 to 1, whatever I is, once the instr it's on is done
+ *
+***************************************/
+void set_nmi( em6502 *emu, int level )
+{
+	if ( level && !emu->nmi_line )
+	{
+		emu->pending_interrupts |= INTERRUPT_NMI;
+		end_slice(emu);
+	}
 
-			//***********************>>>DEY INSTRUCTIONS<<<*************************
-			case 0x88: //DEY : Y<- Y - 1
-				emu->Y = emu->Y - (unsigned char)1;
+	emu->nmi_line = (level != 0);
+}
 
-				emu->PC+=1;
-				//affects s,z flags
-				TEST_AND_SET_ZERO(emu->P, emu->Y) ;
-				TEST_AND_SET_NEG(emu->P, emu->Y) ;
-				break;
 
-			//***********************>>>INX INSTRUCTIONS<<<*************************
-			case 0xE8: //INX : X<- X + 1
-				emu->X = emu->X + (unsigned char)1;
+/**************************************
+ * Name:  trigger_reset
+ * Inputs:  em6502 * - the 6502 object
+ * Outputs: None
+ * Function: pulses RESET; once the instr it's on is done, the cpu drops S by 3, sets I
+ *			 and starts over from the vector at $FFFC. Memory and the other registers
+ *			 are left alone, unlike reset_em6502
+ *
+***************************************/
+void trigger_reset( em6502 *emu )
+{
+	emu->pending_interrupts |= INTERRUPT_RESET;
+	end_slice(emu);
+}
+#endif
 
-				emu->PC+=1;
-				//affects s,z flags
-				TEST_AND_SET_ZERO(emu->P, emu->X) ;
-				TEST_AND_SET_NEG(emu->P, emu->X) ;
-				break;
 
+/**************************************
+ * Name:  start_run
+ * Inputs:  em6502 * - the 6502 object to execute
+ *				unsigned int - max number of instructions to execute, -1 for all
+ * Outputs: int - why it stopped, one of STOP_*
+ * Function: executes the previosuly loaded program, until it runs out of instrs
+ *			 or gets to cycle_limit; with events scheduled, the cpu gets stopped at
+ *			 each one to run it, and then carries on
+ *
+***************************************/
+static int start_run( em6502 *emu, unsigned int max_instr_count )
+{
+	int stop;
+	#ifdef ENABLE_EVENTS
+	unsigned long long cycle_limit = emu->cycle_limit;
+	#ifdef ALLOW_MAX_INSTR_COUNT
+	unsigned int instr_count;
+	#endif
+	#endif
 
-			//***********************>>>INY INSTRUCTIONS<<<*************************
-			case 0xC8: //INY : Y<- Y + 1
-				emu->Y = emu->Y + (unsigned char)1;
+	//if we stopped at a breakpoint last time, this is the instr at it
+	emu->resume_pc = emu->PC;
+	emu->resume = 1;
 
-				emu->PC+=1;
-				//affects s,z flags
-				TEST_AND_SET_ZERO(emu->P, emu->Y) ;
-				TEST_AND_SET_NEG(emu->P, emu->Y) ;
-				break;
+	#ifdef ENABLE_EVENTS
+	while ( 1 )
+	{
+		run_due_events(emu);
 
+		#ifdef ENABLE_INTERRUPTS
+		take_interrupts(emu);
+		#endif
 
-			//***********************>>>PHA INSTRUCTIONS<<<*************************
-			case 0x48:  //PHA : [stack]<- Acc, stack<- stack - 1
-				STUB_OUT_MEM_ACCESS_IFACES ;
+		emu->cycle_limit = next_event_cycle(emu);
+		if ( emu->cycle_limit > cycle_limit )
+		{
+			emu->cycle_limit = cycle_limit;
+		}
 
-				//emu->Memory[ generate_addr(emu->S, STACK_HIGH_ADDR) ] = emu->Acc;
-				write_mem(emu,generate_addr(emu->S, STACK_HIGH_ADDR),emu->Acc);
+		#ifdef ALLOW_MAX_INSTR_COUNT
+		instr_count = emu->instr_count;
+		stop = run_slice(emu, max_instr_count);
+		max_instr_count -= emu->instr_count - instr_count;
+		if ( max_instr_count == 0 )
+		{
+			break;
+		}
+		#else
+		stop = run_slice(emu, max_instr_count);
+		#endif
 
-				emu->S-=1; //remember that stack grows down
+		//done, unless it was the next event (or an interrupt) that stopped it
+		if ( stop != STOP_BUDGET || emu->cycles >= cycle_limit )
+		{
+			break;
+		}
+	}
 
-				emu->PC+=1;
-				//affects no flags
-				break;
+	emu->cycle_limit = cycle_limit;
+	#else
+	stop = run_slice(emu, max_instr_count);
+	#endif
 
-			//***********************>>>PLA INSTRUCTIONS<<<*************************
-			case 0x68:  //PLA : Acc<- [stack], stack<- stack - 1
-				//STUB_OUT_MEM_ACCESS_IFACES ;
+	return stop;
+}
 
-				//first increment stack
-				emu->S+=1; //remember that stack grows down
 
-				emu->Acc = read_mem(emu, generate_addr(emu->S, STACK_HIGH_ADDR) );
+/**************************************
+ * Name:  run_program
+ * Inputs:  em6502 * - the 6502 object to execute
+ *				unsigned int - max number of instructions to execute, -1 for all
+ * Outputs: int - why it stopped, one of STOP_*
+ * Function: executes the previosuly loaded program, on the engine the emulator is set to
+ *
+***************************************/
+int run_program( em6502 *emu, unsigned int max_instr_count )
+{
+	#ifdef ENABLE_CYCLE_COUNT
+	emu->cycle_limit = NO_CYCLE_LIMIT;
+	#endif
 
-				emu->PC+=1;
-				//affects s,z flags
-				TEST_AND_SET_ZERO(emu->P, emu->Acc) ;
-				TEST_AND_SET_NEG(emu->P, emu->Acc) ;
-				break;
+	return start_run(emu, max_instr_count);
+}
 
-			//***********************>>>PHP INSTRUCTIONS<<<*************************
-			case 0x08:  //PHP : [stack]<- P, stack<- stack - 1
-				STUB_OUT_MEM_ACCESS_IFACES ;
 
-				//emu->Memory[ generate_addr(emu->S, STACK_HIGH_ADDR) ] = emu->P;
-				write_mem(emu,generate_addr(emu->S, STACK_HIGH_ADDR),emu->P);
+#ifdef ENABLE_CYCLE_COUNT
+/**************************************
+ * Name:  run_program_cycles
+ * Inputs:  em6502 * - the 6502 object to execute
+ *				unsigned int - max number of instructions to execute, -1 for all
+ *				unsigned long long - max number of cycles to execute
+ * Outputs: int - why it stopped, one of STOP_*
+ * Function: same as run_program, but also stops once the instrs it ran took the cycles
+ *			 it was given; the last one can go over by a few, it doesnt stop halfway through
+ *
+***************************************/
+int run_program_cycles( em6502 *emu, unsigned int max_instr_count, unsigned long long max_cycles )
+{
+	emu->cycle_limit = emu->cycles + max_cycles;
+	if ( emu->cycle_limit < emu->cycles )
+	{
+		emu->cycle_limit = NO_CYCLE_LIMIT;
+	}
 
-				emu->S-=1; //remember that stack grows down
+	return start_run(emu, max_instr_count);
+}
+#endif
+
+
+#ifdef ENABLE_REGISTER_LOCALS
+//run_interpreter keeps the registers in these locals. they only get written back to the
+//em6502 for what looks at them there; idle_loop_skip, and run_interpreter's caller once
+//it returns. fetch_decoded and the profiler just need PC. listeners only get the addr
+#undef REG_A
+#undef REG_X
+#undef REG_Y
+#undef REG_P
+#undef REG_S
+#undef REG_PC
+#define REG_A reg_a
+#define REG_X reg_x
+#define REG_Y reg_y
+#define REG_P reg_p
+#define REG_S reg_s
+#define REG_PC reg_pc
+
+#undef SPILL_REGS
+#undef SPILL_PC
+#define SPILL_REGS \
+	(emu->Acc = reg_a, emu->X = reg_x, emu->Y = reg_y, emu->P = reg_p, emu->S = reg_s, emu->PC = reg_pc)
+#define SPILL_PC (emu->PC = reg_pc)
+#endif
 
-				emu->PC+=1;
-				//affects no flags
-				break;
+/**************************************
+ * Name:  run_interpreter
+ * Inputs:  em6502 * - the 6502 object to execute
+ *				unsigned int - max number of instructions to execute, -1 for all
+ * Outputs: int - why it stopped, one of STOP_*
+ * Function: executes the previosuly loaded program, one instr at a time
+ *
+***************************************/
+int run_interpreter( em6502 *emu, unsigned int max_instr_count )
+{
+	unsigned char ch1;
+	unsigned short ea; //addr the current instr operates on
+	#ifdef ENABLE_ALU_TABLES
+	unsigned short alu; //the table entry for the current instr
+	#else
+	unsigned char ch2; //ADC/SBC/CMP and the shifts work them out bit by bit
+	unsigned char res;
+	#endif
+	int stop; //why we stopped, one of STOP_*
+
+	#ifdef ENABLE_REGISTER_LOCALS
+	unsigned char reg_a = emu->Acc;
+	unsigned char reg_x = emu->X;
+	unsigned char reg_y = emu->Y;
+	unsigned char reg_p = emu->P;
+	unsigned char reg_s = emu->S;
+	unsigned short reg_pc = emu->PC;
+	#endif
 
-			//***********************>>>PLP INSTRUCTIONS<<<*************************
-			case 0x28:  //PLP : P<- [stack], stack<- stack - 1
-				//STUB_OUT_MEM_ACCESS_IFACES ;
+	#ifdef ENABLE_PREDECODE_CACHE
+	decoded_instr scratch; //for instrs in pages we dont cache
+	decoded_instr *instr;
+	#endif
 
-				//first increment stack
-				emu->S+=1; //remember that stack grows down
+	#ifdef ENABLE_THREADED_DISPATCH
+	//where each opcode's code starts
+	static void *dispatch_table[NUM_HANDLERS] =
+	{
+		#define OPCODE_DESC(code,mnemonic,mode,length,cycles,penalty) [code] = &&OPCODE(code),
+		#include "opcodes.def"
+		#undef OPCODE_DESC
 
-				emu->P = read_mem(emu, generate_addr(emu->S, STACK_HIGH_ADDR) );
+		#ifdef ENABLE_PREDECODE_CACHE
+		[BREAKPOINT_HANDLER] = &&OPCODE(BREAKPOINT_HANDLER),
+		#endif
 
-				emu->PC+=1;
-				//affects all flags, they all get replaced with new values
-				//no need to set/test them right now
-				break;
-
-			//***********************>>>CLI INSTRUCTIONS<<<*************************
-			case 0x58: //CLI : clear interrupts, dont think it does anything...yet
-				STUB_OUT_INTERRUPTS_IFACES ;
-
-				//affects IRQ/interrupts flag
-				IRQ_DISABLE_CLEAR(emu->P);
-				emu->PC+=1;
-				break;
-
-			//***********************>>>SEI INSTRUCTIONS<<<*************************
-			case 0x78: //SEI : sets interrupts, dont think it does anything...yet
-				STUB_OUT_INTERRUPTS_IFACES ;
+		#ifdef ENABLE_FUSION
+		#define FUSE2(op1,m1,mode1,len1,op2,m2,mode2,len2) \
+			[FUSION_##op1##_##op2] = &&OPCODE(FUSION_##op1##_##op2),
+		#define FUSE3(op1,m1,mode1,len1,op2,m2,mode2,len2,op3,m3,mode3,len3) \
+			[FUSION_##op1##_##op2##_##op3] = &&OPCODE(FUSION_##op1##_##op2##_##op3),
+		#include "fusions.def"
+		#undef FUSE2
+		#undef FUSE3
+		#endif
+	};
 
-				//affects IRQ/interrupts flag
-				IRQ_DISABLE_SET(emu->P);
-				emu->PC+=1;
-				break;
-
-			//***********************>>>NOP INSTRUCTIONS<<<*************************
-			case 0xEA: //NOP : increments the PC by one, does nothing else
-				emu->PC+=1;
-				break;
+	//the first instr is dispatched here, every one after that by the NEXT_INSTR
+	//at the end of the instr before it
+	NEXT_INSTR_NO_COUNT;
+	#else
+	unsigned short cur_handler; //the case being run
 
-			//***********************>>>BRK INSTRUCTIONS<<<*************************
-			case 0x00: //BRK : programmed interrupt
-				STUB_OUT_INTERRUPTS_IFACES ;
-				STUB_OUT_MEM_ACCESS_IFACES ;
-
-				//increment PC by 2, push onto stack
-				//observe that the 2nd byte of the instr is the interrupt signature
+	#ifdef ALLOW_MAX_INSTR_COUNT
+		while (max_instr_count-- && CYCLE_BUDGET_LEFT)
+	#elif
+		while(CYCLE_BUDGET_LEFT)
+	#endif
+	{
+		FETCH_INSTR;
+		cur_handler = CURRENT_HANDLER;
 
-				//emu->Memory[ generate_addr(emu->S, STACK_HIGH_ADDR) ] = ((emu->PC)+2) >> 8;
-				write_mem(emu,generate_addr(emu->S, STACK_HIGH_ADDR),((emu->PC)+2) >> 8);
-				emu->S-=1;
-
-				//emu->Memory[ generate_addr(emu->S, STACK_HIGH_ADDR) ] = ((emu->PC)+2);
-				write_mem(emu,generate_addr(emu->S, STACK_HIGH_ADDR),((emu->PC)+2));
-				emu->S-=1;
-
-				//set the break flag and push onto stack
-				BRK_SET(emu->P);
-
-				//emu->Memory[ generate_addr(emu->S, STACK_HIGH_ADDR) ] = emu->P;
-				write_mem(emu,generate_addr(emu->S, STACK_HIGH_ADDR),emu->P);
-				emu->S-=1;
-
-				//disable interrupts
-				IRQ_DISABLE_SET(emu->P);
-
-				//set PC to point to ISR location
-				//for historic reasons, the isr is located at the addr [0xFFFF,0xFFFE]
-				/*
-				printf("generate_addr_1 %d\n",generate_addr(ISR_HIGH_ADDR, ISR_HIGH_ADDR) );
-				printf("generate_addr_2 %d\n",generate_addr(ISR_LOW_ADDR, ISR_HIGH_ADDR) );
-				printf("generate_addr_3 %d\n",
-					generate_addr(
-						emu->Memory[ generate_addr( ISR_LOW_ADDR, ISR_HIGH_ADDR ) ],    //low bit
-						emu->Memory[ generate_addr( ISR_HIGH_ADDR, ISR_HIGH_ADDR ) ]  //high bit
-					)
-				);
-				*/
-
-				emu->PC = generate_addr(
-						read_mem(emu, generate_addr( ISR_LOW_ADDR, ISR_HIGH_ADDR ) ),    //low bit
-						read_mem(emu, generate_addr( ISR_HIGH_ADDR, ISR_HIGH_ADDR ) )  //high bit
-				);
-				break;
-
-			//***********************>>>RTI INSTRUCTIONS<<<*************************
-			case 0x40: //RTI : return from interrupt
-				STUB_OUT_INTERRUPTS_IFACES ;
-
-				//pull old P/status register from stack
-				emu->S+=1;
-				emu->P = read_mem(emu, generate_addr(emu->S, STACK_HIGH_ADDR) );
-
-				//pull 2bytes that make up our PC from stack
-				emu->S+=1;
-				emu->PC = generate_addr(
-						read_mem(emu, generate_addr(emu->S, STACK_HIGH_ADDR) ),  //low byte
-						read_mem(emu, generate_addr((emu->S)+1, STACK_HIGH_ADDR) )  //high byte
-				);
-				emu->S+=1;
-
-				//observe that this does not mess with IRQ status
-				//whatever it was when it was pushed, that's what comes out
-				//if you want to change it, the isr must modify it on the stack
-				break;
-
-			//***********************>>>JSR INSTRUCTIONS<<<*************************
-			case 0x20: //JSR addr16 : jump to subroutine
-				STUB_OUT_INTERRUPTS_IFACES ;
-				STUB_OUT_MEM_ACCESS_IFACES ;
-
-				//implemented same as BRK except the addr of the isr is in bytes 2,3 of the instr
-				//also, no interrupts are handled in case of subroutine calls
-
-				//increment PC by 2, push onto stack
-				//PC will point to 3rd byte of JSR instr
-				//emu->Memory[ generate_addr(emu->S, STACK_HIGH_ADDR) ] = ((emu->PC)+2) >> 8;
-				write_mem(emu,generate_addr(emu->S, STACK_HIGH_ADDR),((emu->PC)+2) >> 8);
-				emu->S-=1;
-
-				//emu->Memory[ generate_addr(emu->S, STACK_HIGH_ADDR) ] = ((emu->PC)+2);
-				write_mem(emu,generate_addr(emu->S, STACK_HIGH_ADDR),((emu->PC)+2));
-				emu->S-=1;
-
-				emu->PC = generate_addr( GET_FIRST_ARG, GET_SECOND_ARG );
-
-				//no flags affected
-				break;
-
-
-			//***********************>>>RTS INSTRUCTIONS<<<*************************
-			case 0x60: //RTS : return from subroutine
-
-				//implemented same as BRK except the addr of the isr is in bytes 2,3 of the instr
-				//also, no interrupts are handled in case of subroutine calls
-
-				//pull 2bytes that make up our PC from stack
-				emu->S+=1;
-				emu->PC = generate_addr(
-						read_mem(emu, generate_addr(emu->S, STACK_HIGH_ADDR) ),  //low byte
-						read_mem(emu, generate_addr((emu->S)+1, STACK_HIGH_ADDR) )  //high byte
-				);
-				emu->S+=1;
-
-				//increment PC again because it points to 3rd byte of previous JSR instr
-				emu->PC+=1;
-				break;
-
-			default:
-				printf("error: invalid object code 0x%hhx at P=%d\n", read_mem(emu,emu->PC), emu->PC );
-				printf("with %d remaining\n", max_instr_count);
-				exit(-1);
-
-				//assert(0);
+		//process a single instruction here
+		//this defines the main logic loop that implements the instruction set for the 6502 chip
+	dispatch:
+		switch( cur_handler )
+	#endif
+		{
+			//one case per opcode, all 256 of them, built out of its line in opcodes.def
+			#define OPCODE_DESC(code,mnemonic,mode,length,cycles,penalty) \
+				OPCODE(code): \
+					EA_##mode; \
+					INSTR_CYCLES(code,mode); \
+					INSTR_##mnemonic(mode,length); \
+					NEXT_INSTR;
+			#include "opcodes.def"
+			#undef OPCODE_DESC
+
+			#ifdef ENABLE_PREDECODE_CACHE
+			//instrs with a breakpoint get decoded to this, rather than to their opcode's case
+			OPCODE(BREAKPOINT_HANDLER):
+				if ( BREAKPOINT_STOPS ) STOP_RUN(STOP_BREAKPOINT);
+				DISPATCH(instr->opcode);
+			#endif
+
+			#ifdef ENABLE_FUSION
+			//then one per fused sequence; each of its instrs runs just like in its own case,
+			//without dispatching in between
+			#define FUSE2(op1,m1,mode1,len1,op2,m2,mode2,len2) \
+				OPCODE(FUSION_##op1##_##op2): \
+					EA_##mode1; \
+					INSTR_CYCLES(op1,mode1); \
+					INSTR_##m1(mode1,len1); \
+					FUSED_NEXT(len1); \
+					EA_##mode2; \
+					INSTR_CYCLES(op2,mode2); \
+					INSTR_##m2(mode2,len2); \
+					NEXT_INSTR;
+			#define FUSE3(op1,m1,mode1,len1,op2,m2,mode2,len2,op3,m3,mode3,len3) \
+				OPCODE(FUSION_##op1##_##op2##_##op3): \
+					EA_##mode1; \
+					INSTR_CYCLES(op1,mode1); \
+					INSTR_##m1(mode1,len1); \
+					FUSED_NEXT(len1); \
+					EA_##mode2; \
+					INSTR_CYCLES(op2,mode2); \
+					INSTR_##m2(mode2,len2); \
+					FUSED_NEXT(len2); \
+					EA_##mode3; \
+					INSTR_CYCLES(op3,mode3); \
+					INSTR_##m3(mode3,len3); \
+					NEXT_INSTR;
+			#include "fusions.def"
+			#undef FUSE2
+			#undef FUSE3
+			#endif
 		}
 
-
+	#ifndef ENABLE_THREADED_DISPATCH
 		#ifdef ALLOW_MAX_INSTR_COUNT
 		  emu->instr_count++;  //each loop processes a single instruction
 		#endif
 	}
+	#endif
+
+	stop = STOP_BUDGET;
 
-	return;
+stop_run:
+	SPILL_REGS;
+	return stop;
 }
+
+
+#ifdef ENABLE_REGISTER_LOCALS
+//everything after run_interpreter works on the em6502 directly again
+#undef REG_A
+#undef REG_X
+#undef REG_Y
+#undef REG_P
+#undef REG_S
+#undef REG_PC
+#define REG_A emu->Acc
+#define REG_X emu->X
+#define REG_Y emu->Y
+#define REG_P emu->P
+#define REG_S emu->S
+#define REG_PC emu->PC
+
+#undef SPILL_REGS
+#undef SPILL_PC
+#define SPILL_REGS
+#define SPILL_PC
+#endif
+
+
+#ifdef ENABLE_DYNAREC
+//the handlers the dynarec's translated blocks call, one per opcode
+//these are the same instrs as in run_interpreter, except the operand comes in
+//as an argument; it was decoded back when the block was translated
+#undef GET_FIRST_ARG
+#undef GET_SECOND_ARG
+#undef GET_ADDR_ARG
+#define GET_FIRST_ARG ((unsigned char)operand)
+#define GET_SECOND_ARG ((unsigned char)(operand >> 8))
+#define GET_ADDR_ARG operand
+
+//invalid opcodes and BRK are never translated, so nothing here stops the run
+#undef STOP_RUN
+#define STOP_RUN(reason) return
+
+//each handler gets every local an instr can use, and most only use a few of them
+#define HANDLER_SCRATCH __attribute__((unused))
+
+//where ALU table entries go
+#ifdef ENABLE_ALU_TABLES
+#define ALU_ENTRY_LOCAL unsigned short alu HANDLER_SCRATCH;
+#else
+#define ALU_ENTRY_LOCAL
+#endif
+
+//run_dynarec looks for idle loops itself, once a block has run
+#undef IDLE_CHECK
+#define IDLE_CHECK(target)
+
+#define OPCODE_DESC(code,mnemonic,mode,length,cycles,penalty) \
+	static void exec_##code( em6502 *emu, unsigned short operand ) \
+	{ \
+		unsigned char ch1 HANDLER_SCRATCH; \
+		unsigned char ch2 HANDLER_SCRATCH; \
+		unsigned char res HANDLER_SCRATCH; \
+		ALU_ENTRY_LOCAL \
+		unsigned short ea HANDLER_SCRATCH; \
+		EA_##mode; \
+		INSTR_CYCLES(code,mode); \
+		INSTR_##mnemonic(mode,length); \
+	}
+#include "opcodes.def"
+#undef OPCODE_DESC
+
+const dynarec_handler_t dynarec_handler[256] =
+{
+	#define OPCODE_DESC(code,mnemonic,mode,length,cycles,penalty) [code] = exec_##code,
+	#include "opcodes.def"
+	#undef OPCODE_DESC
+};
+#endif
@@ -5,6 +5,7 @@
 
 #include "definitions.h"
 #include "paging.h"
+#include "opcodes.h"
 
 
 /* Define macros to check the P-register  */
@@ -153,6 +154,18 @@ For example, if memory location $1000 contains the (hexadecimal) value $AB, then
 			if ( OVERFLOW_GET(MEM_LOC) ) OVERFLOW_SET(P); \
 			else OVERFLOW_CLEAR(P);
 
+//with ENABLE_LAZY_FLAGS, N/Z/C/V live in the em6502's flag_* while it runs
+//these put them back into P/take them out of it again
+#define PACK_FLAGS(emu,P) \
+	P = (P & 0x3C) | ((emu)->flag_n & 0x80) | ((emu)->flag_z == 0) << 1 | \
+		(emu)->flag_c | ((emu)->flag_v & 0x80) >> 1
+
+#define UNPACK_FLAGS(emu,P) \
+	( (emu)->flag_n = (P), \
+	  (emu)->flag_z = ~(P) & 0x02, \
+	  (emu)->flag_c = (P) & 0x01, \
+	  (emu)->flag_v = (P) << 1 )
+
 //this is to mark those instructions that access memory and do not go through the read/write_mem
 //interface. in the future, these might have to be changed
 #define STUB_OUT_MEM_ACCESS_IFACES 1
@@ -161,14 +174,6 @@ For example, if memory location $1000 contains the (hexadecimal) value $AB, then
 #endif
 
 
-//this is to mark those instructions that deal with interrups
-//in the future, these might have to be changed
-#define STUB_OUT_INTERRUPTS_IFACES 1
-#ifndef STUB_OUT_INTERRUPTS_IFACES
-	assert(0); //this fails because its not doing the interrupts correctly
-#endif
-
-
 //what defines a memory region
 //for mem-mapped io services
 typedef struct {
@@ -177,10 +182,121 @@ typedef struct {
 }mem_region;
 
 
+//a single instruction, as decoded by run_program
+//slots live in em6502->decode_cache until the memory they came from is written
+typedef struct {
+	unsigned short operand; //operand bytes, put together as an addr (high byte is 0 for 1 byte operands)
+	unsigned short handler; //which case of the interpreter runs it; its opcode, or a fused sequence starting with it
+	unsigned char opcode;
+	unsigned char mode; //one of MODE_*
+	unsigned char length; //length in bytes, including opcode; 0 means not decoded yet
+}decoded_instr;
 
 
+//everything a memory map lives in, allocated as one block
+//so an emulator's memory is a single malloc/free, and its page_ts sit next to each other
+typedef struct {
+	unsigned char memory[MEMORY_SIZE]; //_memory points here
+	page_t pages[NUM_PAGES]; //page_table points here
+}memory_arena;
 
+
+//a page of memory shared between an emulator and its forks, see fork_em6502, or between
+//emulators that happen to hold the same bytes, see dedup_pages
+//it never changes; whichever of them writes to it first gets its own copy instead
+typedef struct {
+	unsigned int refs; //how many emulators' pages point at it
+	unsigned char data[PAGE_SIZE];
+}shared_page;
+
+
+//the last loop run_program saw jumping back to its start, see idle.c
 typedef struct {
+	unsigned char seen; //0 until a jump back in this run_program, the rest is only set after one
+	unsigned char busy; //1 once the loop is known to have side effects
+	unsigned short head; //where the loop starts
+	unsigned short tail; //the instr that jumps back to head
+	unsigned int instr_count; //instrs run before that jump
+	unsigned long long cycles; //and cycles, the jump included
+	unsigned char Acc, X, Y, P, S; //registers right at the jump
+	unsigned int skipped; //instrs fast-forwarded through so far, in all loops
+}idle_loop;
+
+
+struct em6502;
+
+//a listener added with add_memory_write_listener, or add_memory_access_listener
+typedef struct {
+	mem_region region; //addrs it watches
+	unsigned char mode; //READ and/or WRITE, the accesses it watches
+	void (*cb_mem_write)(unsigned short addr); //add_memory_write_listener's; called after each write to one of them
+	void (*cb_access)(struct em6502 *emu, void *context, unsigned short addr, unsigned char val, unsigned char mode); //or add_memory_access_listener's
+	void *context; //passed back to cb_access
+}write_listener;
+
+//a callback scheduled to run at a given cycle, see events.c
+typedef struct {
+	unsigned long long cycle; //run it before any instr starting at or past this many cycles
+	unsigned int id; //what schedule_event returned for it; later ones have bigger ids
+	void (*cb_event)(struct em6502 *emu, void *context);
+	void *context; //whatever the device wants passed back to it
+}scheduled_event;
+
+
+//why run_program stopped
+#define STOP_BUDGET 0 //it ran every instr (or cycle) it was given
+#define STOP_INVALID_OPCODE 1 //PC is at an opcode the 6502 doesnt have
+#define STOP_BRK 2 //PC is at a BRK, and stop_at_brk is set
+#define STOP_BREAKPOINT 3 //PC is at a breakpoint, see set_breakpoint
+
+//1 if there's a breakpoint at addr
+#define BREAKPOINT_AT(emu,addr) \
+	((emu)->breakpoints != 0 && ((emu)->breakpoints[(addr) / 8] & (1 << ((addr) % 8))))
+
+
+//1 if a write listener watches addr
+#define WATCHED(emu,addr) \
+	((emu)->watch_masks[(addr) / PAGE_SIZE] != 0 && \
+	 ((emu)->watch_masks[(addr) / PAGE_SIZE][(addr) % PAGE_SIZE / 8] & (1 << ((addr) % 8))))
+
+//1 if a listener watches reads of addr
+#define READ_WATCHED(emu,addr) \
+	((emu)->read_watch_masks[(addr) / PAGE_SIZE] != 0 && \
+	 ((emu)->read_watch_masks[(addr) / PAGE_SIZE][(addr) % PAGE_SIZE / 8] & (1 << ((addr) % 8))))
+
+//the byte at addr, straight out of its page's data; no listener or device hears about it
+//for looking at code ahead of the cpu, which hasnt read it (and may never)
+#define PEEK_MEM(emu,addr) \
+	((emu)->page_table[(addr) / PAGE_SIZE]->data[(addr) % PAGE_SIZE])
+
+//marks the page addr is in as written since the last checkpoint
+#define MARK_DIRTY(emu,addr) \
+	((emu)->dirty_pages[(addr) / PAGE_SIZE / 8] |= 1 << ((addr) / PAGE_SIZE % 8))
+
+//1 if writes to addr have to go through its page_t, see update_page
+#define SLOW_PAGE(emu,addr) ((emu)->slow_pages[(addr) / PAGE_SIZE])
+
+
+//interrupts latched in em6502->pending_interrupts; an IRQ is a level, so it never is
+#define INTERRUPT_NMI 1
+#define INTERRUPT_RESET 2
+
+//cycle_limit when there's no cycle budget
+#define NO_CYCLE_LIMIT (~0ULL)
+
+
+//which engine run_program executes code on
+#define ENGINE_INTERPRETER 0
+#define ENGINE_DYNAREC 1 //only with ENABLE_DYNAREC, see dynarec.c
+
+struct dynarec_page; //private to dynarec.c
+struct instr_profile; //private to profile.c
+struct em6502_checkpoint; //private to em_6502.c
+
+
+
+
+typedef struct em6502 {
         unsigned char Acc; //accumulator
         unsigned char X; //X register
         unsigned char Y; //Y register
@@ -188,14 +304,86 @@ typedef struct {
         unsigned char S; //stack pointer
         unsigned short PC; //program counter
 
+		#ifdef ENABLE_LAZY_FLAGS
+		  //N/Z/C/V while run_program runs, P's copies of them are only up to date once it returns
+		  unsigned char flag_n; //N is its bit 7
+		  unsigned char flag_z; //Z is set when it's 0
+		  unsigned char flag_c; //C, either 0 or 1
+		  unsigned char flag_v; //V is its bit 7
+		#endif
+
         //our paging-based memory model plugs in here
         page_t *page_table[NUM_PAGES];
         unsigned char *_memory; //dynamic memory into which page_table points
+        memory_arena *arena; //where they're both allocated; 0 until create_simple_memory_map
+        shared_page *shared_pages[NUM_PAGES]; //what the pages shared with forks point at; 0 for the ones in _memory
+        unsigned char dirty_pages[NUM_PAGES / 8]; //a bit per page, set when it's written; see checkpoint_em6502
+        struct em6502_checkpoint *checkpoint; //what rollback_em6502 goes back to, 0 until there is one
+
+		#ifdef ENABLE_FAST_MEMORY
+		  unsigned char slow_pages[NUM_PAGES]; //1 for each page that isnt plain RAM at its place in _memory
+		  unsigned char *read_pages[NUM_PAGES]; //the bytes reads of each page go straight to, 0 if they go through its page_t
+		#endif
 
 		#ifdef ALLOW_MAX_INSTR_COUNT
 		  unsigned int instr_count;  //how many instructions we executed
 		#endif
 
+		#ifdef ENABLE_CYCLE_COUNT
+		  unsigned long long cycles; //how many cycles they took
+		  unsigned long long cycle_limit; //run_program stops before any instr starting at or past this many
+		#endif
+
+		#ifdef ENABLE_EVENTS
+		  scheduled_event events[MAX_EVENTS]; //a min-heap on cycle, then id; events[0] is the next one due
+		  unsigned int num_events;
+		  unsigned int next_event_id; //id the next event scheduled gets
+		#endif
+
+		#ifdef ENABLE_INTERRUPTS
+		  unsigned int irq_lines; //a bit per device holding IRQ; it gets taken while any is set and I is clear
+		  unsigned char nmi_line; //1 while NMI is held; it only gets taken when it goes from 0 to 1
+		  unsigned char pending_interrupts; //INTERRUPT_NMI/INTERRUPT_RESET, latched until they're taken
+		#endif
+
+		unsigned char stop_at_brk; //stop at a BRK rather than running it, like a program's end; starts off
+		unsigned char *breakpoints; //a bit per addr, set for the ones with a breakpoint; 0 until the first one
+		write_listener write_listeners[MAX_MEMORY_WRITER_LISTENERS];
+		unsigned int num_write_listeners;
+		unsigned char *watch_masks[NUM_PAGES]; //a bit per addr of the page, set where a write listener watches; 0 for pages none do
+		unsigned char *read_watch_masks[NUM_PAGES]; //the same for reads; pages with one are never plain RAM
+		unsigned short resume_pc; //where run_program started; a breakpoint there doesnt stop it until it's run
+		unsigned char resume; //1 until the instr at resume_pc has run
+
+		#ifdef ENABLE_PREDECODE_CACHE
+		  //one slot per addr, allocated a page at a time the first time code in it runs
+		  //pages with a listener or a device are never cached
+		  decoded_instr *decode_cache[NUM_PAGES];
+		#endif
+
+		#ifdef ENABLE_FUSION
+		  unsigned char fusion; //fuse the sequences in fusions.def as they get decoded; starts on
+		  unsigned char fused_pages[NUM_PAGES]; //1 for pages whose decode_cache has a fused slot, so writes there look further back
+		#endif
+
+		#ifdef ENABLE_PROFILER
+		  struct instr_profile *profile; //what ran back to back, 0 until the first instr
+		#endif
+
+		#ifdef ENABLE_IDLE_SKIP
+		  unsigned char idle_skip; //fast-forward through loops that provably do nothing; starts on
+		  idle_loop idle;
+		#endif
+
+		#ifdef ENABLE_DYNAREC
+		  unsigned char engine; //what run_program runs code on, one of ENGINE_*; starts as ENGINE_INTERPRETER
+		  struct dynarec_page *dynarec_pages[NUM_PAGES]; //translated blocks, by the page their code is in
+		  unsigned char *dynarec_code; //executable memory blocks get translated into, 0 until the first one
+		  unsigned int dynarec_code_used; //how much of it is taken
+		  unsigned char dynarec_stale; //set when the code of a translated block gets overwritten
+		  unsigned int dynarec_flushes; //times every block got thrown away, so page_code knows whose are gone
+		#endif
+
 }em6502;
 
 /**************************************
@@ -207,41 +395,300 @@ typedef struct {
 ***************************************/
 void initialize_em6502( em6502 *);
 
+/**************************************
+ * Name:  reset_em6502
+ * Inputs:  em6502 * - the 6502 object to reset
+ * Outputs: None
+ * Function: puts the 6502 back the way initialize_em6502 and create_simple_memory_map
+ *			 left it, with its memory cleared; keeps what it has allocated, so
+ *			 reusing an emulator is cheaper than destroying it and making another
+ *
+***************************************/
+void reset_em6502( em6502 * );
+
+/**************************************
+ * Name:  destroy_em6502
+ * Inputs:  em6502 * - the 6502 object to destroy
+ * Outputs: None
+ * Function: frees everything the 6502 has allocated, memory map included;
+ *			 it has to be initialized again before it can be used
+ *
+***************************************/
+void destroy_em6502( em6502 * );
+
 /**************************************
  * Name:  load_program
  * Inputs:  em6502 * - the 6502 object to load program
  *	 			void * - the memory containing the program; gets copied into em6502->Memory
  *				size_t - size of program to copy
- *				unsigned int -  offset from start
+ *				unsigned int -  offset from start, any addr
  * Outputs: None
- * Function: copies the memory into the memory space of the em6502 object
+ * Function: copies the memory into the memory space of the em6502 object,
+ *			 and points PC at the start of it
  *
 ***************************************/
 void load_program( em6502 *, void *, size_t, unsigned int);
 
 
+/**************************************
+ * Name:  load_memory
+ * Inputs:  em6502 * - the 6502 object
+ *				const void * - the bytes to copy in
+ *				size_t - how many; they have to fit below $10000
+ *				unsigned int - addr to copy them to, any addr
+ * Outputs: None
+ * Function: load_program without touching PC; a memcpy per run of pages that
+ *			 are next to each other in memory, rather than a write_mem per byte.
+ *			 Listeners arent called, and ROM pages keep what they had
+ *
+***************************************/
+void load_memory( em6502 *, const void *, size_t, unsigned int );
+
+
 /**************************************
  * Name:  run_program
  * Inputs:  em6502 * - the 6502 object to execute
  *				unsigned int - max number of instructions to execute, -1 for all
+ * Outputs: int - why it stopped, one of STOP_*
+ * Function: executes the previosuly loaded program, until the instrs run out or
+ *			 it gets to something it cant run; PC is left at that instr
+ *
+***************************************/
+int run_program( em6502 *, unsigned int );
+
+
+#ifdef ENABLE_CYCLE_COUNT
+/**************************************
+ * Name:  run_program_cycles
+ * Inputs:  em6502 * - the 6502 object to execute
+ *				unsigned int - max number of instructions to execute, -1 for all
+ *				unsigned long long - max number of cycles to execute
+ * Outputs: int - why it stopped, one of STOP_*
+ * Function: same as run_program, but also stops once the instrs it ran took the cycles
+ *			 it was given; the last one can go over by a few, it doesnt stop halfway through
+ *
+***************************************/
+int run_program_cycles( em6502 *, unsigned int, unsigned long long );
+#endif
+
+
+/**************************************
+ * Name:  run_interpreter
+ * Inputs:  em6502 * - the 6502 object to execute
+ *				unsigned int - max number of instructions to execute, -1 for all
+ * Outputs: int - why it stopped, one of STOP_*
+ * Function: same as run_program, but always interprets, whatever the engine
+ *
+***************************************/
+int run_interpreter( em6502 *, unsigned int );
+
+
+/**************************************
+ * Name:  set_breakpoint
+ * Inputs:  em6502 * - the 6502 object
+ *				unsigned short - addr to stop at
+ * Outputs: None
+ * Function: run_program stops with STOP_BREAKPOINT before running the instr at addr,
+ *			 unless that's the instr it was started on
+ *
+***************************************/
+void set_breakpoint( em6502 *, unsigned short );
+
+
+/**************************************
+ * Name:  clear_breakpoint
+ * Inputs:  em6502 * - the 6502 object
+ *				unsigned short - addr of the breakpoint
  * Outputs: None
- * Function: executes the previosuly loaded program
+ * Function: removes a breakpoint set with set_breakpoint
  *
 ***************************************/
-void run_program( em6502 *, unsigned int );
+void clear_breakpoint( em6502 *, unsigned short );
+
+
+#ifdef ENABLE_INTERRUPTS
+/**************************************
+ * Name:  set_irq
+ * Inputs:  em6502 * - the 6502 object
+ *				unsigned int - which device's IRQ output, 0-31
+ *				int - 1 to hold IRQ, 0 to let go of it
+ * Outputs: None
+ * Function: IRQ is level triggered; while any device holds it and I is clear, the cpu
+ *			 takes it through the vector at $FFFE, once the instr it's on is done
+ *
+***************************************/
+void set_irq( em6502 *, unsigned int, int );
+
+
+/**************************************
+ * Name:  set_nmi
+ * Inputs:  em6502 * - the 6502 object
+ *				int - 1 to hold NMI, 0 to let go of it
+ * Outputs: None
+ * Function: NMI is edge triggered; it gets taken through the vector at $FFFA once
+ *			 each time it goes from 0 to 1, whatever I is, once the instr it's on is done
+ *
+***************************************/
+void set_nmi( em6502 *, int );
+
+
+/**************************************
+ * Name:  trigger_reset
+ * Inputs:  em6502 * - the 6502 object
+ * Outputs: None
+ * Function: pulses RESET; once the instr it's on is done, the cpu drops S by 3, sets I
+ *			 and starts over from the vector at $FFFC. Memory and the other registers
+ *			 are left alone, unlike reset_em6502
+ *
+***************************************/
+void trigger_reset( em6502 * );
+#endif
+
+
+/**************************************
+ * Name:  read_mem
+ * Inputs:  em6502 * - the 6502 chip whose memory we want to read
+ *				unsigned short  - the addr to get
+ * Outputs: unsigned char - the value at that memory location
+ * Function: returns memory at given addr, going through the page's listener
+ *
+***************************************/
+unsigned char read_mem( em6502 *, unsigned short );
+
+
+/**************************************
+ * Name:  write_mem
+ * Inputs:  em6502 * - the 6502 chip whose memory we want to write
+ *			unsigned short  - the addr to write to
+ *			unsigned char - the value to write
+ * Outputs: none
+ * Function: writes memory to given addr, going through the page's listener;
+ *			 pages without WRITE set are ROM, and keep what they had
+ *
+***************************************/
+void write_mem( em6502 *, unsigned short, unsigned char );
 
 
 /**************************************
  * Name:  add_memory_write_listener
  * Inputs:  em6502 * - the 6502 object to execute
  * 			mem_region - memory region to watch
- *			void (*cb_mem_write)(unsigned int) - callback function ptr to invoke
+ *			void (*cb_mem_write)(unsigned short) - callback function ptr to invoke
+ * Outputs: int - 1 if it was added, 0 if there are MAX_MEMORY_WRITER_LISTENERS already
+ * Function: registers a memory write listener at given memory region; it gets
+ * 			 called with the addr after every write there, along with any
+ * 			 other listener watching it. Writes anywhere else dont check them
+ *
+***************************************/
+int add_memory_write_listener( em6502 *, mem_region, void (*cb_mem_write)(unsigned short) );
+
+
+/**************************************
+ * Name:  add_memory_access_listener
+ * Inputs:  em6502 * - the 6502 object
+ * 			mem_region - memory region to watch
+ * 			unsigned char - READ, WRITE or READ | WRITE; the accesses to watch
+ *			cb_access - called with the emulator, the context, the addr, the byte written
+ *						(0 for reads) and READ or WRITE
+ * 			void * - passed back to it
+ * Outputs: int - 1 if it was added, 0 if there are MAX_MEMORY_WRITER_LISTENERS already
+ * Function: add_memory_write_listener for a listener with a context, that can watch reads too;
+ * 			 it's called before a read, so it can change what gets read (see cartridge.c),
+ * 			 and after a write. Like write listeners it's byte-granular, so a page with a few
+ * 			 watched bytes still gets decoded and translated; instrs decoded from a watched
+ * 			 byte call it when they get decoded, rather than every time they run.
+ * 			 Needs a memory map; create_simple_memory_map has to come first
+ *
+***************************************/
+int add_memory_access_listener( em6502 *, mem_region, unsigned char,
+								void (*cb_access)(em6502 *, void *, unsigned short, unsigned char, unsigned char),
+								void * );
+
+
+
+/**************************************
+ * Name:  set_memory_device
+ * Inputs:  em6502 * - the 6502 object
+ * 			mem_region - addrs the device answers to
+ * 			cb_device - called on every read and write there, 0 to take the device away
+ * 			void * - passed back to it
+ * Outputs: None
+ * Function: puts a device behind every page the region touches; it gets the emulator
+ * 			 and its context, and returns the byte that gets read or stored, see page_t
+ *
+***************************************/
+void set_memory_device( em6502 *, mem_region,
+						unsigned char (*cb_device)(em6502 *, void *, unsigned short, unsigned char, unsigned char),
+						void * );
+
+
+/**************************************
+ * Name:  fork_em6502
+ * Inputs:  em6502 * - the 6502 object to fork
+ * 			em6502 * - where to put the fork; it mustnt be initialized, or it leaks
+ * Outputs: None
+ * Function: makes a copy of the emulator that runs on from where it is, without copying
+ * 			 its memory; the two share every page until one of them writes to it, and then
+ * 			 that one gets its own copy of the page. Each page only gets shared the first
+ * 			 time it's forked, so forking the same emulator again is cheap
+ * 			 shared pages arent in _memory, only the ones written since; read them through
+ * 			 read_mem or page_table. Forks can outlive the emulator they came from, but they
+ * 			 all have to be used from the same thread
+ *
+***************************************/
+void fork_em6502( em6502 *, em6502 * );
+
+
+/**************************************
+ * Name:  unshare_page
+ * Inputs:  em6502 * - the 6502 object
+ * 			unsigned int - the page
+ * Outputs: None
+ * Function: gives the emulator its own copy of a page it shares with a fork, if it does;
+ * 			 write_mem does this on its own, only needed before poking page->data directly
+ *
+***************************************/
+void unshare_page( em6502 *, unsigned int );
+
+
+/**************************************
+ * Name:  share_page
+ * Inputs:  em6502 * - the 6502 object
+ * 			unsigned int - the page
+ * 			shared_page * - what to point it at
+ * Outputs: None
+ * Function: points the page at a shared_page holding the same bytes it does, letting go
+ * 			 of whichever it shared before; see dedup_pages. The page has to be in its
+ * 			 place in _memory or shared already
+ *
+***************************************/
+void share_page( em6502 *, unsigned int, shared_page * );
+
+
+/**************************************
+ * Name:  checkpoint_em6502
+ * Inputs:  em6502 * - the 6502 object
  * Outputs: None
- * Function: registers a memory write listener at given memory region
+ * Function: saves the registers, counters, events and memory, for rollback_em6502 to
+ * 			 go back to; replaces any checkpoint it had. Costs a copy of all of memory,
+ * 			 so it's meant to be taken once and rolled back to many times
  *
 ***************************************/
-void add_memory_write_listener( em6502 *, mem_region, void (*cb_mem_write)(unsigned short) );
+void checkpoint_em6502( em6502 * );
+
 
+/**************************************
+ * Name:  rollback_em6502
+ * Inputs:  em6502 * - the 6502 object
+ * Outputs: None
+ * Function: puts the emulator back the way it was at its checkpoint; only the pages
+ * 			 written since get copied back, so it costs what the run did rather than
+ * 			 all of memory. A page counts as written once write_mem writes it or
+ * 			 invalidate_code gets told it changed; poking _memory without either isnt
+ * 			 seen. Devices' own state is theirs to put back
+ *
+***************************************/
+void rollback_em6502( em6502 * );
 
 
 /**************************************
@@ -250,10 +697,84 @@ void add_memory_write_listener( em6502 *, mem_region, void (*cb_mem_write)(unsig
  * Outputs: None
  * Function: creates the simplest memory map possible;
  * 			 straight mapping with all pages marked as read-able
+ * 			 an emulator that already has a map gets its pages put back that way;
+ * 			 whatever is in its memory stays there
  *
 ***************************************/
 void create_simple_memory_map( em6502 * );
 
 
+//the code decoded and translated from a page's bytes, kept aside while they're switched out,
+//see switch_page_data
+typedef struct {
+	#ifdef ENABLE_PREDECODE_CACHE
+	  decoded_instr *decoded; //the page's decode_cache
+	#endif
+	#ifdef ENABLE_FUSION
+	  unsigned char fused; //and fused_pages
+	#endif
+	#ifdef ENABLE_DYNAREC
+	  struct dynarec_page *translated; //and dynarec_pages
+	  unsigned int flushes; //dynarec_flushes when it was put aside; it's gone if that's changed since
+	#endif
+}page_code;
+
+
+/**************************************
+ * Name:  switch_page_data
+ * Inputs:  em6502 * - the 6502 object
+ * 			unsigned int - the page
+ * 			unsigned char * - the bytes to point it at
+ * 			page_code * - where to put the code decoded from the bytes it points at now
+ * 			page_code * - the code decoded from the new bytes, last time they were here; emptied
+ * Outputs: None
+ * Function: update_page for bank switching; the page's code goes aside with its bytes and comes back
+ * 			 with them, so switching back and forth only costs a few pointer stores, rather than
+ * 			 decoding and translating all of it again. Only instrs running over into the next page,
+ * 			 or in from the last, get decoded again. The two page_codes have to be for the same
+ * 			 page, and different bytes; start them zeroed, and free them with free_page_code
+ *
+***************************************/
+void switch_page_data( em6502 *, unsigned int, unsigned char *, page_code *, page_code * );
+
+
+/**************************************
+ * Name:  free_page_code
+ * Inputs:  page_code * - code put aside by switch_page_data
+ * Outputs: None
+ * Function: frees it, leaving it empty
+ *
+***************************************/
+void free_page_code( page_code * );
+
+
+/**************************************
+ * Name:  update_page
+ * Inputs:  em6502 * - the 6502 object
+ * 			unsigned int - the page
+ * Outputs: None
+ * Function: call after changing a page's page_t (its data, flag, listener or device);
+ * 			 works out again whether its accesses can skip it, and drops any
+ * 			 code decoded from it
+ *
+***************************************/
+void update_page( em6502 *, unsigned int );
+
+
+/**************************************
+ * Name:  invalidate_code
+ * Inputs:  em6502 * - the 6502 object
+ * 			unsigned short - first addr that was modified
+ * 			unsigned short - last addr that was modified
+ * Outputs: None
+ * Function: drops any decoded instrs (and translated blocks) overlapping the given range
+ * 			 write_mem/load_program do this on their own; only needed after
+ * 			 poking memory directly (page->data, _memory). Changing a page_t
+ * 			 takes update_page instead, which does this for the whole page
+ *
+***************************************/
+void invalidate_code( em6502 *, unsigned short, unsigned short );
+
+
 
 #endif  /* EM_6502_H */
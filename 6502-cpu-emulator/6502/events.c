@@ -0,0 +1,175 @@
+/* This is the event scheduler; devices hang callbacks off the cycle count here  */
+
+#include <stdio.h>
+
+#include "events.h"
+
+#ifdef ENABLE_EVENTS
+
+/*
+ * The events are kept in a binary min-heap in the em6502, so the next one due is
+ * always events[0]. run_program sets its cycle_limit to that one's cycle and lets
+ * the cpu run flat out up to it, the same as for a cycle budget; the instrs never
+ * look at the events themselves. Once it gets there, it runs everything due and
+ * carries on to the next one.
+ */
+
+//1 if a is due before b; ties go to whichever was scheduled first
+#define EVENT_BEFORE(a,b) \
+	((a)->cycle < (b)->cycle || ((a)->cycle == (b)->cycle && (a)->id < (b)->id))
+
+//moves the event at i up the heap until its parent is due before it
+static void sift_up( em6502 *emu, unsigned int i )
+{
+	scheduled_event ev = emu->events[i];
+
+	while ( i > 0 && EVENT_BEFORE(&ev, &emu->events[(i - 1) / 2]) )
+	{
+		emu->events[i] = emu->events[(i - 1) / 2];
+		i = (i - 1) / 2;
+	}
+
+	emu->events[i] = ev;
+}
+
+//moves the event at i down the heap until both its children are due after it
+static void sift_down( em6502 *emu, unsigned int i )
+{
+	scheduled_event ev = emu->events[i];
+	unsigned int child;
+
+	while ( (child = 2 * i + 1) < emu->num_events )
+	{
+		if ( child + 1 < emu->num_events && EVENT_BEFORE(&emu->events[child + 1], &emu->events[child]) )
+		{
+			child++;
+		}
+		if ( !EVENT_BEFORE(&emu->events[child], &ev) )
+		{
+			break;
+		}
+
+		emu->events[i] = emu->events[child];
+		i = child;
+	}
+
+	emu->events[i] = ev;
+}
+
+//takes the event at i out of the heap
+static void remove_event( em6502 *emu, unsigned int i )
+{
+	emu->num_events--;
+	if ( i == emu->num_events )
+	{
+		return;
+	}
+
+	emu->events[i] = emu->events[emu->num_events];
+	sift_down(emu, i);
+	sift_up(emu, i);
+}
+
+
+/**************************************
+ * Name:  schedule_event
+ * Inputs:  em6502 * - the 6502 object
+ * 			unsigned long long - cycle to run it at; one that's already gone runs
+ * 								 before the next instr does
+ * 			void (*cb_event)(em6502 *, void *) - callback to run
+ * 			void * - passed back to the callback as is
+ * Outputs: unsigned int - an id for cancel_event, 0 if MAX_EVENTS are already scheduled
+ * Function: has run_program call the callback before any instr that starts at or
+ * 			 past that cycle; events due at the same cycle run in the order they
+ * 			 were scheduled. A callback can schedule more, itself included
+ *
+***************************************/
+unsigned int schedule_event( em6502 *emu, unsigned long long cycle, void (*cb_event)(em6502 *, void *), void *context )
+{
+	scheduled_event *ev;
+	unsigned int id;
+
+	if ( emu->num_events == MAX_EVENTS )
+	{
+		return 0;
+	}
+
+	id = emu->next_event_id++;
+	if ( emu->next_event_id == 0 )
+	{
+		//0 is for failing
+		emu->next_event_id = 1;
+	}
+
+	ev = &emu->events[emu->num_events];
+	ev->cycle = cycle;
+	ev->id = id;
+	ev->cb_event = cb_event;
+	ev->context = context;
+	sift_up(emu, emu->num_events++);
+
+	return id;
+}
+
+
+/**************************************
+ * Name:  cancel_event
+ * Inputs:  em6502 * - the 6502 object
+ * 			unsigned int - what schedule_event returned
+ * Outputs: int - 1 if it was cancelled, 0 if it already ran (or never was)
+ * Function: unschedules an event
+ *
+***************************************/
+int cancel_event( em6502 *emu, unsigned int id )
+{
+	unsigned int i;
+
+	for ( i = 0; i < emu->num_events; i++ )
+	{
+		if ( emu->events[i].id == id )
+		{
+			remove_event(emu, i);
+			return 1;
+		}
+	}
+
+	return 0;
+}
+
+
+/**************************************
+ * Name:  next_event_cycle
+ * Inputs:  em6502 * - the 6502 object
+ * Outputs: unsigned long long - when the next event is due, NO_CYCLE_LIMIT if there are none
+ * Function: run_program stops the cpu here to run it
+ *
+***************************************/
+unsigned long long next_event_cycle( em6502 *emu )
+{
+	return emu->num_events == 0 ? NO_CYCLE_LIMIT : emu->events[0].cycle;
+}
+
+
+/**************************************
+ * Name:  run_due_events
+ * Inputs:  em6502 * - the 6502 object
+ * Outputs: None
+ * Function: runs every event due by the current cycle, soonest first;
+ * 			 run_program calls this in between running instrs
+ *
+***************************************/
+void run_due_events( em6502 *emu )
+{
+	scheduled_event ev;
+
+	while ( emu->num_events != 0 && emu->events[0].cycle <= emu->cycles )
+	{
+		//out of the heap first, so the callback can schedule more
+		ev = emu->events[0];
+		remove_event(emu, 0);
+
+		(*ev.cb_event)(emu, ev.context);
+	}
+}
+
+#endif
@@ -0,0 +1,57 @@
+#ifndef EVENTS_H
+#define EVENTS_H
+
+#include "em_6502.h"
+
+#ifdef ENABLE_EVENTS
+
+/**************************************
+ * Name:  schedule_event
+ * Inputs:  em6502 * - the 6502 object
+ * 			unsigned long long - cycle to run it at; one that's already gone runs
+ * 								 before the next instr does
+ * 			void (*cb_event)(em6502 *, void *) - callback to run
+ * 			void * - passed back to the callback as is
+ * Outputs: unsigned int - an id for cancel_event, 0 if MAX_EVENTS are already scheduled
+ * Function: has run_program call the callback before any instr that starts at or
+ * 			 past that cycle; events due at the same cycle run in the order they
+ * 			 were scheduled. A callback can schedule more, itself included
+ *
+***************************************/
+unsigned int schedule_event( em6502 *, unsigned long long, void (*cb_event)(em6502 *, void *), void * );
+
+
+/**************************************
+ * Name:  cancel_event
+ * Inputs:  em6502 * - the 6502 object
+ * 			unsigned int - what schedule_event returned
+ * Outputs: int - 1 if it was cancelled, 0 if it already ran (or never was)
+ * Function: unschedules an event
+ *
+***************************************/
+int cancel_event( em6502 *, unsigned int );
+
+
+/**************************************
+ * Name:  next_event_cycle
+ * Inputs:  em6502 * - the 6502 object
+ * Outputs: unsigned long long - when the next event is due, NO_CYCLE_LIMIT if there are none
+ * Function: run_program stops the cpu here to run it
+ *
+***************************************/
+unsigned long long next_event_cycle( em6502 * );
+
+
+/**************************************
+ * Name:  run_due_events
+ * Inputs:  em6502 * - the 6502 object
+ * Outputs: None
+ * Function: runs every event due by the current cycle, soonest first;
+ * 			 run_program calls this in between running instrs
+ *
+***************************************/
+void run_due_events( em6502 * );
+
+#endif
+
+#endif /* EVENTS_H */
@@ -4,6 +4,9 @@
 
 #include "em_6502.h"
 #include "unit_test.h"
+#include "benchmark.h"
+#include "batch.h"
+#include "loader.h"
 
 #include <stdio.h>
 
@@ -11,20 +14,35 @@
 //for running unit tests
 //#define RUN_UNIT_TEST
 
+//for timing the emulator
+//#define RUN_BENCHMARK
+
 void *test_memory_listener(unsigned short addr)
 {
 	printf("Called test_memory_listener with addr=%d\n",addr);
 }
 
 
-int main()
+int main( int argc, char **argv )
 {
+	em6502 emulator;
+	mem_region region;
+	#ifdef ENABLE_LOADER
+	image_info info;
+	#else
 	FILE * pFile;
 	long size;
-	em6502 emulator;
 	char * memblock;
 	int i;
-	mem_region region;
+	#endif
+
+	#ifdef ENABLE_BATCH
+	//6502 --batch manifest [threads]
+	if ( argc > 1 && strcmp(argv[1], "--batch") == 0 )
+	{
+		return run_batch_cli(argc - 2, argv + 2);
+	}
+	#endif
 
     printf("sizeof(char) == %d\n", sizeof(char));
 	  printf("sizeof(unsigned short) == %d\n", sizeof(unsigned short));
@@ -37,11 +55,22 @@ int main()
        run_test_harness();
     #endif
 
+    #ifdef RUN_BENCHMARK
+       run_benchmark();
+    #endif
+
 	//lets try to run our own compiled file - 'disco.as'
 	//as compiled by our asslink
 	initialize_em6502( &emulator);
 	create_simple_memory_map(&emulator);
 
+	#ifdef ENABLE_LOADER
+	//no reading it into a buffer first; it gets copied once, straight out of the file
+	//(it's RAM on 6502asm.com, so it isnt attached as ROM)
+	if ( !load_image_file(&emulator, "test/alive.as", IMAGE_RAW, 0x0600, &info) ) { printf("Failed to open file"); exit(-1); }
+
+	printf ("Size of file: %u bytes.\n", info.num_segments > 0 ? info.segments[0].size : 0);
+	#else
 	//pFile = fopen ("test/disco.as","rb");
 	//pFile = fopen ("test/noise.as","rb"); //noise crashes: tries to return from main
 	//pFile = fopen ("test/colors.as","rb");  //colors crashes; same as on 6502asm.com
@@ -70,6 +99,7 @@ int main()
 	load_program( &emulator, memblock, size, 0x0600);
 
 	free(memblock);
+	#endif
 
 //	//one more thing:
 //	//as per documentation on 6502asm.com, 0x00FF is the key-pressed
@@ -90,11 +120,16 @@ int main()
 //	while(1)
 //	{
 		//launch this bad boy!
-		run_program(&emulator, 9999);
+		if ( run_program(&emulator, 9999) == STOP_INVALID_OPCODE )
+		{
+			printf("error: invalid object code 0x%hhx at P=%d\n", read_mem(&emulator,emulator.PC), emulator.PC );
+			exit(-1);
+		}
 //	}
 
 	printf("Yes, success\n");
 
+	destroy_em6502(&emulator);
 
 
 	return 0;
@@ -0,0 +1,227 @@
+/* This is the idle loop detector; it fast-forwards through loops that provably do nothing  */
+
+#include <stdio.h>
+
+#include "idle.h"
+
+#ifdef ENABLE_IDLE_SKIP
+
+/*
+ * A loop is idle when running it once more can't change anything:
+ *	- it runs straight from its head down to the JMP or branch at its tail, and back
+ *	- none of its instrs write memory or touch the stack, or have a breakpoint
+ *	- none of its bytes, and nothing it reads, are in a page with a listener
+ *	  (a device could change what it reads, and the listener would see each access)
+ *	- the registers are the same at the jump back as they were at the one before it
+ * Memory can only change in between run_program calls, so a loop only counts as idle
+ * once it has gone around in the same call. Something like a JMP to itself, or polling
+ * a byte for a keypress, then just counts its iterations as run.
+ */
+
+//instrs that write memory, or move the stack pointer
+static int has_side_effects( unsigned char opcode )
+{
+	switch ( opcode )
+	{
+		case 0x85: case 0x95: case 0x8D: case 0x9D: case 0x99: case 0x81: case 0x91: //STA
+		case 0x86: case 0x96: case 0x8E: //STX
+		case 0x84: case 0x94: case 0x8C: //STY
+		case 0xE6: case 0xF6: case 0xEE: case 0xFE: //INC
+		case 0xC6: case 0xD6: case 0xCE: case 0xDE: //DEC
+		case 0x06: case 0x16: case 0x0E: case 0x1E: //ASL
+		case 0x46: case 0x56: case 0x4E: case 0x5E: //LSR
+		case 0x26: case 0x36: case 0x2E: case 0x3E: //ROL
+		case 0x66: case 0x76: case 0x6E: case 0x7E: //ROR
+		case 0x48: case 0x08: case 0x68: case 0x28: //PHA, PHP, PLA, PLP
+			return 1;
+	}
+
+	return 0;
+}
+
+//1 if any page from first to last has a listener, or a byte a listener watches reads of
+static int pages_watched( em6502 *emu, unsigned int first, unsigned int last )
+{
+	for ( ; first <= last; first++ )
+	{
+		if ( HAS_LISTENER(emu->page_table[first % NUM_PAGES]) || emu->read_watch_masks[first % NUM_PAGES] != 0 )
+		{
+			return 1;
+		}
+	}
+
+	return 0;
+}
+
+/**************************************
+ * Name:  idle_loop_length
+ * Inputs:  em6502 * - the 6502 object
+ * 			unsigned short - addr the loop starts at
+ * 			unsigned short - addr of the instr that jumps back to the start
+ * Outputs: unsigned int - number of instrs in the loop, 0 if it isnt side effect free
+ * Function: checks everything about the loop that doesnt depend on the registers
+ *
+***************************************/
+static unsigned int idle_loop_length( em6502 *emu, unsigned short head, unsigned short tail )
+{
+	const opcode_desc *desc;
+	unsigned char opcode;
+	unsigned short operand;
+	unsigned int pc = head;
+	unsigned int count = 0;
+
+	while ( pc <= tail )
+	{
+		opcode = emu->page_table[pc / PAGE_SIZE]->data[pc % PAGE_SIZE];
+		desc = &opcode_table[opcode];
+
+		if ( desc->mode == MODE_NONE || BREAKPOINT_AT(emu, pc) ||
+			 pages_watched(emu, pc / PAGE_SIZE, (pc + desc->length - 1) / PAGE_SIZE) )
+		{
+			return 0;
+		}
+
+		count++;
+
+		if ( pc == tail )
+		{
+			//the jump back itself; a JMP through a pointer would read it
+			return opcode == 0x4C || desc->mode == MODE_RELATIVE ? count : 0;
+		}
+
+		if ( changes_flow(opcode) || has_side_effects(opcode) )
+		{
+			return 0;
+		}
+
+		operand = 0;
+		if ( desc->length > 1 )
+		{
+			operand = emu->page_table[(pc + 1) / PAGE_SIZE % NUM_PAGES]->data[(pc + 1) % PAGE_SIZE];
+		}
+		if ( desc->length > 2 )
+		{
+			operand |= emu->page_table[(pc + 2) / PAGE_SIZE % NUM_PAGES]->data[(pc + 2) % PAGE_SIZE] << 8;
+		}
+
+		//whatever page its read could land in
+		switch ( desc->mode )
+		{
+			case MODE_Z_PAGE:
+			case MODE_Z_PAGE_X:
+			case MODE_Z_PAGE_Y:
+				if ( pages_watched(emu, 0, 0) ) return 0;
+				break;
+			case MODE_ABSOLUTE:
+				if ( pages_watched(emu, operand / PAGE_SIZE, operand / PAGE_SIZE) ) return 0;
+				break;
+			case MODE_ABS_X:
+			case MODE_ABS_Y:
+				if ( pages_watched(emu, operand / PAGE_SIZE, operand / PAGE_SIZE + 1) ) return 0;
+				break;
+			case MODE_IND_X:
+			case MODE_IND_Y:
+				if ( pages_watched(emu, 0, NUM_PAGES - 1) ) return 0;
+				break;
+			default:
+				break;
+		}
+
+		pc += desc->length;
+	}
+
+	//the instrs dont line up with the tail
+	return 0;
+}
+
+
+/**************************************
+ * Name:  idle_loop_skip
+ * Inputs:  em6502 * - the 6502 object
+ * 			unsigned short - addr being jumped back to
+ * 			unsigned short - addr of the instr jumping back
+ * 			unsigned int - how many more instrs run_program can run after it
+ * Outputs: unsigned int - how many instrs got fast-forwarded through
+ * Function: called at every jump back, before the jump is counted; if the loop
+ * 			 provably does nothing, counts as many whole iterations of it as
+ * 			 fit in the budget as run, without running them
+ *
+***************************************/
+unsigned int idle_loop_skip( em6502 *emu, unsigned short head, unsigned short tail, unsigned int budget )
+{
+	idle_loop *loop = &emu->idle;
+	unsigned int length;
+	unsigned int skip = 0;
+	#ifdef ENABLE_CYCLE_COUNT
+	unsigned long long loop_cycles;
+	#endif
+
+	if ( !emu->idle_skip )
+	{
+		return 0;
+	}
+
+	if ( !loop->seen || loop->head != head || loop->tail != tail )
+	{
+		//a different loop
+		loop->seen = 1;
+		loop->busy = 0;
+		loop->head = head;
+		loop->tail = tail;
+	}
+	else if ( loop->busy )
+	{
+		//stays that way until another loop comes along; if its code gets rewritten
+		//without one, the worst that happens is we keep running it the slow way
+		return 0;
+	}
+	else if ( loop->Acc == emu->Acc && loop->X == emu->X && loop->Y == emu->Y &&
+			  loop->P == emu->P && loop->S == emu->S )
+	{
+		length = idle_loop_length(emu, head, tail);
+		if ( length == 0 )
+		{
+			loop->busy = 1;
+			return 0;
+		}
+
+		//and it really was just the loop that ran since then
+		if ( emu->instr_count - loop->instr_count == length )
+		{
+			skip = budget / length;
+
+			#ifdef ENABLE_CYCLE_COUNT
+			//every iteration takes the same cycles, and the last one skipped
+			//has to start before the cycle budget runs out
+			loop_cycles = emu->cycles - loop->cycles;
+			if ( emu->cycles >= emu->cycle_limit )
+			{
+				skip = 0;
+			}
+			else if ( (emu->cycle_limit - emu->cycles) / loop_cycles < skip )
+			{
+				skip = (emu->cycle_limit - emu->cycles) / loop_cycles;
+			}
+			emu->cycles += skip * loop_cycles;
+			#endif
+
+			skip *= length;
+			emu->instr_count += skip;
+			loop->skipped += skip;
+		}
+	}
+
+	loop->instr_count = emu->instr_count;
+	#ifdef ENABLE_CYCLE_COUNT
+	loop->cycles = emu->cycles;
+	#endif
+	loop->Acc = emu->Acc;
+	loop->X = emu->X;
+	loop->Y = emu->Y;
+	loop->P = emu->P;
+	loop->S = emu->S;
+
+	return skip;
+}
+
+#endif
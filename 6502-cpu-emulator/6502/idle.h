@@ -0,0 +1,24 @@
+#ifndef IDLE_H
+#define IDLE_H
+
+#include "em_6502.h"
+
+#ifdef ENABLE_IDLE_SKIP
+
+/**************************************
+ * Name:  idle_loop_skip
+ * Inputs:  em6502 * - the 6502 object
+ * 			unsigned short - addr being jumped back to
+ * 			unsigned short - addr of the instr jumping back
+ * 			unsigned int - how many more instrs run_program can run after it
+ * Outputs: unsigned int - how many instrs got fast-forwarded through
+ * Function: called at every jump back, before the jump is counted; if the loop
+ * 			 provably does nothing, counts as many whole iterations of it as
+ * 			 fit in the budget as run, without running them
+ *
+***************************************/
+unsigned int idle_loop_skip( em6502 *, unsigned short, unsigned short, unsigned int );
+
+#endif
+
+#endif /* IDLE_H */
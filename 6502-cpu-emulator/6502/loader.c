@@ -0,0 +1,418 @@
+/* This is the program loader; it takes images in a few formats, with the addrs they load at in them  */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "assert.h"
+
+#include "loader.h"
+#include "rom.h"
+
+#ifdef ENABLE_LOADER
+
+/*
+ * An image gets parsed all the way through before anything is loaded, so a
+ * malformed one leaves the emulator as it was. Parsing just finds the runs of
+ * bytes the image loads: for the binary formats they're left where they are in
+ * it, and HEX records get decoded into a 64K scratch buffer at their own addrs,
+ * so records that follow on from each other come out as a single run. Each run
+ * then goes in with one load_memory, a memcpy per run of pages.
+ */
+
+//where to run an XEX from, if it loads anything here
+#define XEX_RUNAD 0x02E0
+
+//an image on its way in
+typedef struct {
+	image_info info;
+	const unsigned char *bytes[MAX_IMAGE_SEGMENTS]; //what each segment loads
+	unsigned char *scratch; //HEX's decoded bytes, at their addrs
+	int has_entry; //whether the image said where to start
+}parsed_image;
+
+//adds a run of bytes to the image, onto the end of the last one when it carries straight on from it
+static int add_segment( parsed_image *image, unsigned int addr, const unsigned char *bytes, unsigned int size )
+{
+	unsigned int last = image->info.num_segments - 1;
+
+	if ( addr + size > MEMORY_SIZE )
+	{
+		return 0;
+	}
+
+	if ( size == 0 )
+	{
+		return 1;
+	}
+
+	if ( image->info.num_segments > 0 && image->info.segments[last].addr + image->info.segments[last].size == addr &&
+		 image->bytes[last] + image->info.segments[last].size == bytes )
+	{
+		image->info.segments[last].size += size;
+		return 1;
+	}
+
+	if ( image->info.num_segments == MAX_IMAGE_SEGMENTS )
+	{
+		return 0;
+	}
+
+	image->info.segments[image->info.num_segments].addr = addr;
+	image->info.segments[image->info.num_segments].size = size;
+	image->bytes[image->info.num_segments] = bytes;
+	image->info.num_segments++;
+	return 1;
+}
+
+//PRG: the load addr, then the bytes
+static int parse_prg( parsed_image *image, const unsigned char *data, size_t size )
+{
+	unsigned int addr;
+
+	if ( size < 2 )
+	{
+		return 0;
+	}
+
+	addr = data[0] | (data[1] << 8);
+	image->info.entry = addr;
+	image->has_entry = 1;
+
+	return size - 2 <= MEMORY_SIZE && add_segment(image, addr, data + 2, size - 2);
+}
+
+//XEX: $FF $FF, then start, end, bytes for each segment; any of them can have another $FF $FF in front
+static int parse_xex( parsed_image *image, const unsigned char *data, size_t size )
+{
+	unsigned int start;
+	unsigned int end;
+	unsigned int runad = 0;
+	unsigned char runad_seen = 0; //bit 0 for the low byte, bit 1 for the high one
+	size_t pos = 2;
+
+	if ( size < 2 || data[0] != 0xFF || data[1] != 0xFF )
+	{
+		return 0;
+	}
+
+	while ( pos < size )
+	{
+		if ( pos + 2 <= size && data[pos] == 0xFF && data[pos + 1] == 0xFF )
+		{
+			pos += 2;
+			continue;
+		}
+
+		if ( pos + 4 > size )
+		{
+			return 0;
+		}
+
+		start = data[pos] | (data[pos + 1] << 8);
+		end = data[pos + 2] | (data[pos + 3] << 8);
+		pos += 4;
+
+		if ( end < start || end - start + 1 > size - pos )
+		{
+			return 0;
+		}
+
+		if ( !add_segment(image, start, data + pos, end - start + 1) )
+		{
+			return 0;
+		}
+
+		//the last segment to write RUNAD says where to go
+		if ( start <= XEX_RUNAD && end >= XEX_RUNAD )
+		{
+			runad = (runad & 0xFF00) | data[pos + XEX_RUNAD - start];
+			runad_seen |= 1;
+		}
+		if ( start <= XEX_RUNAD + 1 && end >= XEX_RUNAD + 1 )
+		{
+			runad = (runad & 0x00FF) | (data[pos + XEX_RUNAD + 1 - start] << 8);
+			runad_seen |= 2;
+		}
+
+		pos += end - start + 1;
+	}
+
+	if ( runad_seen == 3 )
+	{
+		image->info.entry = runad;
+		image->has_entry = 1;
+	}
+
+	return 1;
+}
+
+//a hex digit's value, -1 if it isnt one
+static int hex_digit( unsigned char c )
+{
+	if ( c >= '0' && c <= '9' )
+	{
+		return c - '0';
+	}
+	if ( c >= 'A' && c <= 'F' )
+	{
+		return c - 'A' + 10;
+	}
+	if ( c >= 'a' && c <= 'f' )
+	{
+		return c - 'a' + 10;
+	}
+	return -1;
+}
+
+//HEX: a record a line, each :, count, addr, type, data and checksum in hex digits
+static int parse_hex( parsed_image *image, const unsigned char *data, size_t size )
+{
+	unsigned char record[5 + 255]; //count, addr, type, data, checksum
+	unsigned char sum;
+	unsigned int base = 0; //from the extended address records
+	unsigned int addr;
+	unsigned int count;
+	unsigned int i;
+	int high;
+	int low;
+	size_t pos = 0;
+
+	image->scratch = (unsigned char *)malloc(MEMORY_SIZE);
+
+	while ( 1 )
+	{
+		while ( pos < size && (data[pos] == '\r' || data[pos] == '\n' || data[pos] == ' ' || data[pos] == '\t') )
+		{
+			pos++;
+		}
+
+		//ran out before the end of file record
+		if ( pos >= size || data[pos] != ':' || size - pos < 11 )
+		{
+			return 0;
+		}
+		pos++;
+
+		//the count says how long the rest of it is
+		count = 5;
+		for ( i = 0; i < count; i++ )
+		{
+			high = hex_digit(data[pos]);
+			low = hex_digit(data[pos + 1]);
+			if ( high < 0 || low < 0 )
+			{
+				return 0;
+			}
+			record[i] = (high << 4) | low;
+			pos += 2;
+
+			if ( i == 0 )
+			{
+				count = 5 + record[0];
+				if ( size - pos < (count - 1) * 2 )
+				{
+					return 0;
+				}
+			}
+		}
+
+		sum = 0;
+		for ( i = 0; i < count; i++ )
+		{
+			sum += record[i];
+		}
+		if ( sum != 0 )
+		{
+			return 0;
+		}
+
+		addr = (record[1] << 8) | record[2];
+		switch ( record[3] )
+		{
+			case 0x00: //data
+				if ( base >= MEMORY_SIZE || base + addr + record[0] > MEMORY_SIZE )
+				{
+					return 0;
+				}
+				memcpy(&image->scratch[base + addr], &record[4], record[0]);
+				if ( !add_segment(image, base + addr, &image->scratch[base + addr], record[0]) )
+				{
+					return 0;
+				}
+				break;
+
+			case 0x01: //end of file
+				return 1;
+
+			case 0x02: //extended segment address, in paragraphs
+			case 0x04: //extended linear address, in 64K's; only 0 has anything in it for us
+				if ( record[0] != 2 )
+				{
+					return 0;
+				}
+				base = ((record[4] << 8) | record[5]) << (record[3] == 0x02 ? 4 : 16);
+				break;
+
+			case 0x03: //start segment address, CS:IP
+			case 0x05: //start linear address
+				if ( record[0] != 4 )
+				{
+					return 0;
+				}
+				if ( record[3] == 0x03 )
+				{
+					addr = (((record[4] << 8) | record[5]) << 4) + ((record[6] << 8) | record[7]);
+				}
+				else
+				{
+					addr = ((unsigned int)record[4] << 24) | (record[5] << 16) | (record[6] << 8) | record[7];
+				}
+				if ( addr >= MEMORY_SIZE )
+				{
+					return 0;
+				}
+				image->info.entry = addr;
+				image->has_entry = 1;
+				break;
+
+			default:
+				return 0;
+		}
+	}
+}
+
+
+/**************************************
+ * Name:  load_image
+ * Inputs:  em6502 * - the 6502 object
+ * 			const unsigned char * - the image
+ * 			size_t - its size
+ * 			int - its format, one of IMAGE_*
+ * 			unsigned int - where a RAW image goes
+ * 			image_info * - filled in with where it went and where it starts, can be 0
+ * Outputs: int - 1 if it loaded, 0 if nothing was
+ * Function: parses the image, then loads its segments and sets PC
+ *
+***************************************/
+int load_image( em6502 *emu, const unsigned char *data, size_t size, int format, unsigned int addr, image_info *info )
+{
+	parsed_image image;
+	int parsed = 0;
+	unsigned int i;
+
+	memset(&image, 0, sizeof(image));
+
+	if ( format == IMAGE_AUTO )
+	{
+		if ( size > 0 && data[0] == ':' )
+		{
+			format = IMAGE_HEX;
+		}
+		else if ( size >= 2 && data[0] == 0xFF && data[1] == 0xFF )
+		{
+			format = IMAGE_XEX;
+		}
+		else
+		{
+			format = IMAGE_RAW;
+		}
+	}
+
+	switch ( format )
+	{
+		case IMAGE_RAW:
+			image.info.entry = addr;
+			image.has_entry = 1;
+			parsed = addr <= MEMORY_SIZE && size <= MEMORY_SIZE - addr && add_segment(&image, addr, data, size);
+			break;
+
+		case IMAGE_PRG:
+			parsed = parse_prg(&image, data, size);
+			break;
+
+		case IMAGE_HEX:
+			parsed = parse_hex(&image, data, size);
+			break;
+
+		case IMAGE_XEX:
+			parsed = parse_xex(&image, data, size);
+			break;
+	}
+
+	if ( parsed )
+	{
+		for ( i = 0; i < image.info.num_segments; i++ )
+		{
+			load_memory(emu, image.bytes[i], image.info.segments[i].size, image.info.segments[i].addr);
+		}
+
+		//with nothing to say where it starts, it starts at the start
+		if ( !image.has_entry && image.info.num_segments > 0 )
+		{
+			image.info.entry = image.info.segments[0].addr;
+		}
+		emu->PC = image.info.entry;
+
+		image.info.format = format;
+		if ( info != 0 )
+		{
+			*info = image.info;
+		}
+	}
+
+	free(image.scratch);
+	return parsed;
+}
+
+
+/**************************************
+ * Name:  load_image_file
+ * Inputs:  em6502 * - the 6502 object
+ * 			const char * - path of the image
+ * 			int - its format, one of IMAGE_*
+ * 			unsigned int - where a RAW image goes
+ * 			image_info * - filled in like load_image does, can be 0
+ * Outputs: int - 1 if it loaded, 0 if not
+ * Function: load_image on a file
+ *
+***************************************/
+int load_image_file( em6502 *emu, const char *path, int format, unsigned int addr, image_info *info )
+{
+	int loaded;
+
+	#ifdef ENABLE_ROM_MAPPING
+	rom_image rom;
+
+	if ( !open_rom(&rom, path) )
+	{
+		return 0;
+	}
+
+	loaded = load_image(emu, rom.data, rom.size, format, addr, info);
+	close_rom(&rom);
+	#else
+	unsigned char *buffer;
+	FILE *file;
+	long size;
+
+	file = fopen(path, "rb");
+	if ( file == 0 )
+	{
+		return 0;
+	}
+
+	fseek(file, 0, SEEK_END);
+	size = ftell(file);
+	rewind(file);
+
+	buffer = (unsigned char *)malloc(size > 0 ? size : 1);
+	loaded = size >= 0 && fread(buffer, 1, size, file) == (size_t)size &&
+			 load_image(emu, buffer, size, format, addr, info);
+
+	fclose(file);
+	free(buffer);
+	#endif
+
+	return loaded;
+}
+
+#endif
@@ -0,0 +1,70 @@
+#ifndef LOADER_H
+#define LOADER_H
+
+#include <stddef.h>
+
+#include "em_6502.h"
+
+#ifdef ENABLE_LOADER
+
+//formats load_image understands
+#define IMAGE_AUTO 0 //HEX if it starts with ':', XEX if it starts with $FF $FF, RAW otherwise
+#define IMAGE_RAW 1 //just the bytes; they go wherever they're told to
+#define IMAGE_PRG 2 //a 2-byte little-endian load addr, then the bytes
+#define IMAGE_HEX 3 //Intel HEX text; data can go anywhere, and a start record says where to run
+#define IMAGE_XEX 4 //Atari DOS binary; $FF $FF, then segments of start, end (inclusive) and bytes
+
+//most runs of bytes an image can load in
+#define MAX_IMAGE_SEGMENTS 64
+
+//a run of bytes an image loaded
+typedef struct {
+	unsigned short addr; //where it starts
+	unsigned int size; //bytes in it, up to all 64K
+}image_segment;
+
+//what load_image found in an image
+typedef struct {
+	int format; //one of IMAGE_*, never IMAGE_AUTO
+	unsigned short entry; //where it starts running; PC gets set to it
+	unsigned int num_segments;
+	image_segment segments[MAX_IMAGE_SEGMENTS]; //in the order they were loaded; later ones win where they overlap
+}image_info;
+
+
+/**************************************
+ * Name:  load_image
+ * Inputs:  em6502 * - the 6502 object
+ * 			const unsigned char * - the image
+ * 			size_t - its size
+ * 			int - its format, one of IMAGE_*
+ * 			unsigned int - where a RAW image goes; any addr
+ * 			image_info * - filled in with where it went and where it starts, can be 0
+ * Outputs: int - 1 if it loaded, 0 if it's malformed or doesnt fit below $10000;
+ * 			 then nothing was loaded
+ * Function: loads each contiguous run of bytes in the image with a single load_memory,
+ * 			 straight out of the image for the binary formats, and points PC at its entry:
+ * 			 the load addr for RAW and PRG, the start record for HEX and RUNAD ($02E0)
+ * 			 for XEX, or their first segment if they dont have one
+ *
+***************************************/
+int load_image( em6502 *, const unsigned char *, size_t, int, unsigned int, image_info * );
+
+
+/**************************************
+ * Name:  load_image_file
+ * Inputs:  em6502 * - the 6502 object
+ * 			const char * - path of the image
+ * 			int - its format, one of IMAGE_*
+ * 			unsigned int - where a RAW image goes
+ * 			image_info * - filled in like load_image does, can be 0
+ * Outputs: int - 1 if it loaded, 0 if it couldnt be read or load_image wouldnt take it
+ * Function: load_image on a file; where ROMs can be mapped it's read through
+ * 			 the mapping, with no buffer in between
+ *
+***************************************/
+int load_image_file( em6502 *, const char *, int, unsigned int, image_info * );
+
+#endif
+
+#endif /* LOADER_H */
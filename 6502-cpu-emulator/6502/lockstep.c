@@ -0,0 +1,775 @@
+/* This is the lockstep engine; it runs the same program on many emulators at once, a SIMD lane each  */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "lockstep.h"
+
+#ifdef ENABLE_LOCKSTEP
+
+/*
+ * Parameter sweeps run a program over and over from slightly different starting states,
+ * and the runs mostly go through the same instrs in the same order. Here each run is a
+ * lane, and the lanes at the same instr run it together: each register is a vector with
+ * a byte per lane, so an LDA or an ADC is a handful of SIMD instrs for all of them, with
+ * the lanes that arent at that instr masked out.
+ *
+ * Each step, run_lockstep takes the lowest PC any lane still running is at, and runs the
+ * instr there on every lane that's at it, with the same bytes there. Lanes that went the
+ * other way at a branch wait their turn; running the ones furthest behind first is what
+ * brings them back together where the two sides of an if join up again.
+ *
+ * Memory is interleaved a byte from each lane at a time, so an addr that's the same in
+ * every lane (zero page, absolute, the stack while the lanes' S agree) is a single vector
+ * load or store too. Indexed addrs that differ between lanes get read and written a lane
+ * at a time.
+ *
+ * The instrs are the interpreter's from em_6502.c, done a vector at a time: the same flags
+ * (kept the way ENABLE_LAZY_FLAGS keeps them), the same cycle counts and the same quirks,
+ * so a lane ends up exactly where run_program would have left it on its own.
+ */
+
+#if LOCKSTEP_LANES != 8 && LOCKSTEP_LANES != 16 && LOCKSTEP_LANES != 32
+	#error "LOCKSTEP_LANES has to be 8, 16 or 32"
+#endif
+
+//on x86-64, run_lockstep is built for AVX2 as well as for plain x86-64;
+//the loader picks whichever the host can run
+#if defined(__x86_64__) && defined(__linux__) && !defined(__AVX2__)
+	#define LOCKSTEP_TARGET __attribute__((target_clones("avx2","default")))
+#else
+	#define LOCKSTEP_TARGET
+#endif
+
+//so the helpers get built into each of those, rather than called with vectors the other one cant pass
+//they take their vectors by pointer all the same; a vector passed or returned by value is
+//one the default clone would pass differently than AVX code (gcc warns about it, -Wpsabi)
+#define LANE_HELPER static inline __attribute__((always_inline))
+
+//a byte of every lane; the registers, flags and rows of memory are these
+//aligned(1) so they can be loaded from anywhere, may_alias since they're read out of unsigned char arrays
+typedef unsigned char lane_bytes __attribute__((vector_size(LOCKSTEP_LANES), aligned(1), may_alias));
+
+//an addr for every lane
+typedef unsigned short lane_addrs __attribute__((vector_size(LOCKSTEP_LANES * 2), aligned(1), may_alias));
+
+//and a counter
+typedef unsigned int lane_counts __attribute__((vector_size(LOCKSTEP_LANES * 4), aligned(1), may_alias));
+typedef unsigned long long lane_cycles __attribute__((vector_size(LOCKSTEP_LANES * 8), aligned(1), may_alias));
+
+//what comparing lane_bytes/lane_addrs gives: -1 in the lanes it holds in, 0 in the rest
+typedef signed char lane_flags __attribute__((vector_size(LOCKSTEP_LANES)));
+typedef short lane_addr_flags __attribute__((vector_size(LOCKSTEP_LANES * 2)));
+
+//most cycles a single instr can take, page crossings and taken branches included
+#define MAX_INSTR_CYCLES 7
+
+//the same value in every lane
+#define SPLAT(val) ((lane_bytes){0} + (unsigned char)(val))
+#define SPLAT_ADDR(val) ((lane_addrs){0} + (unsigned short)(val))
+
+//each lane's byte, as an addr
+#define WIDEN(bytes) __builtin_convertvector((bytes), lane_addrs)
+
+//0xFF in the lanes where a comparison of lane_bytes/lane_addrs holds, 0 in the rest
+#define LANES_WHERE(cond) ((lane_bytes)(cond))
+#define ADDR_LANES_WHERE(cond) ((lane_bytes)__builtin_convertvector((cond), lane_flags))
+
+//a lane mask, for lane_addrs
+#define ADDR_MASK(mask) ((lane_addrs)__builtin_convertvector((lane_flags)(mask), lane_addr_flags))
+
+//a in the lanes mask is set in, b in the rest
+#define SELECT(mask,a,b) (((a) & (mask)) | ((b) & ~(mask)))
+
+//addr's byte in every lane
+#define ROW(addr) (*(lane_bytes *)&ls->memory[(unsigned int)(unsigned short)(addr) * LOCKSTEP_LANES])
+
+
+//a bit per lane, set for the ones whose byte has its top bit set
+LANE_HELPER unsigned int lane_bits( const lane_bytes *v )
+{
+	unsigned long long word;
+	unsigned int bits = 0;
+	unsigned int i;
+
+	for ( i = 0; i < LOCKSTEP_LANES / 8; i++ )
+	{
+		//gathers the top bit of each of the 8 bytes into the top byte
+		memcpy(&word, (const unsigned char *)v + i * 8, 8);
+		bits |= (unsigned int)(((word & 0x8080808080808080ULL) * 0x0002040810204081ULL) >> 56) << (i * 8);
+	}
+
+	return bits;
+}
+
+//lane_bits of any lane_bytes expression
+#define LANE_BITS(v) ({ lane_bytes lane_bits_of = (v); lane_bits(&lane_bits_of); })
+
+//puts the byte at ea in each of the lanes in bits into val; lead is one of them
+LANE_HELPER void read_lanes( lockstep *ls, const lane_addrs *ea, unsigned int bits, unsigned int lead, lane_bytes *val )
+{
+	unsigned int lane;
+
+	*val = ROW((*ea)[lead]);
+
+	//one load covers every lane whose ea is the same as the lead's; the rest get theirs one at a time
+	bits &= ~LANE_BITS(ADDR_LANES_WHERE(*ea == (*ea)[lead]));
+	for ( ; bits != 0; bits &= bits - 1 )
+	{
+		lane = __builtin_ctz(bits);
+		(*val)[lane] = ls->memory[(*ea)[lane] * LOCKSTEP_LANES + lane];
+	}
+}
+
+//writes val to ea in each of the lanes in run (and bits); lead is one of them
+LANE_HELPER void write_lanes( lockstep *ls, const lane_addrs *ea, const lane_bytes *val, const lane_bytes *run,
+							  unsigned int bits, unsigned int lead )
+{
+	lane_bytes same = *run & ADDR_LANES_WHERE(*ea == (*ea)[lead]);
+	unsigned int lane;
+
+	ROW((*ea)[lead]) = SELECT(same, *val, ROW((*ea)[lead]));
+
+	bits &= ~lane_bits(&same);
+	for ( ; bits != 0; bits &= bits - 1 )
+	{
+		lane = __builtin_ctz(bits);
+		ls->memory[(*ea)[lane] * LOCKSTEP_LANES + lane] = (*val)[lane];
+	}
+}
+
+//read_lanes/write_lanes on the lanes running the instr, for addrs and bytes that are expressions
+#define READ_LANES(addrs) \
+	({ lane_addrs read_ea = (addrs); lane_bytes read_val; read_lanes(ls, &read_ea, run_bits, lead, &read_val); read_val; })
+#define WRITE_LANES(addrs,val) \
+	do { \
+		lane_addrs write_ea = (addrs); \
+		lane_bytes write_val = (val); \
+		write_lanes(ls, &write_ea, &write_val, &run, run_bits, lead); \
+	} while (0)
+
+
+//***********************>>>LANES<<<*************************
+//sets reg in the lanes running the instr, leaves it alone in the rest
+#define SET_LANES(reg,val) reg = SELECT(run, (val), reg)
+#define SET_PC_LANES(val) reg_pc = SELECT(run_addrs, (val), reg_pc)
+
+//moves the lanes running the instr on to the next one
+#define NEXT_PC(len) SET_PC_LANES(SPLAT_ADDR(pc + (len)))
+
+//the lanes running the instr stop at it, rather than running it
+#define STOP_LANES(reason) { halt = (reason); break; }
+
+
+//***********************>>>ADDRESSING MODES<<<*************************
+//same as in em_6502.c; EA_<mode> works out ea, READ_<mode>/WRITE_<mode> get and put the operand
+//op1/op2/operand are the same in every lane running the instr, and so is pc
+#define EA_NONE
+#define EA_IMPLIED
+#define EA_ACCUM
+#define EA_IMMEDIATE
+#define EA_Z_PAGE
+#define EA_Z_PAGE_X ea = WIDEN(reg_x + op1)
+#define EA_Z_PAGE_Y ea = WIDEN(reg_y + op1)
+//the interpreter doesnt keep the pointer in the zero page, so neither does this
+#define EA_IND_X \
+	ea = WIDEN(reg_x) + op1; \
+	ea = WIDEN(READ_LANES(ea)) | WIDEN(READ_LANES(ea + 1)) << 8
+#define EA_IND_Y ea = (WIDEN(ROW(op1)) | WIDEN(ROW(op1 + 1)) << 8) + WIDEN(reg_y)
+#define EA_ABS_X ea = WIDEN(reg_x) + operand
+#define EA_ABS_Y ea = WIDEN(reg_y) + operand
+#define EA_ABSOLUTE
+//the pointer's high byte comes from the same page as its low byte, like the interpreter
+#define EA_INDIRECT ea = WIDEN(ROW(operand)) | WIDEN(ROW((operand & 0xFF00) | (unsigned char)(op1 + 1))) << 8
+#define EA_RELATIVE target = pc + 2 + (signed char)op1
+
+#define READ_ACCUM reg_a
+#define READ_IMMEDIATE SPLAT(op1)
+#define READ_Z_PAGE ROW(op1)
+#define READ_Z_PAGE_X READ_LANES(ea)
+#define READ_Z_PAGE_Y READ_LANES(ea)
+#define READ_IND_X READ_LANES(ea)
+#define READ_IND_Y READ_LANES(ea)
+#define READ_ABS_X READ_LANES(ea)
+#define READ_ABS_Y READ_LANES(ea)
+#define READ_ABSOLUTE ROW(operand)
+
+#define WRITE_ACCUM(val) SET_LANES(reg_a, val)
+#define WRITE_Z_PAGE(val) ROW(op1) = SELECT(run, (val), ROW(op1))
+#define WRITE_Z_PAGE_X(val) WRITE_LANES(ea, (val))
+#define WRITE_Z_PAGE_Y(val) WRITE_LANES(ea, (val))
+#define WRITE_IND_X(val) WRITE_LANES(ea, (val))
+#define WRITE_IND_Y(val) WRITE_LANES(ea, (val))
+#define WRITE_ABS_X(val) WRITE_LANES(ea, (val))
+#define WRITE_ABS_Y(val) WRITE_LANES(ea, (val))
+#define WRITE_ABSOLUTE(val) ROW(operand) = SELECT(run, (val), ROW(operand))
+
+//push/pull a byte on each lane's stack
+#define STACK_ADDRS (WIDEN(reg_s) | 0x0100)
+#define PUSH(val) \
+	WRITE_LANES(STACK_ADDRS, (val)); \
+	SET_LANES(reg_s, reg_s - 1)
+
+#define PULL(dest) \
+	SET_LANES(reg_s, reg_s + 1); \
+	SET_LANES(dest, READ_LANES(STACK_ADDRS))
+
+//the addr each lane has at the top of its stack; S+1 stays in the stack page
+#define PULL_ADDR \
+	WIDEN(READ_LANES(STACK_ADDRS)) | \
+	WIDEN(READ_LANES(WIDEN((lane_bytes)(reg_s + 1)) | 0x0100)) << 8
+
+
+//***********************>>>CYCLES<<<*************************
+//1 in the lanes where indexing took ea into the next page
+#define PAGE_CROSSED(index) (ADDR_LANES_WHERE((ea ^ (ea - WIDEN(index))) > 0xFF) & 1)
+#define PAGE_CROSSED_NONE 0
+#define PAGE_CROSSED_IMPLIED 0
+#define PAGE_CROSSED_ACCUM 0
+#define PAGE_CROSSED_IMMEDIATE 0
+#define PAGE_CROSSED_Z_PAGE 0
+#define PAGE_CROSSED_Z_PAGE_X 0
+#define PAGE_CROSSED_Z_PAGE_Y 0
+#define PAGE_CROSSED_IND_X 0
+#define PAGE_CROSSED_IND_Y PAGE_CROSSED(reg_y)
+#define PAGE_CROSSED_ABS_X PAGE_CROSSED(reg_x)
+#define PAGE_CROSSED_ABS_Y PAGE_CROSSED(reg_y)
+#define PAGE_CROSSED_ABSOLUTE 0
+#define PAGE_CROSSED_INDIRECT 0
+#define PAGE_CROSSED_RELATIVE 0 //branches count their own, see BRANCH_IF
+
+//the cycles the instr takes in each lane, once ea is worked out
+#define INSTR_CYCLES(cycles,penalty,mode) \
+	cyc = SPLAT(cycles); \
+	if ( penalty ) cyc += PAGE_CROSSED_##mode
+
+
+//***********************>>>FLAGS<<<*************************
+#define SET_NZ(val) SET_LANES(flag_n, val); SET_LANES(flag_z, val)
+
+//P with N/Z/C/V put back in, like PACK_FLAGS
+#define PACKED_P \
+	((reg_p & 0x3C) | (flag_n & 0x80) | (LANES_WHERE(flag_z == 0) & 0x02) | flag_c | (flag_v & 0x80) >> 1)
+
+#define FLAGS_TO_P SET_LANES(reg_p, PACKED_P)
+#define FLAGS_FROM_P \
+	SET_LANES(flag_n, reg_p); \
+	SET_LANES(flag_z, ~reg_p & 0x02); \
+	SET_LANES(flag_c, reg_p & 0x01); \
+	SET_LANES(flag_v, reg_p << 1)
+
+
+//***********************>>>INSTRUCTIONS<<<*************************
+//see em_6502.c for what each of these does, and why
+#define LOAD_REG(reg,mode,len) \
+	SET_LANES(reg, READ_##mode); \
+	NEXT_PC(len); \
+	SET_NZ(reg)
+
+#define INSTR_LDA(mode,len) LOAD_REG(reg_a,mode,len)
+#define INSTR_LDX(mode,len) LOAD_REG(reg_x,mode,len)
+#define INSTR_LDY(mode,len) LOAD_REG(reg_y,mode,len)
+
+#define STORE_REG(reg,mode,len) \
+	WRITE_##mode(reg); \
+	NEXT_PC(len)
+
+#define INSTR_STA(mode,len) STORE_REG(reg_a,mode,len)
+#define INSTR_STX(mode,len) STORE_REG(reg_x,mode,len)
+#define INSTR_STY(mode,len) STORE_REG(reg_y,mode,len)
+
+#define INSTR_CLC(mode,len) SET_LANES(flag_c, SPLAT(0)); NEXT_PC(len)
+#define INSTR_CLD(mode,len) SET_LANES(reg_p, reg_p & 0xF7); NEXT_PC(len)
+#define INSTR_CLV(mode,len) SET_LANES(flag_v, SPLAT(0)); NEXT_PC(len)
+#define INSTR_SEC(mode,len) SET_LANES(flag_c, SPLAT(1)); NEXT_PC(len)
+#define INSTR_SED(mode,len) SET_LANES(reg_p, reg_p | 0x08); NEXT_PC(len)
+#define INSTR_CLI(mode,len) SET_LANES(reg_p, reg_p & 0xFB); NEXT_PC(len)
+#define INSTR_SEI(mode,len) SET_LANES(reg_p, reg_p | 0x04); NEXT_PC(len)
+
+//C and V come from A and M alone, the carry in only goes into the result
+#define INSTR_ADC(mode,len) \
+	ch1 = reg_a; \
+	ch2 = READ_##mode; \
+	res = ch1 + ch2; \
+	SET_LANES(reg_a, res + flag_c); \
+	NEXT_PC(len); \
+	SET_NZ(reg_a); \
+	SET_LANES(flag_c, LANES_WHERE(res < ch1) & 1); \
+	SET_LANES(flag_v, ~(ch1 ^ ch2) & (ch1 ^ res))
+
+#define INSTR_SBC(mode,len) \
+	ch1 = reg_a; \
+	ch2 = READ_##mode + (flag_c ^ 1); \
+	res = ch1 - ch2; \
+	SET_LANES(reg_a, res); \
+	NEXT_PC(len); \
+	SET_NZ(reg_a); \
+	SET_LANES(flag_c, LANES_WHERE(ch1 >= ch2) & 1); \
+	SET_LANES(flag_v, (ch1 ^ ch2) & (ch1 ^ res))
+
+#define LOGIC_OP(op,mode,len) \
+	res = reg_a op READ_##mode; \
+	SET_LANES(reg_a, res); \
+	NEXT_PC(len); \
+	SET_NZ(reg_a)
+
+#define INSTR_AND(mode,len) LOGIC_OP(&,mode,len)
+#define INSTR_EOR(mode,len) LOGIC_OP(^,mode,len)
+#define INSTR_ORA(mode,len) LOGIC_OP(|,mode,len)
+
+#define INSTR_BIT(mode,len) \
+	ch1 = READ_##mode; \
+	SET_LANES(flag_z, reg_a & ch1); \
+	SET_LANES(flag_n, ch1); \
+	SET_LANES(flag_v, ch1 << 1); \
+	NEXT_PC(len)
+
+#define COMPARE_REG(reg,mode,len) \
+	ch1 = reg; \
+	ch2 = READ_##mode; \
+	res = ch1 - ch2; \
+	NEXT_PC(len); \
+	SET_NZ(res); \
+	SET_LANES(flag_c, LANES_WHERE(ch1 >= ch2) & 1)
+
+#define INSTR_CMP(mode,len) COMPARE_REG(reg_a,mode,len)
+#define INSTR_CPX(mode,len) COMPARE_REG(reg_x,mode,len)
+#define INSTR_CPY(mode,len) COMPARE_REG(reg_y,mode,len)
+
+#define STEP_MEM(op,mode,len) \
+	ch1 = READ_##mode op 1; \
+	WRITE_##mode(ch1); \
+	NEXT_PC(len); \
+	SET_NZ(ch1)
+
+#define INSTR_INC(mode,len) STEP_MEM(+,mode,len)
+#define INSTR_DEC(mode,len) STEP_MEM(-,mode,len)
+
+#define STEP_REG(reg,op,len) \
+	SET_LANES(reg, reg op 1); \
+	NEXT_PC(len); \
+	SET_NZ(reg)
+
+#define INSTR_DEX(mode,len) STEP_REG(reg_x,-,len)
+#define INSTR_DEY(mode,len) STEP_REG(reg_y,-,len)
+#define INSTR_INX(mode,len) STEP_REG(reg_x,+,len)
+#define INSTR_INY(mode,len) STEP_REG(reg_y,+,len)
+
+#define TRANSFER_REG(dest,src,len) \
+	SET_LANES(dest, src); \
+	NEXT_PC(len); \
+	SET_NZ(dest)
+
+#define INSTR_TAX(mode,len) TRANSFER_REG(reg_x,reg_a,len)
+#define INSTR_TAY(mode,len) TRANSFER_REG(reg_y,reg_a,len)
+#define INSTR_TSX(mode,len) TRANSFER_REG(reg_x,reg_s,len)
+#define INSTR_TXA(mode,len) TRANSFER_REG(reg_a,reg_x,len)
+#define INSTR_TYA(mode,len) TRANSFER_REG(reg_a,reg_y,len)
+
+#define INSTR_TXS(mode,len) SET_LANES(reg_s, reg_x); NEXT_PC(len)
+
+#define INSTR_ASL(mode,len) \
+	ch1 = READ_##mode; \
+	ch2 = ch1 >> 7; \
+	ch1 = ch1 << 1; \
+	SET_LANES(flag_c, ch2); \
+	WRITE_##mode(ch1); \
+	NEXT_PC(len); \
+	SET_NZ(ch1)
+
+#define INSTR_LSR(mode,len) \
+	ch1 = READ_##mode; \
+	ch2 = ch1 & 1; \
+	ch1 = ch1 >> 1; \
+	SET_LANES(flag_c, ch2); \
+	WRITE_##mode(ch1); \
+	NEXT_PC(len); \
+	SET_NZ(ch1)
+
+//N goes out into C, the same as the interpreter
+#define INSTR_ROL(mode,len) \
+	ch1 = READ_##mode; \
+	ch2 = flag_n >> 7; \
+	ch1 = ch1 << 1 | flag_c; \
+	SET_LANES(flag_c, ch2); \
+	WRITE_##mode(ch1); \
+	NEXT_PC(len); \
+	SET_NZ(ch1)
+
+#define INSTR_ROR(mode,len) \
+	ch1 = READ_##mode; \
+	ch2 = ch1 & 1; \
+	ch1 = ch1 >> 1 | flag_c << 7; \
+	SET_LANES(flag_c, ch2); \
+	WRITE_##mode(ch1); \
+	NEXT_PC(len); \
+	SET_NZ(ch1)
+
+//JMP abs goes to the same place in every lane, JMP (ind) to wherever each lane's pointer says
+#define JMP_ABSOLUTE SET_PC_LANES(SPLAT_ADDR(operand))
+#define JMP_INDIRECT SET_PC_LANES(ea)
+#define INSTR_JMP(mode,len) JMP_##mode
+
+//the lanes where cond holds branch, and take a cycle more, and another for landing in a different page
+#define BRANCH_IF(cond,len) \
+	taken = run & LANES_WHERE(cond); \
+	cyc += taken & SPLAT(1 + ((target ^ (unsigned short)(pc + (len))) > 0xFF)); \
+	NEXT_PC(len); \
+	reg_pc = SELECT(ADDR_MASK(taken), SPLAT_ADDR(target), reg_pc)
+
+#define INSTR_BCC(mode,len) BRANCH_IF( flag_c == 0, len )
+#define INSTR_BCS(mode,len) BRANCH_IF( flag_c != 0, len )
+#define INSTR_BEQ(mode,len) BRANCH_IF( flag_z == 0, len )
+#define INSTR_BMI(mode,len) BRANCH_IF( (flag_n & 0x80) != 0, len )
+#define INSTR_BNE(mode,len) BRANCH_IF( flag_z != 0, len )
+#define INSTR_BPL(mode,len) BRANCH_IF( (flag_n & 0x80) == 0, len )
+#define INSTR_BVC(mode,len) BRANCH_IF( (flag_v & 0x80) == 0, len )
+#define INSTR_BVS(mode,len) BRANCH_IF( (flag_v & 0x80) != 0, len )
+
+#define INSTR_PHA(mode,len) PUSH(reg_a); NEXT_PC(len)
+#define INSTR_PHP(mode,len) FLAGS_TO_P; PUSH(reg_p); NEXT_PC(len)
+
+#define INSTR_PLA(mode,len) \
+	PULL(reg_a); \
+	NEXT_PC(len); \
+	SET_NZ(reg_a)
+
+#define INSTR_PLP(mode,len) PULL(reg_p); FLAGS_FROM_P; NEXT_PC(len)
+
+#define INSTR_NOP(mode,len) NEXT_PC(len)
+
+#define INSTR_BRK(mode,len) \
+	if ( ls->stop_at_brk ) STOP_LANES(STOP_BRK); \
+	PUSH(SPLAT((pc + 2) >> 8)); \
+	PUSH(SPLAT(pc + 2)); \
+	FLAGS_TO_P; \
+	SET_LANES(reg_p, reg_p | 0x10); \
+	PUSH(reg_p); \
+	SET_LANES(reg_p, reg_p | 0x04); \
+	SET_PC_LANES(WIDEN(ROW(0xFFFE)) | WIDEN(ROW(0xFFFF)) << 8)
+
+#define INSTR_RTI(mode,len) \
+	PULL(reg_p); \
+	FLAGS_FROM_P; \
+	SET_LANES(reg_s, reg_s + 1); \
+	SET_PC_LANES(PULL_ADDR); \
+	SET_LANES(reg_s, reg_s + 1)
+
+#define INSTR_JSR(mode,len) \
+	PUSH(SPLAT((pc + 2) >> 8)); \
+	PUSH(SPLAT(pc + 2)); \
+	SET_PC_LANES(SPLAT_ADDR(operand))
+
+#define INSTR_RTS(mode,len) \
+	SET_LANES(reg_s, reg_s + 1); \
+	SET_PC_LANES(PULL_ADDR); \
+	SET_LANES(reg_s, reg_s + 1); \
+	SET_PC_LANES(reg_pc + 1)
+
+#define INSTR_INVALID(mode,len) STOP_LANES(STOP_INVALID_OPCODE)
+
+
+/**************************************
+ * Name:  run_lockstep
+ * Inputs:  lockstep * - the lanes
+ * 			unsigned int - max number of instructions each lane executes, -1 for all
+ * 			unsigned long long - max number of cycles each lane executes, NO_CYCLE_LIMIT for all
+ * Outputs: None
+ * Function: runs every lane the way run_program_cycles would run it on its own, until
+ * 			 they've all stopped; stop says why each did. Lanes at the same instr run it
+ * 			 together, a SIMD instr for all of them; the rest wait their turn
+ *
+***************************************/
+LOCKSTEP_TARGET
+void run_lockstep( lockstep *ls, unsigned int max_instr_count, unsigned long long max_cycles )
+{
+	//the lanes' registers, kept in locals while they run
+	lane_bytes reg_a = *(lane_bytes *)ls->Acc;
+	lane_bytes reg_x = *(lane_bytes *)ls->X;
+	lane_bytes reg_y = *(lane_bytes *)ls->Y;
+	lane_bytes reg_p = *(lane_bytes *)ls->P;
+	lane_bytes reg_s = *(lane_bytes *)ls->S;
+	lane_addrs reg_pc = *(lane_addrs *)ls->PC;
+	lane_counts instr_count = *(lane_counts *)ls->instr_count;
+	lane_cycles cycles = *(lane_cycles *)ls->cycles;
+	lane_bytes flag_n;
+	lane_bytes flag_z;
+	lane_bytes flag_c;
+	lane_bytes flag_v;
+
+	unsigned int start_count[LOCKSTEP_LANES]; //instr_count each lane started at
+	unsigned long long cycle_limit[LOCKSTEP_LANES]; //and the cycle it has to stop at
+
+	lane_bytes live; //0xFF in the lanes still running
+	unsigned int live_bits; //the same, a bit per lane
+	lane_bytes run; //0xFF in the lanes running this instr
+	lane_addrs run_addrs; //the same, for lane_addrs
+	unsigned int run_bits; //and a bit per lane
+	unsigned int lead; //one of the lanes running it
+	unsigned int safe = 0; //steps left before the budgets need checking again
+	int halt; //STOP_* the lanes running the instr stop at it with, 0 if they ran it
+
+	unsigned short pc; //where the instr is
+	unsigned char opcode;
+	unsigned char op1;
+	unsigned char op2;
+	unsigned short operand;
+	unsigned short target; //where a branch goes
+	lane_addrs ea; //each lane's addr the instr operates on
+	lane_bytes cyc; //cycles it took in each lane
+	lane_bytes taken;
+	lane_bytes ch1;
+	lane_bytes ch2;
+	lane_bytes res;
+
+	unsigned long long room;
+	unsigned int bits;
+	unsigned int lane;
+
+	flag_n = reg_p;
+	flag_z = ~reg_p & 0x02;
+	flag_c = reg_p & 0x01;
+	flag_v = reg_p << 1;
+
+	live_bits = ls->num_lanes >= 32 ? ~0u : (1u << ls->num_lanes) - 1;
+	live_bits &= (1ull << LOCKSTEP_LANES) - 1;
+	for ( lane = 0; lane < LOCKSTEP_LANES; lane++ )
+	{
+		live[lane] = (live_bits >> lane & 1) ? 0xFF : 0;
+		ls->stop[lane] = STOP_BUDGET;
+		start_count[lane] = instr_count[lane];
+
+		//same as run_program_cycles
+		cycle_limit[lane] = cycles[lane] + max_cycles;
+		if ( cycle_limit[lane] < cycles[lane] )
+		{
+			cycle_limit[lane] = NO_CYCLE_LIMIT;
+		}
+	}
+
+	while ( 1 )
+	{
+		if ( safe == 0 )
+		{
+			//drop the lanes that are out of budget, and work out how many steps the rest
+			//are good for before that needs doing again
+			safe = ~0u;
+			for ( bits = live_bits; bits != 0; bits &= bits - 1 )
+			{
+				lane = __builtin_ctz(bits);
+				if ( instr_count[lane] - start_count[lane] == max_instr_count || cycles[lane] >= cycle_limit[lane] )
+				{
+					live_bits &= ~(1u << lane);
+					live[lane] = 0;
+					continue;
+				}
+
+				room = (cycle_limit[lane] - cycles[lane]) / MAX_INSTR_CYCLES;
+				if ( room > max_instr_count - (instr_count[lane] - start_count[lane]) )
+				{
+					room = max_instr_count - (instr_count[lane] - start_count[lane]);
+				}
+				if ( room < safe )
+				{
+					//it has room for 1 more at least, or it would have been dropped
+					safe = room == 0 ? 1 : room;
+				}
+			}
+
+			if ( live_bits == 0 )
+			{
+				break;
+			}
+		}
+		safe--;
+
+		//the lowest PC a lane is at; mostly, they're all at the same one
+		lead = __builtin_ctz(live_bits);
+		pc = reg_pc[lead];
+		run = live & ADDR_LANES_WHERE(reg_pc == pc);
+		if ( lane_bits(&run) != live_bits )
+		{
+			for ( bits = live_bits & ~lane_bits(&run); bits != 0; bits &= bits - 1 )
+			{
+				lane = __builtin_ctz(bits);
+				if ( reg_pc[lane] < pc )
+				{
+					pc = reg_pc[lane];
+					lead = lane;
+				}
+			}
+			run = live & ADDR_LANES_WHERE(reg_pc == pc);
+		}
+
+		//of those, the ones with the same instr there as the lead
+		opcode = ROW(pc)[lead];
+		op1 = op2 = 0;
+		run &= LANES_WHERE(ROW(pc) == opcode);
+		if ( opcode_table[opcode].length > 1 )
+		{
+			op1 = ROW(pc + 1)[lead];
+			run &= LANES_WHERE(ROW(pc + 1) == op1);
+		}
+		if ( opcode_table[opcode].length > 2 )
+		{
+			op2 = ROW(pc + 2)[lead];
+			run &= LANES_WHERE(ROW(pc + 2) == op2);
+		}
+		operand = op1 | op2 << 8;
+
+		run_bits = lane_bits(&run);
+		run_addrs = ADDR_MASK(run);
+		halt = 0;
+
+		switch ( opcode )
+		{
+			//one case per opcode, built out of its line in opcodes.def, like run_interpreter's
+			#define OPCODE_DESC(code,mnemonic,mode,length,cycles,penalty) \
+				case code: \
+					EA_##mode; \
+					INSTR_CYCLES(cycles,penalty,mode); \
+					INSTR_##mnemonic(mode,length); \
+					break;
+			#include "opcodes.def"
+			#undef OPCODE_DESC
+		}
+
+		if ( halt != 0 )
+		{
+			//they're done; the instr they stopped at doesnt count
+			for ( bits = run_bits; bits != 0; bits &= bits - 1 )
+			{
+				ls->stop[__builtin_ctz(bits)] = halt;
+			}
+			live_bits &= ~run_bits;
+			live &= ~run;
+			if ( live_bits == 0 )
+			{
+				break;
+			}
+			continue;
+		}
+
+		instr_count += __builtin_convertvector(run & 1, lane_counts);
+		cycles += __builtin_convertvector(cyc & run, lane_cycles);
+		ls->steps++;
+	}
+
+	reg_p = PACKED_P;
+
+	*(lane_bytes *)ls->Acc = reg_a;
+	*(lane_bytes *)ls->X = reg_x;
+	*(lane_bytes *)ls->Y = reg_y;
+	*(lane_bytes *)ls->P = reg_p;
+	*(lane_bytes *)ls->S = reg_s;
+	*(lane_addrs *)ls->PC = reg_pc;
+	*(lane_counts *)ls->instr_count = instr_count;
+	*(lane_cycles *)ls->cycles = cycles;
+}
+
+
+/**************************************
+ * Name:  initialize_lockstep
+ * Inputs:  lockstep * - the lanes to init
+ * 			unsigned int - how many lanes to use, up to LOCKSTEP_LANES
+ * Outputs: None
+ * Function: puts every lane in the state initialize_em6502 and create_simple_memory_map
+ * 			 leave an emulator in, with its memory cleared
+ *
+***************************************/
+void initialize_lockstep( lockstep *ls, unsigned int num_lanes )
+{
+	memset(ls, 0, sizeof(lockstep));
+	memset(ls->S, 0xFF, sizeof(ls->S)); //same as initialize_em6502
+
+	ls->memory = (unsigned char *)calloc(MEMORY_SIZE, LOCKSTEP_LANES);
+	ls->num_lanes = num_lanes > LOCKSTEP_LANES ? LOCKSTEP_LANES : num_lanes;
+}
+
+
+/**************************************
+ * Name:  destroy_lockstep
+ * Inputs:  lockstep * - the lanes
+ * Outputs: None
+ * Function: frees their memory
+ *
+***************************************/
+void destroy_lockstep( lockstep *ls )
+{
+	free(ls->memory);
+	ls->memory = 0;
+}
+
+
+/**************************************
+ * Name:  load_lockstep_lane
+ * Inputs:  lockstep * - the lanes
+ * 			unsigned int - which one
+ * 			em6502 * - emulator to copy into it
+ * Outputs: None
+ * Function: copies the emulator's registers, counters and memory into the lane;
+ * 			 the memory is read through its pages' data, without calling listeners
+ *
+***************************************/
+void load_lockstep_lane( lockstep *ls, unsigned int lane, em6502 *emu )
+{
+	unsigned int addr;
+
+	ls->Acc[lane] = emu->Acc;
+	ls->X[lane] = emu->X;
+	ls->Y[lane] = emu->Y;
+	ls->P[lane] = emu->P;
+	ls->S[lane] = emu->S;
+	ls->PC[lane] = emu->PC;
+	ls->instr_count[lane] = emu->instr_count;
+	ls->cycles[lane] = emu->cycles;
+
+	for ( addr = 0; addr < MEMORY_SIZE; addr++ )
+	{
+		ls->memory[addr * LOCKSTEP_LANES + lane] = emu->page_table[addr / PAGE_SIZE]->data[addr % PAGE_SIZE];
+	}
+}
+
+
+/**************************************
+ * Name:  store_lockstep_lane
+ * Inputs:  lockstep * - the lanes
+ * 			unsigned int - which one
+ * 			em6502 * - emulator to copy it into
+ * Outputs: None
+ * Function: the other way around; the emulator ends up as if it had run what the lane did
+ *
+***************************************/
+void store_lockstep_lane( lockstep *ls, unsigned int lane, em6502 *emu )
+{
+	unsigned int addr;
+
+	emu->Acc = ls->Acc[lane];
+	emu->X = ls->X[lane];
+	emu->Y = ls->Y[lane];
+	emu->P = ls->P[lane];
+	emu->S = ls->S[lane];
+	emu->PC = ls->PC[lane];
+	emu->instr_count = ls->instr_count[lane];
+	emu->cycles = ls->cycles[lane];
+
+	for ( addr = 0; addr < MEMORY_SIZE; addr += PAGE_SIZE )
+	{
+		unshare_page(emu, addr / PAGE_SIZE);
+	}
+
+	for ( addr = 0; addr < MEMORY_SIZE; addr++ )
+	{
+		//ROM keeps what it had, like write_mem would
+		if ( GET_WRITE(emu->page_table[addr / PAGE_SIZE]->flag) )
+		{
+			emu->page_table[addr / PAGE_SIZE]->data[addr % PAGE_SIZE] = ls->memory[addr * LOCKSTEP_LANES + lane];
+		}
+	}
+
+	//the memory was poked straight into the pages, so any code decoded from it is stale
+	invalidate_code(emu, 0, MEMORY_SIZE - 1);
+}
+
+#endif
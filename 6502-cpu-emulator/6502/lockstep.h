@@ -0,0 +1,93 @@
+#ifndef LOCKSTEP_H
+#define LOCKSTEP_H
+
+#include "em_6502.h"
+
+#ifdef ENABLE_LOCKSTEP
+
+//LOCKSTEP_LANES emulators, stored a register at a time rather than an emulator at a time,
+//so a SIMD instr can work on the same register of all of them
+//each lane is a plain 6502 with 64K of RAM; no memory map, listeners, breakpoints or interrupts
+typedef struct {
+	unsigned char Acc[LOCKSTEP_LANES];
+	unsigned char X[LOCKSTEP_LANES];
+	unsigned char Y[LOCKSTEP_LANES];
+	unsigned char P[LOCKSTEP_LANES];
+	unsigned char S[LOCKSTEP_LANES];
+	unsigned short PC[LOCKSTEP_LANES];
+	unsigned int instr_count[LOCKSTEP_LANES];
+	unsigned long long cycles[LOCKSTEP_LANES];
+	int stop[LOCKSTEP_LANES]; //why each lane stopped the last run_lockstep, one of STOP_*
+
+	//every lane's memory, a byte of each in turn; lane l's addr a is memory[a * LOCKSTEP_LANES + l]
+	unsigned char *memory;
+
+	unsigned int num_lanes; //how many of the lanes are used, from lane 0 up
+	unsigned char stop_at_brk; //same as em6502's, for all of them; starts off
+	unsigned long long steps; //instrs run_lockstep ran, counted once however many lanes ran each
+}lockstep;
+
+
+/**************************************
+ * Name:  initialize_lockstep
+ * Inputs:  lockstep * - the lanes to init
+ * 			unsigned int - how many lanes to use, up to LOCKSTEP_LANES
+ * Outputs: None
+ * Function: puts every lane in the state initialize_em6502 and create_simple_memory_map
+ * 			 leave an emulator in, with its memory cleared
+ *
+***************************************/
+void initialize_lockstep( lockstep *, unsigned int );
+
+
+/**************************************
+ * Name:  destroy_lockstep
+ * Inputs:  lockstep * - the lanes
+ * Outputs: None
+ * Function: frees their memory
+ *
+***************************************/
+void destroy_lockstep( lockstep * );
+
+
+/**************************************
+ * Name:  load_lockstep_lane
+ * Inputs:  lockstep * - the lanes
+ * 			unsigned int - which one
+ * 			em6502 * - emulator to copy into it
+ * Outputs: None
+ * Function: copies the emulator's registers, counters and memory into the lane;
+ * 			 the memory is read through its pages' data, without calling listeners
+ *
+***************************************/
+void load_lockstep_lane( lockstep *, unsigned int, em6502 * );
+
+
+/**************************************
+ * Name:  store_lockstep_lane
+ * Inputs:  lockstep * - the lanes
+ * 			unsigned int - which one
+ * 			em6502 * - emulator to copy it into
+ * Outputs: None
+ * Function: the other way around; the emulator ends up as if it had run what the lane did
+ *
+***************************************/
+void store_lockstep_lane( lockstep *, unsigned int, em6502 * );
+
+
+/**************************************
+ * Name:  run_lockstep
+ * Inputs:  lockstep * - the lanes
+ * 			unsigned int - max number of instructions each lane executes, -1 for all
+ * 			unsigned long long - max number of cycles each lane executes, NO_CYCLE_LIMIT for all
+ * Outputs: None
+ * Function: runs every lane the way run_program_cycles would run it on its own, until
+ * 			 they've all stopped; stop says why each did. Lanes at the same instr run it
+ * 			 together, a SIMD instr for all of them; the rest wait their turn
+ *
+***************************************/
+void run_lockstep( lockstep *, unsigned int, unsigned long long );
+
+#endif
+
+#endif /* LOCKSTEP_H */
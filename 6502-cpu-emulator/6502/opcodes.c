@@ -0,0 +1,117 @@
+/* This is the opcode descriptor table and the disassembler built on top of it  */
+
+#include <stdio.h>
+
+#include "opcodes.h"
+
+
+//one entry per line of opcodes.def
+const opcode_desc opcode_table[256] =
+{
+	#define OPCODE_DESC(code,mnemonic,mode,length,cycles,penalty) \
+		[code] = { #mnemonic, MODE_##mode, length, cycles, penalty },
+	#include "opcodes.def"
+	#undef OPCODE_DESC
+};
+
+//spelled the same as in opcodes.def
+const char *const opcode_mode_name[MODE_NONE + 1] =
+{
+	"IMPLIED", "ACCUM", "IMMEDIATE", "Z_PAGE", "Z_PAGE_X", "Z_PAGE_Y", "IND_X",
+	"IND_Y", "ABS_X", "ABS_Y", "ABSOLUTE", "INDIRECT", "RELATIVE", "NONE"
+};
+
+
+/**************************************
+ * Name:  changes_flow
+ * Inputs:  unsigned char - opcode
+ * Outputs: int - 1 if the instr can change the flow, 0 otherwise
+ * Function: any instr that can set PC to something other than the next instr
+ * 			 changes the flow; jumps, branches, calls, returns and BRK
+ *
+***************************************/
+int changes_flow( unsigned char opcode )
+{
+	switch ( opcode )
+	{
+		case 0x00: //BRK
+		case 0x20: //JSR
+		case 0x40: //RTI
+		case 0x4C: //JMP
+		case 0x60: //RTS
+		case 0x6C: //JMP
+			return 1;
+	}
+
+	return opcode_table[opcode].mode == MODE_RELATIVE;
+}
+
+
+/**************************************
+ * Name:  disassemble_instr
+ * Inputs:  const unsigned char * - the instr bytes; opcode followed by its operand, if any
+ *				unsigned short - addr the instr is at, for working out branch targets
+ *				char * - where to write the text, at least DISASSEMBLY_MAX_LEN long
+ * Outputs: int - length of the instr in bytes
+ * Function: writes out the instr the way the assembler would take it in
+ *
+***************************************/
+int disassemble_instr( const unsigned char *bytes, unsigned short addr, char *out )
+{
+	const opcode_desc *desc = &opcode_table[bytes[0]];
+	unsigned short addr16 = 0;
+
+	if ( desc->length == 3 )
+	{
+		addr16 = bytes[1] | (bytes[2] << 8);
+	}
+
+	switch ( desc->mode )
+	{
+		case MODE_IMPLIED:
+			sprintf(out, "%s", desc->mnemonic);
+			break;
+		case MODE_ACCUM:
+			sprintf(out, "%s A", desc->mnemonic);
+			break;
+		case MODE_IMMEDIATE:
+			sprintf(out, "%s #$%02X", desc->mnemonic, bytes[1]);
+			break;
+		case MODE_Z_PAGE:
+			sprintf(out, "%s $%02X", desc->mnemonic, bytes[1]);
+			break;
+		case MODE_Z_PAGE_X:
+			sprintf(out, "%s $%02X,X", desc->mnemonic, bytes[1]);
+			break;
+		case MODE_Z_PAGE_Y:
+			sprintf(out, "%s $%02X,Y", desc->mnemonic, bytes[1]);
+			break;
+		case MODE_IND_X:
+			sprintf(out, "%s ($%02X,X)", desc->mnemonic, bytes[1]);
+			break;
+		case MODE_IND_Y:
+			sprintf(out, "%s ($%02X),Y", desc->mnemonic, bytes[1]);
+			break;
+		case MODE_ABS_X:
+			sprintf(out, "%s $%04X,X", desc->mnemonic, addr16);
+			break;
+		case MODE_ABS_Y:
+			sprintf(out, "%s $%04X,Y", desc->mnemonic, addr16);
+			break;
+		case MODE_ABSOLUTE:
+			sprintf(out, "%s $%04X", desc->mnemonic, addr16);
+			break;
+		case MODE_INDIRECT:
+			sprintf(out, "%s ($%04X)", desc->mnemonic, addr16);
+			break;
+		case MODE_RELATIVE:
+			//show where the branch goes, not the displacement
+			sprintf(out, "%s $%04X", desc->mnemonic, (unsigned short)(addr + 2 + (signed char)bytes[1]));
+			break;
+		default:
+			sprintf(out, "dcb $%02X", bytes[0]);
+			break;
+	}
+
+	return desc->length;
+}
@@ -0,0 +1,68 @@
+#ifndef OPCODES_H
+#define OPCODES_H
+
+//addressing modes an instruction can use
+//these are numbered the same as the modes in 6502-aslink's Assembler
+#define MODE_IMPLIED 0
+#define MODE_ACCUM 1
+#define MODE_IMMEDIATE 2
+#define MODE_Z_PAGE 3
+#define MODE_Z_PAGE_X 4
+#define MODE_Z_PAGE_Y 5
+#define MODE_IND_X 6
+#define MODE_IND_Y 7
+#define MODE_ABS_X 8
+#define MODE_ABS_Y 9
+#define MODE_ABSOLUTE 10
+#define MODE_INDIRECT 11
+#define MODE_RELATIVE 12
+#define MODE_NONE 13 //not a valid opcode
+
+//longest string disassemble_instr writes, including the terminating 0
+//ex: "LDA $1234,X"
+#define DISASSEMBLY_MAX_LEN 16
+
+//everything we know about an opcode
+//built from opcodes.def, which 6502-aslink/gen_opcode.rb generates and the
+//assembler reads back; change the table there, not here
+typedef struct {
+	const char *mnemonic; //ex: "LDA", "INVALID" for opcodes the 6502 doesnt have
+	unsigned char mode; //one of MODE_*
+	unsigned char length; //length in bytes, including opcode
+	unsigned char cycles; //base number of cycles it takes
+	unsigned char page_penalty; //extra cycles if its indexed addr crosses a page (or its branch is taken)
+}opcode_desc;
+
+//all 256 opcodes, indexed by opcode
+extern const opcode_desc opcode_table[256];
+
+//the name of each addressing mode, as opcodes.def spells it, indexed by MODE_*
+//ex: "IMMEDIATE"
+extern const char *const opcode_mode_name[MODE_NONE + 1];
+
+
+/**************************************
+ * Name:  changes_flow
+ * Inputs:  unsigned char - opcode
+ * Outputs: int - 1 if the instr can change the flow, 0 otherwise
+ * Function: any instr that can set PC to something other than the next instr
+ * 			 changes the flow; jumps, branches, calls, returns and BRK
+ *
+***************************************/
+int changes_flow( unsigned char );
+
+
+/**************************************
+ * Name:  disassemble_instr
+ * Inputs:  const unsigned char * - the instr bytes; opcode followed by its operand, if any
+ *				unsigned short - addr the instr is at, for working out branch targets
+ *				char * - where to write the text, at least DISASSEMBLY_MAX_LEN long
+ * Outputs: int - length of the instr in bytes
+ * Function: writes out the instr the way the assembler would take it in
+ * 			 ex: "LDA ($20),Y", "ASL A", "BNE $0612"
+ * 			 opcodes the 6502 doesnt have come out as a dcb macro
+ *
+***************************************/
+int disassemble_instr( const unsigned char *, unsigned short, char * );
+
+#endif /* OPCODES_H */
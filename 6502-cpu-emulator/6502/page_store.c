@@ -0,0 +1,235 @@
+/* This is the page store; emulators holding the same bytes share a single copy of them through it  */
+
+#include <stdlib.h>
+#include <string.h>
+#include "assert.h"
+
+#include "page_store.h"
+
+#ifdef ENABLE_PAGE_STORE
+
+#ifdef __unix__
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+/*
+ * The store is a hash table of shared_pages, the same ones fork_em6502 makes, keyed
+ * on a hash of their bytes; open addressing, kept at most half full. dedup_pages
+ * looks each of an emulator's pages up in it and points the page at what it finds,
+ * so the pages of thousands of emulators running the same ROM, and all their
+ * zeroed ones, come down to a single copy each. Writing to one gets the writer its
+ * own copy back in _memory, the way it does for a fork.
+ */
+
+//slots a new store starts out with
+#define PAGE_STORE_INITIAL_SIZE 256
+
+//64-bit FNV-1a
+static unsigned long long hash_page( const unsigned char *data )
+{
+	unsigned long long hash = 0xCBF29CE484222325ULL;
+	unsigned int i;
+
+	for ( i = 0; i < PAGE_SIZE; i++ )
+	{
+		hash ^= data[i];
+		hash *= 0x100000001B3ULL;
+	}
+
+	return hash;
+}
+
+//the slot holding a page with these bytes, or the empty one it would go in
+static unsigned int find_slot( page_store *store, unsigned long long hash, const unsigned char *data )
+{
+	unsigned int slot = (unsigned int)hash & (store->size - 1);
+
+	while ( store->pages[slot] != 0 &&
+			(store->hashes[slot] != hash || memcmp(store->pages[slot]->data, data, PAGE_SIZE) != 0) )
+	{
+		slot = (slot + 1) & (store->size - 1);
+	}
+
+	return slot;
+}
+
+//twice the slots, with everything put back in them
+static void grow_store( page_store *store )
+{
+	shared_page **pages = store->pages;
+	unsigned long long *hashes = store->hashes;
+	unsigned int size = store->size;
+	unsigned int slot;
+	unsigned int i;
+
+	store->size = size * 2;
+	store->pages = (shared_page **)calloc(store->size, sizeof(shared_page *));
+	store->hashes = (unsigned long long *)malloc(store->size * sizeof(unsigned long long));
+
+	for ( i = 0; i < size; i++ )
+	{
+		if ( pages[i] != 0 )
+		{
+			slot = find_slot(store, hashes[i], pages[i]->data);
+			store->pages[slot] = pages[i];
+			store->hashes[slot] = hashes[i];
+		}
+	}
+
+	free(pages);
+	free(hashes);
+}
+
+#ifdef __unix__
+//hands the bits of _memory no page uses any more back to the OS; they read as zeros
+//if they're ever touched again, and a page copied back in overwrites all of its bytes
+static void release_unused_memory( em6502 *emu )
+{
+	unsigned long host_page = (unsigned long)sysconf(_SC_PAGESIZE);
+	unsigned char *end = emu->_memory + MEMORY_SIZE;
+	unsigned char *start;
+	unsigned int first;
+	unsigned int last;
+	unsigned int i;
+
+	start = (unsigned char *)(((unsigned long)emu->_memory + host_page - 1) & ~(host_page - 1));
+	for ( ; start + host_page <= end; start += host_page )
+	{
+		first = (start - emu->_memory) / PAGE_SIZE;
+		last = (start + host_page - 1 - emu->_memory) / PAGE_SIZE;
+		for ( i = first; i <= last && emu->shared_pages[i] != 0; i++ );
+
+		if ( i > last )
+		{
+			madvise(start, host_page, MADV_DONTNEED);
+		}
+	}
+}
+#endif
+
+
+/**************************************
+ * Name:  initialize_page_store
+ * Inputs:  page_store * - the store to init
+ * Outputs: None
+ * Function: makes an empty store
+ *
+***************************************/
+void initialize_page_store( page_store *store )
+{
+	store->size = PAGE_STORE_INITIAL_SIZE;
+	store->count = 0;
+	store->pages = (shared_page **)calloc(store->size, sizeof(shared_page *));
+	store->hashes = (unsigned long long *)malloc(store->size * sizeof(unsigned long long));
+}
+
+
+/**************************************
+ * Name:  destroy_page_store
+ * Inputs:  page_store * - the store
+ * Outputs: None
+ * Function: lets go of its pages, freeing the ones no emulator shares any more
+ *
+***************************************/
+void destroy_page_store( page_store *store )
+{
+	unsigned int i;
+
+	for ( i = 0; i < store->size; i++ )
+	{
+		if ( store->pages[i] != 0 && --store->pages[i]->refs == 0 )
+		{
+			free(store->pages[i]);
+		}
+	}
+
+	free(store->pages);
+	free(store->hashes);
+	store->pages = 0;
+	store->hashes = 0;
+	store->size = 0;
+	store->count = 0;
+}
+
+
+/**************************************
+ * Name:  dedup_pages
+ * Inputs:  page_store * - the store
+ * 			em6502 * - the 6502 object
+ * Outputs: unsigned int - how many of its pages it now shares with the store
+ * Function: points each of the emulator's pages at the store's copy of the same bytes,
+ * 			 adding the ones it doesnt have yet; pages it already shares with a fork
+ * 			 go in as they are, rather than being copied
+ *
+***************************************/
+unsigned int dedup_pages( page_store *store, em6502 *emu )
+{
+	unsigned char aliased[NUM_PAGES];
+	unsigned char *data;
+	unsigned long long hash;
+	unsigned int slot;
+	unsigned int count = 0;
+	unsigned int i;
+
+	assert(emu->arena != 0);
+
+	//pages other pages are pointed into have to stay where they are, same as for a fork
+	memset(aliased, 0, sizeof(aliased));
+	for ( i = 0; i < NUM_PAGES; i++ )
+	{
+		data = emu->page_table[i]->data;
+		if ( data != &emu->_memory[i * PAGE_SIZE] && data >= emu->_memory && data < emu->_memory + MEMORY_SIZE )
+		{
+			aliased[(data - emu->_memory) / PAGE_SIZE] = 1;
+		}
+	}
+
+	for ( i = 0; i < NUM_PAGES; i++ )
+	{
+		data = emu->page_table[i]->data;
+		if ( emu->shared_pages[i] == 0 && (aliased[i] || data != &emu->_memory[i * PAGE_SIZE]) )
+		{
+			continue;
+		}
+
+		hash = hash_page(data);
+		slot = find_slot(store, hash, data);
+
+		if ( store->pages[slot] == 0 )
+		{
+			if ( emu->shared_pages[i] != 0 )
+			{
+				store->pages[slot] = emu->shared_pages[i];
+				store->pages[slot]->refs++;
+			}
+			else
+			{
+				store->pages[slot] = (shared_page *)malloc(sizeof(shared_page));
+				store->pages[slot]->refs = 1;
+				memcpy(store->pages[slot]->data, data, PAGE_SIZE);
+			}
+			store->hashes[slot] = hash;
+			store->count++;
+		}
+
+		if ( emu->shared_pages[i] != store->pages[slot] )
+		{
+			share_page(emu, i, store->pages[slot]);
+		}
+		count++;
+
+		if ( store->count * 2 >= store->size )
+		{
+			grow_store(store);
+		}
+	}
+
+	#ifdef __unix__
+	release_unused_memory(emu);
+	#endif
+
+	return count;
+}
+
+#endif
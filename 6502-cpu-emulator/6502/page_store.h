@@ -0,0 +1,55 @@
+#ifndef PAGE_STORE_H
+#define PAGE_STORE_H
+
+#include "em_6502.h"
+
+#ifdef ENABLE_PAGE_STORE
+
+//every distinct page dedup_pages has seen, by a hash of its bytes
+//it holds on to each of them, so they outlive the emulators they came from
+typedef struct {
+	shared_page **pages; //open addressing; 0 for empty slots
+	unsigned long long *hashes; //of the page in the same slot
+	unsigned int size; //slots, a power of 2
+	unsigned int count; //pages in it
+}page_store;
+
+
+/**************************************
+ * Name:  initialize_page_store
+ * Inputs:  page_store * - the store to init
+ * Outputs: None
+ * Function: makes an empty store
+ *
+***************************************/
+void initialize_page_store( page_store * );
+
+
+/**************************************
+ * Name:  destroy_page_store
+ * Inputs:  page_store * - the store
+ * Outputs: None
+ * Function: lets go of its pages; the emulators still sharing them keep them
+ *
+***************************************/
+void destroy_page_store( page_store * );
+
+
+/**************************************
+ * Name:  dedup_pages
+ * Inputs:  page_store * - the store
+ * 			em6502 * - the 6502 object
+ * Outputs: unsigned int - how many of its pages it now shares with the store
+ * Function: points each of the emulator's pages at the store's copy of the same bytes,
+ * 			 adding the ones it doesnt have yet; a page gets its own copy back the first
+ * 			 time it's written, like a fork's. Pages pointed somewhere else, and the ones
+ * 			 they point into, are left alone. On unix-likes the _memory they used gets
+ * 			 handed back to the OS, so what's resident is the pages it writes
+ * 			 the store and everything deduped into it have to be used from the same thread
+ *
+***************************************/
+unsigned int dedup_pages( page_store *, em6502 * );
+
+#endif
+
+#endif /* PAGE_STORE_H */
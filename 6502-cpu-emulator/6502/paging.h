@@ -14,6 +14,8 @@
 
 #include "definitions.h"
 
+struct em6502;
+
 //it seems the 6502 pages are 0xFF bytes in size
 //the total addressable memory is 0xFFFF bytes
 //
@@ -27,8 +29,18 @@ typedef struct{
 	//mode should be one of: {READ,WRITE}
 	//possible execute for accesses by PC (FUTURE)
 	void (*cb_mem_listener)(unsigned short addr, unsigned char val, unsigned char mode);
+
+	//a device behind this page, see set_memory_device
+	//on a READ it returns the byte the cpu gets, val being what's in data;
+	//on a WRITE it returns the byte that gets stored in data, val being what the cpu wrote
+	unsigned char (*cb_device)(struct em6502 *emu, void *context, unsigned short addr, unsigned char val, unsigned char mode);
+	void *device_context; //passed back to cb_device, whatever the device wants
 }page_t;
 
+//1 if accesses to the page have to call something
+#define HAS_LISTENER(P) \
+	((P)->cb_mem_listener != 0 || (P)->cb_device != 0)
+
 
 //flag bit values:
 //(high) |x| |x| |x| |x| |listener| |execute| |write| |read| (low)
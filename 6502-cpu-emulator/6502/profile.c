@@ -0,0 +1,236 @@
+/* This is the instr profiler; it finds the instr sequences worth fusing  */
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "profile.h"
+
+#ifdef ENABLE_PROFILER
+
+//slots in the triple table; triples past this many different ones dont get counted
+#define PROFILE_TRIPLE_SLOTS 4096
+
+//a triple, and how many times it ran
+typedef struct {
+	unsigned int key; //1 + its 3 opcodes, first one in the high byte; 0 for an empty slot
+	unsigned int count;
+}profiled_triple;
+
+struct instr_profile {
+	unsigned int pairs[256][256]; //how many times each opcode ran straight after each other one
+	profiled_triple triples[PROFILE_TRIPLE_SLOTS]; //same for 3 in a row, hashed by their opcodes
+	unsigned int instrs; //instrs counted in all
+
+	//the run of instrs leading up to the one about to go; only ones that can be fused with it
+	unsigned char run; //how many of last[] are in it, up to 2
+	unsigned char last[2]; //their opcodes, most recent last
+	unsigned short next_pc; //where the most recent one falls through to
+	unsigned char page; //page the most recent one is in
+};
+
+//a pair or triple that could be fused
+typedef struct {
+	unsigned char opcode[3];
+	unsigned char length; //2 or 3
+	unsigned int count; //times it ran
+}fusion_candidate;
+
+
+//finds the slot of a triple, or the empty one it goes in; 0 if the table is full
+static profiled_triple *find_triple( struct instr_profile *profile, unsigned int key )
+{
+	unsigned int slot = (key * 2654435761u) % PROFILE_TRIPLE_SLOTS;
+	unsigned int i;
+
+	for ( i = 0; i < PROFILE_TRIPLE_SLOTS; i++, slot = (slot + 1) % PROFILE_TRIPLE_SLOTS )
+	{
+		if ( profile->triples[slot].key == key || profile->triples[slot].key == 0 )
+		{
+			return &profile->triples[slot];
+		}
+	}
+
+	return 0;
+}
+
+/**************************************
+ * Name:  profile_instr
+ * Inputs:  em6502 * - the 6502 object
+ * 			unsigned char - opcode of the instr about to run at PC
+ * Outputs: None
+ * Function: counts the instr, along with the 1 or 2 that ran right before it
+ * 			 if they led straight up to it; the interpreter calls this on every instr
+ *
+***************************************/
+void profile_instr( em6502 *emu, unsigned char opcode )
+{
+	struct instr_profile *profile = emu->profile;
+	profiled_triple *triple;
+	unsigned int key;
+
+	if ( profile == 0 )
+	{
+		profile = (struct instr_profile *)calloc(1, sizeof(struct instr_profile));
+		emu->profile = profile;
+	}
+
+	profile->instrs++;
+
+	//the same rules fuse_decoded goes by: the whole sequence runs straight through in one page,
+	//and none of its instrs start in the last 2 bytes of it
+	if ( emu->PC != profile->next_pc || emu->PC / PAGE_SIZE != profile->page || emu->PC % PAGE_SIZE > PAGE_SIZE - 3 )
+	{
+		profile->run = 0;
+	}
+
+	if ( profile->run >= 1 )
+	{
+		profile->pairs[profile->last[1]][opcode]++;
+	}
+
+	if ( profile->run >= 2 )
+	{
+		key = 1 + ((profile->last[0] << 16) | (profile->last[1] << 8) | opcode);
+		triple = find_triple(profile, key);
+		if ( triple != 0 )
+		{
+			triple->key = key;
+			triple->count++;
+		}
+	}
+
+	//only the last instr of a sequence can go somewhere else
+	if ( changes_flow(opcode) || opcode_table[opcode].mode == MODE_NONE )
+	{
+		profile->run = 0;
+	}
+	else
+	{
+		profile->last[0] = profile->last[1];
+		profile->last[1] = opcode;
+		if ( profile->run < 2 )
+		{
+			profile->run++;
+		}
+	}
+
+	profile->next_pc = emu->PC + opcode_table[opcode].length;
+	profile->page = emu->PC / PAGE_SIZE;
+}
+
+
+//best candidates first: the ones that save the most dispatches
+static int compare_candidates( const void *a, const void *b )
+{
+	const fusion_candidate *ca = (const fusion_candidate *)a;
+	const fusion_candidate *cb = (const fusion_candidate *)b;
+	double saved_a = (double)ca->count * (ca->length - 1);
+	double saved_b = (double)cb->count * (cb->length - 1);
+
+	if ( saved_a != saved_b )
+	{
+		return saved_a < saved_b ? 1 : -1;
+	}
+
+	return ca->length - cb->length;
+}
+
+/**************************************
+ * Name:  print_profile
+ * Inputs:  em6502 * - the 6502 object
+ * 			FILE * - where to print
+ * 			unsigned int - how many sequences to list
+ * Outputs: None
+ * Function: lists the instr pairs and triples that would save the most dispatches
+ * 			 if they were fused, best first, each with its line for fusions.def
+ *
+***************************************/
+void print_profile( em6502 *emu, FILE *out, unsigned int max )
+{
+	struct instr_profile *profile = emu->profile;
+	fusion_candidate *candidates;
+	const opcode_desc *desc;
+	unsigned int num = 0;
+	unsigned int i, j;
+
+	if ( profile == 0 || profile->instrs == 0 )
+	{
+		fprintf(out, "no instrs profiled\n");
+		return;
+	}
+
+	candidates = (fusion_candidate *)malloc((256 * 256 + PROFILE_TRIPLE_SLOTS) * sizeof(fusion_candidate));
+
+	for ( i = 0; i < 256; i++ )
+	{
+		for ( j = 0; j < 256; j++ )
+		{
+			if ( profile->pairs[i][j] != 0 )
+			{
+				candidates[num].opcode[0] = i;
+				candidates[num].opcode[1] = j;
+				candidates[num].length = 2;
+				candidates[num].count = profile->pairs[i][j];
+				num++;
+			}
+		}
+	}
+
+	for ( i = 0; i < PROFILE_TRIPLE_SLOTS; i++ )
+	{
+		if ( profile->triples[i].key != 0 )
+		{
+			candidates[num].opcode[0] = (profile->triples[i].key - 1) >> 16;
+			candidates[num].opcode[1] = (profile->triples[i].key - 1) >> 8;
+			candidates[num].opcode[2] = profile->triples[i].key - 1;
+			candidates[num].length = 3;
+			candidates[num].count = profile->triples[i].count;
+			num++;
+		}
+	}
+
+	qsort(candidates, num, sizeof(fusion_candidate), compare_candidates);
+
+	fprintf(out, "fusion candidates, out of %u instrs run:\n", profile->instrs);
+	fprintf(out, "rank  dispatches saved  sequence\n");
+
+	for ( i = 0; i < num && i < max; i++ )
+	{
+		fprintf(out, "%4u  %9u %5.1f%%  ", i + 1, candidates[i].count * (candidates[i].length - 1),
+				100.0 * candidates[i].count * (candidates[i].length - 1) / profile->instrs);
+		for ( j = 0; j < candidates[i].length; j++ )
+		{
+			desc = &opcode_table[candidates[i].opcode[j]];
+			fprintf(out, "%s%s %s", j > 0 ? " / " : "", desc->mnemonic, opcode_mode_name[desc->mode]);
+		}
+		fprintf(out, "\n");
+
+		//ready to paste into fusions.def
+		fprintf(out, "      FUSE%u(", candidates[i].length);
+		for ( j = 0; j < candidates[i].length; j++ )
+		{
+			desc = &opcode_table[candidates[i].opcode[j]];
+			fprintf(out, "%s 0x%02X, %s, %s, %u", j > 0 ? ", " : "", candidates[i].opcode[j],
+					desc->mnemonic, opcode_mode_name[desc->mode], desc->length);
+		}
+		fprintf(out, " )\n");
+	}
+
+	free(candidates);
+}
+
+
+/**************************************
+ * Name:  clear_profile
+ * Inputs:  em6502 * - the 6502 object
+ * Outputs: None
+ * Function: throws away everything counted so far
+ *
+***************************************/
+void clear_profile( em6502 *emu )
+{
+	free(emu->profile);
+	emu->profile = 0;
+}
+
+#endif
@@ -0,0 +1,46 @@
+#ifndef PROFILE_H
+#define PROFILE_H
+
+#include <stdio.h>
+
+#include "em_6502.h"
+
+#ifdef ENABLE_PROFILER
+
+/**************************************
+ * Name:  profile_instr
+ * Inputs:  em6502 * - the 6502 object
+ * 			unsigned char - opcode of the instr about to run at PC
+ * Outputs: None
+ * Function: counts the instr, along with the 1 or 2 that ran right before it
+ * 			 if they led straight up to it; the interpreter calls this on every instr
+ *
+***************************************/
+void profile_instr( em6502 *, unsigned char );
+
+
+/**************************************
+ * Name:  print_profile
+ * Inputs:  em6502 * - the 6502 object
+ * 			FILE * - where to print
+ * 			unsigned int - how many sequences to list
+ * Outputs: None
+ * Function: lists the instr pairs and triples that would save the most dispatches
+ * 			 if they were fused, best first, each with its line for fusions.def
+ *
+***************************************/
+void print_profile( em6502 *, FILE *, unsigned int );
+
+
+/**************************************
+ * Name:  clear_profile
+ * Inputs:  em6502 * - the 6502 object
+ * Outputs: None
+ * Function: throws away everything counted so far
+ *
+***************************************/
+void clear_profile( em6502 * );
+
+#endif
+
+#endif /* PROFILE_H */
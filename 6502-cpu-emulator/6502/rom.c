@@ -0,0 +1,122 @@
+/* This is the ROM loader; images get mapped read-only and attached to an emulator's pages without copying them  */
+
+#include <stdlib.h>
+#include "assert.h"
+
+#include "rom.h"
+
+#ifdef ENABLE_ROM_MAPPING
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+/*
+ * load_program copies a program into _memory, which is what RAM wants. A ROM
+ * never changes, so there's no need for a copy of it per emulator; the file
+ * gets mapped once and the pages it covers point straight into the mapping.
+ * Mappings are made of whole host pages, which are a multiple of ours, so the last
+ * page of an image that doesnt fill it is still backed, by the zeros past the end of
+ * the file. Since the mapping is read-only, write_mem drops writes to pages without
+ * WRITE set, rather than storing them, and so does anything else that writes through
+ * page data (rollback_em6502, store_lockstep_lane).
+ */
+
+/**************************************
+ * Name:  open_rom
+ * Inputs:  rom_image * - the image to fill in
+ * 			const char * - path of the file
+ * Outputs: int - 1 if it got mapped, 0 if it couldnt be opened, was empty or wouldnt map
+ * Function: maps the file read-only
+ *
+***************************************/
+int open_rom( rom_image *rom, const char *path )
+{
+	struct stat st;
+	void *data;
+	int fd;
+
+	rom->data = 0;
+	rom->size = 0;
+
+	fd = open(path, O_RDONLY);
+	if ( fd < 0 )
+	{
+		return 0;
+	}
+
+	if ( fstat(fd, &st) != 0 || st.st_size == 0 )
+	{
+		close(fd);
+		return 0;
+	}
+
+	data = mmap(0, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+
+	//the mapping keeps the file open on its own
+	close(fd);
+
+	if ( data == MAP_FAILED )
+	{
+		return 0;
+	}
+
+	rom->data = (unsigned char *)data;
+	rom->size = st.st_size;
+	return 1;
+}
+
+
+/**************************************
+ * Name:  close_rom
+ * Inputs:  rom_image * - the image
+ * Outputs: None
+ * Function: unmaps it
+ *
+***************************************/
+void close_rom( rom_image *rom )
+{
+	if ( rom->data != 0 )
+	{
+		munmap(rom->data, rom->size);
+	}
+
+	rom->data = 0;
+	rom->size = 0;
+}
+
+
+/**************************************
+ * Name:  attach_rom
+ * Inputs:  em6502 * - the 6502 object
+ * 			rom_image * - the image
+ * 			unsigned int - offset from start, a page-multiple
+ * Outputs: None
+ * Function: points the pages the image covers at it, read and execute only
+ *
+***************************************/
+void attach_rom( em6502 *emu, rom_image *rom, unsigned int offset )
+{
+	unsigned int num_pages = (rom->size + PAGE_SIZE - 1) / PAGE_SIZE;
+	unsigned int i;
+
+	//it can only point whole pages at it
+	assert(offset % PAGE_SIZE == 0);
+	assert(rom->data != 0);
+	assert(offset + rom->size <= MEMORY_SIZE);
+
+	for ( i = 0; i < num_pages; i++ )
+	{
+		//a page shared with a fork goes back to being its own first
+		unshare_page(emu, offset / PAGE_SIZE + i);
+
+		emu->page_table[offset / PAGE_SIZE + i]->data = &rom->data[i * PAGE_SIZE];
+		emu->page_table[offset / PAGE_SIZE + i]->flag = READ | EXECUTE;
+
+		//new bytes, so anything decoded from the old ones is gone
+		update_page(emu, offset / PAGE_SIZE + i);
+	}
+}
+
+#endif
@@ -0,0 +1,57 @@
+#ifndef ROM_H
+#define ROM_H
+
+#include <stddef.h>
+
+#include "em_6502.h"
+
+#ifdef ENABLE_ROM_MAPPING
+
+//a ROM image mapped read-only straight out of its file
+//the pages attach_rom points at it belong to it, so it has to outlive the emulators using it
+typedef struct {
+	unsigned char *data; //the mapping; 0 if nothing's open
+	size_t size; //bytes in the file
+}rom_image;
+
+
+/**************************************
+ * Name:  open_rom
+ * Inputs:  rom_image * - the image to fill in
+ * 			const char * - path of the file
+ * Outputs: int - 1 if it got mapped, 0 if it couldnt be opened, was empty or wouldnt map
+ * Function: maps the file read-only; nothing is read until something touches it,
+ * 			 and every process mapping the same file shares the OS's copy of it
+ *
+***************************************/
+int open_rom( rom_image *, const char * );
+
+
+/**************************************
+ * Name:  close_rom
+ * Inputs:  rom_image * - the image
+ * Outputs: None
+ * Function: unmaps it; no emulator can still have it attached
+ *
+***************************************/
+void close_rom( rom_image * );
+
+
+/**************************************
+ * Name:  attach_rom
+ * Inputs:  em6502 * - the 6502 object
+ * 			rom_image * - the image
+ * 			unsigned int - offset from start; has to be a page-multiple, and the image has to fit
+ * Outputs: None
+ * Function: points the pages from the offset on straight at the image, with no copying,
+ * 			 and makes them ROM: read and execute, and writes to them are dropped.
+ * 			 The tail of the last page past the end of the file reads as zeros.
+ * 			 Any number of emulators can attach the same image; unlike load_program,
+ * 			 PC is left alone
+ *
+***************************************/
+void attach_rom( em6502 *, rom_image *, unsigned int );
+
+#endif
+
+#endif /* ROM_H */
@@ -0,0 +1,154 @@
+/* This is the real-time throttle; it paces run_program to the clock of the chip being emulated  */
+
+#include <stdio.h>
+#include <errno.h>
+#include <time.h>
+
+#include "throttle.h"
+
+#ifdef ENABLE_THROTTLE
+
+/*
+ * Pacing every instr would mean reading the host clock millions of times a second,
+ * so the emulator runs a frame's worth of cycles flat out and then sleeps until
+ * the host has caught up with them. Every deadline is worked out from the start
+ * of the run rather than from the frame before, so the odd late wake up or
+ * instr running past the end of a frame doesnt add up into drift.
+ * The sleep is on an absolute deadline, and stops a little short of it to spin
+ * the rest, since the scheduler can wake us up well past it.
+ */
+
+#define NS_PER_SEC 1000000000LL
+
+//default throttle->spin_ns, roughly what waking up from a sleep can be late by
+#define DEFAULT_SPIN_NS 200000
+
+//default throttle->max_lag_frames
+#define DEFAULT_MAX_LAG_FRAMES 3
+
+//the host's monotonic clock, in ns
+static long long now_ns( void )
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * NS_PER_SEC + ts.tv_nsec;
+}
+
+//sleeps until the monotonic clock gets to when
+static void sleep_until( long long when )
+{
+	struct timespec ts;
+
+	ts.tv_sec = when / NS_PER_SEC;
+	ts.tv_nsec = when % NS_PER_SEC;
+
+	while ( clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, 0) == EINTR )
+	{
+	}
+}
+
+
+/**************************************
+ * Name:  start_throttle
+ * Inputs:  em6502 * - the 6502 object to run
+ * 			throttle * - the throttle to start
+ * 			unsigned long long - clock to pace it to, in Hz; one of CLOCK_HZ_*, or any other
+ * 			unsigned int - frames per second
+ * Outputs: None
+ * Function: sets up a real-time run starting now, with the stats cleared;
+ * 			 spin_ns and max_lag_frames get defaults that can be changed after
+ *
+***************************************/
+void start_throttle( em6502 *emu, throttle *t, unsigned long long clock_hz, unsigned int frame_hz )
+{
+	memset(t, 0, sizeof(throttle));
+
+	t->clock_hz = clock_hz;
+	t->frame_hz = frame_hz;
+	t->spin_ns = DEFAULT_SPIN_NS;
+	t->max_lag_frames = DEFAULT_MAX_LAG_FRAMES;
+
+	t->start_cycles = emu->cycles;
+	t->start_ns = now_ns();
+}
+
+
+/**************************************
+ * Name:  run_frame
+ * Inputs:  em6502 * - the 6502 object to run
+ * 			throttle * - its throttle
+ * Outputs: int - why it stopped, one of STOP_*
+ * Function: runs the next frame's worth of cycles, then sleeps until the host clock
+ * 			 catches up with the emulated one; a frame that runs past its deadline
+ * 			 doesnt sleep, so the next ones catch up. Anything but STOP_BUDGET
+ * 			 comes back right away, and the next call carries on with the same frame
+ *
+***************************************/
+int run_frame( em6502 *emu, throttle *t )
+{
+	unsigned long long end_cycles;
+	long long deadline;
+	long long now;
+	int stop;
+
+	//the frame ends at the same cycle however the ones before it went
+	end_cycles = t->start_cycles + (t->frame + 1) * t->clock_hz / t->frame_hz;
+
+	while ( emu->cycles < end_cycles )
+	{
+		stop = run_program_cycles(emu, -1, end_cycles - emu->cycles);
+		if ( stop != STOP_BUDGET )
+		{
+			return stop;
+		}
+	}
+
+	t->frame++;
+	t->frames++;
+
+	deadline = t->start_ns + (long long)(t->frame * NS_PER_SEC / t->frame_hz);
+	now = now_ns();
+
+	t->drift_ns = now - deadline;
+	if ( t->drift_ns > t->max_drift_ns )
+	{
+		t->max_drift_ns = t->drift_ns;
+	}
+
+	if ( now > deadline )
+	{
+		t->overruns++;
+
+		//too far behind to catch up without running flat out for a while; drop the lost time
+		if ( t->drift_ns > (long long)t->max_lag_frames * NS_PER_SEC / t->frame_hz )
+		{
+			t->resyncs++;
+			t->start_cycles = emu->cycles;
+			t->start_ns = now;
+			t->frame = 0;
+		}
+
+		return STOP_BUDGET;
+	}
+
+	if ( deadline - now > t->spin_ns )
+	{
+		sleep_until(deadline - t->spin_ns);
+	}
+
+	do
+	{
+		now = now_ns();
+	} while ( now < deadline );
+
+	t->late_wake_ns = now - deadline;
+	if ( t->late_wake_ns > t->max_late_wake_ns )
+	{
+		t->max_late_wake_ns = t->late_wake_ns;
+	}
+
+	return STOP_BUDGET;
+}
+
+#endif
@@ -0,0 +1,65 @@
+#ifndef THROTTLE_H
+#define THROTTLE_H
+
+#include "em_6502.h"
+
+#ifdef ENABLE_THROTTLE
+
+//some clocks to pace to, in Hz
+#define CLOCK_HZ_6507 1193182 //atari 2600, NTSC colorburst / 3
+#define CLOCK_HZ_2A03 1789773 //NES, NTSC
+#define CLOCK_HZ_1MHZ 1000000 //apple II, c64, most everything else give or take
+
+//how a real-time run is going, see run_frame
+typedef struct {
+	unsigned long long clock_hz; //cycles the emulated chip runs per second
+	unsigned int frame_hz; //frames per second; each one runs clock_hz / frame_hz cycles, then sleeps
+	unsigned int spin_ns; //wake up this long before a frame's deadline and spin the rest, for less jitter
+	unsigned int max_lag_frames; //frames behind the host can fall before it gives up catching up
+
+	//where the current run of frames started; everything is paced from here
+	unsigned long long start_cycles; //emu->cycles at its start
+	long long start_ns; //host time at its start
+	unsigned long long frame; //frames run since then
+
+	//for telling whether the host keeps up
+	unsigned int frames; //frames run in all
+	unsigned int overruns; //frames that were done running only after their deadline
+	unsigned int resyncs; //times it fell max_lag_frames behind, and started pacing over from there
+	long long drift_ns; //how long after its deadline the last frame was done running; < 0 when it was early
+	long long max_drift_ns; //the most that ever was
+	long long late_wake_ns; //how long after its deadline the last frame that slept woke up
+	long long max_late_wake_ns; //the most that ever was
+}throttle;
+
+
+/**************************************
+ * Name:  start_throttle
+ * Inputs:  em6502 * - the 6502 object to run
+ * 			throttle * - the throttle to start
+ * 			unsigned long long - clock to pace it to, in Hz; one of CLOCK_HZ_*, or any other
+ * 			unsigned int - frames per second
+ * Outputs: None
+ * Function: sets up a real-time run starting now, with the stats cleared;
+ * 			 spin_ns and max_lag_frames get defaults that can be changed after
+ *
+***************************************/
+void start_throttle( em6502 *, throttle *, unsigned long long, unsigned int );
+
+
+/**************************************
+ * Name:  run_frame
+ * Inputs:  em6502 * - the 6502 object to run
+ * 			throttle * - its throttle
+ * Outputs: int - why it stopped, one of STOP_*
+ * Function: runs the next frame's worth of cycles, then sleeps until the host clock
+ * 			 catches up with the emulated one; a frame that runs past its deadline
+ * 			 doesnt sleep, so the next ones catch up. Anything but STOP_BUDGET
+ * 			 comes back right away, and the next call carries on with the same frame
+ *
+***************************************/
+int run_frame( em6502 *, throttle * );
+
+#endif
+
+#endif /* THROTTLE_H */
@@ -1,12 +1,28 @@
 //this is the testing component of the emulator
 //it will test out the functionality of the existing code
 
+//test_rom makes its image with mkstemp, which is POSIX rather than C
+#define _POSIX_C_SOURCE 200809L
 
+#include <stdlib.h>
+#include <time.h>
 
 #include "unit_test.h"
 #include "em_6502.h"
+#include "throttle.h"
+#include "events.h"
+#include "batch.h"
+#include "lockstep.h"
+#include "page_store.h"
+#include "rom.h"
+#include "loader.h"
+#include "cartridge.h"
 #include "definitions.h"
 
+#ifdef ENABLE_ROM_MAPPING
+#include <unistd.h>
+#endif
+
 
 //on vista, calling assert fails spectacularly with a dialog box popup
 //i could not figure out how to get rid of that so i hacked around it
@@ -96,12 +112,23 @@
 	em6502 emulator; \
 	printf("running %s...\n", strName); \
     initialize_em6502( &emulator); \
+    SET_TEST_ENGINE(emulator); \
     create_simple_memory_map( &emulator ); \
 	load_program( &emulator, &program, sizeof(program), 0)
 
 
 
+//the battery runs once per engine; this is the one running it now
+#ifdef ENABLE_DYNAREC
+	static unsigned char test_engine = ENGINE_INTERPRETER;
+	#define SET_TEST_ENGINE(emu) (emu).engine = test_engine
+#else
+	#define SET_TEST_ENGINE(emu)
+#endif
+
+
 //define our unit test sigs here
+void run_unit_tests();
 void test_init();
 void test_no_flags();
 void test_memory_copied();
@@ -137,10 +164,59 @@ void test_txx_instr();
 void test_inx_instr();
 void test_dex_instr();
 void test_phx_instr();
+void test_flag_consumers();
 void test_cli_instr();
 void test_nop_instr();
 void test_brk_instr();
 void test_jsr_instr();
+void test_self_modifying_code();
+void test_stop_reasons();
+void test_page_changes();
+void test_memory_device();
+void test_write_listeners();
+void test_fork();
+void test_checkpoint();
+#ifdef ENABLE_PAGE_STORE
+void test_page_store();
+#endif
+#ifdef ENABLE_ROM_MAPPING
+void test_rom();
+#endif
+#ifdef ENABLE_LOADER
+void test_loader();
+#endif
+#ifdef ENABLE_CARTRIDGE
+void test_cartridge();
+#endif
+void test_reset_and_destroy();
+#ifdef ENABLE_CYCLE_COUNT
+void test_cycles();
+#endif
+#ifdef ENABLE_THROTTLE
+void test_throttle();
+#endif
+#ifdef ENABLE_EVENTS
+void test_events();
+#endif
+#ifdef ENABLE_INTERRUPTS
+void test_interrupts();
+#endif
+#ifdef ENABLE_BATCH
+void test_batch();
+#endif
+#ifdef ENABLE_LOCKSTEP
+void test_lockstep();
+#endif
+#ifdef ENABLE_IDLE_SKIP
+void test_idle_skip();
+#endif
+void test_disassembler();
+#ifdef ENABLE_DYNAREC
+void test_engines_agree();
+#endif
+#ifdef ENABLE_FUSION
+void test_fusion();
+#endif
 
 //start testing real programs
 void test_program_1();
@@ -177,7 +253,37 @@ void run_test_harness()
 {
 	printf("running unit tests...\n\n");
 
+	run_unit_tests();
+
+	#ifdef ENABLE_DYNAREC
+	//everything has to come out the same on translated code
+	printf("\nrunning unit tests on the dynarec...\n\n");
+	test_engine = ENGINE_DYNAREC;
+	run_unit_tests();
+	test_engine = ENGINE_INTERPRETER;
+	#endif
+
+	#ifdef ENABLE_DYNAREC
+	test_engines_agree();
+	#endif
+
+	#ifdef ENABLE_FUSION
+	test_fusion();
+	#endif
+
+	printf("\n...finished unit tests!\n");
+}
+
 
+/**************************************
+ * Name:  run_unit_tests
+ * Inputs:  None
+ * Outputs: None
+ * Function: runs each unit test once
+ *
+***************************************/
+void run_unit_tests()
+{
 	test_init();
 	test_no_flags();
 	test_memory_copied();
@@ -216,14 +322,55 @@ void run_test_harness()
 	test_inx_instr();
 	test_dex_instr();
 	test_phx_instr();
+	test_flag_consumers();
 	test_cli_instr();
 	test_nop_instr();
 	test_brk_instr();
 	test_jsr_instr();
+	test_self_modifying_code();
+	test_stop_reasons();
+	test_page_changes();
+	test_memory_device();
+	test_write_listeners();
+	test_fork();
+	test_checkpoint();
+	#ifdef ENABLE_PAGE_STORE
+	test_page_store();
+	#endif
+	#ifdef ENABLE_ROM_MAPPING
+	test_rom();
+	#endif
+	#ifdef ENABLE_LOADER
+	test_loader();
+	#endif
+	#ifdef ENABLE_CARTRIDGE
+	test_cartridge();
+	#endif
+	test_reset_and_destroy();
+	#ifdef ENABLE_CYCLE_COUNT
+	test_cycles();
+	#endif
+	#ifdef ENABLE_THROTTLE
+	test_throttle();
+	#endif
+	#ifdef ENABLE_EVENTS
+	test_events();
+	#endif
+	#ifdef ENABLE_INTERRUPTS
+	test_interrupts();
+	#endif
+	#ifdef ENABLE_BATCH
+	test_batch();
+	#endif
+	#ifdef ENABLE_LOCKSTEP
+	test_lockstep();
+	#endif
+	#ifdef ENABLE_IDLE_SKIP
+	test_idle_skip();
+	#endif
+	test_disassembler();
 
 	test_program_1();
-
-	printf("\n...finished unit tests!\n");
 }
 
 
@@ -309,6 +456,8 @@ void test_memory_copied()
 	assert(read_mem(&emulator,2) == Memory[2] );
 	assert(read_mem(&emulator,3) == Memory[3] );
 	assert(read_mem(&emulator,4) == Memory[4] );
+
+	destroy_em6502( &emulator );
 }
 
 void test_long_program_load()
@@ -333,6 +482,8 @@ void test_long_program_load()
 	assert(emulator.page_table[1]->data[255] == program[511]);
 	assert(emulator.page_table[2]->data[0] == program[512]);
 	assert(emulator.page_table[2]->data[255] == program[767]);
+
+	destroy_em6502( &emulator );
 }
 
 void test_ld__instr()
@@ -380,6 +531,8 @@ void test_ld__instr()
 	assert(emulator.Y == 0x00);	//we should load that value into acc
 	assert( (ZERO_GET(emulator.P)) );  //zero flag should be set
 	assert( !(NEG_GET(emulator.P)) );  //negative flag should NOT be set
+
+	destroy_em6502( &emulator );
 }
 
 
@@ -411,6 +564,8 @@ void test_sty_instr()
 
 	run_program(&emulator, 1); //STY $01 $30
 	assert(emulator._memory[0x3001] == 0x20);
+
+	destroy_em6502( &emulator );
 }
 
 void test_stx_instr()
@@ -440,6 +595,8 @@ void test_stx_instr()
 
 	run_program(&emulator, 1); //STX $01 $30
 	assert(emulator._memory[0x3001] == 0x20);
+
+	destroy_em6502( &emulator );
 }
 
 void test_sta_instr()
@@ -499,6 +656,8 @@ void test_sta_instr()
 
 	run_program(&emulator, 5);
 	assert(emulator._memory[0xEB25] == 0x12);
+
+	destroy_em6502( &emulator );
 }
 
 
@@ -563,6 +722,8 @@ void test_non_imm_lda_instr()
 
 	run_program(&emulator, 4);
 	assert(emulator.Acc == 0xFE);
+
+	destroy_em6502( &emulator );
 }
 
 void test_non_imm_ldx_instr()
@@ -605,6 +766,7 @@ void test_non_imm_ldx_instr()
 	run_program(&emulator, 4);
 	assert(emulator.X == 0xFD);
 
+	destroy_em6502( &emulator );
 }
 
 
@@ -648,6 +810,8 @@ void test_non_imm_ldy_instr()
 
 	run_program(&emulator, 4);
 	assert(emulator.Y == 0xFE);
+
+	destroy_em6502( &emulator );
 }
 
 //This is the debug version i've used to develop the TEST_AND_SET_V macros
@@ -737,6 +901,8 @@ void test_V_flags()
 	//assert( ret == 1 );
 	TEST_AND_SET_V_OVERFLOW_SUBTRACTION(P, ch1, ch2) ;
 	assert( (int)(OVERFLOW_GET(P)) != 0 );
+
+	destroy_em6502( &emulator );
 }
 
 
@@ -788,6 +954,8 @@ void test_C_flags()
 	ch2 = -1;
 	TEST_AND_SET_CARRY_ADDITION(P, ch1, ch2) ;
 	assert( (int)(CARRY_GET(P)) != 0 );
+
+	destroy_em6502( &emulator );
 }
 
 
@@ -821,6 +989,8 @@ void test_hw_flags()
 
 	run_program(&emulator, 1); //CLV
 	assert((int)(OVERFLOW_GET(emulator.P)) == 0 );
+
+	destroy_em6502( &emulator );
 }
 
 void test_adc_instr()
@@ -909,6 +1079,8 @@ void test_adc_instr()
 	//test run of SETUP_ABSOLUTE_INDEXED_X_MEMORY macro
 	run_program(&emulator, 6);
 	assert(emulator.Acc == 0xFF);
+
+	destroy_em6502( &emulator );
 }
 
 
@@ -994,6 +1166,8 @@ void test_and_instr()
 	//test run of SETUP_ABSOLUTE_INDEXED_X_MEMORY macro
 	run_program(&emulator, 6);
 	assert(emulator.Acc == 0x0E);
+
+	destroy_em6502( &emulator );
 }
 
 void test_bit_instr()
@@ -1042,6 +1216,7 @@ void test_bit_instr()
 	assert( (int)(NEG_GET(emulator.P)) != 0x00 );
 	assert( (int)(OVERFLOW_GET(emulator.P)) != 0x00 );
 
+	destroy_em6502( &emulator );
 }
 
 
@@ -1152,6 +1327,8 @@ void test_cmp_instr()
 	assert( (int)(ZERO_GET(emulator.P)) == 0x00 );
 	assert( (int)(CARRY_GET(emulator.P)) == 0x00 );
 	assert( (int)(NEG_GET(emulator.P)) == 0x00 );
+
+	destroy_em6502( &emulator );
 }
 
 
@@ -1237,6 +1414,8 @@ void test_eor_instr()
 	//test run of SETUP_ABSOLUTE_INDEXED_X_MEMORY macro
 	run_program(&emulator, 6);
 	assert(emulator.Acc == 0xF0);
+
+	destroy_em6502( &emulator );
 }
 
 
@@ -1323,6 +1502,8 @@ void test_ora_instr()
 	//test run of SETUP_ABSOLUTE_INDEXED_X_MEMORY macro
 	run_program(&emulator, 6);
 	assert(emulator.Acc == 0xFE);
+
+	destroy_em6502( &emulator );
 }
 
 void test_sbc_instr()
@@ -1419,6 +1600,8 @@ void test_sbc_instr()
 	//test run of SETUP_ABSOLUTE_INDEXED_X_MEMORY macro
 	run_program(&emulator, 6);
 	assert(emulator.Acc == 0x02);
+
+	destroy_em6502( &emulator );
 }
 
 void test_inc_instr()
@@ -1463,6 +1646,7 @@ void test_inc_instr()
 	run_program(&emulator, 4);
 	assert(emulator._memory[0xEB25] == 0xFF);
 
+	destroy_em6502( &emulator );
 }
 
 void test_dec_instr()
@@ -1506,6 +1690,8 @@ void test_dec_instr()
 	//test run of SETUP_ABSOLUTE_INDEXED_X_MEMORY macro
 	run_program(&emulator, 4);
 	assert(emulator._memory[0xEB25] == 0xFD);
+
+	destroy_em6502( &emulator );
 }
 
 
@@ -1548,6 +1734,8 @@ void test_cpx_instr()
 	assert( (int)(ZERO_GET(emulator.P)) == 0x00 );
 	assert( (int)(NEG_GET(emulator.P)) == 0x00 );
 	assert( (int)(CARRY_GET(emulator.P)) != 0x00 );
+
+	destroy_em6502( &emulator );
 }
 
 void test_cpy_instr()
@@ -1589,6 +1777,8 @@ void test_cpy_instr()
 	assert( (int)(ZERO_GET(emulator.P)) == 0x00 );
 	assert( (int)(NEG_GET(emulator.P)) == 0x00 );
 	assert( (int)(CARRY_GET(emulator.P)) != 0x00 );
+
+	destroy_em6502( &emulator );
 }
 
 
@@ -1651,6 +1841,8 @@ void test_rol_instr()
 	//test run of accumulator wraparound
 	run_program(&emulator, 3);
 	assert(emulator.Acc == 0xFC);
+
+	destroy_em6502( &emulator );
 }
 
 
@@ -1715,6 +1907,8 @@ void test_ror_instr()
 	//test run of accumulator wraparound
 	run_program(&emulator, 3);
 	assert(emulator.Acc == 0x7F);
+
+	destroy_em6502( &emulator );
 }
 
 
@@ -1782,6 +1976,8 @@ void test_asl_intsr()
 	assert( (int)(ZERO_GET(emulator.P)) == 0x00 );
 	assert( (int)(CARRY_GET(emulator.P)) != 0x00 );
 	assert( (int)(NEG_GET(emulator.P)) != 0x00 );
+
+	destroy_em6502( &emulator );
 }
 
 
@@ -1849,6 +2045,8 @@ void test_lsr_instr()
 	assert( (int)(ZERO_GET(emulator.P)) == 0x00 );
 	assert( (int)(CARRY_GET(emulator.P)) == 0x00 );
 	assert( (int)(NEG_GET(emulator.P)) == 0x00 );
+
+	destroy_em6502( &emulator );
 }
 
 void test_jmp_instr()
@@ -1879,6 +2077,8 @@ void test_jmp_instr()
 	//test run of SETUP_POST_INDEXED_Y_INDIRECT_MEMORY macro
 	run_program(&emulator, 8);
 	assert(emulator.PC == 0xEAFB);
+
+	destroy_em6502( &emulator );
 }
 
 void test_bxx_instr()
@@ -1978,6 +2178,8 @@ void test_bxx_instr()
 
 	run_program(&emulator, 2);
 	assert(emulator.PC == 0x24);
+
+	destroy_em6502( &emulator );
 }
 
 
@@ -2041,6 +2243,8 @@ void test_txx_instr()
 	assert(emulator.S == 0x03);
 	assert( (int)(ZERO_GET(emulator.P)) == 0x00 );
 	assert( (int)(NEG_GET(emulator.P)) == 0x00 );
+
+	destroy_em6502( &emulator );
 }
 
 void test_inx_instr()
@@ -2063,6 +2267,8 @@ void test_inx_instr()
 
 	run_program(&emulator, 4);
 	assert( emulator.Y == 0x04);
+
+	destroy_em6502( &emulator );
 }
 
 void test_dex_instr()
@@ -2085,6 +2291,8 @@ void test_dex_instr()
 
 	run_program(&emulator, 4);
 	assert( emulator.Y == 0x02);
+
+	destroy_em6502( &emulator );
 }
 
 
@@ -2127,6 +2335,60 @@ void test_phx_instr()
 	run_program(&emulator, 1);
 	assert( emulator.P == 0xDE);
 	assert( emulator.S == 0xFF);
+
+	destroy_em6502( &emulator );
+}
+
+
+/**************************************
+ * Name:  test_flag_consumers
+ * Inputs:  None
+ * Outputs: None
+ * Function: unit tests for the instrs that use P as a whole, and for P in between
+ *			 run_program calls; they all have to see the flags the instrs before them set
+ *
+***************************************/
+void test_flag_consumers()
+{
+	unsigned char program[] =
+	{
+		0xA9, 0x7F, //LDA #$7F
+		0x69, 0x01, //ADC #$01, sets N and V
+		0x08, //PHP
+		0xA9, 0x00, //LDA #$00, sets Z, clears N
+		0x28, //PLP, back to N and V
+		0x30, 0x02, //BMI over the LDX
+		0xA2, 0x01, //LDX #$01
+		0x70, 0x02, //BVS over the LDY
+		0xA0, 0x01, //LDY #$01
+		0x18, //CLC
+		0xEA //NOP
+	};
+
+	SETUP_UNIT_TEST("test_flag_consumers") ;
+
+	emulator.P = 0x01; //carry in to the ADC
+	run_program(&emulator, 3);
+	assert( emulator.Acc == 0x81 );
+	assert( emulator.P == 0xC0 );
+	assert( emulator._memory[0x01FF] == 0xC0 );
+
+	run_program(&emulator, 1);
+	assert( emulator.P == 0x42 );
+
+	//whatever P gets set to in between calls is what the next instrs see
+	emulator.P = 0x43;
+	run_program(&emulator, 3);
+	assert( emulator.P == 0xC0 );
+	assert( emulator.X == 0x00 );
+	assert( emulator.Y == 0x00 );
+	assert( emulator.PC == 0x10 );
+
+	emulator.P = 0xFF;
+	run_program(&emulator, 1);
+	assert( emulator.P == 0xFE );
+
+	destroy_em6502( &emulator );
 }
 
 
@@ -2148,6 +2410,8 @@ void test_cli_instr()
 
 	run_program(&emulator, 1);
 	assert( (int)(IRQ_DISABLE_GET(emulator.P)) != 0x00 );
+
+	destroy_em6502( &emulator );
 }
 
 void test_nop_instr()
@@ -2165,6 +2429,7 @@ void test_nop_instr()
 	run_program(&emulator, 3);
 	assert( emulator.PC == 0x03 );
 
+	destroy_em6502( &emulator );
 }
 
 void test_brk_instr()
@@ -2207,6 +2472,8 @@ void test_brk_instr()
 	assert( emulator.PC == 0x06 );
 	assert( emulator.P == 0x10 );
 	assert( (int)(IRQ_DISABLE_GET(emulator.P)) == 0x00 );  //interrupts disabled
+
+	destroy_em6502( &emulator );
 }
 
 
@@ -2243,30 +2510,2016 @@ void test_jsr_instr()
 	run_program(&emulator, 3);
 	assert( emulator.PC == 0x07 );
 	assert( (int)(CARRY_GET(emulator.P)) != 0x00 );  //flags should get preserved across subroutines
+
+	destroy_em6502( &emulator );
 }
 
 
-void test_program_1()
+void test_self_modifying_code()
 {
-	//this runs a random looping program
+	//this tests that code gets re-decoded after it is overwritten
 	unsigned char program[] =
 	{
-	0xA9, 0x0F, 0x8D, 0x00, 0x00, 0xA9, 0x04, 0x8D,
-	0x01, 0x00, 0xA9, 0x01, 0x8D, 0x02, 0x00, 0xAD,
-	0x00, 0x00, 0x8D, 0x03, 0x00, 0xAD, 0x01, 0x00,
-	0x8D, 0x04, 0x00, 0xAD, 0x02, 0x00, 0xC9, 0x00,
-	0xD0, 0x06, 0xEE, 0x00, 0x00, 0x4C, 0x2B, 0x00,
-	0xCE, 0x00, 0x00, 0xAE, 0x02, 0x00, 0xAD, 0x00,
-	0x00, 0xC9, 0x1F, 0xD0, 0x05, 0xA2, 0x01, 0x4C,
-	0x40, 0x00, 0xC9, 0x00, 0xD0, 0x02, 0xA2, 0x00,
-	0x8E, 0x02, 0x00, 0xA9, 0x01, 0xA2, 0x00, 0x81,
-	0x00, 0xA9, 0x00, 0xA2, 0x00, 0x81, 0x03, 0x4C,
-	0x0F, 0x00
+		0xA2, 0x00, //LDX #$00
+		0xEA, //NOP, gets patched to INX
+
+		0xA9, 0xE8, //LDA #$E8
+		0x8D, 0x02, 0x00, //STA $0002
+
+		0x4C, 0x02, 0x00 //JMP $0002
 	};
 
-	SETUP_UNIT_TEST("test_program_1") ;
+	SETUP_UNIT_TEST("test_self_modifying_code") ;
+
+	run_program(&emulator, 5);
+	assert( emulator.PC == 0x02 );
+	assert( emulator.X == 0x00 );
+	assert( emulator._memory[0x02] == 0xE8 );
+
+	run_program(&emulator, 1); //INX, not the NOP we ran before
+	assert( emulator.PC == 0x03 );
+	assert( emulator.X == 0x01 );
+
+	//now patch the operand of the LDA behind the emulator's back
+	emulator._memory[0x04] = 0xCA; //DEX
+	invalidate_code(&emulator, 0x04, 0x04);
+
+	run_program(&emulator, 4); //LDA, STA, JMP, DEX
+	assert( emulator.Acc == 0xCA );
+	assert( emulator.PC == 0x03 );
+	assert( emulator.X == 0x00 );
+
+	destroy_em6502( &emulator );
+}
+
+
+/**************************************
+ * Name:  test_stop_reasons
+ * Inputs:  None
+ * Outputs: None
+ * Function: unit tests for what run_program returns; breakpoints, BRK and invalid opcodes
+ *
+***************************************/
+void test_stop_reasons()
+{
+	unsigned char program[] =
+	{
+		0xA9, 0x05, //LDA #$05
+		0x85, 0x10, //STA $10, breakpoint here; LDA and STA get fused if they can
+		0xE8, //INX
+		0x00 //BRK, goes to $0020 where there's an invalid opcode
+	};
+
+	SETUP_UNIT_TEST("test_stop_reasons") ;
+
+	memset(emulator._memory, 0, MEMORY_SIZE);
+	load_program( &emulator, &program, sizeof(program), 0);
+	emulator._memory[0x20] = 0x02;
+	emulator._memory[0xFFFE] = 0x20;
+	emulator._memory[0xFFFF] = 0x00;
+
+	set_breakpoint(&emulator, 0x02);
+	emulator.stop_at_brk = 1;
+
+	assert( run_program(&emulator, 100) == STOP_BREAKPOINT );
+	assert( emulator.PC == 0x02 );
+	assert( emulator.Acc == 0x05 );
+	assert( emulator._memory[0x10] == 0x00 );
+	#ifdef ALLOW_MAX_INSTR_COUNT
+	assert( emulator.instr_count == 1 );
+	#endif
+
+	//picks up at the breakpoint it stopped at, rather than stopping there again
+	assert( run_program(&emulator, 100) == STOP_BRK );
+	assert( emulator.PC == 0x05 );
+	assert( emulator._memory[0x10] == 0x05 );
+	assert( emulator.X == 0x01 );
+	#ifdef ALLOW_MAX_INSTR_COUNT
+	assert( emulator.instr_count == 3 );
+	#endif
+
+	//a BRK is where the program ends, so it stays stopped on it
+	assert( run_program(&emulator, 100) == STOP_BRK );
+	assert( emulator.PC == 0x05 );
+	#ifdef ALLOW_MAX_INSTR_COUNT
+	assert( emulator.instr_count == 3 );
+	#endif
+
+	emulator.stop_at_brk = 0;
+	assert( run_program(&emulator, 100) == STOP_INVALID_OPCODE );
+	assert( emulator.PC == 0x20 );
+	assert( emulator.S == 0xFC );
+	#ifdef ALLOW_MAX_INSTR_COUNT
+	assert( emulator.instr_count == 4 );
+	#endif
+
+	//and nothing stops it once the breakpoint is gone
+	clear_breakpoint(&emulator, 0x02);
+	emulator.PC = 0x00;
+	assert( run_program(&emulator, 3) == STOP_BUDGET );
+	assert( emulator.PC == 0x05 );
+	#ifdef ALLOW_MAX_INSTR_COUNT
+	assert( emulator.instr_count == 7 );
+	#endif
+
+	//setting one in code that has already run (and been fused) stops there too
+	set_breakpoint(&emulator, 0x02);
+	emulator.PC = 0x00;
+	assert( run_program(&emulator, 3) == STOP_BREAKPOINT );
+	assert( emulator.PC == 0x02 );
+	#ifdef ALLOW_MAX_INSTR_COUNT
+	assert( emulator.instr_count == 8 );
+	#endif
+
+	destroy_em6502( &emulator );
+}
+
+
+//what test_page_changes' listener has seen
+static unsigned int listener_reads;
+static unsigned int listener_writes;
+
+static void count_accesses( unsigned short addr, unsigned char val, unsigned char mode )
+{
+	if ( mode == READ ) listener_reads++;
+	if ( mode == WRITE ) listener_writes++;
+}
+
+/**************************************
+ * Name:  test_page_changes
+ * Inputs:  None
+ * Outputs: None
+ * Function: unit tests for update_page; pages that get a listener or
+ *			 get pointed elsewhere stop being treated as plain RAM
+ *
+***************************************/
+void test_page_changes()
+{
+	unsigned char program[] =
+	{
+		0xA9, 0xAA, //LDA #$AA
+		0x8D, 0x00, 0x03, //STA $0300, page 3 has a listener
+		0x8D, 0x00, 0x04, //STA $0400, page 4 is really page 5
+		0xAD, 0x05, 0x03, //LDA $0305
+		0x8D, 0x00, 0x02 //STA $0200
+	};
+
+	SETUP_UNIT_TEST("test_page_changes") ;
+
+	memset(&emulator._memory[0x0200], 0, 4 * PAGE_SIZE);
+	emulator._memory[0x0305] = 0x55;
+
+	listener_reads = 0;
+	listener_writes = 0;
+	emulator.page_table[3]->cb_mem_listener = count_accesses;
+	update_page(&emulator, 3);
+	emulator.page_table[4]->data = &emulator._memory[0x0500];
+	update_page(&emulator, 4);
+
+	run_program(&emulator, 5);
+	assert( emulator._memory[0x0300] == 0xAA );
+	assert( emulator._memory[0x0400] == 0x00 );
+	assert( emulator._memory[0x0500] == 0xAA );
+	assert( emulator._memory[0x0200] == 0x55 );
+	assert( listener_reads == 1 );
+	assert( listener_writes == 1 );
+
+	//and back to normal
+	emulator.page_table[3]->cb_mem_listener = 0;
+	update_page(&emulator, 3);
+	emulator.PC = 0;
+	run_program(&emulator, 5);
+	assert( listener_reads == 1 );
+	assert( listener_writes == 1 );
+
+	destroy_em6502( &emulator );
+}
+
+
+//test_memory_device's device: $D000 counts down as it's read, $D001 keeps
+//whatever's written to it xor'ed with a mask, the rest of the page is plain memory
+typedef struct {
+	em6502 *emu; //the emulator it's plugged into
+	unsigned char count;
+	unsigned char mask;
+	unsigned int reads;
+}countdown_device;
+
+static unsigned char countdown_access( em6502 *emu, void *context, unsigned short addr, unsigned char val, unsigned char mode )
+{
+	countdown_device *device = (countdown_device *)context;
+
+	assert( (emu == device->emu) );
+
+	if ( addr == 0xD000 && mode == READ )
+	{
+		device->reads++;
+		return --device->count;
+	}
+	if ( addr == 0xD001 && mode == WRITE )
+	{
+		return val ^ device->mask;
+	}
+
+	return val;
+}
+
+/**************************************
+ * Name:  test_memory_device
+ * Inputs:  None
+ * Outputs: None
+ * Function: unit tests for set_memory_device; reads come from the device
+ *			 rather than memory, each emulator's device gets its own context,
+ *			 and polling one isnt an idle loop
+ *
+***************************************/
+void test_memory_device()
+{
+	unsigned char program[] =
+	{
+		0xAD, 0x00, 0xD0, //loop: LDA $D000
+		0xD0, 0xFB, //BNE loop
+		0xA9, 0x0F, //LDA #$0F
+		0x8D, 0x01, 0xD0, //STA $D001
+		0xAD, 0x01, 0xD0, //LDA $D001
+		0x8D, 0x02, 0xD0, //STA $D002
+		0x00 //BRK
+	};
+	countdown_device devices[2];
+	mem_region region;
+	em6502 other;
+	int i;
+
+	SETUP_UNIT_TEST("test_memory_device") ;
+
+	initialize_em6502(&other);
+	SET_TEST_ENGINE(other);
+	create_simple_memory_map(&other);
+	load_program(&other, &program, sizeof(program), 0);
+
+	region.low = 0xD000;
+	region.high = 0xD0FF;
+	memset(devices, 0, sizeof(devices));
+	devices[0].emu = &emulator;
+	devices[0].count = 5;
+	devices[0].mask = 0xF0;
+	devices[1].emu = &other;
+	devices[1].count = 9;
+	devices[1].mask = 0x33;
+	set_memory_device(&emulator, region, countdown_access, &devices[0]);
+	set_memory_device(&other, region, countdown_access, &devices[1]);
+	emulator.stop_at_brk = 1;
+	other.stop_at_brk = 1;
+
+	//a few instrs of one, then the other, and so on
+	for ( i = 0; i < 20; i++ )
+	{
+		run_program(&emulator, 3);
+		run_program(&other, 3);
+	}
+
+	assert( emulator.PC == 0x10 );
+	assert( devices[0].reads == 5 );
+	assert( devices[0].count == 0 );
+	#ifdef ALLOW_MAX_INSTR_COUNT
+	assert( emulator.instr_count == 5 * 2 + 4 );
+	#endif
+	assert( emulator.Acc == 0xFF );
+	assert( emulator._memory[0xD000] == 0x00 );
+	assert( emulator._memory[0xD001] == 0xFF );
+	assert( emulator._memory[0xD002] == 0xFF );
+
+	assert( other.PC == 0x10 );
+	assert( devices[1].reads == 9 );
+	#ifdef ALLOW_MAX_INSTR_COUNT
+	assert( other.instr_count == 9 * 2 + 4 );
+	#endif
+	assert( other.Acc == 0x3C );
+	assert( other._memory[0xD002] == 0x3C );
+
+	//and taken away again
+	set_memory_device(&emulator, region, 0, &devices[0]);
+	assert( (emulator.page_table[0xD0]->device_context == 0) );
+	emulator.PC = 0;
+	emulator._memory[0xD000] = 0x00;
+	run_program(&emulator, 2);
+	assert( emulator.PC == 0x05 );
+	assert( devices[0].reads == 5 );
+
+	destroy_em6502( &other );
+	destroy_em6502( &emulator );
+}
+
+//what test_write_listeners' listeners have seen, in order; a listener's
+//number is in the high byte, the addr written in the low
+static unsigned int writes_seen[16];
+static unsigned int num_writes_seen;
+
+static void first_write_listener( unsigned short addr )
+{
+	writes_seen[num_writes_seen++] = 0x10000 | addr;
+}
+
+static void second_write_listener( unsigned short addr )
+{
+	writes_seen[num_writes_seen++] = 0x20000 | addr;
+}
+
+/**************************************
+ * Name:  test_write_listeners
+ * Inputs:  None
+ * Outputs: None
+ * Function: unit tests for add_memory_write_listener; only writes to the
+ *			 bytes watched get seen, by every listener watching them
+ *
+***************************************/
+void test_write_listeners()
+{
+	unsigned char program[] =
+	{
+		0xA9, 0x42, //LDA #$42
+		0x85, 0xFD, //STA $FD
+		0x85, 0xFE, //STA $FE
+		0xE6, 0xFF, //INC $FF
+		0xA5, 0xFC, //LDA $FC
+		0x48, //PHA
+		0x8D, 0x00, 0x01, //STA $0100
+		0x8D, 0x01, 0x01 //STA $0101
+	};
+	mem_region region;
+	int i;
+
+	SETUP_UNIT_TEST("test_write_listeners") ;
+
+	num_writes_seen = 0;
+	region.low = 0x00FE;
+	region.high = 0x00FF;
+	assert( add_memory_write_listener(&emulator, region, first_write_listener) );
+	region.low = 0x00FF;
+	region.high = 0x0100;
+	assert( add_memory_write_listener(&emulator, region, second_write_listener) );
+
+	//the rest of their pages isnt watched
+	assert( !WATCHED(&emulator, 0x00FD) );
+	assert( WATCHED(&emulator, 0x00FE) );
+	assert( !WATCHED(&emulator, 0x0101) );
+	assert( (emulator.watch_masks[0x02] == 0) );
+
+	run_program(&emulator, 8);
+	assert( emulator._memory[0x00FF] == 0x01 );
+	assert( emulator._memory[0x01FF] == 0x00 );
+	assert( num_writes_seen == 4 );
+	assert( writes_seen[0] == 0x100FE );
+	assert( writes_seen[1] == 0x100FF );
+	assert( writes_seen[2] == 0x200FF );
+	assert( writes_seen[3] == 0x20100 );
+
+	//only so many of them
+	for ( i = 2; i < MAX_MEMORY_WRITER_LISTENERS; i++ )
+	{
+		assert( add_memory_write_listener(&emulator, region, first_write_listener) );
+	}
+	assert( !add_memory_write_listener(&emulator, region, first_write_listener) );
+
+	//and a reset takes them all away
+	reset_em6502(&emulator);
+	assert( emulator.num_write_listeners == 0 );
+	assert( !WATCHED(&emulator, 0x00FE) );
+	write_mem(&emulator, 0x00FE, 0x00);
+	assert( num_writes_seen == 4 );
+
+	destroy_em6502( &emulator );
+}
+
+//1 if the two emulators' memory reads the same everywhere
+static int same_memory( em6502 *a, em6502 *b )
+{
+	unsigned int addr;
+
+	for ( addr = 0; addr < MEMORY_SIZE; addr++ )
+	{
+		if ( read_mem(a, addr) != read_mem(b, addr) )
+		{
+			return 0;
+		}
+	}
+
+	return 1;
+}
+
+/**************************************
+ * Name:  test_fork
+ * Inputs:  None
+ * Outputs: None
+ * Function: unit tests for fork_em6502; a fork runs on the same as what it came
+ *			 from, only copies the pages it writes, and neither sees the other's writes
+ *
+***************************************/
+void test_fork()
+{
+	unsigned char program[] =
+	{
+		0xA2, 0x00, //LDX #$00
+		0xE6, 0x10, //loop: INC $10
+		0xA5, 0x10, //LDA $10
+		0x9D, 0x00, 0x03, //STA $0300,X
+		0xE8, //INX
+		0xD0, 0xF6, //BNE loop
+		0x00 //BRK
+	};
+	em6502 fork;
+	em6502 second;
+	em6502 third;
+	unsigned int owned;
+	int i;
+
+	SETUP_UNIT_TEST("test_fork") ;
 
+	emulator._memory[0x8000] = 0x77;
+	run_program(&emulator, 10);
+
+	fork_em6502(&emulator, &fork);
+	fork_em6502(&emulator, &second);
+	assert( fork.PC == emulator.PC );
+	assert( fork.X == emulator.X );
+	#ifdef ALLOW_MAX_INSTR_COUNT
+	assert( fork.instr_count == emulator.instr_count );
+	#endif
+	assert( (emulator.shared_pages[0x80] != 0) );
+	assert( (fork.shared_pages[0x80] == emulator.shared_pages[0x80]) );
+	assert( emulator.shared_pages[0x80]->refs == 3 );
+	assert( read_mem(&fork, 0x8000) == 0x77 );
+
+	//both run on the same, each on its own pages
 	run_program(&emulator, 100);
+	run_program(&fork, 100);
+	assert( fork.PC == emulator.PC );
+	assert( fork.Acc == emulator.Acc );
+	assert( fork.X == emulator.X );
+	assert( same_memory(&emulator, &fork) );
+	assert( read_mem(&second, 0x0310) == 0x00 );
+
+	//only the zero page and page 3 got copied
+	owned = 0;
+	for ( i = 0; i < NUM_PAGES; i++ )
+	{
+		owned += fork.shared_pages[i] == 0;
+	}
+	assert( owned == 2 );
+	assert( (fork.shared_pages[0x00] == 0) );
+	assert( (fork.shared_pages[0x03] == 0) );
+	assert( emulator.shared_pages[0x80]->refs == 3 );
+
+	write_mem(&second, 0x8000, 0x12);
+	assert( read_mem(&second, 0x8000) == 0x12 );
+	assert( read_mem(&emulator, 0x8000) == 0x77 );
+	assert( read_mem(&fork, 0x8000) == 0x77 );
+	assert( fork.shared_pages[0x80]->refs == 2 );
+
+	//a fork of a fork outlives both
+	fork_em6502(&fork, &third);
+	destroy_em6502(&emulator);
+	destroy_em6502(&fork);
+	assert( read_mem(&third, 0x8000) == 0x77 );
+	assert( third.shared_pages[0x80]->refs == 1 );
+	third.stop_at_brk = 1;
+	assert( (run_program(&third, 2000) == STOP_BRK) );
+	assert( third.PC == 0x0C );
+	assert( read_mem(&third, 0x03FF) == read_mem(&third, 0x10) );
+
+	//and a reset gives its shared pages back
+	reset_em6502(&second);
+	assert( (second.shared_pages[0x10] == 0) );
+	assert( read_mem(&second, 0x8000) == 0x00 );
+
+	destroy_em6502(&second);
+	destroy_em6502(&third);
+}
+
+/**************************************
+ * Name:  test_checkpoint
+ * Inputs:  None
+ * Outputs: None
+ * Function: unit tests for checkpoint_em6502 and rollback_em6502; only the pages
+ *			 written get marked, and rolling back puts everything as it was
+ *
+***************************************/
+void test_checkpoint()
+{
+	unsigned char program[] =
+	{
+		0xA2, 0x00, //LDX #$00
+		0xE6, 0x10, //loop: INC $10
+		0xA5, 0x10, //LDA $10
+		0x9D, 0x00, 0x03, //STA $0300,X
+		0x20, 0x20, 0x00, //JSR sub
+		0xE8, //INX
+		0xD0, 0xF3, //BNE loop
+		0x00, //BRK
+		0xEA, 0xEA, 0xEA, 0xEA, 0xEA, 0xEA, 0xEA, 0xEA, 0xEA, 0xEA, 0xEA, 0xEA, 0xEA, 0xEA, 0xEA, 0xEA, //padding
+		0x8D, 0x0F, 0x00, //sub: STA $000F, over the BRK
+		0x60 //RTS
+	};
+	unsigned char before[MEMORY_SIZE];
+	unsigned char after[MEMORY_SIZE];
+	unsigned char A;
+	unsigned char X;
+	#ifdef ALLOW_MAX_INSTR_COUNT
+	unsigned int instrs;
+	#endif
+	int i;
+
+	SETUP_UNIT_TEST("test_checkpoint") ;
+
+	emulator.stop_at_brk = 1;
+	run_program(&emulator, 2);
+	checkpoint_em6502(&emulator);
+	memcpy(before, emulator._memory, MEMORY_SIZE);
+	for ( i = 0; i < NUM_PAGES / 8; i++ )
+	{
+		assert( emulator.dirty_pages[i] == 0 );
+	}
+
+	run_program(&emulator, 20);
+	A = emulator.Acc;
+	X = emulator.X;
+	#ifdef ALLOW_MAX_INSTR_COUNT
+	instrs = emulator.instr_count;
+	#endif
+	memcpy(after, emulator._memory, MEMORY_SIZE);
+
+	//the code, and the zero page; the stack; and page 3
+	assert( emulator.dirty_pages[0] == 0x0B );
+	for ( i = 1; i < NUM_PAGES / 8; i++ )
+	{
+		assert( emulator.dirty_pages[i] == 0 );
+	}
+
+	//the same run again from the checkpoint, code that patched itself included
+	for ( i = 0; i < 3; i++ )
+	{
+		rollback_em6502(&emulator);
+		assert( emulator.PC == 0x04 );
+		assert( emulator.X == 0x00 );
+		#ifdef ALLOW_MAX_INSTR_COUNT
+		assert( emulator.instr_count == 2 );
+		#endif
+		assert( emulator.dirty_pages[0] == 0 );
+		assert( memcmp(emulator._memory, before, MEMORY_SIZE) == 0 );
+
+		run_program(&emulator, 20);
+		assert( emulator.Acc == A );
+		assert( emulator.X == X );
+		#ifdef ALLOW_MAX_INSTR_COUNT
+		assert( emulator.instr_count == instrs );
+		#endif
+		assert( memcmp(emulator._memory, after, MEMORY_SIZE) == 0 );
+	}
+
+	destroy_em6502( &emulator );
+}
+
+#ifdef ENABLE_PAGE_STORE
+/**************************************
+ * Name:  test_page_store
+ * Inputs:  None
+ * Outputs: None
+ * Function: unit tests for dedup_pages; the same bytes in any emulator end up
+ *			 as a single page, which each of them gets its own copy of on a write
+ *
+***************************************/
+void test_page_store()
+{
+	unsigned char program[] =
+	{
+		0xAD, 0x00, 0x80, //LDA $8000
+		0x85, 0x10, //STA $10
+		0xEE, 0x00, 0x90, //INC $9000
+		0x00 //BRK
+	};
+	em6502 emus[3];
+	page_store store;
+	int i;
+
+	printf("running test_page_store...\n");
+
+	initialize_page_store(&store);
+
+	for ( i = 0; i < 3; i++ )
+	{
+		initialize_em6502(&emus[i]);
+		SET_TEST_ENGINE(emus[i]);
+		create_simple_memory_map(&emus[i]);
+		load_program(&emus[i], &program, sizeof(program), 0);
+		emus[i].stop_at_brk = 1;
+		write_mem(&emus[i], 0x8000, 0x42);
+		write_mem(&emus[i], 0x9000, 0x10 + i);
+	}
+
+	//the program, $8000's page, everything zeroed and then a page of $9000 each
+	assert( dedup_pages(&store, &emus[0]) == NUM_PAGES );
+	assert( store.count == 4 );
+	assert( dedup_pages(&store, &emus[1]) == NUM_PAGES );
+	assert( dedup_pages(&store, &emus[2]) == NUM_PAGES );
+	assert( store.count == 6 );
+	assert( (emus[0].shared_pages[0x00] == emus[2].shared_pages[0x00]) );
+	assert( (emus[0].shared_pages[0x80] == emus[1].shared_pages[0x80]) );
+	assert( (emus[0].shared_pages[0x10] == emus[1].shared_pages[0x20]) );
+	assert( (emus[0].shared_pages[0x90] != emus[1].shared_pages[0x90]) );
+	assert( emus[0].shared_pages[0x80]->refs == 4 );
+
+	//a second time changes nothing
+	assert( dedup_pages(&store, &emus[0]) == NUM_PAGES );
+	assert( store.count == 6 );
+	assert( emus[0].shared_pages[0x80]->refs == 4 );
+
+	for ( i = 0; i < 3; i++ )
+	{
+		assert( (run_program(&emus[i], 10) == STOP_BRK) );
+		assert( read_mem(&emus[i], 0x10) == 0x42 );
+		assert( read_mem(&emus[i], 0x9000) == 0x11 + i );
+		assert( read_mem(&emus[i], 0x9001) == 0x00 );
+		assert( (emus[i].shared_pages[0x00] == 0) );
+		assert( (emus[i].shared_pages[0x90] == 0) );
+		assert( (emus[i].shared_pages[0x80] != 0) );
+	}
+
+	//the store can go before the emulators, or after
+	destroy_page_store(&store);
+	assert( emus[0].shared_pages[0x80]->refs == 3 );
+	destroy_em6502(&emus[0]);
+	initialize_page_store(&store);
+	assert( dedup_pages(&store, &emus[1]) == NUM_PAGES );
+	assert( store.count == 4 );
+	destroy_em6502(&emus[1]);
+	destroy_em6502(&emus[2]);
+	destroy_page_store(&store);
+}
+#endif
+
+#ifdef ENABLE_ROM_MAPPING
+/**************************************
+ * Name:  test_rom
+ * Inputs:  None
+ * Outputs: None
+ * Function: unit tests for attach_rom; emulators read and run the file's
+ *			 own mapping, and writes to it go nowhere
+ *
+***************************************/
+void test_rom()
+{
+	unsigned char program[] =
+	{
+		0xAD, 0x00, 0xF0, //LDA $F000
+		0x85, 0x80, //STA $80
+		0xAD, 0x2B, 0xF1, //LDA $F12B, the last byte of the file
+		0x85, 0x81, //STA $81
+		0xAD, 0xFF, 0xF1, //LDA $F1FF, past the end of it
+		0x85, 0x82, //STA $82
+		0x20, 0x00, 0xF1, //JSR $F100
+		0xEE, 0x00, 0xF0, //INC $F000
+		0xAD, 0x00, 0xF0, //LDA $F000
+		0x85, 0x83, //STA $83
+		0x00 //BRK
+	};
+	unsigned char image[300];
+	char path[] = "/tmp/6502_romXXXXXX";
+	rom_image rom;
+	rom_image missing;
+	em6502 emus[3];
+	int fd;
+	int i;
+
+	printf("running test_rom...\n");
+
+	memset(image, 0, sizeof(image));
+	image[0x000] = 0x42;
+	image[0x100] = 0xA2; //LDX #$07
+	image[0x101] = 0x07;
+	image[0x102] = 0x60; //RTS
+	image[0x12B] = 0x99;
+
+	fd = mkstemp(path);
+	assert( fd >= 0 );
+	assert( write(fd, image, sizeof(image)) == sizeof(image) );
+	close(fd);
+
+	assert( open_rom(&rom, path) );
+	assert( rom.size == sizeof(image) );
+
+	//the file can go away; the mapping doesnt
+	unlink(path);
+	assert( open_rom(&missing, path) == 0 );
+	assert( (missing.data == 0) );
+	assert( open_rom(&missing, "/dev/null") == 0 );
+
+	for ( i = 0; i < 2; i++ )
+	{
+		initialize_em6502(&emus[i]);
+		SET_TEST_ENGINE(emus[i]);
+		create_simple_memory_map(&emus[i]);
+		load_program(&emus[i], &program, sizeof(program), 0);
+		emus[i].stop_at_brk = 1;
+		attach_rom(&emus[i], &rom, 0xF000);
+	}
+
+	//both of them on the one copy
+	assert( (emus[0].page_table[0xF0]->data == rom.data) );
+	assert( (emus[1].page_table[0xF1]->data == rom.data + PAGE_SIZE) );
+	assert( (emus[0].page_table[0xF2]->data == &emus[0]._memory[0xF200]) );
+
+	//and a fork of one keeps using it
+	fork_em6502(&emus[0], &emus[2]);
+	SET_TEST_ENGINE(emus[2]);
+	assert( (emus[2].page_table[0xF0]->data == rom.data) );
+
+	#ifdef ENABLE_FAST_MEMORY
+	//reads of it skip the page_t, wherever it's mapped
+	assert( (emus[0].read_pages[0xF1] == rom.data + PAGE_SIZE) );
+	assert( (emus[2].read_pages[0xF0] == rom.data) );
+	#endif
+
+	for ( i = 0; i < 3; i++ )
+	{
+		assert( (run_program(&emus[i], 20) == STOP_BRK) );
+		assert( read_mem(&emus[i], 0x80) == 0x42 );
+		assert( read_mem(&emus[i], 0x81) == 0x99 );
+		assert( read_mem(&emus[i], 0x82) == 0x00 );
+		assert( read_mem(&emus[i], 0x83) == 0x42 );
+				assert( emus[i].X == 0x07 );
+	}
+
+	//a write straight to it is dropped too, and a rollback leaves it be
+	checkpoint_em6502(&emus[1]);
+	write_mem(&emus[1], 0xF12B, 0x00);
+	assert( read_mem(&emus[1], 0xF12B) == 0x99 );
+	assert( (emus[1].dirty_pages[0xF1 / 8] & (1 << (0xF1 % 8))) == 0 );
+	rollback_em6502(&emus[1]);
+	assert( read_mem(&emus[1], 0xF12B) == 0x99 );
+
+	for ( i = 0; i < 3; i++ )
+	{
+		destroy_em6502(&emus[i]);
+	}
+	close_rom(&rom);
+	assert( (rom.data == 0) );
+}
+#endif
+
+#ifdef ENABLE_LOADER
+/**************************************
+ * Name:  test_loader
+ * Inputs:  None
+ * Outputs: None
+ * Function: unit tests for load_image; each format goes where it says,
+ *			 at any addr, and a bad image loads nothing at all
+ *
+***************************************/
+void test_loader()
+{
+	unsigned char program[] =
+	{
+		0xEA //NOP
+	};
+	unsigned char raw[0x30];
+	unsigned char prg[] =
+	{
+		0x00, 0xC0, //load at $C000
+		0xA9, 0x05, //LDA #$05
+		0x00 //BRK
+	};
+	const char *hex =
+		":03100000A907EA53\r\n" //LDA #$07, NOP
+		":02100300E80003\r\n" //INX, BRK; carries on from the last one
+		":01800000552A\r\n"
+		":020000020800F4\r\n" //segment $0800, so addr 0 is $8000
+		":010000006699\r\n"
+		":0400000500001000E7\r\n" //start at $1000
+		":00000001FF\r\n";
+	const char *bad_hex =
+		":03100000A907EA53\n"
+		":01800000552B\n" //checksum's off by one
+		":00000001FF\n";
+	const char *far_hex =
+		":020000040001F9\n" //the second 64K
+		":010000006699\n"
+		":00000001FF\n";
+	unsigned char xex[] =
+	{
+		0xFF, 0xFF,
+		0x00, 0x20, 0x02, 0x20, //$2000-$2002
+		0xA2, 0x09, //LDX #$09
+		0x00, //BRK
+		0xFF, 0xFF,
+		0xE0, 0x02, 0xE1, 0x02, //RUNAD
+		0x00, 0x20
+	};
+	image_info info;
+	int i;
+
+	SETUP_UNIT_TEST("test_loader") ;
+
+	emulator.stop_at_brk = 1;
+	for ( i = 0; i < sizeof(raw); i++ )
+	{
+		raw[i] = i + 1;
+	}
+
+	//raw, straddling a page
+	assert( load_image(&emulator, raw, sizeof(raw), IMAGE_RAW, 0x12F0, &info) );
+	assert( info.format == IMAGE_RAW );
+	assert( info.num_segments == 1 );
+	assert( (info.segments[0].addr == 0x12F0 && info.segments[0].size == sizeof(raw)) );
+	assert( emulator.PC == 0x12F0 );
+	assert( read_mem(&emulator, 0x12F0) == 0x01 );
+	assert( read_mem(&emulator, 0x131F) == 0x30 );
+	assert( read_mem(&emulator, 0x1320) == 0x00 );
+
+	//load_program takes any addr now too
+	load_program(&emulator, raw, 4, 0x0345);
+	assert( emulator.PC == 0x0345 );
+	assert( read_mem(&emulator, 0x0348) == 0x04 );
+
+	//a page pointed somewhere else breaks the run in two
+	emulator.page_table[0x31]->data = &emulator._memory[0x5000];
+	update_page(&emulator, 0x31);
+	assert( load_image(&emulator, raw, sizeof(raw), IMAGE_RAW, 0x30F0, 0) );
+	assert( emulator._memory[0x30FF] == 0x10 );
+	assert( emulator._memory[0x5000] == 0x11 );
+	assert( emulator._memory[0x501F] == 0x30 );
+	assert( emulator._memory[0x3100] == 0x00 );
+	emulator.page_table[0x31]->data = &emulator._memory[0x3100];
+	update_page(&emulator, 0x31);
+
+	//prg
+	assert( load_image(&emulator, prg, sizeof(prg), IMAGE_PRG, 0, &info) );
+	assert( (info.num_segments == 1 && info.segments[0].addr == 0xC000 && info.segments[0].size == 3) );
+	assert( emulator.PC == 0xC000 );
+	assert( (run_program(&emulator, 10) == STOP_BRK) );
+	assert( emulator.Acc == 0x05 );
+
+	//hex, with the records that follow on from each other as one segment
+	assert( load_image(&emulator, (const unsigned char *)hex, strlen(hex), IMAGE_AUTO, 0, &info) );
+	assert( info.format == IMAGE_HEX );
+	assert( info.num_segments == 3 );
+	assert( (info.segments[0].addr == 0x1000 && info.segments[0].size == 5) );
+	assert( (info.segments[2].addr == 0x8000 && info.segments[2].size == 1) );
+	assert( info.entry == 0x1000 );
+	assert( read_mem(&emulator, 0x8000) == 0x66 );
+	assert( (run_program(&emulator, 10) == STOP_BRK) );
+	assert( (emulator.Acc == 0x07 && emulator.X == 0x01) );
+
+	//xex, starting from RUNAD
+	assert( load_image(&emulator, xex, sizeof(xex), IMAGE_AUTO, 0, &info) );
+	assert( info.format == IMAGE_XEX );
+	assert( info.num_segments == 2 );
+	assert( info.entry == 0x2000 );
+	assert( read_mem(&emulator, 0x02E1) == 0x20 );
+	assert( (run_program(&emulator, 10) == STOP_BRK) );
+	assert( emulator.X == 0x09 );
+
+	//none of these load anything, or move PC
+	emulator.PC = 0x1234;
+	write_mem(&emulator, 0x1000, 0x00);
+	assert( !load_image(&emulator, (const unsigned char *)bad_hex, strlen(bad_hex), IMAGE_HEX, 0, &info) );
+	assert( !load_image(&emulator, (const unsigned char *)far_hex, strlen(far_hex), IMAGE_HEX, 0, &info) );
+	assert( !load_image(&emulator, (const unsigned char *)hex, strlen(hex) - 13, IMAGE_HEX, 0, &info) );
+	assert( !load_image(&emulator, xex, sizeof(xex) - 1, IMAGE_XEX, 0, &info) );
+	assert( !load_image(&emulator, prg, 1, IMAGE_PRG, 0, &info) );
+	assert( !load_image(&emulator, raw, sizeof(raw), IMAGE_RAW, 0xFFE0, &info) );
+	assert( read_mem(&emulator, 0x1000) == 0x00 );
+	assert( emulator.PC == 0x1234 );
+
+	destroy_em6502( &emulator );
+}
+#endif
+
+#ifdef ENABLE_CARTRIDGE
+/**************************************
+ * Name:  test_cartridge
+ * Inputs:  None
+ * Outputs: None
+ * Function: unit tests for the 2600 cartridge mapper; code switches banks by
+ *			 touching hotspots in any mirror, and the ROM never gets copied
+ *
+***************************************/
+void test_cartridge()
+{
+	unsigned char program[] =
+	{
+		0xEA //NOP
+	};
+	unsigned char bank1[] =
+	{
+		0xA9, 0x11, //LDA #$11
+		0x85, 0x80, //STA $80
+		0xAD, 0xF8, 0xFF //LDA $FFF8, bank 0 from here on
+	};
+	unsigned char bank0[] =
+	{
+		0xA9, 0x22, //LDA #$22, at $F007
+		0x85, 0x81, //STA $81
+		0x2C, 0xF9, 0x1F, //BIT $1FF9, bank 1 again, through another mirror
+	};
+	unsigned char bank1_end[] =
+	{
+		0xE6, 0x82, //INC $82, at $F00E
+		0x00 //BRK
+	};
+	unsigned char bank1_top[] =
+	{
+		0xA9, 0x33, //LDA #$33, at $FFF4
+		0xEA, //NOP
+		0xEA //NOP, right below the hotspots
+	};
+	static unsigned char image[0x2000];
+	#ifdef ENABLE_PREDECODE_CACHE
+	decoded_instr *decoded;
+	#endif
+	#ifdef ENABLE_DYNAREC
+	struct dynarec_page *translated;
+	#endif
+	cartridge cart;
+	int i;
+
+	SETUP_UNIT_TEST("test_cartridge") ;
+
+	memset(image, 0, sizeof(image));
+	memcpy(&image[0x1000], bank1, sizeof(bank1));
+	memcpy(&image[0x0007], bank0, sizeof(bank0));
+	memcpy(&image[0x100E], bank1_end, sizeof(bank1_end));
+	memcpy(&image[0x1FF4], bank1_top, sizeof(bank1_top));
+	image[0x0800] = 0xA0;
+	image[0x1800] = 0xB1;
+
+	//F8 starts in its last bank
+	assert( !initialize_cartridge(&cart, image, 0x1000, CART_F8) );
+	assert( initialize_cartridge(&cart, image, sizeof(image), CART_F8) );
+	assert( attach_cartridge(&emulator, &cart) );
+	assert( (emulator.page_table[0xF0]->data == &image[0x1000]) );
+	assert( (emulator.page_table[0x38]->data == &image[0x1800]) );
+	assert( read_mem(&emulator, 0x5800) == 0xB1 );
+
+	//only the hotspots are watched; the rest of the ROM has no listener at all
+	assert( READ_WATCHED(&emulator, 0xFFF8) );
+	assert( READ_WATCHED(&emulator, 0x1FF9) );
+	assert( !READ_WATCHED(&emulator, 0xFFF7) );
+	assert( !HAS_LISTENER(emulator.page_table[0xFF]) );
+
+	#ifdef ENABLE_FAST_MEMORY
+	//so reads of it go straight to the image, except in the page with the hotspots
+	assert( (emulator.read_pages[0xF0] == &image[0x1000]) );
+	assert( (emulator.read_pages[0xFF] == 0) );
+	assert( SLOW_PAGE(&emulator, 0xF000) );
+	#endif
+
+	emulator.stop_at_brk = 1;
+	for ( i = 0; i < 2; i++ )
+	{
+		emulator.PC = 0xF000;
+		assert( (run_program(&emulator, 20) == STOP_BRK) );
+		assert( emulator.PC == 0xF010 );
+		assert( read_mem(&emulator, 0x80) == 0x11 );
+		assert( read_mem(&emulator, 0x81) == 0x22 );
+		assert( read_mem(&emulator, 0x82) == i + 1 );
+		assert( cart.slice[0] == 1 );
+		assert( cart.switches == 2 * i + 2 );
+	}
+
+	//decoding, fusing and translating code that ends right below the hotspots doesnt touch them;
+	//only the cpu fetching from them does
+	emulator.PC = 0xFFF4;
+	assert( (run_program(&emulator, 3) == STOP_BUDGET) );
+	assert( emulator.PC == 0xFFF8 );
+	assert( emulator.Acc == 0x33 );
+	assert( cart.slice[0] == 1 );
+	assert( cart.switches == 4 );
+
+	//writes switch too, and dont go anywhere
+	write_mem(&emulator, 0x3FF8, 0x55);
+	assert( cart.slice[0] == 0 );
+	assert( read_mem(&emulator, 0xF800) == 0xA0 );
+	assert( read_mem(&emulator, 0x3FF8) == 0x00 );
+
+	//and a slice's decoded and translated code comes back with it
+	#ifdef ENABLE_PREDECODE_CACHE
+	decoded = emulator.decode_cache[0xF0];
+	#endif
+	#ifdef ENABLE_DYNAREC
+	translated = emulator.dynarec_pages[0xF0];
+	#endif
+	switch_bank(&emulator, &cart, 0, 1);
+	switch_bank(&emulator, &cart, 0, 0);
+	#ifdef ENABLE_PREDECODE_CACHE
+	assert( (emulator.decode_cache[0xF0] == decoded) );
+	#endif
+	#ifdef ENABLE_DYNAREC
+	assert( (emulator.dynarec_pages[0xF0] == translated) );
+	assert( (emulator.engine == ENGINE_INTERPRETER || translated != 0) );
+	#endif
+
+	destroy_em6502(&emulator);
+	destroy_cartridge(&cart);
+
+	//E0: a slice for each of the first 3 windows, and the last one fixed
+	initialize_em6502(&emulator);
+	create_simple_memory_map(&emulator);
+	for ( i = 0; i < 8; i++ )
+	{
+		image[i * 0x400] = i;
+	}
+	assert( initialize_cartridge(&cart, image, sizeof(image), CART_E0) );
+	assert( attach_cartridge(&emulator, &cart) );
+	assert( read_mem(&emulator, 0xF000) == 4 );
+	assert( read_mem(&emulator, 0xF800) == 6 );
+	assert( read_mem(&emulator, 0xFC00) == 7 );
+	read_mem(&emulator, 0x1FE1);
+	write_mem(&emulator, 0xBFEA, 0x00);
+	assert( read_mem(&emulator, 0xF000) == 1 );
+	assert( read_mem(&emulator, 0xF400) == 2 );
+	assert( read_mem(&emulator, 0x1400) == 2 );
+	assert( read_mem(&emulator, 0xF800) == 6 );
+	destroy_em6502(&emulator);
+	destroy_cartridge(&cart);
+
+	//3F: whatever's written to the zero page's first $40 picks the bank
+	initialize_em6502(&emulator);
+	create_simple_memory_map(&emulator);
+	assert( initialize_cartridge(&cart, image, sizeof(image), CART_3F) );
+	assert( attach_cartridge(&emulator, &cart) );
+	assert( read_mem(&emulator, 0xF000) == 0 );
+	assert( read_mem(&emulator, 0xF800) == 6 );
+	write_mem(&emulator, 0x003F, 0x02);
+	assert( read_mem(&emulator, 0xF000) == 4 );
+	write_mem(&emulator, 0x0040, 0x01);
+	assert( read_mem(&emulator, 0xF000) == 4 );
+	destroy_em6502(&emulator);
+	destroy_cartridge(&cart);
+}
+#endif
+
+/**************************************
+ * Name:  test_reset_and_destroy
+ * Inputs:  None
+ * Outputs: None
+ * Function: unit tests for reset_em6502 and destroy_em6502; a reset emulator
+ *			 runs the same as a new one, on the memory it already had
+ *
+***************************************/
+void test_reset_and_destroy()
+{
+	unsigned char program[] =
+	{
+		0xA2, 0x03, //LDX #$03
+		0xE8, //INX
+		0x86, 0x10, //STX $10
+		0x38 //SEC
+	};
+	unsigned char *memory;
+
+	SETUP_UNIT_TEST("test_reset_and_destroy") ;
+
+	memory = emulator._memory;
+	emulator.page_table[3]->cb_mem_listener = count_accesses;
+	update_page(&emulator, 3);
+	set_breakpoint(&emulator, 0x02);
+
+	assert( run_program(&emulator, 4) == STOP_BREAKPOINT );
+	assert( emulator.X == 0x03 );
+
+	reset_em6502(&emulator);
+	assert( (emulator._memory == memory) );
+	assert( emulator._memory[0x00] == 0x00 );
+	assert( (emulator.page_table[3]->cb_mem_listener == 0) );
+	assert( (emulator.breakpoints == 0) );
+	assert( (emulator.PC == 0x00 && emulator.X == 0x00 && emulator.S == 0xFF) );
+	#ifdef ALLOW_MAX_INSTR_COUNT
+	assert( emulator.instr_count == 0 );
+	#endif
+
+	//and it runs like it was never used
+	load_program( &emulator, &program, sizeof(program), 0);
+	assert( run_program(&emulator, 4) == STOP_BUDGET );
+	assert( emulator.X == 0x04 );
+	assert( emulator._memory[0x10] == 0x04 );
+	assert( (CARRY_GET(emulator.P)) );
+
+	destroy_em6502( &emulator );
+	assert( (emulator.arena == 0) );
+	assert( (emulator._memory == 0) );
+	assert( (emulator.breakpoints == 0) );
+}
+
+
+#ifdef ENABLE_CYCLE_COUNT
+/**************************************
+ * Name:  test_cycles
+ * Inputs:  None
+ * Outputs: None
+ * Function: unit tests for cycle counting; page crossings, branches,
+ *			 and running for a number of cycles
+ *
+***************************************/
+void test_cycles()
+{
+	unsigned char program[] =
+	{
+		0xA9, 0x01, //LDA #$01, 2
+		0xA2, 0xFF, //LDX #$FF, 2
+		0xBD, 0x01, 0x10, //LDA $1001,X, 4 + 1 for crossing into $1100
+		0xBD, 0x00, 0x10, //LDA $1000,X, 4
+		0x9D, 0x01, 0x10, //STA $1001,X, 5 whether it crosses or not
+		0xF0, 0x00, //BEQ $000F, 2 + 1 for being taken
+		0xD0, 0x00, //BNE $0011, 2
+		0x4C, 0xFC, 0x00 //JMP $00FC, 3
+	};
+
+	SETUP_UNIT_TEST("test_cycles") ;
+
+	emulator._memory[0xFC] = 0xF0; //BEQ $0102, 2 + 1 for being taken + 1 for landing in the next page
+	emulator._memory[0xFD] = 0x04;
+	emulator._memory[0x102] = 0xEA; //NOP, 2
+	emulator._memory[0x200] = 0x4C; //JMP $0200, 3
+	emulator._memory[0x201] = 0x00;
+	emulator._memory[0x202] = 0x02;
+
+	assert( run_program(&emulator, 3) == STOP_BUDGET );
+	assert( emulator.cycles == 9 );
+	run_program(&emulator, 7);
+	assert( emulator.PC == 0x103 );
+	assert( emulator.cycles == 32 );
+
+	//the instr budget still counts
+	emulator.PC = 0x200;
+	assert( run_program_cycles(&emulator, 5, 1000) == STOP_BUDGET );
+	#ifdef ALLOW_MAX_INSTR_COUNT
+	assert( emulator.instr_count == 15 );
+	#endif
+	assert( emulator.cycles == 47 );
+
+	//instrs that start within the budget run, even if they end past it
+	assert( run_program_cycles(&emulator, -1, 1000) == STOP_BUDGET );
+	#ifdef ALLOW_MAX_INSTR_COUNT
+	assert( emulator.instr_count == 349 );
+	#endif
+	assert( emulator.cycles == 1049 );
+
+	//whether or not they're fast-forwarded through
+	#ifdef ENABLE_IDLE_SKIP
+	emulator.idle_skip = 0;
+	#endif
+	assert( run_program_cycles(&emulator, -1, 999) == STOP_BUDGET );
+	#ifdef ALLOW_MAX_INSTR_COUNT
+	assert( emulator.instr_count == 682 );
+	#endif
+	assert( emulator.cycles == 2048 );
+
+	destroy_em6502( &emulator );
+}
+#endif
+
+
+#ifdef ENABLE_EVENTS
+//what the event callbacks below saw, in the order they ran
+static unsigned long long event_cycles[16];
+static unsigned char event_x[16];
+static int events_run;
+
+//notes down when it ran, and what context it got
+static void record_event( em6502 *emu, void *context )
+{
+	event_cycles[events_run] = emu->cycles;
+	event_x[events_run] = emu->X;
+	events_run++;
+	*(int *)context += 1;
+}
+
+//same, then runs again 100 cycles after it was due
+static void periodic_event( em6502 *emu, void *context )
+{
+	record_event(emu, context);
+	schedule_event(emu, event_cycles[events_run - 1] / 100 * 100 + 100, periodic_event, context);
+}
+
+/**************************************
+ * Name:  test_events
+ * Inputs:  None
+ * Outputs: None
+ * Function: unit tests for the event scheduler; order, cancelling, events
+ *			 rescheduling themselves, and idle loops running up to them
+ *
+***************************************/
+void test_events()
+{
+	unsigned char program[] =
+	{
+		0xE8, //INX, 2
+		0x4C, 0x00, 0x00 //JMP $0000, 3
+	};
+	int count = 0;
+	unsigned int id;
+	int i;
+
+	SETUP_UNIT_TEST("test_events") ;
+
+	//they run in cycle order, ties in the order they were scheduled
+	events_run = 0;
+	assert( schedule_event(&emulator, 50, record_event, &count) != 0 );
+	assert( schedule_event(&emulator, 20, record_event, &count) != 0 );
+	id = schedule_event(&emulator, 30, record_event, &count);
+	assert( schedule_event(&emulator, 20, record_event, &count) != 0 );
+	assert( cancel_event(&emulator, id) == 1 );
+	assert( cancel_event(&emulator, id) == 0 );
+
+	assert( run_program(&emulator, 20) == STOP_BUDGET );
+	#ifdef ALLOW_MAX_INSTR_COUNT
+	assert( emulator.instr_count == 20 );
+	#endif
+	assert( emulator.cycles == 50 );
+	assert( events_run == 2 );
+	assert( count == 2 );
+	//the INX that starts at cycle 20 hasnt run yet
+	assert( (event_cycles[0] == 20 && event_cycles[1] == 20) );
+	assert( (event_x[0] == 4 && event_x[1] == 4) );
+
+	//due right where the last run stopped, so it's the first thing the next one does
+	assert( run_program(&emulator, 1) == STOP_BUDGET );
+	assert( events_run == 3 );
+	assert( event_cycles[2] == 50 );
+	assert( emulator.cycles == 52 );
+
+	//a timer; the ones due by the end of the budget run, the one right at it waits
+	events_run = 0;
+	count = 0;
+	emulator.X = 0;
+	assert( schedule_event(&emulator, 100, periodic_event, &count) != 0 );
+	assert( run_program_cycles(&emulator, -1, 1000 - emulator.cycles) == STOP_BUDGET );
+	assert( events_run == 9 );
+	for ( i = 0; i < events_run; i++ )
+	{
+		assert( (event_cycles[i] >= (i + 1) * 100 && event_cycles[i] < (i + 1) * 100 + 3) );
+	}
+	assert( emulator.cycles >= 1000 );
+	assert( emulator.num_events == 1 );
+
+	//an idle loop gets fast-forwarded right up to the event, not past it
+	reset_em6502(&emulator);
+	emulator._memory[0] = 0x4C; //JMP $0000
+	emulator._memory[1] = 0x00;
+	emulator._memory[2] = 0x00;
+	events_run = 0;
+	assert( schedule_event(&emulator, 3000, record_event, &count) != 0 );
+	assert( schedule_event(&emulator, 3001, record_event, &count) != 0 );
+	assert( run_program(&emulator, 5000) == STOP_BUDGET );
+	assert( events_run == 2 );
+	assert( event_cycles[0] == 3000 );
+	assert( event_cycles[1] == 3003 );
+	#ifdef ALLOW_MAX_INSTR_COUNT
+	assert( emulator.instr_count == 5000 );
+	#endif
+	assert( emulator.cycles == 15000 );
+
+	//only so many at once
+	reset_em6502(&emulator);
+	for ( i = 0; i < MAX_EVENTS; i++ )
+	{
+		assert( schedule_event(&emulator, 10, record_event, &count) != 0 );
+	}
+	assert( schedule_event(&emulator, 10, record_event, &count) == 0 );
+
+	destroy_em6502( &emulator );
+}
+#endif
+
+
+#ifdef ENABLE_INTERRUPTS
+//a device that pulls IRQ when its event comes up
+static void raise_irq( em6502 *emu, void *context )
+{
+	set_irq(emu, 3, 1);
+}
+
+/**************************************
+ * Name:  test_interrupts
+ * Inputs:  None
+ * Outputs: None
+ * Function: unit tests for IRQ, NMI and RESET; when they get taken, what gets
+ *			 pushed, masking, and IRQ being a level while NMI is an edge
+ *
+***************************************/
+void test_interrupts()
+{
+	unsigned char program[] =
+	{
+		0x78, //SEI
+		0xEA, //NOP
+		0x58, //CLI
+		0xE8, //loop: INX
+		0x4C, 0x03, 0x00 //JMP loop
+	};
+	unsigned char irq_handler[] =
+	{
+		0xC8, //INY
+		0x40 //RTI
+	};
+	unsigned char nmi_handler[] =
+	{
+		0xE6, 0x10, //INC $10
+		0x40 //RTI
+	};
+	unsigned char vectors[] =
+	{
+		0x00, 0x03, //NMI, $0300
+		0x00, 0x04, //RESET, $0400
+		0x00, 0x02 //IRQ, $0200
+	};
+	unsigned char S;
+	unsigned int y;
+	int i;
+
+	SETUP_UNIT_TEST("test_interrupts") ;
+	load_program(&emulator, irq_handler, sizeof(irq_handler), 0x0200);
+	load_program(&emulator, nmi_handler, sizeof(nmi_handler), 0x0300);
+	for ( i = 0; i < sizeof(vectors); i++ )
+	{
+		write_mem(&emulator, 0xFFFA + i, vectors[i]);
+	}
+	emulator.PC = 0;
+	S = emulator.S;
+
+	//held while I is set, it waits for the CLI and gets taken right after it
+	assert( run_program(&emulator, 1) == STOP_BUDGET );
+	set_irq(&emulator, 3, 1);
+	assert( run_program(&emulator, 3) == STOP_BUDGET );
+	assert( emulator.PC == 0x0201 );
+	assert( emulator.Y == 1 );
+	assert( emulator.S == (unsigned char)(S - 3) );
+	assert( (emulator._memory[0x100 + S] == 0x00 && emulator._memory[0x100 + S - 1] == 0x03) );
+	assert( (emulator._memory[0x100 + S - 2] & 0x14) == 0 ); //pushed with I and B clear
+	assert( (IRQ_DISABLE_GET(emulator.P)) );
+	assert( emulator.cycles == 2 + 2 + 2 + 7 + 2 );
+
+	//as long as it's held, RTI lets it straight back in
+	assert( run_program(&emulator, 4) == STOP_BUDGET );
+	assert( emulator.PC == 0x0201 );
+	assert( emulator.Y == 3 );
+	assert( emulator.S == (unsigned char)(S - 3) );
+
+	//let go, it's back to the loop
+	set_irq(&emulator, 3, 0);
+	assert( run_program(&emulator, 20) == STOP_BUDGET );
+	assert( emulator.Y == 3 );
+	assert( emulator.S == S );
+	assert( (emulator.PC >= 0x0003 && emulator.PC <= 0x0004) );
+
+	//a device raising it from an event
+	assert( schedule_event(&emulator, emulator.cycles + 100, raise_irq, 0) != 0 );
+	assert( run_program_cycles(&emulator, -1, 99) == STOP_BUDGET );
+	assert( emulator.Y == 3 );
+	assert( run_program_cycles(&emulator, -1, 10) == STOP_BUDGET );
+	assert( emulator.Y >= 4 );
+	set_irq(&emulator, 3, 0);
+	assert( run_program(&emulator, 10) == STOP_BUDGET );
+
+	//NMI gets taken with I set, once per edge
+	emulator.P |= 0x04;
+	y = emulator.Y;
+	set_irq(&emulator, 0, 1);
+	set_nmi(&emulator, 1);
+	assert( run_program(&emulator, 1) == STOP_BUDGET );
+	assert( emulator.PC == 0x0302 );
+	assert( emulator._memory[0x10] == 1 );
+	assert( run_program(&emulator, 50) == STOP_BUDGET );
+	assert( emulator._memory[0x10] == 1 );
+	set_nmi(&emulator, 1);
+	assert( run_program(&emulator, 50) == STOP_BUDGET );
+	assert( emulator._memory[0x10] == 1 );
+	set_nmi(&emulator, 0);
+	set_nmi(&emulator, 1);
+	assert( run_program(&emulator, 50) == STOP_BUDGET );
+	assert( emulator._memory[0x10] == 2 );
+	assert( emulator.Y == y ); //the IRQ stayed masked the whole time
+	assert( emulator.S == S );
+	set_irq(&emulator, 0, 0);
+
+	//RESET starts over from its vector, and doesnt write the stack
+	emulator._memory[0x100 + S] = 0xAA;
+	trigger_reset(&emulator);
+	emulator.cycles = 0;
+	assert( run_program(&emulator, 0) == STOP_BUDGET );
+	assert( emulator.PC == 0x0400 );
+	assert( emulator.S == (unsigned char)(S - 3) );
+	assert( emulator._memory[0x100 + S] == 0xAA );
+	assert( (IRQ_DISABLE_GET(emulator.P)) );
+	assert( emulator.cycles == 7 );
+
+	destroy_em6502( &emulator );
+}
+#endif
+
+
+#ifdef ENABLE_BATCH
+/**************************************
+ * Name:  test_batch
+ * Inputs:  None
+ * Outputs: None
+ * Function: unit tests for the batch runner; results, exit reasons, and
+ *			 getting the same ones whatever the number of threads
+ *
+***************************************/
+void test_batch()
+{
+	unsigned char countdown[] =
+	{
+		0xA2, 0x05, //LDX #$05
+		0xCA, //loop: DEX
+		0xD0, 0xFD, //BNE loop
+		0x00 //BRK
+	};
+	unsigned char spin[] =
+	{
+		0xE8, //loop: INX
+		0x4C, 0x00, 0x02 //JMP loop
+	};
+	unsigned char invalid[] = { 0xEA, 0x02 };
+	batch_job jobs[6];
+	batch_result results[6];
+	batch_result one_thread[6];
+	char line[256];
+	FILE *out;
+	int i;
+
+	printf("running test_batch...\n");
+
+	memset(jobs, 0, sizeof(jobs));
+	strcpy(jobs[0].path, "countdown");
+	jobs[0].image = countdown;
+	jobs[0].image_size = sizeof(countdown);
+	jobs[0].load_addr = jobs[0].start_pc = 0x0600;
+
+	strcpy(jobs[1].path, "spin");
+	jobs[1].image = spin;
+	jobs[1].image_size = sizeof(spin);
+	jobs[1].load_addr = jobs[1].start_pc = 0x0200;
+
+	strcpy(jobs[2].path, "no/such/file.bin");
+
+	strcpy(jobs[3].path, "invalid");
+	jobs[3].image = invalid;
+	jobs[3].image_size = sizeof(invalid);
+
+	//the same again, anywhere in memory
+	jobs[4] = jobs[0];
+	jobs[4].load_addr = jobs[4].start_pc = 0x1234;
+	jobs[5] = jobs[0];
+
+	for ( i = 0; i < 6; i++ )
+	{
+		jobs[i].max_instrs = 100;
+		jobs[i].max_cycles = NO_CYCLE_LIMIT;
+	}
+	jobs[1].max_cycles = 50;
+
+	run_batch(jobs, results, 6, 3);
+
+	assert( results[0].stop == STOP_BRK );
+	assert( results[0].PC == 0x0605 );
+	assert( results[0].X == 0 );
+	assert( results[0].instr_count == 11 );
+	assert( (results[0].cycles == 2 + 5 * 2 + 5 * 3 - 1) );
+
+	assert( results[1].stop == STOP_BUDGET );
+	assert( results[1].instr_count == 20 );
+	assert( results[1].X == 10 );
+
+	assert( results[2].stop == STOP_LOAD_ERROR );
+	assert( results[3].stop == STOP_INVALID_OPCODE );
+	assert( results[3].PC == 0x0001 );
+
+	assert( results[4].stop == STOP_BRK );
+	assert( results[4].PC == 0x1239 );
+	assert( (results[4].mem_hash != results[0].mem_hash) );
+	assert( (results[5].mem_hash == results[0].mem_hash) );
+
+	run_batch(jobs, one_thread, 6, 1);
+	assert( memcmp(results, one_thread, sizeof(results)) == 0 );
+
+	out = tmpfile();
+	write_result_json(out, 2, &jobs[2], &results[2]);
+	write_result_json(out, 0, &jobs[0], &results[0]);
+	rewind(out);
+	fgets(line, sizeof(line), out);
+	assert( strcmp(line, "{\"job\":2,\"path\":\"no/such/file.bin\",\"exit\":\"load_error\"}\n") == 0 );
+	fgets(line, sizeof(line), out);
+	assert( strncmp(line, "{\"job\":0,\"path\":\"countdown\",\"exit\":\"brk\",\"pc\":1541,\"a\":0,\"x\":0,", 61) == 0 );
+	fclose(out);
+}
+#endif
+
+
+#ifdef ENABLE_LOCKSTEP
+/**************************************
+ * Name:  test_lockstep
+ * Inputs:  None
+ * Outputs: None
+ * Function: unit tests for the lockstep lanes; every lane has to end up exactly
+ *			 where run_program leaves the same emulator, however far apart they drift
+ *
+***************************************/
+void test_lockstep()
+{
+	unsigned char program[] =
+	{
+		0xA5, 0x10, //LDA $10
+		0xA2, 0x00, //LDX #$00
+		0x4A, //loop: LSR A
+		0x90, 0x02, //BCC skip
+		0x49, 0xB8, //EOR #$B8
+		0x9D, 0xFF, 0x02, //skip: STA $02FF,X
+		0x20, 0x20, 0x06, //JSR sub
+		0xE8, //INX
+		0xE0, 0x10, //CPX #$10
+		0xD0, 0xF0, //BNE loop
+		0xA5, 0x11, //LDA $11
+		0xF0, 0x01, //BEQ done
+		0x02, //an invalid opcode, for the lanes with $11 set
+		0x00, //done: BRK
+		0xEA, 0xEA, 0xEA, 0xEA, 0xEA, 0xEA, //padding
+		0x48, //sub: PHA
+		0x18, //CLC
+		0x65, 0x12, //ADC $12
+		0x85, 0x12, //STA $12
+		0x68, //PLA
+		0x60 //RTS
+	};
+	em6502 emus[8];
+	em6502 emulator;
+	lockstep lanes;
+	int stops[8];
+	unsigned int instrs;
+	int i;
+	int budget;
+
+	printf("running test_lockstep...\n");
+
+	initialize_em6502(&emulator);
+	create_simple_memory_map(&emulator);
+
+	//once running everything, once stopping partway through the loop
+	for ( budget = 0; budget < 2; budget++ )
+	{
+		initialize_lockstep(&lanes, 8);
+		lanes.stop_at_brk = 1;
+
+		for ( i = 0; i < 8; i++ )
+		{
+			initialize_em6502(&emus[i]);
+			SET_TEST_ENGINE(emus[i]);
+			create_simple_memory_map(&emus[i]);
+			emus[i].stop_at_brk = 1;
+			load_program(&emus[i], &program, sizeof(program), 0x0600);
+			write_mem(&emus[i], 0x10, 0x11 * i + 3);
+			write_mem(&emus[i], 0x11, i & 4);
+			write_mem(&emus[i], 0x12, i);
+			load_lockstep_lane(&lanes, i, &emus[i]);
+		}
+
+		for ( i = 0; i < 8; i++ )
+		{
+			stops[i] = run_program_cycles(&emus[i], budget ? 40 : -1, NO_CYCLE_LIMIT);
+		}
+		run_lockstep(&lanes, budget ? 40 : -1, NO_CYCLE_LIMIT);
+
+		for ( i = 0; i < 8; i++ )
+		{
+			assert( (lanes.stop[i] == stops[i]) );
+			assert( (lanes.stop[i] == (budget ? STOP_BUDGET : (i & 4) ? STOP_INVALID_OPCODE : STOP_BRK)) );
+
+			reset_em6502(&emulator);
+			store_lockstep_lane(&lanes, i, &emulator);
+			assert( (emulator.Acc == emus[i].Acc) );
+			assert( (emulator.X == emus[i].X) );
+			assert( (emulator.Y == emus[i].Y) );
+			assert( (emulator.P == emus[i].P) );
+			assert( (emulator.S == emus[i].S) );
+			assert( (emulator.PC == emus[i].PC) );
+			assert( (emulator.instr_count == emus[i].instr_count) );
+			assert( (emulator.cycles == emus[i].cycles) );
+			assert( memcmp(emulator._memory, emus[i]._memory, MEMORY_SIZE) == 0 );
+
+			instrs = emus[i].instr_count;
+			destroy_em6502(&emus[i]);
+		}
+
+		//the lanes branch different ways, so they cant all have been run together every step
+		assert( lanes.steps > instrs );
+		assert( (lanes.steps < 8 * instrs) );
+
+		destroy_lockstep(&lanes);
+	}
+
+	destroy_em6502(&emulator);
+}
+#endif
+
+
+#ifdef ENABLE_THROTTLE
+/**************************************
+ * Name:  test_throttle
+ * Inputs:  None
+ * Outputs: None
+ * Function: unit tests for real-time runs; pacing, stopping partway through
+ *			 a frame, and a host that cant keep up
+ *
+***************************************/
+void test_throttle()
+{
+	unsigned char program[] =
+	{
+		0xE8, //INX, 2
+		0x4C, 0x00, 0x00 //JMP $0000, 3
+	};
+	throttle t;
+	struct timespec before;
+	struct timespec after;
+	long long elapsed;
+	int i;
+
+	SETUP_UNIT_TEST("test_throttle") ;
+
+	//1000 cycles a frame, each one 10ms
+	clock_gettime(CLOCK_MONOTONIC, &before);
+	start_throttle(&emulator, &t, 100000, 100);
+	for ( i = 0; i < 5; i++ )
+	{
+		assert( run_frame(&emulator, &t) == STOP_BUDGET );
+	}
+	clock_gettime(CLOCK_MONOTONIC, &after);
+	elapsed = (after.tv_sec - before.tv_sec) * 1000000000LL + (after.tv_nsec - before.tv_nsec);
+
+	assert( t.frames == 5 );
+	assert( (emulator.cycles >= 5000 && emulator.cycles < 5005) );
+	assert( elapsed >= 50000000 );
+	assert( t.overruns == 0 );
+
+	//a frame that stops early gets finished by the next call
+	set_breakpoint(&emulator, 0x0001);
+	assert( run_frame(&emulator, &t) == STOP_BREAKPOINT );
+	assert( t.frames == 5 );
+	clear_breakpoint(&emulator, 0x0001);
+	assert( run_frame(&emulator, &t) == STOP_BUDGET );
+	assert( t.frames == 6 );
+	assert( (emulator.cycles >= 6000 && emulator.cycles < 6005) );
+
+	//20 million cycles in 1ms is more than any host can do
+	start_throttle(&emulator, &t, 20000000000ULL, 1000);
+	t.max_lag_frames = 1000000;
+	assert( run_frame(&emulator, &t) == STOP_BUDGET );
+	assert( run_frame(&emulator, &t) == STOP_BUDGET );
+	assert( t.overruns == 2 );
+	assert( t.drift_ns > 0 );
+	assert( t.resyncs == 0 );
+	assert( t.frame == 2 );
+
+	//past max_lag_frames, it stops trying to catch up
+	t.max_lag_frames = 0;
+	assert( run_frame(&emulator, &t) == STOP_BUDGET );
+	assert( t.resyncs == 1 );
+	assert( t.frame == 0 );
+	assert( t.start_cycles == emulator.cycles );
+
+	destroy_em6502( &emulator );
+}
+#endif
+
+
+#ifdef ENABLE_IDLE_SKIP
+void test_idle_skip()
+{
+	//this waits for a key, counts up in memory, then spins on a JMP to itself
+	//it has to come out the same as without fast-forwarding through the idle parts
+	unsigned char program[] =
+	{
+		0xA5, 0xFF, //LDA $FF, the key pressed
+		0xF0, 0xFC, //BEQ $0000
+		0x85, 0x10, //STA $10
+		0xA2, 0x40, //LDX #$40
+		0xE6, 0x11, //loop: INC $11
+		0xCA, //DEX
+		0xD0, 0xFB, //BNE loop
+		0x4C, 0x0D, 0x00 //JMP $000D
+	};
+	unsigned int slices[] = { 1, 2, 3, 5, 100 };
+	unsigned int count;
+	em6502 other;
+	int i;
+
+	SETUP_UNIT_TEST("test_idle_skip") ;
+
+	memset(emulator._memory, 0, MEMORY_SIZE);
+	load_program( &emulator, &program, sizeof(program), 0);
+
+	initialize_em6502( &other);
+	SET_TEST_ENGINE(other);
+	create_simple_memory_map( &other );
+	memset(other._memory, 0, MEMORY_SIZE);
+	load_program( &other, &program, sizeof(program), 0);
+	other.idle_skip = 0;
+
+	//waiting for the key
+	for ( i = 0; i < 20; i++ )
+	{
+		run_program(&emulator, slices[i % 5]);
+		run_program(&other, slices[i % 5]);
+	}
+
+	assert( emulator.PC == other.PC );
+	assert( emulator.Acc == other.Acc );
+	assert( emulator.P == other.P );
+	assert( emulator.instr_count == other.instr_count );
+	assert( emulator.idle.skipped > 0 );
+	assert( other.idle.skipped == 0 );
+
+	//the key comes in between calls; the loop isnt idle anymore
+	emulator._memory[0xFF] = 0x07;
+	other._memory[0xFF] = 0x07;
+
+	for ( i = 0; i < 100; i++ )
+	{
+		run_program(&emulator, slices[i % 5]);
+		run_program(&other, slices[i % 5]);
+	}
+
+	assert( emulator.Acc == other.Acc );
+	assert( emulator.X == other.X );
+	assert( emulator.Y == other.Y );
+	assert( emulator.P == other.P );
+	assert( emulator.S == other.S );
+	assert( emulator.PC == other.PC );
+	assert( emulator.instr_count == other.instr_count );
+	assert( memcmp(emulator._memory, other._memory, MEMORY_SIZE) == 0 );
+	assert( emulator._memory[0x10] == 0x07 );
+	assert( emulator._memory[0x11] == 0x40 );
+	assert( emulator.PC == 0x0D );
+
+	//a billion instrs of JMP $000D go by without running them
+	count = emulator.instr_count;
+	run_program(&emulator, 1000000000);
+	assert( emulator.instr_count == count + 1000000000 );
+	assert( emulator.PC == 0x0D );
+	assert( emulator.idle.skipped > 999000000 );
+
+	destroy_em6502( &emulator );
+	destroy_em6502( &other );
+}
+#endif
+
+
+void test_disassembler()
+{
+	//this tests the opcode table and the disassembler built from it
+	unsigned char program[] =
+	{
+		0xA9, 0x0F, //LDA #$0F
+		0xB1, 0x20, //LDA ($20),Y
+		0x9D, 0x00, 0x02, //STA $0200,X
+		0x0A, //ASL A
+		0x6C, 0x34, 0x12, //JMP ($1234)
+		0xD0, 0xF3, //BNE $0000
+		0xCA, //DEX
+		0x02 //not a 6502 opcode
+	};
+	char text[DISASSEMBLY_MAX_LEN];
+	int addr = 0;
+
+	printf("running test_disassembler...\n");
+
+	assert( opcode_table[0xA9].mode == MODE_IMMEDIATE );
+	assert( opcode_table[0xA9].length == 2 );
+	assert( opcode_table[0xA9].cycles == 2 );
+	assert( opcode_table[0xBD].page_penalty == 1 );
+	assert( opcode_table[0x9D].page_penalty == 0 );
+	assert( opcode_table[0x02].mode == MODE_NONE );
+
+	addr += disassemble_instr(&program[addr], addr, text);
+	assert( strcmp(text, "LDA #$0F") == 0 );
+	addr += disassemble_instr(&program[addr], addr, text);
+	assert( strcmp(text, "LDA ($20),Y") == 0 );
+	addr += disassemble_instr(&program[addr], addr, text);
+	assert( strcmp(text, "STA $0200,X") == 0 );
+	addr += disassemble_instr(&program[addr], addr, text);
+	assert( strcmp(text, "ASL A") == 0 );
+	addr += disassemble_instr(&program[addr], addr, text);
+	assert( strcmp(text, "JMP ($1234)") == 0 );
+	addr += disassemble_instr(&program[addr], addr, text);
+	assert( strcmp(text, "BNE $0000") == 0 );
+	addr += disassemble_instr(&program[addr], addr, text);
+	assert( strcmp(text, "DEX") == 0 );
+	addr += disassemble_instr(&program[addr], addr, text);
+	assert( strcmp(text, "dcb $02") == 0 );
+	assert( addr == sizeof(program) );
+}
+
+
+#ifdef ENABLE_DYNAREC
+void test_engines_agree()
+{
+	//this runs a program that loops, calls, and overwrites its own code on both engines
+	//and checks they end up in exactly the same state, however the run gets sliced up
+	//sub goes through most of the instrs and addressing modes the dynarec translates
+	unsigned char program[] =
+	{
+		0xA2, 0x00, //LDX #$00
+		0xA0, 0x10, //LDY #$10
+		0x8A, //loop: TXA
+		0x9D, 0x00, 0x03, //STA $0300,X
+		0x7D, 0x00, 0x03, //ADC $0300,X
+		0x20, 0x20, 0x00, //JSR sub
+		0xE8, //INX
+		0x88, //DEY
+		0xD0, 0xF2, //BNE loop
+		0xEE, 0x21, 0x00, //INC sub+1, changes what sub loads
+		0x4C, 0x02, 0x00, //JMP $0002
+		0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+		0xA9, 0x00, //sub: LDA #$00
+		0x65, 0xF0, //ADC $F0
+		0x85, 0xF0, //STA $F0
+		0x26, 0xF1, //ROL $F1
+		0x48, //PHA
+		0xE9, 0x03, //SBC #$03
+		0x91, 0x0E, //STA ($0E),Y, the INX/DEY above make the pointer
+		0xD1, 0x21, //CMP ($21),Y, and the operand INC changes is part of this one
+		0x24, 0xF1, //BIT $F1
+		0x46, 0xF0, //LSR $F0
+		0x6A, //ROR A
+		0xA1, 0x10, //LDA ($10,X), the pointer can be past the zero page
+		0x5D, 0xF0, 0x03, //EOR $03F0,X, into the next page once X gets to $10
+		0x68, //PLA
+		0x36, 0xF2, //ROL $F2,X
+		0x3E, 0x00, 0x03, //ROL $0300,X
+		0xE0, 0x80, //CPX #$80
+		0xC4, 0xF0, //CPY $F0
+		0x60 //RTS
+	};
+	unsigned int slices[] = { 1, 3, 17, 250, 1000 };
+	em6502 other;
+	int i;
+
+	SETUP_UNIT_TEST("test_engines_agree") ;
+
+	initialize_em6502( &other);
+	create_simple_memory_map( &other );
+	load_program( &other, &program, sizeof(program), 0);
+
+	emulator.engine = ENGINE_INTERPRETER;
+	other.engine = ENGINE_DYNAREC;
+
+	for ( i = 0; i < 500; i++ )
+	{
+		run_program(&emulator, slices[i % 5]);
+		run_program(&other, slices[i % 5]);
+	}
+
+	assert( emulator.Acc == other.Acc );
+	assert( emulator.X == other.X );
+	assert( emulator.Y == other.Y );
+	assert( emulator.P == other.P );
+	assert( emulator.S == other.S );
+	assert( emulator.PC == other.PC );
+	assert( emulator.instr_count == other.instr_count );
+	#ifdef ENABLE_CYCLE_COUNT
+	assert( emulator.cycles == other.cycles );
+	#endif
+	assert( memcmp(emulator._memory, other._memory, MEMORY_SIZE) == 0 );
+
+	destroy_em6502( &emulator );
+	destroy_em6502( &other );
+}
+
+#endif
+
+
+#ifdef ENABLE_FUSION
+/**************************************
+ * Name:  test_fusion
+ * Inputs:  None
+ * Outputs: None
+ * Function: checks fusions.def against the opcode table, and that fused
+ *			 sequences run exactly like the instrs in them do on their own
+ *
+***************************************/
+void test_fusion()
+{
+	//the first STA of the fused triple changes where the second one stores
+	unsigned char program[] =
+	{
+		0xA2, 0x00, //LDX #$00
+		0xA0, 0x00, //LDY #$00
+		0xA9, 0x20, //loop: LDA #$20
+		0x99, 0x0A, 0x00, //STA $000A,Y, the low byte of the next STA's addr
+		0x99, 0x30, 0x00, //STA $0030,Y
+		0x99, 0x40, 0x00, //STA $0040,Y
+		0xE8, //INX
+		0x8A, //TXA
+		0xC9, 0x10, //CMP #$10
+		0xD0, 0xEF, //BNE loop
+		0xA2, 0x05, //LDX #$05
+		0xCA, //DEX
+		0xD0, 0xFD, //BNE $0017
+		0x4C, 0x1A, 0x00 //JMP $001A
+	};
+	unsigned int slices[] = { 1, 2, 3, 5, 100 };
+	em6502 other;
+	int i;
+
+	SETUP_UNIT_TEST("test_fusion") ;
+
+	//every fused instr has to be spelled the way opcodes.def has it,
+	//and only the last one can go somewhere else
+	#define CHECK_FUSED_INSTR(op,m,md,len,last) \
+		assert( strcmp(opcode_table[op].mnemonic, #m) == 0 ); \
+		assert( opcode_table[op].mode == MODE_##md ); \
+		assert( opcode_table[op].length == len ); \
+		assert( (last || !changes_flow(op)) )
+	#define FUSE2(op1,m1,mode1,len1,op2,m2,mode2,len2) \
+		CHECK_FUSED_INSTR(op1,m1,mode1,len1,0); \
+		CHECK_FUSED_INSTR(op2,m2,mode2,len2,1);
+	#define FUSE3(op1,m1,mode1,len1,op2,m2,mode2,len2,op3,m3,mode3,len3) \
+		CHECK_FUSED_INSTR(op1,m1,mode1,len1,0); \
+		CHECK_FUSED_INSTR(op2,m2,mode2,len2,0); \
+		CHECK_FUSED_INSTR(op3,m3,mode3,len3,1);
+	#include "fusions.def"
+	#undef FUSE2
+	#undef FUSE3
+	#undef CHECK_FUSED_INSTR
+
+	memset(emulator._memory, 0, MEMORY_SIZE);
+	load_program( &emulator, &program, sizeof(program), 0);
+
+	initialize_em6502( &other);
+	create_simple_memory_map( &other );
+	memset(other._memory, 0, MEMORY_SIZE);
+	load_program( &other, &program, sizeof(program), 0);
+	other.fusion = 0;
+
+	for ( i = 0; i < 100; i++ )
+	{
+		run_program(&emulator, slices[i % 5]);
+		run_program(&other, slices[i % 5]);
+	}
+
+	assert( emulator.Acc == other.Acc );
+	assert( emulator.X == other.X );
+	assert( emulator.Y == other.Y );
+	assert( emulator.P == other.P );
+	assert( emulator.S == other.S );
+	assert( emulator.PC == other.PC );
+	#ifdef ALLOW_MAX_INSTR_COUNT
+	assert( emulator.instr_count == other.instr_count );
+	#endif
+	assert( memcmp(emulator._memory, other._memory, MEMORY_SIZE) == 0 );
+
+	//the second STA went where the first one pointed it, right from the start
+	assert( emulator._memory[0x0020] == 0x20 );
+	assert( emulator._memory[0x0030] == 0x00 );
+	assert( emulator._memory[0x0040] == 0x20 );
+	assert( emulator.X == 0x00 );
+	assert( emulator.PC == 0x001A );
+
+	//INX/TXA and DEX/BNE really did get fused
+	assert( emulator.decode_cache[0][0x0F].handler > 255 );
+	assert( emulator.decode_cache[0][0x17].handler > 255 );
+	assert( other.decode_cache[0][0x0F].handler == 0xE8 );
+
+	destroy_em6502( &emulator );
+	destroy_em6502( &other );
+}
+#endif
+
+
+void test_program_1()
+{
+	//this runs a random looping program
+	unsigned char program[] =
+	{
+	0xA9, 0x0F, 0x8D, 0x00, 0x00, 0xA9, 0x04, 0x8D,
+	0x01, 0x00, 0xA9, 0x01, 0x8D, 0x02, 0x00, 0xAD,
+	0x00, 0x00, 0x8D, 0x03, 0x00, 0xAD, 0x01, 0x00,
+	0x8D, 0x04, 0x00, 0xAD, 0x02, 0x00, 0xC9, 0x00,
+	0xD0, 0x06, 0xEE, 0x00, 0x00, 0x4C, 0x2B, 0x00,
+	0xCE, 0x00, 0x00, 0xAE, 0x02, 0x00, 0xAD, 0x00,
+	0x00, 0xC9, 0x1F, 0xD0, 0x05, 0xA2, 0x01, 0x4C,
+	0x40, 0x00, 0xC9, 0x00, 0xD0, 0x02, 0xA2, 0x00,
+	0x8E, 0x02, 0x00, 0xA9, 0x01, 0xA2, 0x00, 0x81,
+	0x00, 0xA9, 0x00, 0xA2, 0x00, 0x81, 0x03, 0x4C,
+	0x0F, 0x00
+	};
+
+	SETUP_UNIT_TEST("test_program_1") ;
+
+	run_program(&emulator, 100);
+
+	destroy_em6502( &emulator );
 }
 
 
@@ -4,18 +4,60 @@
 
 # Add inputs and outputs from these tool invocations to the build variables 
 C_SRCS += \
+../6502/alu.c \
+../6502/batch.c \
+../6502/lockstep.c \
+../6502/page_store.c \
+../6502/rom.c \
+../6502/loader.c \
+../6502/cartridge.c \
+../6502/benchmark.c \
+../6502/dynarec.c \
 ../6502/em_6502.c \
+../6502/events.c \
 ../6502/harness.c \
+../6502/idle.c \
+../6502/opcodes.c \
+../6502/profile.c \
+../6502/throttle.c \
 ../6502/unit_test.c 
 
 OBJS += \
+./6502/alu.o \
+./6502/batch.o \
+./6502/lockstep.o \
+./6502/page_store.o \
+./6502/rom.o \
+./6502/loader.o \
+./6502/cartridge.o \
+./6502/benchmark.o \
+./6502/dynarec.o \
 ./6502/em_6502.o \
+./6502/events.o \
 ./6502/harness.o \
+./6502/idle.o \
+./6502/opcodes.o \
+./6502/profile.o \
+./6502/throttle.o \
 ./6502/unit_test.o 
 
 C_DEPS += \
+./6502/alu.d \
+./6502/batch.d \
+./6502/lockstep.d \
+./6502/page_store.d \
+./6502/rom.d \
+./6502/loader.d \
+./6502/cartridge.d \
+./6502/benchmark.d \
+./6502/dynarec.d \
 ./6502/em_6502.d \
+./6502/events.d \
 ./6502/harness.d \
+./6502/idle.d \
+./6502/opcodes.d \
+./6502/profile.d \
+./6502/throttle.d \
 ./6502/unit_test.d 
 
 